@@ -0,0 +1,56 @@
+#!/bin/sh
+# Requests per second for the bundled greet.py, once forked per request
+# through cgi_pass and once through a spawned FastCGI worker pool.
+# Usage: bench/cgi_vs_fastcgi.sh [requests] [concurrency] [workers]
+# Run from the repository root after building webserv.
+
+REQUESTS=${1:-500}
+CONCURRENCY=${2:-8}
+WORKERS=${3:-4}
+PORT=8193
+CONFIG=/tmp/webserv_fastcgi_bench.$$.ini
+URLS=/tmp/webserv_fastcgi_bench.$$.urls
+
+cat > $CONFIG <<EOF
+[server:localhost]
+port=$PORT
+
+[route:/fork]
+methods=GET
+cgi_pass=/cgi-bin/greet.py
+
+[route:/cgi-bin]
+methods=GET
+cgi_pass=fastcgi://spawn:/cgi-bin/fcgi_worker.py
+fastcgi_workers=$WORKERS
+EOF
+
+./webserv $CONFIG > /dev/null 2>&1 &
+PID=$!
+sleep 1
+
+# The session cookie keeps session creation out of the numbers
+run() {
+  i=0
+  : > $URLS
+  while [ $i -lt $REQUESTS ]; do
+    echo "url = \"http://localhost:$PORT$1?name=bench$i&age=$i\"" >> $URLS
+    echo "output = \"/dev/null\"" >> $URLS
+    i=$((i + 1))
+  done
+  # One warm-up request, so the FastCGI workers have compiled the script
+  curl -s -o /dev/null -b session_id=bench "http://localhost:$PORT$1"
+  START=$(date +%s%N)
+  curl -s -b session_id=bench --parallel --parallel-max $CONCURRENCY -K $URLS 2> /dev/null
+  END=$(date +%s%N)
+  awk -v name="$2" -v n=$REQUESTS -v ns=$((END - START)) \
+    'BEGIN { printf "  %-28s %8.1f req/s %8.2f ms/req\n", name, n / (ns / 1e9), ns / 1e6 / n }'
+}
+
+echo "$REQUESTS requests to greet.py, $CONCURRENCY at a time:"
+run /fork/greet.py "CGI, fork per request"
+run /cgi-bin/greet.py "FastCGI, $WORKERS workers"
+
+kill -INT $PID
+wait $PID 2> /dev/null
+rm -f $CONFIG $URLS
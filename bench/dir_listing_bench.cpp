@@ -0,0 +1,113 @@
+// Directory listing benchmark: readdir + ostringstream page build on every
+// request (the old path) against the mtime-validated cache streamed in chunks.
+//
+//   ./dir_listing_bench [entries]     (default 100000)
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include "DirectoryListingCache.hpp"
+#include "DirectoryListingRenderer.hpp"
+#include "ParsingUtils.hpp"
+
+static double now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+// Reads and drops what the listing queued until all of it went through
+static void drain(OutputQueue& out, int peer) {
+  char buffer[65536];
+  do {
+    while (read(peer, buffer, sizeof(buffer)) > 0)
+      ;
+  } while (out.flush() && out.isPending());
+}
+
+static std::string legacyPage(const std::string& directoryPath, const std::string& uri) {
+  std::vector<std::string> contents = ParsingUtils::getDirectoryContents(directoryPath);
+  std::ostringstream html;
+  html << "<html><head><title>Directory Listing of " << uri << "</title></head><body>";
+  html << "<h2>Directory Listing of " << uri << "</h2><ul>";
+  for (std::vector<std::string>::const_iterator it = contents.begin(); it != contents.end(); ++it)
+    html << "<li><a href=\"" << uri << "/" << *it << "\">" << *it << "</a></li>";
+  html << "</ul></body></html>";
+  return html.str();
+}
+
+int main(int argc, char** argv) {
+  size_t count = (argc > 1) ? std::strtoul(argv[1], NULL, 10) : 100000;
+  char tmpl[] = "/tmp/webserv_listing_XXXXXX";
+  if (mkdtemp(tmpl) == NULL) {
+    perror("mkdtemp");
+    return 1;
+  }
+  std::string dir(tmpl);
+  for (size_t i = 0; i < count; ++i) {
+    std::string path = dir + "/upload_" + ParsingUtils::toString(i) + ".bin";
+    int fd = open(path.c_str(), O_CREAT | O_WRONLY, 0644);
+    if (fd >= 0)
+      close(fd);
+  }
+  int pair[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == -1) {
+    perror("socketpair");
+    return 1;
+  }
+  fcntl(pair[0], F_SETFL, O_NONBLOCK);
+  fcntl(pair[1], F_SETFL, O_NONBLOCK);
+  OutputQueue sink;
+  sink.setFd(pair[0]);
+  const int rounds = 5;
+  Cookie cookie("", "");
+
+  double start = now();
+  size_t bytes = 0;
+  for (int i = 0; i < rounds; ++i)
+    bytes += legacyPage(dir, "/uploads").size();
+  double legacy = (now() - start) / rounds;
+
+  DirectoryListingCache cache;
+  start = now();
+  const DirectoryListing* listing = cache.getListing(dir);
+  double cold = now() - start;
+
+  DirectoryListingQuery full;
+  start = now();
+  for (int i = 0; i < rounds; ++i) {
+    DirectoryListingRenderer::stream(cache.getListing(dir), cache, full, "/uploads", cookie, sink);
+    drain(sink, pair[1]);
+  }
+  double warmFull = (now() - start) / rounds;
+
+  DirectoryListingQuery paged = DirectoryListingQuery::fromQueryString("sort=mtime&order=desc&page=7&per_page=100");
+  listing->at(0, DirectoryListing::SORT_MTIME); // build the mtime order once
+  start = now();
+  for (int i = 0; i < rounds * 100; ++i) {
+    DirectoryListingRenderer::stream(cache.getListing(dir), cache, paged, "/uploads", cookie, sink);
+    drain(sink, pair[1]);
+  }
+  double warmPage = (now() - start) / (rounds * 100);
+
+  std::cout << "entries:                      " << listing->size() << std::endl;
+  cache.release(listing);
+  std::cout << "legacy readdir + build:       " << legacy << " ms/request (" << bytes / rounds << " bytes in memory)" << std::endl;
+  std::cout << "cache miss (readdir + stat):  " << cold << " ms" << std::endl;
+  std::cout << "cache hit, full page stream:  " << warmFull << " ms/request" << std::endl;
+  std::cout << "cache hit, 100-entry page:    " << warmPage << " ms/request" << std::endl;
+
+  close(pair[0]);
+  close(pair[1]);
+  for (size_t i = 0; i < count; ++i)
+    unlink((dir + "/upload_" + ParsingUtils::toString(i) + ".bin").c_str());
+  rmdir(dir.c_str());
+  return 0;
+}
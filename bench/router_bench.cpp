@@ -0,0 +1,97 @@
+// Router benchmark: 10k routes, matched through the compiled segment trie and
+// through the old lookup (map::at, std::out_of_range on a miss, a retry on the
+// parent path and a full Route copy per hit).
+//
+//   ./router_bench [routes]     (default 10000)
+
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <sys/time.h>
+#include "Router.hpp"
+#include "ParsingUtils.hpp"
+
+static double now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static std::string parentPath(const std::string& path) {
+  size_t pos = path.find_last_of('/');
+  if (pos == std::string::npos || pos == 0)
+    return path;
+  return path.substr(0, pos);
+}
+
+static bool legacyLookup(const std::map<std::string, Route>& routes, const std::string& path, Route& route) {
+  try {
+    route = routes.at(path);
+  } catch (const std::out_of_range&) {
+    try {
+      route = routes.at(parentPath(path));
+    } catch (const std::out_of_range&) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  size_t count = (argc > 1) ? std::strtoul(argv[1], NULL, 10) : 10000;
+  std::map<std::string, Route> routes;
+  Route route;
+  route.setGetMethod(true);
+  for (size_t i = 0; i < count; ++i) {
+    std::string path = "/api/v" + ParsingUtils::toString(i % 4) + "/service" + ParsingUtils::toString(i / 4);
+    route.setRoutePath(path);
+    routes[path] = route;
+  }
+  route.setRoutePath("/");
+  routes["/"] = route;
+
+  double start = now();
+  Router router;
+  router.compile(routes);
+  double compileTime = now() - start;
+
+  // A mix of exact hits, file requests below a route, deep paths and misses
+  std::vector<std::string> paths;
+  for (size_t i = 0; i < 1000; ++i) {
+    std::string base = "/api/v" + ParsingUtils::toString(i % 4) + "/service" + ParsingUtils::toString((i * 7) % (count / 4));
+    paths.push_back(base);
+    paths.push_back(base + "/index.html");
+    paths.push_back(base + "/img/large/x.jpg");
+    paths.push_back("/scanner/wp-login.php" + ParsingUtils::toString(i));
+  }
+
+  const int rounds = 200;
+  size_t hits = 0;
+  start = now();
+  for (int r = 0; r < rounds; ++r)
+    for (size_t i = 0; i < paths.size(); ++i) {
+      const RouteRecord* record = router.match(paths[i]);
+      if (record != NULL && record->route->getRoutePath() != "/")
+        ++hits;
+    }
+  double trieTime = now() - start;
+
+  size_t legacyHits = 0;
+  start = now();
+  for (int r = 0; r < rounds; ++r)
+    for (size_t i = 0; i < paths.size(); ++i) {
+      Route found;
+      if (legacyLookup(routes, paths[i], found))
+        ++legacyHits;
+    }
+  double legacyTime = now() - start;
+
+  size_t lookups = rounds * paths.size();
+  std::cout << "routes:                 " << router.size() << " (compiled in " << compileTime << " ms)" << std::endl;
+  std::cout << "trie match:             " << trieTime * 1e6 / lookups << " ns/lookup, " << hits / rounds << "/" << paths.size() << " below a non-root route" << std::endl;
+  std::cout << "legacy map::at + retry: " << legacyTime * 1e6 / lookups << " ns/lookup, " << legacyHits / rounds << "/" << paths.size() << " found" << std::endl;
+  return 0;
+}
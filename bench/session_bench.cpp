@@ -0,0 +1,88 @@
+// Session creation benchmark. The old generator reseeded rand() with
+// time(NULL) on every call, so it produced one ID per second and
+// createSession() spun until the clock ticked; the ChaCha20-backed one
+// hands out 132-bit IDs from a buffer. Lookups are what every request
+// with a session cookie pays: getSessionData() and incrementRequestCount(),
+// in a scattered order so the table does not stay in cache.
+//
+//   ./session_bench [sessions] [legacy seconds] [lookups]
+//   (default 1000000, 3, 10000000)
+
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <ctime>
+#include <sys/time.h>
+#include "SessionManager.hpp"
+
+static double now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static std::string legacyID() {
+  std::string id;
+  static const char alphanum[] =
+    "0123456789"
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+    "abcdefghijklmnopqrstuvwxyz";
+  srand((unsigned) time(NULL));
+  for (int i = 0; i < 10; ++i)
+    id += alphanum[rand() % (sizeof(alphanum) - 1)];
+  return id;
+}
+
+int main(int argc, char** argv) {
+  int sessions = argc > 1 ? std::atoi(argv[1]) : 1000000;
+  int legacySeconds = argc > 2 ? std::atoi(argv[2]) : 3;
+  long lookups = argc > 3 ? std::atol(argv[3]) : 10000000L;
+
+  // Old createSession(): generate until the ID is not taken yet
+  std::set<std::string> legacy;
+  unsigned long legacyCalls = 0;
+  double start = now();
+  while (now() - start < legacySeconds * 1000.0) {
+    ++legacyCalls;
+    legacy.insert(legacyID());
+  }
+  double legacyMs = now() - start;
+
+  SessionManager generator;
+  start = now();
+  for (int i = 0; i < sessions; ++i)
+    generator.generateUniqueID();
+  double generateMs = now() - start;
+
+  SessionManager store(sessions, 0, 0);
+  std::vector<std::string> ids;
+  ids.reserve(sessions);
+  start = now();
+  for (int i = 0; i < sessions; ++i)
+    ids.push_back(store.createSession());
+  double createMs = now() - start;
+
+  unsigned long found = 0;
+  start = now();
+  for (long i = 0; i < lookups; ++i) {
+    SessionData* session = store.getSessionData(ids[(i * 7919) % sessions]);
+    if (session != NULL) {
+      session->incrementRequestCount();
+      ++found;
+    }
+  }
+  double lookupMs = now() - start;
+
+  std::cout << "legacy srand(time) IDs: " << legacy.size() << " distinct out of " << legacyCalls
+            << " calls in " << legacyMs / 1000.0 << " s, " << legacy.size() / (legacyMs / 1000.0) << " sessions/s" << std::endl;
+  std::cout << "ChaCha20 IDs:           " << sessions / (generateMs / 1000.0) << " IDs/s, "
+            << generateMs * 1000000.0 / sessions << " ns each" << std::endl;
+  std::cout << "createSession():        " << sessions / (createMs / 1000.0) << " sessions/s, "
+            << createMs * 1000000.0 / sessions << " ns each (" << store.getSessionCount() << " stored)" << std::endl;
+  std::cout << "getSessionData():       " << lookups / (lookupMs / 1000.0) << " lookups/s, "
+            << lookupMs * 1000000.0 / lookups << " ns each (" << found << " found)" << std::endl;
+  return 0;
+}
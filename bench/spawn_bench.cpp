@@ -0,0 +1,85 @@
+// CGI spawn benchmark: starts /bin/true the way executeCGI used to (fork,
+// then execve in the child) and the way it does now (posix_spawn), while the
+// process's resident set grows. fork copies the page tables, so its cost
+// grows with RSS; posix_spawn shares the address space until the exec.
+//
+//   ./spawn_bench [max MB] [spawns]     (default 1024 MB, 200 spawns)
+
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <spawn.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+static double now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static pid_t forkSpawn(char** argv) {
+  pid_t pid = fork();
+  if (pid == 0) {
+    execve(argv[0], argv, environ);
+    _exit(127);
+  }
+  return pid;
+}
+
+static pid_t posixSpawn(char** argv) {
+  pid_t pid = -1;
+  if (posix_spawn(&pid, argv[0], NULL, NULL, argv, environ) != 0)
+    return -1;
+  return pid;
+}
+
+// Milliseconds per spawn, waiting for each child before the next
+static double measure(pid_t (*spawn)(char**), int spawns) {
+  char* argv[2];
+  argv[0] = const_cast<char*>("/bin/true");
+  argv[1] = NULL;
+  double start = now();
+  for (int i = 0; i < spawns; ++i) {
+    pid_t pid = spawn(argv);
+    if (pid == -1) {
+      std::cerr << "spawn failed" << std::endl;
+      std::exit(1);
+    }
+    waitpid(pid, NULL, 0);
+  }
+  return (now() - start) / spawns;
+}
+
+int main(int argc, char** argv) {
+  size_t maxMb = argc > 1 ? std::strtoul(argv[1], NULL, 10) : 1024;
+  int spawns = argc > 2 ? std::atoi(argv[2]) : 200;
+  std::vector<char*> blocks;
+  size_t rssMb = 0;
+
+  std::cout << "RSS grown by   fork+execve    posix_spawn" << std::endl;
+  for (size_t targetMb = 0; targetMb <= maxMb; targetMb = targetMb == 0 ? 64 : targetMb * 4) {
+    // Touched, so the pages are resident and mapped
+    while (rssMb < targetMb) {
+      char* block = new char[1 << 20];
+      std::memset(block, 1, 1 << 20);
+      blocks.push_back(block);
+      ++rssMb;
+    }
+    double forked = measure(forkSpawn, spawns);
+    double spawned = measure(posixSpawn, spawns);
+    std::cout.width(7);
+    std::cout << rssMb << " MB";
+    std::cout.width(11);
+    std::cout << forked << " ms";
+    std::cout.width(12);
+    std::cout << spawned << " ms" << std::endl;
+  }
+  for (size_t i = 0; i < blocks.size(); ++i)
+    delete[] blocks[i];
+  return 0;
+}
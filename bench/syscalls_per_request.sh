@@ -0,0 +1,37 @@
+#!/bin/sh
+# Counts the syscalls webserv makes per request with strace -c.
+# Usage: bench/syscalls_per_request.sh [path] [requests] [config]
+# Run from the repository root after building webserv.
+
+URL_PATH=${1:-/website/index.html}
+REQUESTS=${2:-100}
+CONFIG=${3:-configs/all_routes.ini}
+OUT=/tmp/webserv_syscalls.$$
+
+if ! command -v strace > /dev/null; then
+  echo "strace not found" >&2
+  exit 1
+fi
+
+./webserv "$CONFIG" > /dev/null 2>&1 &
+PID=$!
+sleep 1
+# One warm-up request so cold caches don't count
+curl -s -o /dev/null "http://localhost:8080$URL_PATH"
+
+strace -c -f -p $PID -o $OUT &
+STRACE=$!
+sleep 1
+i=0
+while [ $i -lt $REQUESTS ]; do
+  curl -s -o /dev/null "http://localhost:8080$URL_PATH"
+  i=$((i + 1))
+done
+kill -INT $STRACE
+wait $STRACE 2> /dev/null
+kill -INT $PID
+
+echo "$REQUESTS requests to $URL_PATH, calls per request:"
+awk -v n=$REQUESTS '$4 ~ /^[0-9]+$/ && $NF != "total" { printf "  %-16s %8.2f\n", $NF, $4 / n }' $OUT \
+  | grep -E "stat|access|open|close|read|write|sendfile|epoll" | sort -k2 -rn
+rm -f $OUT
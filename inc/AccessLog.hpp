@@ -0,0 +1,89 @@
+#ifndef ACCESSLOG_HPP
+#define ACCESSLOG_HPP
+
+#include <string>
+#include <vector>
+#include <ctime>
+#include <stdint.h>
+
+struct AccessLogOptions {
+    std::string path;   // "" for no access log
+    size_t maxSize;     // bytes before the file is rotated, 0 never
+    size_t sampleRate;  // one request in sampleRate is logged
+
+    AccessLogOptions();
+    bool operator==(const AccessLogOptions& other) const;
+};
+
+// One JSON object per line for each request, for latency percentiles and
+// per-route traffic offline. Lines are buffered and written from the reactor
+// loop, like the Logger's. Past maxSize bytes the file moves to <path>.1,
+// and older ones up to <path>.KEEP_FILES.
+class AccessLog {
+  public:
+    // One request. Timings are in microseconds: parse from its first byte
+    // until it is complete, route for the virtual host, session and route
+    // lookups, fs from there to the first byte of the response (filesystem
+    // work, or the script starting), send from there to the last byte.
+    struct Record {
+      bool open;
+      struct timespec started;
+      uint32_t client;
+      std::string vhost;
+      std::string method;
+      std::string path;
+      int status;  // 0 while nothing was sent
+      size_t bytesIn;
+      size_t bytesOut;
+      long parseUs;
+      long routeUs;
+      long fsUs;
+      long sendUs;
+      long lastUs;      // end of the last timed stage
+      long responseUs;  // first byte of the response, 0 before
+
+      Record();
+      // Adds the time since the last stage ended to stage
+      void lap(long& stage);
+    };
+
+    static const size_t KEEP_FILES = 5;
+
+    AccessLog();
+    ~AccessLog();
+
+    void configure(const AccessLogOptions& options);
+    bool isEnabled(void) const;
+    // Opens record for the request starting on clientFd
+    void begin(Record& record, int clientFd, uint32_t client);
+    // Closes record, and logs it if sampled; every 5xx is
+    void finish(Record& record, int clientFd);
+    void flush(void);
+
+    // Told about everything about to be sent to a client, headers included;
+    // the status is read from the status line. Does nothing unless a record
+    // is open on clientFd, so callers need not check.
+    static void sending(int clientFd, const char* data, size_t size);
+    static std::string format(const Record& record);
+    static long nowUs(void);
+
+  private:
+    static const size_t BUFFER_LIMIT = 64 * 1024;
+    // Open records by client fd
+    static std::vector<Record*> records;
+
+    AccessLogOptions options;
+    int logFd;
+    size_t fileSize;
+    unsigned long requests;
+    std::string buffer;
+
+    void openFile(void);
+    void rotate(void);
+    static void appendString(std::string& out, const std::string& value);
+
+    AccessLog(const AccessLog&);
+    AccessLog& operator=(const AccessLog&);
+};
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef CGIBODYSTREAM_HPP
+#define CGIBODYSTREAM_HPP
+
+#include <string>
+#include <sys/types.h>
+#include "EventHandler.hpp"
+
+class Reactor;
+
+// Told once the stream is done; it deletes itself right after. complete is
+// false when the client went away before sending the whole body.
+class CgiBodyListener {
+  public:
+    virtual ~CgiBodyListener() {}
+    virtual void cgiBodyStreamed(bool complete) = 0;
+};
+
+// Feeds a request body to a CGI script's stdin as it arrives from the
+// client. Socket data is spliced into the pipe without a copy through user
+// space. While the pipe is full the client's reads are paused and the pipe
+// is watched for room instead, so a slow script holds back the client
+// rather than growing a buffer here. If the script stops reading, the rest
+// of the body is drained from the socket and dropped.
+class CgiBodyStream : public EventHandler {
+  public:
+    CgiBodyStream(int pipeFd, int clientFd, size_t remaining, Reactor* reactor, CgiBodyListener* listener);
+    ~CgiBodyStream();
+
+    // Registers the pipe; received is the body read along with the headers
+    void start(const std::string& received);
+    // The client socket is readable
+    void pump(void);
+    // The response is out; the script gets no more input
+    void stopFeeding(void);
+    // The listener is gone: drops everything and deletes the stream
+    void abort(void);
+
+    void handleEvent(uint32_t events);
+    void closeConnection(void);
+
+  private:
+    int clientFd;
+    size_t remaining;   // still to come from the client
+    std::string pending; // read from the client, not yet in the pipe
+    Reactor* reactor;
+    CgiBodyListener* listener;
+    bool registered;
+    bool paused;
+    bool useSplice;
+
+    ssize_t readClient(void);
+    bool flushPending(void);
+    bool isPipeFull(void);
+    void pause(void);
+    void resume(void);
+    void closePipe(void);
+    void finish(bool complete);
+
+    CgiBodyStream(const CgiBodyStream&);
+    CgiBodyStream& operator=(const CgiBodyStream&);
+};
+
+#endif
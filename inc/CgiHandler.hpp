@@ -1,25 +1,117 @@
 #ifndef CGIHANDLER_HPP
 #define CGIHANDLER_HPP
 
+#include <map>
 #include <string>
-#include <sstream>
+#include <vector>
 #include <sys/epoll.h>
 #include "EventHandler.hpp"
 #include "Reactor.hpp"
+#include "ProcessReaper.hpp"
+#include "CgiResponseCache.hpp"
+#include "CgiResponseHeader.hpp"
+#include "Route.hpp"
+#include "CgiScheduler.hpp"
 
-class CgiHandler : public EventHandler {
+// Told once the script's response has been sent, or could not be; the
+// handler deletes itself right before. complete is false when the response
+// was cut short after its header went out, so the connection must close.
+class CgiOutputListener {
+  public:
+    virtual ~CgiOutputListener() {}
+    virtual void cgiOutputDone(bool complete) = 0;
+};
+
+// Runs a CGI script and streams its output to the client as it is written.
+// The script's header block is parsed first; the body then follows with
+// the script's Content-Length if it gave one, and nothing past it, in
+// chunks otherwise, spliced from the pipe to the socket. While the socket
+// is full the pipe is not read, so a slow client holds back the script
+// instead of growing a buffer here. Cached routes have no client: their output is collected whole for
+// the CgiResponseCache.
+class CgiHandler : public EventHandler, public ChildExitListener, public CgiScript {
 private:
-    int client_fd;
-    std::ostringstream cgiOutputBuffer; // Buffer to store CGI output
+    // Told when done; NULL once it left, or for cached routes
+    CgiOutputListener* listener;
+    // -1 for cached routes, or once the client is gone
+    int clientFd;
     Reactor *reactor;
     int childPid;
+    // Write end of the script's stdin, until the caller takes it
+    int inputFd;
+    // Set for cached routes: the output goes to the CgiResponseCache, which
+    // answers the waiting clients, instead of to the client
+    std::string cacheKey;
+    long cacheTtlMs;
+    long cacheStaleMs;
+    // Whole output for cached routes, the header block read so far otherwise
+    std::string output;
+    CgiResponseHeader header;
+    bool headerDone;
+    bool bodyStarted;
+    bool chunked;
+    size_t chunkLeft;   // of the current chunk, still in the pipe
+    size_t bodyLeft;    // of the script's Content-Length, still in the pipe
+    std::string pending; // for the client, not yet sent
+    bool useSplice;
+    // The socket is full: the pipe is left unwatched until it drains
+    bool clientBlocked;
+    bool watching;
+    // Output is read and dropped: answered with an error, or nobody listens
+    bool discarding;
+    // The handler is done once the output hit EOF, everything went out and
+    // the child has been reaped, which can happen in any order
+    bool outputComplete;
+    bool outputFailed;
+    bool childReaped;
+    int exitStatus;
+    // Signalled by the CgiScheduler for running past the route's timeout
+    bool timedOut;
+    bool supervised;
+
+    void readOutput(void);
+    void streamOutput(void);
+    bool readHeader(void);
+    void startBody(void);
+    bool forwardBody(void);
+    bool forwardChunk(void);
+    bool drainOutput(void);
+    ssize_t transfer(size_t size);
+    void queueChunk(const char* data, size_t size);
+    bool flushPending(void);
+    bool isClientWritable(void);
+    void pauseClient(void);
+    void resumeClient(void);
+    void dropClient(void);
+    void stopReading(void);
+    void abandonOutput(void);
+    void warnUnlimited(const std::string& resource);
+    void tryFinish(void);
+    void finish(void);
 
 public:
-    CgiHandler(const std::string& filePath, const std::string& queryString, int client_fd, Reactor* reactor);
+    // withInput gives the script a stdin pipe for the request body. The
+    // creator registers the handler for EPOLLIN right away.
+    CgiHandler(const std::string& filePath, const std::map<std::string, std::string>& variables, CgiOutputListener* listener, int clientFd, Reactor* reactor, bool withInput = false);
     ~CgiHandler();
-    void setCGIEnvironment(const std::string& queryString);
-    int executeCGI(const std::string& filePath);
+    void cacheAs(const std::string& key, long ttlMs, long staleMs);
+    // Applies the route's resource limits and hands the script to the
+    // CgiScheduler, whose slot in pool it holds until deleted
+    void supervise(const std::string& pool, const CgiLimits& limits);
+    void keepClientAlive(void);
+    // Signals the script's whole process group
+    void terminate(int signal);
+    // Hands over the write end of the script's stdin
+    int releaseInput(void);
+    // The client socket has room again
+    void clientWritable(void);
+    // The listener and its client are going away; the output is dropped
+    void detach(void);
+    // "NAME=value" strings for the script's envp
+    static std::vector<std::string> buildEnvironment(const std::map<std::string, std::string>& variables);
+    int executeCGI(const std::string& filePath, const std::map<std::string, std::string>& variables, bool withInput);
     void handleEvent(uint32_t events);
+    void childExited(pid_t pid, int status);
     void closeConnection(void);
 };
 
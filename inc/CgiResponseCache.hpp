@@ -0,0 +1,87 @@
+#ifndef CGIRESPONSECACHE_HPP
+#define CGIRESPONSECACHE_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+
+// Implemented by whoever waits for a CGI execution it did not start
+class CgiResponseListener {
+  public:
+    virtual ~CgiResponseListener() {}
+    // response is a complete HTTP response, valid for the call only
+    virtual void cgiResponseReady(const std::string& response) = 0;
+};
+
+// Micro-cache in front of CgiHandler for routes with cgi_cache set. Keys are
+// the script path, query string, the Cookie header unless the route set
+// cgi_cache_ignore_cookie, and the route's cgi_cache_vary headers.
+// A fresh entry is served as is; a stale one is served while one background
+// execution refreshes it. Requests arriving while a key's first execution
+// runs wait for it instead of forking their own. Entries are evicted least
+// recently used first to stay within maxBytes.
+class CgiResponseCache {
+  public:
+    enum Status {
+      MISS,     // the caller runs the script; listener gets the response
+      PENDING,  // an execution is running; listener gets its response
+      FRESH,    // response is set
+      STALE     // response is set; refresh with beginRefresh()
+    };
+    struct Counters {
+      unsigned long hits;
+      unsigned long staleHits;
+      unsigned long misses;
+      unsigned long collapsed;
+      unsigned long refreshes;
+    };
+
+    explicit CgiResponseCache(size_t maxBytes = 8 * 1024 * 1024);
+
+    Status lookup(const std::string& key, CgiResponseListener* listener, const std::string*& response);
+    // True when the caller should start a background refresh of a stale key
+    bool beginRefresh(const std::string& key);
+    // Script output for key; ttlMs and staleMs apply unless its
+    // Cache-Control says otherwise. Waiting listeners are answered.
+    void store(const std::string& key, const std::string& output, long ttlMs, long staleMs);
+    // The execution for key failed; waiting listeners get a 502
+    void fail(const std::string& key);
+    void removeListener(CgiResponseListener* listener);
+
+    size_t size(void) const;
+    size_t getBytes(void) const;
+    const Counters& getCounters(void) const;
+    std::string formatCounters(void) const;
+
+    // Lifetime from the Cache-Control header of CGI output, if it has one.
+    // Returns false when the output must not be cached.
+    static bool parseCacheControl(const std::string& output, long& ttlMs, long& staleMs);
+    // Whether a built response may be shared: a status that is cacheable by
+    // default (RFC 9110 section 15.1) and no Set-Cookie, which is one
+    // client's and must never be replayed to another
+    static bool isShareable(const std::string& response);
+
+  private:
+    struct Entry {
+      std::string response;  // empty until the first execution completes
+      long freshUntilMs;
+      long staleUntilMs;
+      bool running;
+      std::vector<CgiResponseListener*> waiters;
+      unsigned long lastUse;
+    };
+    size_t maxBytes;
+    size_t bytes;
+    unsigned long useClock;
+    std::map<std::string, Entry> entries;
+    Counters counters;
+
+    void notify(std::vector<CgiResponseListener*>& waiters, const std::string& response);
+    void evict(const std::string& keep);
+    static long nowMs(void);
+
+    CgiResponseCache(const CgiResponseCache&);
+    CgiResponseCache& operator=(const CgiResponseCache&);
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef CGIRESPONSEHEADER_HPP
+#define CGIRESPONSEHEADER_HPP
+
+#include <string>
+#include <utility>
+#include <vector>
+
+// The header block a CGI script writes ahead of its body (RFC 3875 section
+// 6): Status, Location, Content-Type and any other fields, such as
+// Set-Cookie, which are passed on. Output that does not start with a
+// header block is sent whole as text/html, as it always was.
+class CgiResponseHeader {
+  public:
+    enum Result {
+      INCOMPLETE, // the block may still end in output yet to come
+      PARSED,
+      ABSENT,     // no header block; the output is all body
+      MALFORMED   // answered with a 502
+    };
+    // Output without a blank line by then is taken to have no header
+    static const size_t MAX_LENGTH = 8192;
+
+    CgiResponseHeader();
+
+    // Looks for the block at the start of output; atEnd once the script
+    // wrote everything
+    Result parse(const std::string& output, bool atEnd);
+    // Bytes of output the block and its blank line took
+    size_t getLength(void) const;
+    bool hasContentLength(void) const;
+    size_t getContentLength(void) const;
+    // Status line and headers, ending with the blank line; bodyLength is
+    // the Content-Length unless the body follows in chunks
+    std::string format(bool chunked, size_t bodyLength) const;
+
+    // Whole output as a response with its Content-Length
+    static std::string buildResponse(const std::string& output);
+
+  private:
+    std::string status;
+    std::vector<std::pair<std::string, std::string> > fields;
+    bool hasContentType;
+    bool contentLengthGiven;
+    size_t contentLength;
+    size_t length;
+
+    void reset(void);
+    bool addField(const std::string& line, bool& statusGiven, bool& hasLocation);
+};
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef CGISCHEDULER_HPP
+#define CGISCHEDULER_HPP
+
+#include <deque>
+#include <map>
+#include <string>
+#include "Route.hpp"
+
+// Told when a queued CGI request may start, or that it waited longer than
+// its route's timeout and was dropped from the queue
+class CgiSlotListener {
+  public:
+    virtual ~CgiSlotListener() {}
+    virtual void cgiSlotGranted(void) = 0;
+    virtual void cgiSlotExpired(void) = 0;
+};
+
+// A running script as the scheduler sees it
+class CgiScript {
+  public:
+    virtual ~CgiScript() {}
+    // Called each deadline check, so the client is not swept as inactive
+    virtual void keepClientAlive(void) = 0;
+    virtual void terminate(int signal) = 0;
+};
+
+// Admission control and deadlines for forked CGI scripts. Each route is a
+// pool running at most cgi_max_scripts at once; later requests wait in a
+// FIFO of cgi_queue_size and are refused once it is full. Scripts running
+// past cgi_timeout get SIGTERM, then SIGKILL after a grace period. Driven
+// by tick() from the reactor loop, which wakes at least once a second.
+class CgiScheduler {
+  public:
+    enum Admission {
+      RUN,     // a slot was taken for the caller
+      QUEUED,  // cgiSlotGranted() follows once one frees up
+      FULL
+    };
+    struct Counters {
+      unsigned long started;
+      unsigned long queued;
+      unsigned long refused;
+      unsigned long expired;
+      unsigned long timedOut;
+    };
+    static const long KILL_GRACE_MS = 2000;
+
+    CgiScheduler();
+
+    Admission admit(const std::string& pool, const CgiLimits& limits, CgiSlotListener* waiter);
+    // The waiter is going away
+    void cancel(CgiSlotListener* waiter);
+    // A slot taken whatever the cap, for executions no client waits on
+    void reserve(const std::string& pool);
+    // Gives back a slot that did not end up running a script
+    void release(const std::string& pool);
+    // The script holding a slot of pool started; timeoutSeconds 0 never
+    // expires
+    void start(CgiScript* script, const std::string& pool, int timeoutSeconds);
+    // Frees the script's slot; the next waiter is started from tick(), so
+    // nothing runs from inside the handler's destructor
+    void finished(CgiScript* script);
+    void tick(void);
+
+    const Counters& getCounters(void) const;
+    size_t getRunning(void) const;
+    size_t getWaiting(void) const;
+    // Counters as "name value" lines, for the status_page route
+    std::string formatCounters(void) const;
+
+  private:
+    struct Waiter {
+      CgiSlotListener* listener;
+      long deadlineMs;  // 0 waits for as long as it takes
+    };
+    struct Pool {
+      size_t running;
+      size_t maxScripts;  // 0 for no cap
+      std::deque<Waiter> queue;
+
+      Pool() : running(0), maxScripts(0) {}
+    };
+    struct Script {
+      std::string pool;
+      long deadlineMs;  // of the next signal, 0 once SIGKILL was sent
+      bool terminated;
+    };
+
+    std::map<std::string, Pool> pools;
+    std::map<CgiScript*, Script> scripts;
+    Counters counters;
+    bool slotsFreed;
+    long nextCheckMs;
+
+    void grantSlots(void);
+    void checkDeadlines(long now);
+    static long nowMs(void);
+
+    CgiScheduler(const CgiScheduler&);
+    CgiScheduler& operator=(const CgiScheduler&);
+};
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef CLIENTLIMITER_HPP
+#define CLIENTLIMITER_HPP
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "Route.hpp"
+
+// Per-client admission control. Open connections are counted per IPv4
+// address in an open-addressing table and capped at accept time; requests
+// to routes with a rate_limit draw from a token bucket per (address, route).
+// Rejections are answered with responses built once, so a flood costs one
+// send per request and nothing else; they are logged as a periodic summary
+// from tick() rather than a line each.
+class ClientLimiter {
+  public:
+    struct Counters {
+      unsigned long acceptedConnections;
+      unsigned long rejectedConnections;
+      unsigned long allowedRequests;
+      unsigned long limitedRequests;
+    };
+
+    ClientLimiter();
+
+    // limit 0 admits every connection, but the address is still counted
+    bool acquireConnection(uint32_t address, size_t limit);
+    void releaseConnection(uint32_t address);
+    size_t getConnectionCount(uint32_t address) const;
+    bool allowRequest(uint32_t address, const Route& route);
+    // Buckets are keyed by Route, which a reload frees; connections stay
+    void resetBuckets(void);
+    // Called from the reactor loop; logs what was rejected since the last
+    // summary, at most every REPORT_INTERVAL_MS
+    void tick(void);
+
+    const Counters& getCounters(void) const;
+    size_t getActiveConnections(void) const;
+    size_t getTrackedClients(void) const;
+    size_t getTrackedBuckets(void) const;
+    // Counters as "name value" lines, for the status_page route
+    std::string formatCounters(void) const;
+
+    static const long REPORT_INTERVAL_MS = 10000;
+
+    // 429 with Retry-After for requests, 503 for connections over the cap
+    static const std::string& getTooManyRequestsResponse(void);
+    static const std::string& getServiceUnavailableResponse(void);
+
+  private:
+    struct ConnectionSlot {
+      uint32_t address;
+      uint32_t count;  // 0 marks an empty slot
+    };
+    struct Bucket {
+      uint32_t address;
+      const Route* route;  // only a key, NULL marks an empty slot
+      double rate;         // copied so sweeping never touches the Route
+      double burst;
+      double tokens;
+      long lastMs;
+    };
+
+    std::vector<ConnectionSlot> connections;
+    size_t connectionCount;
+    size_t activeConnections;
+    std::vector<Bucket> buckets;
+    size_t bucketCount;
+    Counters counters;
+    Counters reported;          // as of the last summary
+    long nextReportMs;
+    uint32_t lastRejected;      // address of the latest rejection
+
+    size_t findConnection(uint32_t address) const;
+    void growConnections(void);
+    void eraseConnection(size_t index);
+    Bucket& findBucket(uint32_t address, const Route* route, double rate, double burst, long now);
+    void sweepBuckets(long now);
+    static uint32_t hash(uint32_t address);
+    static uint32_t hash(uint32_t address, const Route* route);
+    static std::string buildResponse(int code, const std::string& reason, const std::string& extraHeaders);
+    static long nowMs(void);
+
+    ClientLimiter(const ClientLimiter&);
+    ClientLimiter& operator=(const ClientLimiter&);
+};
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef CONFIGSNAPSHOT_HPP
+#define CONFIGSNAPSHOT_HPP
+
+#include <map>
+#include <string>
+#include "Server.hpp"
+#include "VirtualHostIndex.hpp"
+
+// One parsed configuration: the servers with their compiled routes, error
+// pages and MIME tables, and the virtual host index over them. Nothing in a
+// snapshot changes after load(); a reload builds a new one instead.
+// Snapshots are reference counted so a connection can keep the one its
+// current request started with while a newer one is swapped in.
+class ConfigSnapshot {
+  public:
+    // Parses and validates the file, throws on any configuration error.
+    // The returned snapshot holds one reference owned by the caller.
+    static ConfigSnapshot* load(const std::string& path);
+
+    void acquire(void);
+    void release(void);
+
+    const std::map<std::string, Server*>& getServers(void) const;
+    const VirtualHostIndex& getVirtualHostIndex(void) const;
+    unsigned long getGeneration(void) const;
+
+  private:
+    std::map<std::string, Server*> servers;
+    VirtualHostIndex virtualHostIndex;
+    int refCount;
+    unsigned long generation;
+
+    static unsigned long nextGeneration;
+
+    explicit ConfigSnapshot(std::map<std::string, Server*>& servers);
+    ~ConfigSnapshot();
+    ConfigSnapshot(const ConfigSnapshot&);
+    ConfigSnapshot& operator=(const ConfigSnapshot&);
+};
+
+#endif
@@ -30,6 +30,15 @@ class ConfigurationParser {
 		static void parseServerName(std::string &line, Server& serverConfig);
 		static void parseErrorPages(std::string& line, Server& serverConfig);
 		static void parseClientMaxBodySize(std::string& line, Server& serverConfig);
+		static void parseMimeType(std::string& line, Server& serverConfig);
+		static void parseDefaultServer(std::string& line, Server& serverConfig);
+		static void parseMaxConnectionsPerClient(std::string& line, Server& serverConfig);
+		static void parseListenerOption(std::string& line, Server& serverConfig);
+		static void parseSessionMode(std::string& line, Server& serverConfig);
+		static void parseSessionKeys(std::string& line, Server& serverConfig);
+		static void parseSessionFile(std::string& line, Server& serverConfig);
+		static void parseLogLevel(std::string& line, Server& serverConfig);
+		static void parseAccessLog(std::string& line, Server& serverConfig);
 
 		// Route Parsing
     static void parseRouteConfig(std::string& line, Route& routeConfig);
@@ -43,7 +52,18 @@ class ConfigurationParser {
 		static void parseAllowFileUpload(std::string& line, Route& route);
 		static void parseUploadLocation(std::string& line, Route& route);
     static void parseCgiPass(std::string& line, Route& route);
+    static void parseFastCgiPass(const std::string& address, Route& route);
+    static void parseFastCgiWorkers(std::string& line, Route& route);
+    static void parseFastCgiConnections(std::string& line, Route& route);
+    static void parseCgiLimit(std::string& line, Route& route);
     static void parseMaxBodySize(std::string& line, Route& route);
+    static void parseRateLimit(std::string& line, Route& route);
+    static void parseRateBurst(std::string& line, Route& route);
+    static void parseStatusPage(std::string& line, Route& route);
+    static void parseCgiCache(std::string& line, Route& route);
+    static void parseCgiCacheStale(std::string& line, Route& route);
+    static void parseCgiCacheVary(std::string& line, Route& route);
+    static void parseCgiCacheIgnoreCookie(std::string& line, Route& route);
 
     static void checkForDuplicateServerNames(const std::map<std::string, Server*>& servers);
     static void checkForDuplicatePorts(const std::map<std::string, Server*>& servers);
@@ -8,12 +8,16 @@ class Cookie {
     std::string cookieName;
     std::string cookieValue;
 
+    static std::string trim(const std::string& text);
+
   public:
     Cookie(const std::string& name, const std::string& value);
     Cookie();
     std::string getCookieName() const;
     std::string getCookieValue() const;
     std::string getCookieString() const;
+    // Value of the named cookie in a Cookie request header, "" if absent
+    static std::string findValue(const std::string& header, const std::string& name);
 };
 
 #endif
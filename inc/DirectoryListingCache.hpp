@@ -0,0 +1,96 @@
+#ifndef DIRECTORYLISTINGCACHE_HPP
+#define DIRECTORYLISTINGCACHE_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+#include <ctime>
+#include <sys/types.h>
+#include "FileWatcher.hpp"
+
+struct DirectoryEntry {
+  std::string name;
+  bool isDirectory;
+  off_t size;
+  time_t mtime;
+};
+
+// Snapshot of one directory, read once and kept until it changes. A page
+// still being sent keeps the snapshot it started with.
+class DirectoryListing {
+  public:
+    enum SortKey {
+      SORT_NAME,
+      SORT_SIZE,
+      SORT_MTIME
+    };
+
+    DirectoryListing(const std::string& path, const struct timespec& mtime);
+
+    const std::string& getPath() const;
+    const struct timespec& getMtime() const;
+    size_t size() const;
+    // Returns the i-th entry in ascending order of the given key. Orders other
+    // than by name are built lazily on first use and kept with the snapshot.
+    const DirectoryEntry& at(size_t index, SortKey key) const;
+
+    void load(void);
+
+  private:
+    std::string path;
+    struct timespec mtime;
+    std::vector<DirectoryEntry> entries;  // sorted by name
+    mutable std::vector<size_t> bySize;
+    mutable std::vector<size_t> byMtime;
+    // Held by the cache and by each response streaming the listing
+    mutable int refCount;
+    bool detached;   // dropped from the cache, deleted by the last release()
+
+    const std::vector<size_t>& getOrder(SortKey key) const;
+
+    friend class DirectoryListingCache;
+};
+
+// Listings of watched directories are trusted until the watcher reports a
+// change to the directory or to any entry in it, so a file rewritten in
+// place shows its new size and mtime too. Without a watch the directory's
+// mtime is checked per request, which catches entries added, removed or
+// renamed, and the listing is read again after ttlMs at the latest for
+// entries changed in place.
+class DirectoryListingCache : public FileChangeListener {
+  public:
+    explicit DirectoryListingCache(size_t maxDirectories = 64, long ttlMs = 1000);
+    ~DirectoryListingCache();
+
+    void setWatcher(FileWatcher* watcher);
+    // Returns the up-to-date listing of directoryPath with one reference
+    // taken, to be given back with release(). Throws std::runtime_error if
+    // the directory can't be read.
+    const DirectoryListing* getListing(const std::string& directoryPath);
+    void release(const DirectoryListing* listing);
+    void invalidate(const std::string& directoryPath);
+    void clear(void);
+
+    void fileChanged(const std::string& path, bool subtree);
+
+  private:
+    struct Slot {
+      DirectoryListing* listing;
+      long expiresMs;       // 0 when kept up to date by the watcher
+      unsigned long lastUse;
+    };
+    size_t maxDirectories;
+    long ttlMs;
+    unsigned long useClock;
+    FileWatcher* watcher;
+    std::map<std::string, Slot> listings;
+
+    void drop(std::map<std::string, Slot>::iterator it);
+    void evictOldest(void);
+    static long nowMs(void);
+
+    DirectoryListingCache(const DirectoryListingCache&);
+    DirectoryListingCache& operator=(const DirectoryListingCache&);
+};
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef DIRECTORYLISTINGRENDERER_HPP
+#define DIRECTORYLISTINGRENDERER_HPP
+
+#include <string>
+#include "DirectoryListingCache.hpp"
+#include "Cookie.hpp"
+#include "OutputQueue.hpp"
+
+// Options taken from the listing request's query string:
+//   sort=name|size|mtime  order=asc|desc  page=N  per_page=M  format=html|json
+struct DirectoryListingQuery {
+  DirectoryListing::SortKey sort;
+  bool descending;
+  size_t page;     // 1-based, 0 means everything on one page
+  size_t perPage;
+  bool json;
+
+  DirectoryListingQuery();
+  static DirectoryListingQuery fromQueryString(const std::string& queryString);
+};
+
+class DirectoryListingRenderer {
+  public:
+    // Streams the listing page as a chunked response, rendered about
+    // FLUSH_THRESHOLD bytes at a time as the client reads it, so memory stays
+    // bounded whatever the directory size. Takes over the caller's reference
+    // on listing.
+    static bool stream(const DirectoryListing* listing, DirectoryListingCache& listings, const DirectoryListingQuery& query, const std::string& uriPath, const Cookie& cookie, OutputQueue& out);
+
+    static const size_t FLUSH_THRESHOLD = 16384;
+    static const size_t DEFAULT_PER_PAGE = 100;
+    static const size_t MAX_PER_PAGE = 5000;
+
+  private:
+    DirectoryListingRenderer();
+    ~DirectoryListingRenderer();
+};
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef FASTCGIBACKEND_HPP
+#define FASTCGIBACKEND_HPP
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+#include "FastCgiConnection.hpp"
+#include "ProcessReaper.hpp"
+#include "Route.hpp"
+
+class Reactor;
+
+// A FastCGI application routes send their requests to with
+// cgi_pass=fastcgi://<address>. The address is "unix:/path/to.sock",
+// "host:port", or "spawn:/path/to/worker": then the server starts
+// fastcgi_workers copies of the worker on a socket of its own and restarts
+// the ones that exit. Requests are spread over at most maxConnections
+// kept-alive connections and queued when all of them are busy.
+class FastCgiBackend : public ChildExitListener {
+  public:
+    FastCgiBackend(const std::string& address, size_t workers, size_t maxConnections, Reactor* reactor);
+    ~FastCgiBackend();
+
+    // Routes with the same address and pool settings share a backend
+    static std::string makeKey(const Route& route);
+
+    // Takes ownership; the request is answered, or failed with a 502
+    void submit(FastCgiRequest* request);
+    void removeListener(CgiResponseListener* listener);
+
+    // Answers whoever waits for the request and deletes it
+    static void deliver(FastCgiRequest* request, bool failed);
+
+    // Called by the connections
+    void complete(FastCgiRequest* request, bool failed);
+    void retry(FastCgiRequest* request);
+    void connectionLost(std::vector<FastCgiRequest*>& requests);
+    void forget(FastCgiConnection* connection);
+    // What the first connection learnt from FCGI_GET_VALUES; 0 if nothing
+    void learnLimits(size_t applicationMaxConnections);
+    void dispatch(void);
+
+    void childExited(pid_t pid, int status);
+
+  private:
+    struct Worker {
+      pid_t pid;      // -1 once given up on
+      long startedMs;
+      int quickExits; // in a row, each within a second of starting
+    };
+    std::string address;
+    Reactor* reactor;
+    struct sockaddr_storage peer;
+    socklen_t peerLength;
+    bool resolved;
+    // Spawned pools only
+    std::string command;
+    std::string socketPath;
+    int listenFd;
+    std::vector<Worker> workers;
+    size_t maxConnections;
+    // Only one connection is opened until the application's limits are known
+    bool limitsKnown;
+    std::vector<FastCgiConnection*> connections;
+    std::deque<FastCgiRequest*> queue;
+
+    bool resolve(const std::string& target);
+    bool startPool(size_t count);
+    void spawn(Worker& worker);
+    bool hasLiveWorkers(void) const;
+    FastCgiConnection* pickConnection(void);
+    FastCgiConnection* connect(void);
+    static long nowMs(void);
+
+    FastCgiBackend(const FastCgiBackend&);
+    FastCgiBackend& operator=(const FastCgiBackend&);
+};
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef FASTCGICONNECTION_HPP
+#define FASTCGICONNECTION_HPP
+
+#include <map>
+#include <string>
+#include <stdint.h>
+#include "EventHandler.hpp"
+#include "CgiResponseCache.hpp"
+#include "FastCgiRecord.hpp"
+
+class FastCgiBackend;
+class Reactor;
+
+// One request to a FastCGI application: the CGI variables and body going
+// out, the output coming back. Answers a waiting client through its
+// listener, or the CgiResponseCache when cacheKey is set.
+struct FastCgiRequest {
+  std::map<std::string, std::string> params;
+  std::string body;
+  CgiResponseListener* listener;  // NULL once the client is gone
+  std::string cacheKey;
+  long cacheTtlMs;
+  long cacheStaleMs;
+  std::string output;
+  uint32_t appStatus;
+  bool retried;
+
+  FastCgiRequest();
+};
+
+// Kept-alive connection to a FastCGI application. Requests are sent with
+// FCGI_KEEP_CONN so the connection outlives them; when the application
+// reports FCGI_MPXS_CONNS several requests share it, told apart by id.
+class FastCgiConnection : public EventHandler {
+  public:
+    // fd is a non-blocking socket, connected or still connecting
+    FastCgiConnection(FastCgiBackend* backend, Reactor* reactor, int fd);
+    ~FastCgiConnection();
+
+    size_t getLoad(void) const;
+    // True when one more request can be started right now
+    bool canStart(void) const;
+    void start(FastCgiRequest* request);
+    // The client went away: the application is asked to abort and the
+    // output is dropped. Returns false if none of the requests was its.
+    bool abandon(CgiResponseListener* listener);
+    // The backend is being torn down and must not be called back
+    void detach(void);
+
+    void handleEvent(uint32_t events);
+    void closeConnection(void);
+
+  private:
+    FastCgiBackend* backend;
+    Reactor* reactor;
+    bool connected;
+    bool broken;
+    bool multiplexes;
+    size_t maxRequests;
+    uint16_t nextRequestId;
+    std::string writeBuffer;
+    std::string readBuffer;
+    std::map<uint16_t, FastCgiRequest*> active;
+
+    bool finishConnecting(void);
+    bool flush(void);
+    // EPOLLOUT is only asked for while connecting or with records to send;
+    // an idle socket is always writable and would spin the loop
+    void updateInterest(void);
+    bool readRecords(void);
+    void handleRecord(const FastCgiRecord& record);
+    void handleValues(const std::string& content);
+    void endRequest(uint16_t requestId, const std::string& content);
+    uint16_t allocateRequestId(void);
+
+    FastCgiConnection(const FastCgiConnection&);
+    FastCgiConnection& operator=(const FastCgiConnection&);
+};
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef FASTCGIRECORD_HPP
+#define FASTCGIRECORD_HPP
+
+#include <map>
+#include <string>
+#include <stdint.h>
+
+// Encoding and decoding of FastCGI 1.0 records. Writers append whole
+// records to an output buffer; the reader takes complete records off the
+// front of an input buffer and leaves partial ones for the next read.
+class FastCgiRecord {
+  public:
+    enum Type {
+      BEGIN_REQUEST = 1,
+      ABORT_REQUEST = 2,
+      END_REQUEST = 3,
+      PARAMS = 4,
+      STDIN = 5,
+      STDOUT = 6,
+      STDERR = 7,
+      DATA = 8,
+      GET_VALUES = 9,
+      GET_VALUES_RESULT = 10,
+      UNKNOWN_TYPE = 11
+    };
+    // protocolStatus of END_REQUEST
+    enum ProtocolStatus {
+      REQUEST_COMPLETE = 0,
+      CANT_MPX_CONN = 1,
+      OVERLOADED = 2,
+      UNKNOWN_ROLE = 3
+    };
+    static const size_t HEADER_LENGTH = 8;
+    static const size_t MAX_CONTENT_LENGTH = 65535;
+
+    uint8_t type;
+    uint16_t requestId;
+    std::string content;
+
+    // Splits data over as many records as it needs; an empty data appends
+    // the empty record that ends a PARAMS or STDIN stream
+    static void append(std::string& out, uint8_t type, uint16_t requestId, const char* data, size_t length);
+    // Responder role; keepConnection asks the application not to close the
+    // connection once the request ends
+    static void appendBeginRequest(std::string& out, uint16_t requestId, bool keepConnection);
+    // PARAMS or GET_VALUES content, followed by the empty PARAMS record when
+    // type is PARAMS
+    static void appendPairs(std::string& out, uint8_t type, uint16_t requestId, const std::map<std::string, std::string>& pairs);
+    // The whole stream: data records, then the empty one
+    static void appendStream(std::string& out, uint8_t type, uint16_t requestId, const std::string& data);
+
+    static void encodePair(std::string& out, const std::string& name, const std::string& value);
+    // False when content is truncated
+    static bool decodePairs(const std::string& content, std::map<std::string, std::string>& pairs);
+
+    // Takes the record starting at offset if it is complete and advances
+    // offset past it and its padding
+    static bool parse(const std::string& buffer, size_t& offset, FastCgiRecord& record);
+    // END_REQUEST content
+    static bool parseEndRequest(const std::string& content, uint32_t& appStatus, uint8_t& protocolStatus);
+
+  private:
+    static void encodeLength(std::string& out, size_t length);
+};
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef FILEINFOCACHE_HPP
+#define FILEINFOCACHE_HPP
+
+#include <map>
+#include <string>
+#include <ctime>
+#include <sys/types.h>
+#include "FileWatcher.hpp"
+#include "MimeTypes.hpp"
+
+// Result of one stat() on a resolved path, failures included
+struct FileInfo {
+  int error;              // 0, or the errno stat() failed with
+  mode_t mode;
+  off_t size;
+  struct timespec mtime;
+  dev_t device;
+  ino_t inode;
+
+  bool exists(void) const;
+  bool isDirectory(void) const;
+  bool isRegularFile(void) const;
+  // Owner permission bits, as the ParsingUtils checks; a directory is only
+  // readable when it can also be searched
+  bool isReadable(void) const;
+  bool isWritable(void) const;
+};
+
+// stat() results keyed by path, so the several checks one request makes on
+// the same file cost a single syscall, and none while the entry is fresh.
+// Entries in a directory watched through inotify stay valid until the
+// watcher reports a change; the others expire after ttlMs. Each watched
+// entry holds a reference on its directory's watch until it goes.
+class FileInfoCache : public FileChangeListener {
+  public:
+    explicit FileInfoCache(size_t maxEntries = 4096, long ttlMs = 1000);
+    ~FileInfoCache();
+
+    void setWatcher(FileWatcher* watcher);
+    // A copy: the entry may be gone by the next lookup
+    FileInfo lookup(const std::string& path);
+    // MIME type of path under the given table, resolved once per entry
+    const std::string& getMimeType(const std::string& path, const MimeTypes& types);
+    void invalidate(const std::string& path);
+    void clear(void);
+
+    void fileChanged(const std::string& path, bool subtree);
+
+    unsigned long getHits(void) const;
+    unsigned long getMisses(void) const;
+
+  private:
+    struct Slot {
+      FileInfo info;
+      long expiresMs;           // 0 when kept up to date by the watcher
+      unsigned long lastUse;
+      const MimeTypes* mimeTable;
+      const std::string* mimeType;
+    };
+    size_t maxEntries;
+    long ttlMs;
+    unsigned long useClock;
+    unsigned long hits;
+    unsigned long misses;
+    FileWatcher* watcher;
+    std::map<std::string, Slot> entries;
+
+    Slot& find(const std::string& path);
+    void erase(std::map<std::string, Slot>::iterator it);
+    void evictOldest(void);
+    static std::string normalize(const std::string& path);
+    static long nowMs(void);
+
+    FileInfoCache(const FileInfoCache&);
+    FileInfoCache& operator=(const FileInfoCache&);
+};
+
+#endif
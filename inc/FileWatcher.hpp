@@ -0,0 +1,61 @@
+#ifndef FILEWATCHER_HPP
+#define FILEWATCHER_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "EventHandler.hpp"
+
+// Told about a change to path; when subtree is set everything below path
+// is affected too (directory moved or removed, event queue overflowed)
+class FileChangeListener {
+  public:
+    virtual ~FileChangeListener() {}
+    virtual void fileChanged(const std::string& path, bool subtree) = 0;
+};
+
+// inotify watches on the directories holding cached files, so caches can
+// trust their entries until told otherwise instead of stat()ing per request.
+// Several caches share a watch: each successful watch call is one reference,
+// and the watch is removed once the last is given back.
+class FileWatcher : public EventHandler {
+  public:
+    FileWatcher();
+    ~FileWatcher();
+
+    // Watches the directory containing path; false if inotify is unavailable
+    // or the directory can't be watched, in which case callers fall back to
+    // revalidating on their own
+    bool watchParentOf(const std::string& path);
+    // Watches directory itself, for caches of its listing
+    bool watchDirectory(const std::string& directory);
+    // Each gives back one successful call of its counterpart
+    void unwatchParentOf(const std::string& path);
+    void unwatchDirectory(const std::string& directory);
+    void addListener(FileChangeListener* listener);
+    void removeListener(FileChangeListener* listener);
+    bool isActive(void) const;
+
+    void handleEvent(uint32_t events);
+    void closeConnection(void);
+
+  private:
+    struct Watch {
+      // inotify has one descriptor per inode, so a directory reached by two
+      // paths shares it; events are reported under the latest
+      std::vector<std::string> paths;
+      size_t references;
+    };
+    std::map<int, Watch> directories;          // watch descriptor -> directory
+    std::map<std::string, int> watches;        // directory -> watch descriptor
+    std::vector<FileChangeListener*> listeners;
+
+    void notify(const std::string& path, bool subtree);
+    void removeWatch(std::map<int, Watch>::iterator it);
+
+    FileWatcher(const FileWatcher&);
+    FileWatcher& operator=(const FileWatcher&);
+};
+
+#endif
@@ -24,6 +24,7 @@ private:
     bool parseHeaders(void);
     void extractBody(void);
     void parseContentLength();
+    size_t receivedBodyLength(void) const;
 
 public:
     HTTPRequestParser();
@@ -38,6 +39,9 @@ public:
     std::map<std::string, std::string> getHeaders() const;
     std::string getBody() const;
     std::string getBoundary() const;
+    size_t getContentLength() const;
+    // Body bytes that arrived so far, for requests handled before the rest
+    std::string getReceivedBody() const;
 
     bool isCompleteRequest() const;
     bool isRequestLineParsed() const;
@@ -57,6 +61,12 @@ public:
             return "Invalid method";
         }
     };
+    class InvalidUriException : public std::exception {
+    public:
+        virtual const char* what() const throw() {
+            return "Invalid URI";
+        }
+    };
 };
 
 #endif
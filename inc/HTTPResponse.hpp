@@ -5,13 +5,30 @@
 #include "Server.hpp"
 #include "SessionData.hpp"
 #include "Cookie.hpp"
+#include "HtmlTemplate.hpp"
+#include "OpenFileCache.hpp"
+#include "OutputQueue.hpp"
 
+// Responses go out through the connection's OutputQueue: what the socket
+// does not take at once is sent from there as it drains
 class HTTPResponse {
   public:
-    static void sendErrorResponse(int errorCode, const Server* server, int client_fd);
-    static void sendRedirectResponse(const std::string& redirectLocation, int client_fd);
-    static void sendSuccessResponse(const std::string& statusCode, const std::string& contentType, const std::string& content, Cookie cookie, int client_fd);
-    static std::string modifyHtmlContentForSession(const std::string& content, const SessionData* sessionData);
+    static void sendErrorResponse(int errorCode, const Server* server, OutputQueue& out);
+    static std::string buildErrorResponse(int errorCode, const Server* server);
+    static void sendRedirectResponse(const std::string& redirectLocation, OutputQueue& out);
+    static std::string buildSuccessResponse(const std::string& statusCode, const std::string& contentType, const std::string& content, Cookie cookie);
+    static void sendSuccessResponse(const std::string& statusCode, const std::string& contentType, const std::string& content, Cookie cookie, OutputQueue& out);
+    // Chunked transfer encoding, for bodies generated while they are sent
+    static bool sendChunkedHeaders(const std::string& statusCode, const std::string& contentType, Cookie cookie, OutputQueue& out);
+    // Frame body pieces for an OutputSource to produce
+    static void appendChunk(std::string& out, const char* data, size_t length);
+    static void appendLastChunk(std::string& out);
+    // Sends the template's static slices and the variable values with one writev
+    static void sendTemplateResponse(const std::string& statusCode, const std::string& contentType, const HtmlTemplate& page, const TemplateVariables& variables, Cookie cookie, OutputQueue& out);
+    // Headers with write, the body straight from the file with sendfile;
+    // out takes over the reference on file
+    static void sendFileResponse(const std::string& statusCode, const std::string& contentType, OpenFile* file, OpenFileCache& files, Cookie cookie, OutputQueue& out);
+    static void setSessionVariables(TemplateVariables& variables, const SessionData* sessionData);
     static std::string setCookie(const std::string& cookieName, const std::string& cookieValue);
 };
 
@@ -0,0 +1,59 @@
+#ifndef HTMLTEMPLATE_HPP
+#define HTMLTEMPLATE_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+#include <sys/uio.h>
+#include <ctime>
+
+typedef std::map<std::string, std::string> TemplateVariables;
+
+class FileInfoCache;
+
+// An HTML file scanned once for placeholders. "[NAME]" (capitals, digits and
+// '_') marks a variable, "[INCLUDE:file]" pulls in a fragment relative to the
+// including file. Rendering never copies the page: it only points iovecs at
+// the static slices and the variable values.
+class HtmlTemplate {
+  public:
+    explicit HtmlTemplate(const std::string& path);
+
+    // Reads and scans the file and its includes. Throws std::runtime_error
+    // if the file can't be read.
+    void compile(void);
+    // True if the file or one of its included fragments changed on disk,
+    // going through files instead of stat() when given
+    bool isStale(FileInfoCache* files = NULL) const;
+
+    const std::string& getPath(void) const;
+    bool hasPlaceholders(void) const;
+    size_t renderedLength(const TemplateVariables& variables) const;
+    // Appends one iovec per slice; unset variables keep their placeholder text
+    void appendIovecs(const TemplateVariables& variables, std::vector<struct iovec>& iov) const;
+
+    static const int MAX_INCLUDE_DEPTH = 4;
+
+  private:
+    struct Segment {
+      size_t offset;  // into source, covers the raw "[NAME]" for variables
+      size_t length;
+      std::string variable;  // empty for static text
+    };
+    struct Dependency {
+      std::string path;
+      struct timespec mtime;
+    };
+
+    std::string path;
+    std::string source;  // the file followed by every included fragment
+    std::vector<Segment> segments;
+    std::vector<Dependency> dependencies;
+    bool placeholders;
+
+    void compileFile(const std::string& filePath, int depth);
+    void addText(size_t offset, size_t length);
+    const std::string* lookup(const Segment& segment, const TemplateVariables& variables) const;
+};
+
+#endif
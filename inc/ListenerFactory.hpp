@@ -0,0 +1,37 @@
+#ifndef LISTENERFACTORY_HPP
+#define LISTENERFACTORY_HPP
+
+#include <string>
+
+// Per-server socket tuning, from the listen_backlog, tcp_* and so_*
+// directives. A port shared by several servers uses its default server's.
+struct ListenerOptions {
+  int backlog;
+  int deferAcceptSeconds;  // TCP_DEFER_ACCEPT, 0 for off
+  int fastOpenQueue;       // TCP_FASTOPEN queue length, 0 for off
+  bool noDelay;            // TCP_NODELAY, set on every accepted socket
+  int receiveBuffer;       // SO_RCVBUF/SO_SNDBUF, 0 for the kernel's default;
+  int sendBuffer;          // accepted sockets inherit them from the listener
+  bool reusePort;          // SO_REUSEPORT, only takes effect before bind
+
+  ListenerOptions();
+  bool operator==(const ListenerOptions& other) const;
+};
+
+// Creates the listening sockets the AcceptHandlers wait on
+class ListenerFactory {
+  public:
+    // Bound and listening socket for host:port (any address when host is
+    // empty), or -1 with the reason logged
+    static int createListener(const std::string& host, int port, const ListenerOptions& options = ListenerOptions());
+    // Re-applies what can change on a live listener (everything but
+    // SO_REUSEPORT), for a reload that keeps the socket
+    static void tuneListener(int fd, const ListenerOptions& options);
+    static void tuneAccepted(int fd, const ListenerOptions& options);
+
+  private:
+    ListenerFactory();
+    static bool setOption(int fd, int level, int name, int value, const char* label);
+};
+
+#endif
@@ -2,7 +2,6 @@
 #define LOGGER_HPP
 
 #include <iostream>
-#include <fstream>
 #include <string>
 
 enum Level {
@@ -12,16 +11,49 @@ enum Level {
 	DEBUG
 };
 
+// LOG() statements below this rank are compiled out: 0 keeps DEBUG, 1 drops
+// it, up to 3 for errors only
+#ifndef LOG_COMPILED_LEVEL
+# define LOG_COMPILED_LEVEL 0
+#endif
+
+// For messages on the request path: the message is only built when its
+// level is logged
+#define LOG(level, message) \
+	do { \
+		if (Logger::rank(level) >= LOG_COMPILED_LEVEL && Logger::isEnabled(level)) \
+			Logger::log(level, message); \
+	} while (0)
+
+// Lines are collected in a buffer and written out in one go per reactor
+// loop, or when the buffer fills; warnings and errors go out at once.
 class Logger {
 public:
     Logger();
     ~Logger();
     static void log(Level level, const std::string& message);
+    // Messages below level are dropped; INFO unless configured
+    static void setLevel(Level level);
+    static Level getLevel(void);
+    static bool isEnabled(Level level) { return rank(level) >= rank(minimum); }
+    // DEBUG 0, INFO 1, WARNING 2, ERROR 3
+    static int rank(Level level) { return level == DEBUG ? 0 : level + 1; }
+    static bool parseLevel(const std::string& name, Level& level);
+    static void flush(void);
     static std::string getCurrentTime();
     
 private:
+    static const size_t BUFFER_SIZE = 64 * 1024;
+
+    static Level minimum;
+    static int logFd;
+    static char buffer[BUFFER_SIZE];
+    static size_t buffered;
+    static bool flushAtExit;
+
     static std::string getLevelString(Level level);
-    static std::ofstream logFile;
     static std::string generateLogFilename();
+    static void append(const char* data, size_t size);
+    static void writeAll(int fd, const char* data, size_t size);
 };
 #endif
@@ -0,0 +1,34 @@
+#ifndef MIMETYPES_HPP
+#define MIMETYPES_HPP
+
+#include <string>
+#include <vector>
+
+// Extension -> MIME type table: the built-in types merged with a server's
+// [types] block, kept as a flat array sorted on the lowercase extension so a
+// lookup is one binary search with no allocation.
+class MimeTypes {
+  public:
+    MimeTypes();
+
+    void setType(const std::string& extension, const std::string& type);
+    const std::string& getType(const std::string& filePath) const;
+    size_t size() const;
+
+    // Table shared by callers that have no server configuration
+    static const MimeTypes& builtin();
+    static const std::string DEFAULT_TYPE;
+    static const size_t MAX_EXTENSION = 15;
+
+  private:
+    struct Entry {
+      char extension[MAX_EXTENSION + 1];
+      std::string type;
+    };
+    std::vector<Entry> entries;
+
+    static bool lowerExtension(const std::string& filePath, char* out);
+    static bool entryLess(const Entry& a, const Entry& b);
+};
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef NEGATIVELOOKUPCACHE_HPP
+#define NEGATIVELOOKUPCACHE_HPP
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "FileWatcher.hpp"
+
+// Recently missed paths, so a scanner repeating nonexistent URLs is answered
+// 404 from memory before any path resolution or stat(). A Bloom filter in
+// front keeps the usual case, a path that never missed, to a few bit tests.
+// Each entry is stamped with its route root's generation, which the watcher
+// bumps on any change below that root; entries whose directories can't be
+// watched expire after ttlMs instead.
+class NegativeLookupCache : public FileChangeListener {
+  public:
+    explicit NegativeLookupCache(size_t maxEntries = 8192, long ttlMs = 5000);
+    ~NegativeLookupCache();
+
+    void setWatcher(FileWatcher* watcher);
+    // path is the route root joined with the request path
+    bool isKnownMiss(const std::string& root, const std::string& path);
+    // resolvedPath is the file that was actually looked for (default file
+    // appended and so on), whose directory must be watched
+    void recordMiss(const std::string& root, const std::string& path, const std::string& resolvedPath);
+    void clear(void);
+
+    void fileChanged(const std::string& path, bool subtree);
+
+  private:
+    enum {
+      BLOOM_BITS = 1 << 17,
+      BLOOM_HASHES = 4
+    };
+    struct Entry {
+      std::string root;
+      unsigned long generation;
+      long expiresMs;          // 0 when the watcher covers it
+      std::list<std::string>::iterator use;  // its place in recency
+    };
+    size_t maxEntries;
+    long ttlMs;
+    FileWatcher* watcher;
+    std::vector<uint32_t> bloom;
+    size_t bloomInsertions;
+    std::map<std::string, Entry> entries;
+    std::list<std::string> recency;  // least recently hit first
+    std::map<std::string, unsigned long> rootGenerations;
+
+    void erase(std::map<std::string, Entry>::iterator it);
+    bool bloomMayContain(const std::string& path) const;
+    void bloomAdd(const std::string& path);
+    void rebuildBloom(void);
+    bool watchNearestDirectory(const std::string& root, const std::string& path);
+    static void hash(const std::string& path, uint32_t& h1, uint32_t& h2);
+    static long nowMs(void);
+
+    NegativeLookupCache(const NegativeLookupCache&);
+    NegativeLookupCache& operator=(const NegativeLookupCache&);
+};
+
+#endif
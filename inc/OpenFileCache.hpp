@@ -0,0 +1,60 @@
+#ifndef OPENFILECACHE_HPP
+#define OPENFILECACHE_HPP
+
+#include <map>
+#include <string>
+#include <ctime>
+#include <sys/types.h>
+#include "FileWatcher.hpp"
+
+// A read-only descriptor shared by every response sending the same file.
+// Senders use positional I/O (sendfile with an offset, pread), so the fd's
+// own offset is never relied on.
+struct OpenFile {
+  int fd;
+  off_t size;
+  struct timespec mtime;
+  int refCount;
+  bool detached;   // dropped from the cache, closed by the last release()
+};
+
+// nginx-style open file cache: hot static files are opened once and kept
+// open, so serving them needs no open/fstat/close. Open failures are cached
+// for a short while too. Entries are dropped on eviction or when the watcher
+// reports a change; one still being sent stays open until released.
+class OpenFileCache : public FileChangeListener {
+  public:
+    explicit OpenFileCache(size_t maxFiles = 256, long ttlMs = 1000);
+    ~OpenFileCache();
+
+    void setWatcher(FileWatcher* watcher);
+    // Returns the open file with one reference taken, or NULL with errno set
+    OpenFile* acquire(const std::string& path);
+    void release(OpenFile* file);
+    void invalidate(const std::string& path);
+    void clear(void);
+
+    void fileChanged(const std::string& path, bool subtree);
+
+  private:
+    struct Slot {
+      OpenFile* file;       // NULL for a cached open failure
+      int error;
+      long expiresMs;       // 0 when kept up to date by the watcher
+      unsigned long lastUse;
+    };
+    size_t maxFiles;
+    long ttlMs;
+    unsigned long useClock;
+    FileWatcher* watcher;
+    std::map<std::string, Slot> entries;
+
+    void drop(std::map<std::string, Slot>::iterator it);
+    void evictOldest(void);
+    static long nowMs(void);
+
+    OpenFileCache(const OpenFileCache&);
+    OpenFileCache& operator=(const OpenFileCache&);
+};
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef OUTPUTQUEUE_HPP
+#define OUTPUTQUEUE_HPP
+
+#include <deque>
+#include <string>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include "OpenFileCache.hpp"
+
+// Produces a response body a piece at a time, asked for the next piece only
+// once the previous one went out
+class OutputSource {
+  public:
+    virtual ~OutputSource() {}
+    // Appends the next piece to out; false once the body is complete
+    virtual bool produce(std::string& out) = 0;
+};
+
+// Response bytes a non-blocking client socket did not take yet. Every write
+// goes out as far as the socket allows right away and the rest waits here,
+// in order, until the owner calls flush() on EPOLLOUT: nothing ever waits
+// for the socket, so one slow reader can't stall the reactor.
+class OutputQueue {
+  public:
+    OutputQueue();
+    ~OutputQueue();
+
+    void setFd(int fd);
+    int getFd(void) const;
+    // Each returns false once the client is gone; what follows is dropped
+    bool write(const char* data, size_t length);
+    bool write(const std::string& data);
+    // Slices are copied only as far as the socket did not take them
+    bool writev(const struct iovec* iov, size_t count);
+    // Queues bytes [0, file->size) of an acquired file, sent with sendfile
+    // from the queue's own offset; the reference is released once all of
+    // it went out or the queue is cleared
+    bool sendFile(OpenFile* file, OpenFileCache& files);
+    // Queues a generated body; the queue owns source and deletes it once
+    // it is complete or the queue is cleared
+    bool stream(OutputSource* source);
+    // Sends as much as the socket takes now
+    bool flush(void);
+    bool isPending(void) const;
+    bool hasFailed(void) const;
+    void clear(void);
+
+  private:
+    struct Segment {
+      std::string data;
+      size_t sent;
+      OpenFile* file;       // instead of data when set
+      OpenFileCache* files;
+      off_t offset;
+      OutputSource* source; // refills data when set
+
+      Segment();
+    };
+    int fd;
+    bool failed;
+    std::deque<Segment> segments;
+
+    void queue(const char* data, size_t length);
+    bool sendData(Segment& segment);
+    bool sendFileData(Segment& segment);
+    bool sendSourceData(Segment& segment);
+    void popFront(void);
+    bool fail(void);
+
+    OutputQueue(const OutputQueue&);
+    OutputQueue& operator=(const OutputQueue&);
+};
+
+#endif
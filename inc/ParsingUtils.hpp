@@ -22,6 +22,11 @@ class ParsingUtils {
 		static bool controlCharacters(const std::string& str);
 		static void setPrefixString(std::string& str, const std::string& prefix);
     static bool isValidIPv4(const std::string& host);
+    // Dotted quad of an address in host byte order
+    static std::string formatIPv4(unsigned int address);
+    // Contents of a JSON string, without the quotes; bytes that are not
+    // part of valid UTF-8 come out as \u00XX
+    static std::string jsonEscape(const std::string& str);
     static bool containsIllegalUrlCharacters(const std::string& url);
     static void trimAndLower(std::string& str);
     static bool containsAlpha(std::string& str);
@@ -41,12 +46,16 @@ class ParsingUtils {
     static std::string getCurrentWorkingDirectory(void);
     static std::string getWebservRoot(void);
     static std::string removeFinalSlash(const std::string& path);
+    // Resolves "." and ".." segments and collapses repeated slashes; false
+    // when the path is not absolute or ".." climbs above the root
+    static bool normalizeUriPath(const std::string& path, std::string& normalized);
     static bool isFdClosed(int fd) {
     return (fcntl(fd, F_GETFD) == -1 && errno == EBADF);
 }
 
     // url Utils
     static bool isAbsoluteUrl(const std::string& url);
+    static std::string getQueryParameter(const std::string& query, const std::string& name);
 
     //template
     template <typename T>
@@ -0,0 +1,48 @@
+#ifndef PROCESSREAPER_HPP
+#define PROCESSREAPER_HPP
+
+#include <map>
+#include <sys/types.h>
+#include <spawn.h>
+#include <stdint.h>
+#include "EventHandler.hpp"
+
+// Told that a watched child exited; status is as filled in by waitpid
+class ChildExitListener {
+  public:
+    virtual ~ChildExitListener() {}
+    virtual void childExited(pid_t pid, int status) = 0;
+};
+
+// Reaps child processes from the reactor: SIGCHLD is blocked and read from
+// a signalfd, so exits are handled between events like any other input and
+// nothing ever blocks in waitpid. Every child is reaped, watched or not.
+class ProcessReaper : public EventHandler {
+  public:
+    ProcessReaper();
+    ~ProcessReaper();
+
+    // False when signalfd is unavailable; callers then reap on their own
+    bool isActive(void) const;
+    void watch(pid_t pid, ChildExitListener* listener);
+    void unwatch(pid_t pid);
+    // SIGCHLD unblocked and SIGPIPE back to default, for a child about to exec
+    static void restoreSignalMask(void);
+    // The same for a child started with posix_spawn
+    static void restoreSignalMask(posix_spawnattr_t* attributes);
+
+    void handleEvent(uint32_t events);
+    void closeConnection(void);
+
+  private:
+    // Filled right after fork: exits are only reaped from handleEvent, so
+    // none can be missed in between
+    std::map<pid_t, ChildExitListener*> listeners;
+
+    void reap(void);
+
+    ProcessReaper(const ProcessReaper&);
+    ProcessReaper& operator=(const ProcessReaper&);
+};
+
+#endif
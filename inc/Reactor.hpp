@@ -3,18 +3,32 @@
 
 #include <map>
 #include <ctime>
+#include <sys/epoll.h>
 #include "EventHandler.hpp"
 
 class Reactor {
 	private:
 		int epfd;
 		std::map<int, EventHandler*> handlers;
+		// Events each handler is currently registered for
+		std::map<int, uint32_t> interests;
 		std::map<int, time_t> lastActivityMap;
+		// Events of the current epoll_wait, from batchNext on still to be
+		// dispatched; a handler deregistered meanwhile has its own dropped
+		static const int MAX_EVENTS = 2000;
+		epoll_event batch[MAX_EVENTS];
+		int batchSize;
+		int batchNext;
 	public:
 		Reactor();
 		~Reactor();
-		void registerHandler(EventHandler* eh);
+		void registerHandler(EventHandler* eh, uint32_t events = EPOLLIN | EPOLLOUT);
 		void deregisterHandler(int fd);
+		// Replaces the interest set at registration
+		void modifyHandler(int fd, uint32_t events);
+		// Add or remove single events, e.g. EPOLLOUT while output is blocked
+		void enableEvents(int fd, uint32_t events);
+		void disableEvents(int fd, uint32_t events);
 		void event_loop();
 		void updateLastActivity(int fd);
 		void removeFromInactivityList(int fd);
@@ -7,13 +7,57 @@
 #include "MultipartFormDataParser.hpp"
 #include "Reactor.hpp"
 #include "Cookie.hpp"
+#include "SessionData.hpp"
+#include "ConfigSnapshot.hpp"
+#include "CgiResponseCache.hpp"
+#include "FastCgiConnection.hpp"
+#include "CgiBodyStream.hpp"
+#include "CgiHandler.hpp"
+#include "CgiScheduler.hpp"
+#include "AccessLog.hpp"
+#include "OutputQueue.hpp"
 
-class RequestHandler : public EventHandler {
+class RequestHandler : public EventHandler, public CgiResponseListener, public CgiBodyListener, public CgiOutputListener,
+    public CgiSlotListener {
   private: 
     HTTPRequestParser parser;
     Reactor* reactor;
     Cookie cookie;
     bool closeConnectionFlag;
+    // The request's session when the server keeps them in signed cookies
+    SessionData signedSession;
+    bool hasSignedSession;
+    int localPort;
+    // Holds a slot in the ClientLimiter from accept until destruction
+    uint32_t clientAddress;
+    // Queued in the CgiResponseCache for a response another execution makes
+    bool waitingForCgi;
+    // A FastCGI request of its own is pending with a backend
+    bool waitingForFastCgi;
+    // Forked script answering the current request, and the stream feeding
+    // it the body; each clears its pointer here when done
+    CgiHandler* cgiHandler;
+    CgiBodyStream* bodyStream;
+    // Set once a body went to a script: nothing read after it is a request
+    bool cgiBodyStarted;
+    // Waiting in the CgiScheduler for a slot to run the script, with what
+    // it will be started with; the socket is not read meanwhile
+    bool cgiQueued;
+    const Route* queuedRoute;
+    const Server* queuedServer;
+    std::string queuedFilePath;
+    std::string queuedQueryString;
+    std::string queuedPool;
+    // Configuration the current request started with, and its virtual host
+    ConfigSnapshot* config;
+    std::string resolvedHost;
+    Server* resolvedServer;
+    // The current request's access_log line, open from its first byte
+    AccessLog::Record access;
+    // Response bytes the socket did not take yet; no request is read while
+    // there are any, and a close asked for meanwhile waits until they are out
+    OutputQueue output;
+    bool closeAfterOutput;
 
     void handleGetRequest(const Server* server);
     void handlePostRequest(const Server* server);
@@ -23,11 +67,21 @@ class RequestHandler : public EventHandler {
     void handleFileRequest(const Route& route, const Server* server);
     void handleFileUpload(const Route& route, const Server* server);
     void handleCGIRequest(const Route& route, const Server* server);
-    void handleSession(void);
+    void startCGI(const Route& route, const Server* server, const std::string& filePath, const std::string& queryString, const std::string& pool);
+    void handleCachedCGIRequest(const Route& route, const std::string& filePath, const std::string& queryString, const std::string& pool);
+    std::map<std::string, std::string> buildCgiVariables(const std::string& scriptPath, const std::string& queryString);
+    FastCgiRequest* createFastCgiRequest(const std::string& filePath, const std::string& queryString);
+    void submitFastCgiRequest(const Route& route, FastCgiRequest* request);
+    void handleSession(const Server* server);
+    void handleSignedSession(const Server* server);
+    SessionData* findSessionData(void);
+    void logAccess(void);
+    void waitForOutput(void);
+    void flushOutput(void);
 
     bool isPayloadTooLarge(const Server* server, const Route& route);
-    bool shouldCloseConnection(void);
-    std::string generateDirectoryListingPage(const std::vector<std::string>& contents, const std::string& directoryPath);
+    bool isRateLimited(const RouteRecord& record);
+    bool isStreamedCgiPost(void);
     std::string extractFilename(const HTTPRequestParser& parser);
     std::string getFilename(const MultipartFormDataParser& parser);
     std::string removeFilename(const std::string& uri);
@@ -36,19 +90,24 @@ class RequestHandler : public EventHandler {
     std::string removeQueryString(const std::string& uri);
     std::string endWithSlash(const std::string& uri);
     std::string extractSessionIdFromCookie(const std::string& cookie);
-    Server* findServerForHost(const std::string& host, const std::map<std::string, Server*>* serversMap);
+    Server* findServerForHost(const std::string& host);
 
   public:
     RequestHandler();
-    explicit RequestHandler(int fd, Reactor* reactor);
+    explicit RequestHandler(int fd, Reactor* reactor, int localPort = -1, uint32_t clientAddress = 0);
     virtual ~RequestHandler();
 
     void handleEvent(uint32_t events);
+    void cgiResponseReady(const std::string& response);
+    void cgiBodyStreamed(bool complete);
+    void cgiOutputDone(bool complete);
+    void cgiSlotGranted(void);
+    void cgiSlotExpired(void);
     void handleRequest(const Server* server);
     std::string getFilePathFromUri(const Route& route, const std::string& uri);
     std::string getUploadDirectoryFromUri(const Route& route, const std::string& uri);
     std::string extractDirectoryPath(const std::string& filePath);
-    std::string getMimeType(const std::string& filePath);
+    const std::string& getMimeType(const std::string& filePath, const Server* server = NULL);
     void closeConnection(void);
 };
 #endif
@@ -5,6 +5,17 @@
 #include <string>
 #include <vector>
 
+// Bounds on the forked CGI scripts of a route; 0 leaves one off. CPU and
+// memory are limited right after the exec, not before it.
+struct CgiLimits {
+    int timeoutSeconds;  // wall clock, then SIGTERM and, after a grace, SIGKILL
+    int cpuSeconds;      // RLIMIT_CPU
+    long memoryBytes;    // RLIMIT_AS
+    int maxScripts;      // running at once; later requests wait their turn
+    int queueSize;       // waiting at most, beyond which requests get a 503
+
+    CgiLimits();
+};
 
 class Route {
 public:
@@ -27,6 +38,17 @@ public:
     void setMaxBodySize(int size);
     void setHasMaxBodySize(bool value);
     void setHasRootDirectoryPath(bool value);
+    void setRateLimit(double requestsPerSecond);
+    void setRateBurst(int burst);
+    void setStatusPage(bool value);
+    void setCgiCacheTtl(int seconds);
+    void setCgiCacheStale(int seconds);
+    void setCgiCacheVary(const std::vector<std::string>& headers);
+    void setCgiCacheIgnoreCookie(bool value);
+    void setFastCgiAddress(const std::string& address);
+    void setFastCgiWorkers(int workers);
+    void setFastCgiConnections(int connections);
+    void setCgiLimits(const CgiLimits& limits);
 
     std::string getRoutePath() const;
     bool getGetMethod() const;
@@ -46,6 +68,20 @@ public:
     int getMaxBodySize() const;
     bool getHasMaxBodySize() const;
     bool getHasRootDirectoryPath() const;
+    bool getHasRateLimit() const;
+    double getRateLimit() const;
+    int getRateBurst() const;
+    bool getStatusPage() const;
+    bool getHasCgiCache() const;
+    int getCgiCacheTtl() const;
+    int getCgiCacheStale() const;
+    const std::vector<std::string>& getCgiCacheVary() const;
+    bool getCgiCacheIgnoreCookie() const;
+    bool getHasFastCgi() const;
+    std::string getFastCgiAddress() const;
+    int getFastCgiWorkers() const;
+    int getFastCgiConnections() const;
+    const CgiLimits& getCgiLimits() const;
 
 private:
     std::string routePath;
@@ -66,6 +102,26 @@ private:
     int maxBodySize;
     bool hasMaxBodySize;
     bool hasRootDirectoryPath;
+    // Token bucket per client: refilled at rateLimit tokens/s, holds rateBurst
+    bool hasRateLimit;
+    double rateLimit;
+    int rateBurst;
+    bool statusPage;
+    // CGI responses cached for cgiCacheTtl s, then served stale for
+    // cgiCacheStale s more while being refreshed
+    int cgiCacheTtl;
+    int cgiCacheStale;
+    std::vector<std::string> cgiCacheVary;
+    // The script is known not to read cookies: they are left out of the key
+    // and withheld from it, so every client shares one entry
+    bool cgiCacheIgnoreCookie;
+    // cgi_pass=fastcgi://<address>: requests go to a FastCGI application
+    // instead of a forked script. Workers only apply to spawned pools; 0
+    // connections lets the backend pick.
+    std::string fastCgiAddress;
+    int fastCgiWorkers;
+    int fastCgiConnections;
+    CgiLimits cgiLimits;
 };
 
 #endif
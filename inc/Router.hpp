@@ -0,0 +1,71 @@
+#ifndef ROUTER_HPP
+#define ROUTER_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "Route.hpp"
+
+enum RouteFlag {
+  ROUTE_GET               = 1 << 0,
+  ROUTE_POST              = 1 << 1,
+  ROUTE_DELETE            = 1 << 2,
+  ROUTE_REDIRECT          = 1 << 3,
+  ROUTE_DIRECTORY_LISTING = 1 << 4,
+  ROUTE_DEFAULT_FILE      = 1 << 5,
+  ROUTE_CGI               = 1 << 6,
+  ROUTE_FILE_UPLOAD       = 1 << 7,
+  ROUTE_MAX_BODY_SIZE     = 1 << 8,
+  ROUTE_RATE_LIMIT        = 1 << 9,
+  ROUTE_STATUS            = 1 << 10,
+  ROUTE_CGI_CACHE         = 1 << 11
+};
+
+// What the hot path needs to dispatch a request: the route's switches packed
+// into bits, and a pointer to the full (immutable) Route owned by the Server.
+struct RouteRecord {
+  const Route* route;
+  uint16_t flags;
+
+  bool has(RouteFlag flag) const {
+    return (flags & flag) != 0;
+  }
+};
+
+// Routes compiled into a path-segment radix trie. match() returns the route
+// with the longest prefix of the path, on whole segments: "/website" matches
+// "/website/img/x.jpg" but not "/websites".
+class Router {
+  public:
+    Router();
+
+    void compile(const std::map<std::string, Route>& routes);
+    // Returns NULL when no route, not even "/", matches
+    const RouteRecord* match(const std::string& path) const;
+    size_t size() const;
+
+  private:
+    struct Node {
+      int record;  // index in records, -1 if no route ends here
+      size_t firstEdge;
+      size_t edgeCount;
+    };
+    // Single-child chains are collapsed into one edge of several segments
+    struct Edge {
+      std::vector<std::string> label;
+      size_t child;
+    };
+    struct BuildNode;
+
+    std::vector<RouteRecord> records;
+    std::vector<Node> nodes;
+    std::vector<Edge> edges;  // sorted by first segment within each node
+
+    size_t flatten(const BuildNode* buildNode);
+    const Edge* findEdge(const Node& node, const std::string& path, size_t start, size_t length) const;
+    static uint16_t packFlags(const Route& route);
+    static bool nextSegment(const std::string& path, size_t& pos, size_t& start, size_t& length);
+};
+
+#endif
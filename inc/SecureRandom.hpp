@@ -0,0 +1,41 @@
+#ifndef SECURERANDOM_HPP
+#define SECURERANDOM_HPP
+
+#include <cstddef>
+#include <stdint.h>
+
+// ChaCha20 keystream as a CSPRNG, keyed from getrandom(). Output is made
+// BLOCKS blocks at a time and handed out from a buffer, so a session ID
+// costs a memcpy and no system call. After every refill the key is
+// replaced with the first 32 bytes of the new output, and bytes handed out
+// are wiped, so a later memory disclosure does not reveal earlier output
+// (Bernstein's fast-key-erasure construction). The kernel is asked for a
+// fresh key every RESEED_BYTES.
+class SecureRandom {
+  public:
+    static const size_t BLOCK_SIZE = 64;
+    static const size_t BLOCKS = 16;
+    static const size_t RESEED_BYTES = 1 << 20;
+
+    // Throws std::runtime_error if the kernel has no randomness to give
+    SecureRandom();
+    ~SecureRandom();
+
+    void fill(unsigned char* out, size_t length);
+    // One ChaCha20 block (RFC 8439, 2.3)
+    static void block(const uint32_t key[8], uint32_t counter, const uint32_t nonce[3], unsigned char out[BLOCK_SIZE]);
+
+  private:
+    uint32_t key[8];
+    unsigned char buffer[BLOCK_SIZE * BLOCKS];
+    size_t available;  // unused bytes at the end of buffer
+    size_t sinceReseed;
+
+    void reseed(void);
+    void refill(void);
+
+    SecureRandom(const SecureRandom&);
+    SecureRandom& operator=(const SecureRandom&);
+};
+
+#endif
@@ -5,6 +5,10 @@
 #include <string>
 #include "Route.hpp"  // Assume this is the header file for your Route class
 #include "ErrorPageManager.hpp"
+#include "MimeTypes.hpp"
+#include "Router.hpp"
+#include "ListenerFactory.hpp"
+#include "AccessLog.hpp"
 
 class Server {
 	public:
@@ -15,7 +19,24 @@ class Server {
 		void setErrorPage(int errorCode, const std::string& pagePath);
 		void hasCustomErrorPage(bool value);
 		void setMaxClientBodySize(size_t size);
+    void setDefaultServer(bool value);
+    // Position of the [server:] block in the file, servers being kept by name
+    void setConfigOrder(size_t order);
+    // Concurrent connections one client address may hold, 0 for no limit
+    void setMaxConnectionsPerClient(size_t limit);
+    void setListenerOptions(const ListenerOptions& options);
+    // Sessions kept in signed cookies instead of the SessionManager
+    void setSignedSessions(bool value);
+    // The first key signs, all of them verify
+    void setSessionKeys(const std::vector<std::string>& keys);
+    // File the SessionManager maps its table from, "" to keep it in memory
+    void setSessionFile(const std::string& path);
+    // debug, info, warning or error; "" leaves the logger's default
+    void setLogLevel(const std::string& level);
+    void setAccessLogOptions(const AccessLogOptions& options);
 		void addRoute(const std::string& path, const Route& route);
+    void setMimeType(const std::string& extension, const std::string& type);
+    void compileRoutes(void);
 
 		std::string getHost() const;
     const std::vector<int>& getPorts() const;
@@ -24,10 +45,23 @@ class Server {
 		std::string getErrorPage(int errorCode) const;
 		bool hasCustomErrorPage(void) const;
 		long long getMaxClientBodySize() const;
+    bool isDefaultServer(void) const;
+    size_t getConfigOrder(void) const;
+    size_t getMaxConnectionsPerClient(void) const;
+    const ListenerOptions& getListenerOptions(void) const;
+    bool hasSignedSessions(void) const;
+    const std::vector<std::string>& getSessionKeys(void) const;
+    const std::string& getSessionFile(void) const;
+    const std::string& getLogLevel(void) const;
+    const AccessLogOptions& getAccessLogOptions(void) const;
 		Route getRoute(const std::string& path) const;
+    const RouteRecord* matchRoute(const std::string& path) const;
     std::map<std::string, Route> getRoutes() const;
     ErrorPageManager getErrorPageManager() const;
-    const std::map<std::string, std::string>& getMimeTypes() const;
+    const MimeTypes& getMimeTypes() const;
+    // Complete error responses, built on first use and kept with the server
+    const std::string* getCachedErrorResponse(int errorCode) const;
+    const std::string& cacheErrorResponse(int errorCode, const std::string& response) const;
 
     //debug
     void printRoutes() const;
@@ -42,8 +76,19 @@ class Server {
 		std::map<int, std::string> errorPages;
 		bool customErrorPage;
 		long long maxClientBodySize;
+    bool defaultServer;
+    size_t configOrder;
+    size_t maxConnectionsPerClient;
+    ListenerOptions listenerOptions;
+    bool signedSessions;
+    std::vector<std::string> sessionKeys;
+    std::string sessionFile;
+    std::string logLevel;
+    AccessLogOptions accessLogOptions;
 		std::map<std::string, Route> routes;
-    std::map<std::string, std::string> mimeTypes;
+    MimeTypes mimeTypes;
+    Router router;
+    mutable std::map<int, std::string> errorResponses;
 };
 
 #endif
@@ -5,20 +5,93 @@
 #include <string>
 #include "Server.hpp"
 #include "SessionManager.hpp"
+#include "DirectoryListingCache.hpp"
+#include "TemplateCache.hpp"
+#include "ConfigSnapshot.hpp"
+#include "FileInfoCache.hpp"
+#include "OpenFileCache.hpp"
+#include "NegativeLookupCache.hpp"
+#include "ClientLimiter.hpp"
+#include "CgiResponseCache.hpp"
+#include "CgiScheduler.hpp"
+#include "ProcessReaper.hpp"
+#include "FastCgiBackend.hpp"
+
+class Reactor;
+class AcceptHandler;
 
 //Singleton class
 class ServerManager {
 public:
     static ServerManager& getInstance();
-    void setServersMap(std::map<std::string, Server*>* map);
-    std::map<std::string, Server*>* getServersMap() const;
+
+    // Current configuration; holders that outlive one event must acquire() it
+    void setConfig(ConfigSnapshot* snapshot);
+    ConfigSnapshot* getConfig() const;
+    void setConfigPath(const std::string& path);
+
+    // Opens listeners for newly configured ports and closes the ones no
+    // longer configured, leaving unchanged ports (and their backlog) alone.
+    // A port that moved keeps its old listener if the new one can't be bound.
+    void syncListeners(Reactor& reactor);
+    // Re-parses the configuration file and swaps it in; the running
+    // configuration is kept when the new one is invalid
+    bool reloadConfig(Reactor& reactor);
+    // Starts the FastCGI backends routes now use and stops the ones none
+    // uses any more; unchanged ones keep their workers and connections
+    void syncFastCgiBackends(Reactor& reactor);
+    void shutdown(void);
 
     SessionManager& getSessionManager();
+    DirectoryListingCache& getDirectoryListingCache();
+    TemplateCache& getTemplateCache();
+    FileInfoCache& getFileInfoCache();
+    OpenFileCache& getOpenFileCache();
+    NegativeLookupCache& getNegativeLookupCache();
+    ClientLimiter& getClientLimiter();
+    CgiResponseCache& getCgiResponseCache();
+    CgiScheduler& getCgiScheduler();
+    AccessLog& getAccessLog();
+    // NULL when children have to be reaped synchronously
+    void setProcessReaper(ProcessReaper* reaper);
+    ProcessReaper* getProcessReaper() const;
+    // NULL when no route uses that backend
+    FastCgiBackend* getFastCgiBackend(const Route& route);
+    void removeFastCgiListener(CgiResponseListener* listener);
 
 
 private:
-    std::map<std::string, Server*>* serversMap;
+    struct Listener {
+      std::string host;
+      ListenerOptions options;
+      AcceptHandler* handler;
+    };
+
+    ConfigSnapshot* config;
+    std::string configPath;
+    std::map<int, Listener> listeners;
+
+    bool openListener(Reactor& reactor, int port, const std::string& host, const ListenerOptions& options);
+    void closeListener(Reactor& reactor, int port, const Listener& listener);
     SessionManager sessionManager;
+    DirectoryListingCache directoryListingCache;
+    TemplateCache templateCache;
+    FileInfoCache fileInfoCache;
+    OpenFileCache openFileCache;
+    NegativeLookupCache negativeLookupCache;
+    ClientLimiter clientLimiter;
+    CgiResponseCache cgiResponseCache;
+    CgiScheduler cgiScheduler;
+    AccessLog accessLog;
+    ProcessReaper* processReaper;
+    std::map<std::string, FastCgiBackend*> fastCgiBackends;
+
+    // Attaches the session table to the configured session_file
+    void syncSessionFile(void);
+    // Applies the configured log_level, info when none is
+    void syncLogLevel(void);
+    // Opens the configured access_log, or closes it when none is
+    void syncAccessLog(void);
 
     ServerManager();
     ~ServerManager();
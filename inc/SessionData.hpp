@@ -2,20 +2,32 @@
 #define SESSIONDATA_HPP
 
 #include <string>
+#include <ctime>
 
 class SessionData {
+  public:
+    // Session IDs are stored inline, so a session is one fixed-size slot
+    static const size_t MAX_ID_LENGTH = 32;
+
   private:
-    std::string sessionId;
+    char sessionId[MAX_ID_LENGTH + 1];
     int requestCount;
+    time_t createdAt;
+    time_t lastAccess;
 
 public:
-    SessionData(const std::string& id);
+    SessionData();
+    SessionData(const std::string& id, time_t now = 0);
     void incrementRequestCount();
 
     std::string getSessionId() const;
     void setSessionId(const std::string& id);
+    bool hasSessionId(const std::string& id) const;
     int getRequestCount() const;
     void setRequestCount(int count);
+    time_t getCreatedAt() const;
+    time_t getLastAccess() const;
+    void touch(time_t now);
 
 };
 
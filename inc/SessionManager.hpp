@@ -2,22 +2,130 @@
 #define SESSIONMANAGER_HPP
 
 #include <string>
-#include <map>
+#include <vector>
+#include <ctime>
+#include <stdint.h>
 #include "SessionData.hpp"
+#include "SecureRandom.hpp"
 
+// Bounded session store. Sessions live in an open-addressing table of
+// fixed-size slots, threaded on an LRU list. A session expires after
+// idleTimeout seconds without a request, or lifetime seconds after it was
+// created, whichever comes first; past maxSessions the least recently used
+// one is evicted. Expiry is incremental: tick() from the reactor loop drops
+// a bounded number of sessions per call, and lookups check their own.
+//
+// The table is one mapping: a header, then the slots. attach() puts it in a
+// file, which a restarted server maps straight back in.
+//
+// Only the reactor thread uses it, so nothing here locks; a lookup is a hash,
+// a short probe and two LRU link updates.
 class SessionManager {
-  private:
-    std::map<std::string, SessionData> sessions;
-
   public:
+    struct Counters {
+      unsigned long created;
+      unsigned long expiredIdle;
+      unsigned long expiredLifetime;
+      unsigned long evicted;
+    };
+
+    // Characters in a generated ID, 6 random bits each: 132 bits
+    static const size_t ID_LENGTH = 22;
+    static const size_t LOG_PREFIX_LENGTH = 6;
+
+    explicit SessionManager(size_t maxSessions = 10000, long idleTimeout = 1800, long lifetime = 86400);
     ~SessionManager();
+
+    // Moves the table into file, locked for this process, taking over the
+    // sessions already in it; false leaves the table where it was
+    bool attach(const std::string& file);
+    // "" while the table is in memory only
+    const std::string& getFilePath(void) const;
+
+    // Always under a fresh random ID: an ID a client brings is never taken
+    // on, or an expired session would come back and a planted one stick
     std::string createSession();
-    std::string createSession(const std::string& sessionId); // overload in cash of cached cookie, but server was restarted
 
+    // NULL when unknown or expired; a hit counts as activity
     SessionData* getSessionData(const std::string& sessionId);
     std::string generateUniqueID();
+    static bool isValidId(const std::string& sessionId);
+    // What of an ID may be logged
+    static std::string logPrefix(const std::string& sessionId);
+    // When the session expires unless used again
+    time_t getExpiry(const SessionData& session) const;
+    // Signs tokens for servers with signed sessions but no session_keys;
+    // random, so they do not survive a restart
+    const std::vector<std::string>& getFallbackKeys(void);
     void debugPrintSessions() const;
-    void cleanupSessions();
+
+    void tick(void);
+    // Drops up to EXPIRE_BUDGET sessions expired at now
+    void expire(time_t now);
+
+    size_t getSessionCount(void) const;
+    const Counters& getCounters(void) const;
+    // Counters as "name value" lines, for the status_page route
+    std::string formatCounters(void) const;
+
+  private:
+    static const uint32_t NONE = 0xffffffffu;
+    static const size_t EXPIRE_BUDGET = 256;
+
+    struct Slot {
+      SessionData data;
+      bool used;
+      uint32_t newer;  // LRU neighbours, NONE at either end
+      uint32_t older;
+    };
+    // Starts the mapping. Everything a restart needs is in here, so a file
+    // is usable as soon as it is mapped.
+    struct Header {
+      char magic[8];
+      uint32_t slotSize;  // a build with another Slot layout starts afresh
+      uint32_t clean;     // set once the last process to use it closed it
+      uint64_t capacity;
+      uint64_t count;
+      uint32_t newest;
+      uint32_t oldest;
+      Counters counters;
+    };
+
+    Header* header;
+    Slot* slots;
+    // -1 while the table is in memory only
+    int fd;
+    std::string path;
+    size_t maxSessions;
+    long idleTimeout;
+    long lifetime;
+    // Next slot the lifetime sweep looks at
+    size_t sweepCursor;
+    time_t lastTick;
+    SecureRandom random;
+    std::vector<std::string> fallbackKeys;
+
+    size_t find(const std::string& sessionId) const;
+    SessionData* insert(const SessionData& session);
+    void erase(size_t index);
+    void grow(void);
+    void rebuild(void);
+    void replaceTable(Header* table, int tableFd);
+    void link(size_t index);
+    void unlink(size_t index);
+    void relink(size_t to);
+    bool isExpired(const SessionData& session, time_t now) const;
+    void countExpiry(const SessionData& session, time_t now);
+    static uint32_t hash(const std::string& sessionId);
+    static Header* mapTable(int tableFd, size_t capacity);
+    static Header* loadTable(int tableFd, size_t size);
+    static void formatTable(Header* table, size_t capacity);
+    static void unmapTable(Header* table, int tableFd);
+    static size_t mappingSize(size_t capacity);
+    static Slot* slotsOf(Header* table);
+
+    SessionManager(const SessionManager&);
+    SessionManager& operator=(const SessionManager&);
 };
 
 #endif
@@ -0,0 +1,33 @@
+#ifndef SESSIONTOKEN_HPP
+#define SESSIONTOKEN_HPP
+
+#include <string>
+#include <vector>
+#include <ctime>
+#include <stdint.h>
+#include "SessionData.hpp"
+
+// Stateless sessions: the SessionData travels in the cookie, signed with
+// HMAC-SHA256, so any worker holding the keys can verify it without a
+// shared store. A token is base64url(payload) "." base64url(mac), the
+// payload holding the ID, creation time, request count and expiry.
+class SessionToken {
+  public:
+    // Signed with key, valid until expiresAt
+    static std::string issue(const SessionData& session, time_t expiresAt, const std::string& key);
+    // True when one of keys signed token and it has not expired at now. Any
+    // of them verifies, so a new key can be put first while tokens signed
+    // with the old one are still around.
+    static bool verify(const std::string& token, const std::vector<std::string>& keys, time_t now, SessionData& session);
+
+  private:
+    static const unsigned char VERSION = 1;
+
+    static std::string encode(const std::string& bytes);
+    static bool decode(const std::string& text, std::string& bytes);
+    static bool equals(const std::string& a, const std::string& b);
+    static void putNumber(std::string& out, uint64_t value, int bytes);
+    static uint64_t getNumber(const std::string& in, size_t offset, int bytes);
+};
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef SHA256_HPP
+#define SHA256_HPP
+
+#include <cstddef>
+#include <string>
+#include <stdint.h>
+
+// SHA-256 (FIPS 180-4) and HMAC-SHA256 (RFC 2104), for signing session
+// tokens without an external crypto library
+class Sha256 {
+  public:
+    static const size_t DIGEST_SIZE = 32;
+    static const size_t BLOCK_SIZE = 64;
+
+    Sha256();
+    void update(const void* data, size_t length);
+    // Writes the digest; the object must be reset() before reuse
+    void finish(unsigned char digest[DIGEST_SIZE]);
+    void reset(void);
+
+    static std::string digest(const std::string& message);
+    static std::string hmac(const std::string& key, const std::string& message);
+
+  private:
+    uint32_t state[8];
+    unsigned char block[BLOCK_SIZE];
+    size_t blockLength;
+    uint64_t totalLength;
+
+    void compress(const unsigned char* data);
+};
+
+#endif
@@ -16,18 +16,20 @@ class SignalHandler {
     // Cleanup and shutdown logic
     void cleanup();
 
-    void setServersMap(std::map<std::string, Server*>* map);
     void setReactor(Reactor* reactor);
 
+    // SIGHUP only raises a flag; the reactor reloads between event batches
+    bool consumeReloadRequest(void);
+
     void registerResource(EventHandler* resource);
     void deregisterResource(EventHandler* resource);
 
 private:
     // Private Constructor and Destructor
-    SignalHandler() {}
+    SignalHandler() : reactor(NULL) {}
     ~SignalHandler() {}
-    std::map<std::string, Server*>* serversMap;
     Reactor* reactor;
+    static volatile sig_atomic_t reloadRequested;
 
     // Private copy constructor and assignment operator to prevent copying
     SignalHandler(const SignalHandler&);
@@ -35,6 +37,7 @@ private:
 
     // Static signal handling function
     static void handleSignal(int signal);
+    static void handleReloadSignal(int signal);
 
     std::vector<EventHandler*> resources;
 };
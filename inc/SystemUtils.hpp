@@ -1,10 +1,14 @@
 #ifndef SYSTEM_UTILS_HPP
 #define SYSTEM_UTILS_HPP
 
+#include <cstddef>
 
 class SystemUtils {
   public: 
     static void closeUtil(int& fd);
+    // Writes the whole buffer to a blocking fd such as a log file, retrying
+    // short writes. Client sockets go through an OutputQueue instead.
+    static bool writeAll(int fd, const char* data, size_t length);
 
   private:
     SystemUtils();
@@ -0,0 +1,34 @@
+#ifndef TEMPLATECACHE_HPP
+#define TEMPLATECACHE_HPP
+
+#include <map>
+#include <string>
+#include "HtmlTemplate.hpp"
+
+class TemplateCache {
+  public:
+    explicit TemplateCache(size_t maxTemplates = 256);
+    ~TemplateCache();
+
+    // Returns the compiled template for filePath, recompiling it when the file
+    // or one of its includes changed. Throws std::runtime_error on read errors.
+    const HtmlTemplate* getTemplate(const std::string& filePath, FileInfoCache* files = NULL);
+    void invalidate(const std::string& filePath);
+    void clear(void);
+
+  private:
+    struct Slot {
+      HtmlTemplate* compiled;
+      unsigned long lastUse;
+    };
+    size_t maxTemplates;
+    unsigned long useClock;
+    std::map<std::string, Slot> templates;
+
+    void evictOldest(void);
+
+    TemplateCache(const TemplateCache&);
+    TemplateCache& operator=(const TemplateCache&);
+};
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef VIRTUALHOSTINDEX_HPP
+#define VIRTUALHOSTINDEX_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "Server.hpp"
+
+// Host header -> Server lookup, built once from the parsed configuration.
+// Keys are (local port, lowercase server name) in an open-addressing table;
+// "*.example.com" server names are wildcard entries and every port also has
+// a default server (the one marked default_server=on, else the first one
+// listening on it in the configuration file).
+class VirtualHostIndex {
+  public:
+    VirtualHostIndex();
+
+    void build(const std::map<std::string, Server*>& servers);
+    void clear(void);
+
+    // Exact name, then wildcards from the most specific suffix, then the
+    // port's default server. The port in the Host header is ignored: the
+    // caller passes the port the connection was actually accepted on.
+    Server* resolve(int localPort, const std::string& hostHeader) const;
+    Server* getDefaultServer(int localPort) const;
+    size_t size(void) const;
+
+  private:
+    struct Slot {
+      std::string host; // lowercase, "" is the port's default server
+      int port;
+      Server* server;
+      bool used;
+    };
+
+    std::vector<Slot> slots;
+    size_t count;
+
+    void insert(int port, const std::string& host, Server* server, bool replace);
+    Server* find(int port, const char* host, size_t length, bool wildcard) const;
+    static uint32_t hash(int port, const char* host, size_t length, bool wildcard);
+};
+
+#endif
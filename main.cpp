@@ -1,16 +1,14 @@
 #include <iostream>
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
 #include <string.h>
 #include <unistd.h>
 #include <cerrno>
-#include "ConfigurationParser.hpp"
+#include "ConfigSnapshot.hpp"
 #include "SignalHandler.hpp"
 #include "ServerManager.hpp"
 #include "ParsingUtils.hpp"
 #include "Reactor.hpp"
-#include "AcceptHandler.hpp"
+#include "FileWatcher.hpp"
+#include "ProcessReaper.hpp"
 #include "Logger.hpp"
 #include <cstring>
 #include <stdlib.h>
@@ -36,73 +34,47 @@ int main(int argc, char** argv) {
     memcpy(config_file_path, argv[1], strlen(argv[1]) + 1);
   }
 
-  std::map<std::string, Server*> servers;
   Reactor reactor;
+  ConfigSnapshot* config;
   try {
-    servers = ConfigurationParser::parse(config_file_path);
-    ConfigurationParser::checkValidity(servers);
+    config = ConfigSnapshot::load(config_file_path);
     Logger::log(INFO, "Configuration file parsed successfully");
   } catch (const std::exception& e) {
-    ConfigurationParser::cleanupServers(servers);
     Logger::log(ERROR, "Configuration error: " + std::string(e.what()));
     return 1;
   }
+  const std::map<std::string, Server*>& servers = config->getServers();
   Logger::log(INFO, "Number of servers to process: " + ParsingUtils::toString(servers.size()));
-  SignalHandler::getInstance().setServersMap(&servers);
-  ServerManager::getInstance().setServersMap(&servers);
-  for (std::map<std::string, Server*>::iterator it = servers.begin(); it != servers.end(); ++it) {
-    Server* serverConfig = it->second;
-    Logger::log(INFO, "Processing server: " + serverConfig->getServerName() + " with routes:");
-    serverConfig->printRoutes();
-
-    // Iterate over each port in the server configuration
-    const std::vector<int>& ports = serverConfig->getPorts();
-    for (std::vector<int>::const_iterator portIt = ports.begin(); portIt != ports.end(); ++portIt) {
-      int port = *portIt;
-      int server_fd = socket(AF_INET, SOCK_STREAM, 0);
-      if (server_fd == -1) {
-        Logger::log(ERROR, "Error creating socket: " + std::string(strerror(errno)));
-        continue; // Proceed to the next port
-      }
-      sockaddr_in serv_addr = {};
-      serv_addr.sin_family = AF_INET;
-      serv_addr.sin_port = htons(port);
-      // Check if a specific host IP is configured
-      if (!serverConfig->getHost().empty())
-        // Convert and set the specified IP address
-        serv_addr.sin_addr.s_addr = inet_addr(serverConfig->getHost().c_str());
-      else
-        serv_addr.sin_addr.s_addr = INADDR_ANY;
-
-      // Allow socket reuse
-      int opt = 1;
-      if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) == -1) {
-        Logger::log(ERROR, "Error setting socket options: " + std::string(strerror(errno)));
-        close(server_fd);
-        continue; // Proceed to the next port
-      }
-
-      if (bind(server_fd, (struct sockaddr*)&serv_addr, sizeof(serv_addr)) == -1) {
-        Logger::log(ERROR, "Error binding socket: " + std::string(strerror(errno)));
-        close(server_fd);
-        continue; // Proceed to the next port
-      }
-      Logger::log(INFO, "Socket bound to port " + ParsingUtils::toString(port) + " for server: " + serverConfig->getServerName());
-
-      if (listen(server_fd, 10) == -1) {
-        Logger::log(ERROR, "Error listening on socket: " + std::string(strerror(errno)));
-        close(server_fd);
-        continue; // Proceed to the next port
-      }
-      Logger::log(INFO, "Server " + serverConfig->getServerName() + " listening on port " + ParsingUtils::toString(port));
-
-      // Create and register an AcceptHandler for this server_fd
-      SignalHandler::getInstance().setReactor(&reactor);
-      AcceptHandler* handler = new AcceptHandler(server_fd, reactor); // Manage memory carefully
-                                                                                    // SignalHandler::getInstance().registerResource(handler);
-      reactor.registerHandler(handler);
-    }
+  for (std::map<std::string, Server*>::const_iterator it = servers.begin(); it != servers.end(); ++it) {
+    Logger::log(INFO, "Processing server: " + it->second->getServerName() + " with routes:");
+    it->second->printRoutes();
   }
+  // SIGHUP re-reads the same file
+  ServerManager::getInstance().setConfigPath(config_file_path);
+  ServerManager::getInstance().setConfig(config);
+  SignalHandler::getInstance().setReactor(&reactor);
+  ServerManager::getInstance().syncListeners(reactor);
+  // The reactor owns the watcher like any other handler
+  FileWatcher* watcher = new FileWatcher();
+  if (watcher->isActive()) {
+    reactor.registerHandler(watcher);
+    ServerManager::getInstance().getFileInfoCache().setWatcher(watcher);
+    ServerManager::getInstance().getOpenFileCache().setWatcher(watcher);
+    ServerManager::getInstance().getDirectoryListingCache().setWatcher(watcher);
+    ServerManager::getInstance().getNegativeLookupCache().setWatcher(watcher);
+  }
+  else
+    delete watcher;
+  // CGI children are reaped from the event loop too
+  ProcessReaper* reaper = new ProcessReaper();
+  if (reaper->isActive()) {
+    reactor.registerHandler(reaper);
+    ServerManager::getInstance().setProcessReaper(reaper);
+  }
+  else
+    delete reaper;
+  // After the reaper, which supervises spawned workers
+  ServerManager::getInstance().syncFastCgiBackends(reactor);
 
   try {
     reactor.event_loop();
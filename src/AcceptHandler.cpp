@@ -11,6 +11,10 @@
 #include "Reactor.hpp"
 #include "Logger.hpp"
 #include "SystemUtils.hpp"
+#include "ServerManager.hpp"
+#include "ParsingUtils.hpp"
+#include "ClientLimiter.hpp"
+#include "ListenerFactory.hpp"
 
 AcceptHandler::AcceptHandler(int fd, Reactor &reactor) : reactor(reactor) {
   EventHandler::setHandle(fd);
@@ -21,7 +25,7 @@ AcceptHandler::~AcceptHandler() {
 }
 
 void AcceptHandler::handleEvent(uint32_t /*events*/) {
-	Logger::log(INFO, "Accepting a connection");
+	LOG(DEBUG, "Accepting a connection");
 	sockaddr_in client_addr = {};
 	socklen_t client_len = sizeof(client_addr);
 	int client_fd = accept(EventHandler::getHandle(), (struct sockaddr*)&client_addr, &client_len);
@@ -30,10 +34,48 @@ void AcceptHandler::handleEvent(uint32_t /*events*/) {
 	}
 	else 
 	{
-		Logger::log(INFO, "Registering handler for connection");
+		// Virtual hosts are resolved against the port the client actually
+		// connected to, never the one it claims in its Host header
+		sockaddr_in local_addr = {};
+		socklen_t local_len = sizeof(local_addr);
+		int local_port = -1;
+		if (getsockname(client_fd, (struct sockaddr*)&local_addr, &local_len) == 0)
+			local_port = ntohs(local_addr.sin_port);
+		else
+			Logger::log(ERROR, "Error reading local address: " + std::string(strerror(errno)));
+		// Clients over their connection cap get a prebuilt 503 and are dropped
+		// before a handler is ever allocated for them
+		uint32_t client_address = ntohl(client_addr.sin_addr.s_addr);
+		ServerManager& manager = ServerManager::getInstance();
+		size_t limit = 0;
+		if (manager.getConfig() != NULL) {
+			Server* server = manager.getConfig()->getVirtualHostIndex().getDefaultServer(local_port);
+			if (server != NULL) {
+				limit = server->getMaxConnectionsPerClient();
+				ListenerFactory::tuneAccepted(client_fd, server->getListenerOptions());
+			}
+		}
+		if (!manager.getClientLimiter().acquireConnection(client_address, limit)) {
+			// Counted by the limiter and summarized from its tick()
+			LOG(DEBUG, "Connection limit reached for client " + ParsingUtils::formatIPv4(client_address));
+			const std::string& response = ClientLimiter::getServiceUnavailableResponse();
+			// Best effort, the socket is new so its send buffer is empty
+			if (send(client_fd, response.data(), response.size(), MSG_DONTWAIT | MSG_NOSIGNAL) < 0)
+				LOG(DEBUG, "Error sending 503 response: " + std::string(strerror(errno)));
+			// The response says Connection: close. Whatever the client already
+			// sent is read first: closing with unread data would reset the
+			// connection and could discard the 503 before the client reads it
+			char discard[4096];
+			for (int i = 0; i < 4 && recv(client_fd, discard, sizeof(discard), MSG_DONTWAIT) > 0; ++i)
+				;
+			SystemUtils::closeUtil(client_fd);
+			return;
+		}
+		LOG(DEBUG, "Registering handler for connection");
 		// Create and register a RequestHandler for this client_fd
-		EventHandler* handler = new RequestHandler(client_fd, &reactor);
-		reactor.registerHandler(handler);
+		// EPOLLOUT is only asked for while a response is blocked on the socket
+		EventHandler* handler = new RequestHandler(client_fd, &reactor, local_port, client_address);
+		reactor.registerHandler(handler, EPOLLIN);
 	}
 }
 
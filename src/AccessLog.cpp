@@ -0,0 +1,177 @@
+#include "AccessLog.hpp"
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Logger.hpp"
+#include "ParsingUtils.hpp"
+#include "SystemUtils.hpp"
+
+AccessLogOptions::AccessLogOptions() : maxSize(64 * 1024 * 1024), sampleRate(1) {}
+
+bool AccessLogOptions::operator==(const AccessLogOptions& other) const {
+  return path == other.path && maxSize == other.maxSize && sampleRate == other.sampleRate;
+}
+
+AccessLog::Record::Record() : open(false), client(0), status(0), bytesIn(0), bytesOut(0), parseUs(0), routeUs(0),
+    fsUs(0), sendUs(0), lastUs(0), responseUs(0) {
+  started.tv_sec = 0;
+  started.tv_nsec = 0;
+}
+
+void AccessLog::Record::lap(long& stage) {
+  if (!open)
+    return;
+  long now = nowUs();
+  stage += now - lastUs;
+  lastUs = now;
+}
+
+AccessLog::AccessLog() : logFd(-1), fileSize(0), requests(0) {}
+
+AccessLog::~AccessLog() {
+  flush();
+  if (logFd != -1)
+    close(logFd);
+}
+
+void AccessLog::configure(const AccessLogOptions& wanted) {
+  bool reopen = wanted.path != options.path;
+  if (reopen) {
+    flush();
+    if (logFd != -1)
+      close(logFd);
+    logFd = -1;
+  }
+  options = wanted;
+  if (options.sampleRate == 0)
+    options.sampleRate = 1;
+  if (reopen && !options.path.empty())
+    openFile();
+}
+
+bool AccessLog::isEnabled(void) const {
+  return logFd != -1;
+}
+
+void AccessLog::begin(Record& record, int clientFd, uint32_t client) {
+  if (logFd == -1 || clientFd < 0)
+    return;
+  record = Record();
+  record.open = true;
+  record.client = client;
+  clock_gettime(CLOCK_REALTIME, &record.started);
+  record.lastUs = nowUs();
+  if (static_cast<size_t>(clientFd) >= records.size())
+    records.resize(clientFd + 1, NULL);
+  records[clientFd] = &record;
+}
+
+void AccessLog::finish(Record& record, int clientFd) {
+  if (!record.open)
+    return;
+  if (record.responseUs != 0)
+    record.sendUs = nowUs() - record.responseUs;
+  record.open = false;
+  if (clientFd >= 0 && static_cast<size_t>(clientFd) < records.size() && records[clientFd] == &record)
+    records[clientFd] = NULL;
+  if (logFd == -1)
+    return;
+  if (++requests % options.sampleRate != 0 && record.status < 500)
+    return;
+  buffer += format(record);
+  if (buffer.size() >= BUFFER_LIMIT)
+    flush();
+}
+
+void AccessLog::flush(void) {
+  if (buffer.empty() || logFd == -1)
+    return;
+  if (options.maxSize > 0 && fileSize > 0 && fileSize + buffer.size() > options.maxSize)
+    rotate();
+  // A full disk costs the lines, never the request
+  if (logFd != -1 && SystemUtils::writeAll(logFd, buffer.data(), buffer.size()))
+    fileSize += buffer.size();
+  buffer.clear();
+}
+
+void AccessLog::sending(int clientFd, const char* data, size_t size) {
+  if (clientFd < 0 || static_cast<size_t>(clientFd) >= records.size() || records[clientFd] == NULL)
+    return;
+  Record& record = *records[clientFd];
+  if (record.responseUs == 0) {
+    record.lap(record.fsUs);
+    record.responseUs = record.lastUs;
+  }
+  // "HTTP/1.1 200 ..."
+  if (record.status == 0 && data != NULL && size >= 12 && std::memcmp(data, "HTTP/1.", 7) == 0
+      && std::isdigit(static_cast<unsigned char>(data[9])) && std::isdigit(static_cast<unsigned char>(data[10]))
+      && std::isdigit(static_cast<unsigned char>(data[11])))
+    record.status = (data[9] - '0') * 100 + (data[10] - '0') * 10 + (data[11] - '0');
+  record.bytesOut += size;
+}
+
+std::string AccessLog::format(const Record& record) {
+  struct tm utc;
+  gmtime_r(&record.started.tv_sec, &utc);
+  char time[40];
+  size_t length = std::strftime(time, sizeof(time), "%Y-%m-%dT%H:%M:%S", &utc);
+  std::snprintf(time + length, sizeof(time) - length, ".%06ldZ", record.started.tv_nsec / 1000);
+
+  std::string line = "{\"time\":\"" + std::string(time) + "\",\"client\":\"" + ParsingUtils::formatIPv4(record.client) + "\"";
+  line += ",\"vhost\":";
+  appendString(line, record.vhost);
+  line += ",\"method\":";
+  appendString(line, record.method);
+  line += ",\"path\":";
+  appendString(line, record.path);
+  line += ",\"status\":" + ParsingUtils::toString(record.status);
+  line += ",\"bytes_in\":" + ParsingUtils::toString(record.bytesIn);
+  line += ",\"bytes_out\":" + ParsingUtils::toString(record.bytesOut);
+  line += ",\"parse_us\":" + ParsingUtils::toString(record.parseUs);
+  line += ",\"route_us\":" + ParsingUtils::toString(record.routeUs);
+  line += ",\"fs_us\":" + ParsingUtils::toString(record.fsUs);
+  line += ",\"send_us\":" + ParsingUtils::toString(record.sendUs) + "}\n";
+  return line;
+}
+
+long AccessLog::nowUs(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000L + now.tv_nsec / 1000L;
+}
+
+void AccessLog::openFile(void) {
+  logFd = open(options.path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (logFd == -1) {
+    Logger::log(WARNING, "Cannot open access_log " + options.path + ": " + strerror(errno));
+    return;
+  }
+  struct stat info;
+  fileSize = fstat(logFd, &info) == 0 ? info.st_size : 0;
+}
+
+// <path>.4 becomes <path>.5 and so on; the oldest is overwritten
+void AccessLog::rotate(void) {
+  close(logFd);
+  for (size_t i = KEEP_FILES - 1; i > 0; --i) {
+    std::string from = options.path + "." + ParsingUtils::toString(i);
+    std::string to = options.path + "." + ParsingUtils::toString(i + 1);
+    rename(from.c_str(), to.c_str());
+  }
+  std::string first = options.path + ".1";
+  if (rename(options.path.c_str(), first.c_str()) == -1)
+    Logger::log(WARNING, "Cannot rotate access_log " + options.path + ": " + strerror(errno));
+  openFile();
+}
+
+void AccessLog::appendString(std::string& out, const std::string& value) {
+  out += '"';
+  out += ParsingUtils::jsonEscape(value);
+  out += '"';
+}
+
+std::vector<AccessLog::Record*> AccessLog::records;
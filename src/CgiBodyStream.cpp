@@ -0,0 +1,191 @@
+#include "CgiBodyStream.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include "Reactor.hpp"
+#include "Logger.hpp"
+#include "SystemUtils.hpp"
+
+namespace {
+  const size_t chunkSize = 65536;
+}
+
+CgiBodyStream::CgiBodyStream(int pipeFd, int clientFd, size_t remaining, Reactor* reactor, CgiBodyListener* listener)
+  : clientFd(clientFd), remaining(remaining), reactor(reactor), listener(listener),
+    registered(false), paused(false), useSplice(true) {
+  EventHandler::setHandle(pipeFd);
+}
+
+// Deleted without finish() or abort() only when the reactor is torn down;
+// the listener then just has to forget the stream
+CgiBodyStream::~CgiBodyStream() {
+  SystemUtils::closeUtil(EventHandler::getHandle());
+  if (listener != NULL)
+    listener->cgiBodyStreamed(true);
+}
+
+// Nothing is read from the client here, so the listener is never told
+// the client is gone from within its own call
+void CgiBodyStream::start(const std::string& received) {
+  reactor->registerHandler(this);
+  registered = true;
+  // Only watched while the pipe is full
+  reactor->modifyHandler(EventHandler::getHandle(), 0);
+  pending = received;
+  if (flushPending() && remaining == 0)
+    finish(true);
+}
+
+void CgiBodyStream::pump(void) {
+  reactor->updateLastActivity(clientFd);
+  while (true) {
+    if (!flushPending())
+      return;
+    if (remaining == 0) {
+      finish(true);
+      return;
+    }
+    bool spliced = useSplice && EventHandler::getHandle() != -1;
+    ssize_t moved;
+    if (spliced)
+      moved = splice(clientFd, NULL, EventHandler::getHandle(), NULL, std::min(remaining, chunkSize), SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    else
+      moved = readClient();
+    if (moved > 0) {
+      remaining -= moved;
+      continue;
+    }
+    if (moved == 0) {
+      Logger::log(WARNING, "Client closed the connection in the middle of a CGI request body");
+      finish(false);
+      return;
+    }
+    if (errno == EINTR)
+      continue;
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      // splice does not say which side would block
+      if (spliced && isPipeFull())
+        pause();
+      return;
+    }
+    if (spliced && errno == EPIPE) {
+      closePipe();
+      continue;
+    }
+    if (spliced && errno == EINVAL) {
+      // Not supported for this socket: copy through pending instead
+      useSplice = false;
+      continue;
+    }
+    Logger::log(ERROR, "Error reading CGI request body: " + std::string(strerror(errno)));
+    finish(false);
+    return;
+  }
+}
+
+ssize_t CgiBodyStream::readClient(void) {
+  char buffer[16384];
+  ssize_t bytesRead = read(clientFd, buffer, std::min(remaining, sizeof(buffer)));
+  // Dropped once the script stopped reading
+  if (bytesRead > 0 && EventHandler::getHandle() != -1)
+    pending.append(buffer, bytesRead);
+  return bytesRead;
+}
+
+// False while the pipe is full; the stream is then paused
+bool CgiBodyStream::flushPending(void) {
+  while (!pending.empty() && EventHandler::getHandle() != -1) {
+    ssize_t written = write(EventHandler::getHandle(), pending.data(), pending.size());
+    if (written > 0) {
+      pending.erase(0, written);
+      continue;
+    }
+    if (errno == EINTR)
+      continue;
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      pause();
+      return false;
+    }
+    // EPIPE: the script exited or closed its stdin
+    closePipe();
+  }
+  pending.clear();
+  return true;
+}
+
+bool CgiBodyStream::isPipeFull(void) {
+  struct pollfd out;
+  out.fd = EventHandler::getHandle();
+  out.events = POLLOUT;
+  out.revents = 0;
+  return poll(&out, 1, 0) == 0;
+}
+
+void CgiBodyStream::pause(void) {
+  if (paused)
+    return;
+  paused = true;
+  reactor->disableEvents(clientFd, EPOLLIN);
+  reactor->modifyHandler(EventHandler::getHandle(), EPOLLOUT);
+}
+
+void CgiBodyStream::resume(void) {
+  if (!paused)
+    return;
+  paused = false;
+  if (EventHandler::getHandle() != -1)
+    reactor->modifyHandler(EventHandler::getHandle(), 0);
+  reactor->enableEvents(clientFd, EPOLLIN);
+  reactor->updateLastActivity(clientFd);
+}
+
+void CgiBodyStream::stopFeeding(void) {
+  closePipe();
+}
+
+// The script sees the end of its input; whatever the client still sends is
+// read and dropped
+void CgiBodyStream::closePipe(void) {
+  resume();
+  if (registered) {
+    reactor->deregisterHandler(EventHandler::getHandle());
+    registered = false;
+  }
+  SystemUtils::closeUtil(EventHandler::getHandle());
+  pending.clear();
+}
+
+// The pipe has room again, or the script closed its end
+void CgiBodyStream::handleEvent(uint32_t events) {
+  if (paused) {
+    resume();
+    pump();
+  }
+  // Reported even while the pipe is not watched, and for as long as it stays
+  // registered
+  else if (events & (EPOLLERR | EPOLLHUP))
+    closePipe();
+}
+
+void CgiBodyStream::finish(bool complete) {
+  closePipe();
+  CgiBodyListener* owner = listener;
+  listener = NULL;
+  delete this;
+  if (owner != NULL)
+    owner->cgiBodyStreamed(complete);
+}
+
+void CgiBodyStream::abort(void) {
+  listener = NULL;
+  closePipe();
+  delete this;
+}
+
+void CgiBodyStream::closeConnection(void) {
+  finish(false);
+}
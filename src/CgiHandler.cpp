@@ -4,6 +4,7 @@
 #include "HTTPResponse.hpp"
 #include "ParsingUtils.hpp"
 #include "SignalHandler.hpp"
+#include "ServerManager.hpp"
 #include <stdlib.h>
 #include <unistd.h>
 #include <sys/wait.h>
@@ -11,63 +12,517 @@
 #include <sstream>
 #include <fcntl.h>
 #include <string.h>
+#include <algorithm>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <spawn.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <vector>
 
-CgiHandler::CgiHandler(const std::string& filePath, const std::string& queryString, int client_fd, Reactor* reactor) : client_fd(client_fd), reactor(reactor), childPid(-1) {
-  setCGIEnvironment(queryString);
-  int cgiPipeFd = executeCGI(filePath);
+namespace {
+  const size_t chunkSize = 65536;
+}
+
+CgiHandler::CgiHandler(const std::string& filePath, const std::map<std::string, std::string>& variables, CgiOutputListener* listener, int clientFd, Reactor* reactor, bool withInput)
+  : listener(listener), clientFd(clientFd), reactor(reactor), childPid(-1), inputFd(-1), cacheTtlMs(0), cacheStaleMs(0),
+    headerDone(false), bodyStarted(false), chunked(false), chunkLeft(0), bodyLeft(0), useSplice(true), clientBlocked(false), watching(true),
+    discarding(false), outputComplete(false), outputFailed(false), childReaped(false), exitStatus(0), timedOut(false),
+    supervised(false) {
+  int cgiPipeFd = executeCGI(filePath, variables, withInput);
   EventHandler::setHandle(cgiPipeFd);
 }
 
+void CgiHandler::cacheAs(const std::string& key, long ttlMs, long staleMs) {
+  cacheKey = key;
+  cacheTtlMs = ttlMs;
+  cacheStaleMs = staleMs;
+}
+
+// prlimit once the script runs: posix_spawn has no hook before the exec,
+// so the interpreter's own start-up is not bounded. The RLIMIT_* constants
+// are passed as they are, their type differs between C libraries.
+void CgiHandler::supervise(const std::string& pool, const CgiLimits& limits) {
+  struct rlimit limit;
+  if (limits.cpuSeconds > 0) {
+    // One more CPU second before SIGKILL, so SIGXCPU comes first
+    limit.rlim_cur = limits.cpuSeconds;
+    limit.rlim_max = limits.cpuSeconds + 1;
+    if (prlimit(childPid, RLIMIT_CPU, &limit, NULL) == -1)
+      warnUnlimited("CPU time");
+  }
+  if (limits.memoryBytes > 0) {
+    limit.rlim_cur = limits.memoryBytes;
+    limit.rlim_max = limits.memoryBytes;
+    if (prlimit(childPid, RLIMIT_AS, &limit, NULL) == -1)
+      warnUnlimited("memory");
+  }
+  ServerManager::getInstance().getCgiScheduler().start(this, pool, limits.timeoutSeconds);
+  supervised = true;
+}
+
+void CgiHandler::warnUnlimited(const std::string& resource) {
+  Logger::log(WARNING, "Cannot limit the " + resource + " of CGI process " + ParsingUtils::toString(childPid) + ": " + std::string(strerror(errno)));
+}
+
+void CgiHandler::keepClientAlive(void) {
+  if (clientFd != -1)
+    reactor->updateLastActivity(clientFd);
+}
+
+void CgiHandler::terminate(int signal) {
+  if (childReaped && outputComplete)
+    return;
+  timedOut = true;
+  Logger::log(WARNING, "CGI process " + ParsingUtils::toString(childPid) + " timed out, sending "
+    + std::string(signal == SIGKILL ? "SIGKILL" : "SIGTERM"));
+  // Whatever the script started goes too, and with it the pipe's last writer
+  kill(-childPid, signal);
+}
+
+int CgiHandler::releaseInput(void) {
+  int fd = inputFd;
+  inputFd = -1;
+  return fd;
+}
+
+void CgiHandler::detach(void) {
+  listener = NULL;
+  resumeClient();
+  dropClient();
+  // Blocked on the client until now, so nothing else would finish it
+  tryFinish();
+}
+
 void CgiHandler::closeConnection(void) {
-	reactor->removeFromInactivityList(EventHandler::getHandle());
-	reactor->deregisterHandler(EventHandler::getHandle());
-	SystemUtils::closeUtil(getHandle());
-	SystemUtils::closeUtil(client_fd);
+	stopReading();
 	delete this;
 }
 
+// Output is read as it arrives, so a script writing more than a pipe holds
+// keeps running instead of blocking on a full pipe
 void CgiHandler::handleEvent(uint32_t events) {
-  if (events & EPOLLIN) {
-    char buffer[1024];
-    ssize_t bytesRead;
-    int cgiPipeFd = EventHandler::getHandle();
-    waitpid(childPid, NULL, 0);
-    while ((bytesRead = read(cgiPipeFd, buffer, sizeof(buffer))) > 0) {
-      cgiOutputBuffer.write(buffer, bytesRead);
+  if (!(events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+    return;
+  if (cacheKey.empty())
+    streamOutput();
+  else
+    readOutput();
+  tryFinish();
+}
+
+void CgiHandler::clientWritable(void) {
+  if (!clientBlocked)
+    return;
+  resumeClient();
+  streamOutput();
+  tryFinish();
+}
+
+void CgiHandler::childExited(pid_t /*pid*/, int status) {
+  childReaped = true;
+  exitStatus = status;
+  if (timedOut && !outputComplete)
+    abandonOutput();
+  tryFinish();
+}
+
+// Killed for running too long: what is already in the pipe still goes out,
+// but nothing more is waited for
+void CgiHandler::abandonOutput(void) {
+  if (cacheKey.empty())
+    streamOutput();
+  else
+    readOutput();
+  if (outputComplete)
+    return;
+  outputComplete = true;
+  outputFailed = true;
+  if (!headerDone) {
+    headerDone = true;
+    pending = HTTPResponse::buildErrorResponse(504, NULL);
+    discarding = true;
+    flushPending();
+  }
+  else
+    pending.clear();
+}
+
+void CgiHandler::readOutput(void) {
+  char buffer[4096];
+  while (true) {
+    ssize_t bytesRead = read(EventHandler::getHandle(), buffer, sizeof(buffer));
+    if (bytesRead > 0) {
+      output.append(buffer, bytesRead);
+      continue;
     }
+    if (bytesRead == 0)
+      break;
+    if (errno == EINTR)
+      continue;
+    if (errno == EAGAIN || errno == EWOULDBLOCK)
+      return;
+    Logger::log(ERROR, "Error reading from CGI process: " + std::string(strerror(errno)));
+    outputFailed = true;
+    break;
+  }
+  outputComplete = true;
+}
+
+// Runs until the script has nothing more for now or the client is full
+void CgiHandler::streamOutput(void) {
+  if (clientFd != -1)
+    reactor->updateLastActivity(clientFd);
+  while (flushPending() && !outputComplete) {
+    bool progress;
+    if (discarding)
+      progress = drainOutput();
+    else if (!headerDone)
+      progress = readHeader();
+    else
+      progress = forwardBody();
+    if (!progress)
+      return;
+  }
+}
 
-    if (bytesRead == -1) {
-      // Handle read error
-      Logger::log(ERROR, "Error reading from CGI process" + std::string(strerror(errno)));
-      closeConnection();
+bool CgiHandler::readHeader(void) {
+  char buffer[4096];
+  ssize_t bytesRead = read(EventHandler::getHandle(), buffer, sizeof(buffer));
+  if (bytesRead > 0)
+    output.append(buffer, bytesRead);
+  else if (bytesRead == 0)
+    outputComplete = true;
+  else if (errno == EINTR)
+    return true;
+  else if (errno == EAGAIN || errno == EWOULDBLOCK)
+    return false;
+  else {
+    Logger::log(ERROR, "Error reading from CGI process: " + std::string(strerror(errno)));
+    outputFailed = true;
+    outputComplete = true;
+  }
+  CgiResponseHeader::Result result = header.parse(output, outputComplete);
+  if (result == CgiResponseHeader::INCOMPLETE)
+    return true;
+  headerDone = true;
+  if (timedOut) {
+    Logger::log(ERROR, "504 - CGI script timed out");
+    pending = HTTPResponse::buildErrorResponse(504, NULL);
+    discarding = true;
+    return true;
+  }
+  if (outputFailed || output.empty() || result == CgiResponseHeader::MALFORMED) {
+    Logger::log(ERROR, "502 - No valid response from CGI script");
+    pending = HTTPResponse::buildErrorResponse(502, NULL);
+    discarding = true;
+    return true;
+  }
+  startBody();
+  return true;
+}
+
+// Queues the status line and headers, with what was read of the body
+void CgiHandler::startBody(void) {
+  bodyStarted = true;
+  std::string body = output.substr(header.getLength());
+  output.clear();
+  if (outputComplete && (!header.hasContentLength() || body.size() < header.getContentLength()))
+    pending = header.format(false, body.size()) + body;
+  else if (header.hasContentLength()) {
+    // Anything past the declared length is not part of the response
+    if (body.size() > header.getContentLength())
+      body.erase(header.getContentLength());
+    bodyLeft = header.getContentLength() - body.size();
+    pending = header.format(false, header.getContentLength()) + body;
+    if (bodyLeft == 0 && !outputComplete)
+      discarding = true;
+  }
+  else {
+    // The length is only known once the script is done
+    chunked = true;
+    pending = header.format(true, 0);
+    queueChunk(body.data(), body.size());
+  }
+}
+
+bool CgiHandler::forwardBody(void) {
+  if (chunked && chunkLeft == 0)
+    return forwardChunk();
+  ssize_t moved = transfer(chunked ? chunkLeft : std::min(bodyLeft, chunkSize));
+  if (moved > 0) {
+    if (chunked) {
+      chunkLeft -= moved;
+      if (chunkLeft == 0)
+        pending += "\r\n";
     }
+    else {
+      bodyLeft -= moved;
+      // The declared length is out: whatever else the script writes is dropped
+      if (bodyLeft == 0)
+        discarding = true;
+    }
+    return true;
+  }
+  if (moved == 0) {
+    outputComplete = true;
+    // Ended or killed short of its Content-Length: the client must see it
+    if (timedOut || bodyLeft > 0)
+      outputFailed = true;
+    return true;
+  }
+  if (errno == EINTR)
+    return true;
+  if (errno == EAGAIN || errno == EWOULDBLOCK) {
+    // splice does not say which side would block
+    if (useSplice && !isClientWritable())
+      pauseClient();
+    return false;
+  }
+  if (useSplice) {
+    Logger::log(WARNING, "Client gone while sending CGI output: " + std::string(strerror(errno)));
+    dropClient();
+    return true;
+  }
+  Logger::log(ERROR, "Error reading from CGI process: " + std::string(strerror(errno)));
+  outputFailed = true;
+  outputComplete = true;
+  return true;
+}
+
+// Starts the next chunk with what the pipe holds, so the chunk is spliced
+// whole once its size line is out
+bool CgiHandler::forwardChunk(void) {
+  int available = 0;
+  if (ioctl(EventHandler::getHandle(), FIONREAD, &available) == 0 && available > 0) {
+    chunkLeft = std::min(static_cast<size_t>(available), chunkSize);
+    std::ostringstream line;
+    line << std::hex << chunkLeft << "\r\n";
+    pending += line.str();
+    return true;
+  }
+  // Nothing buffered: the script is busy, or it closed its end
+  char buffer[4096];
+  ssize_t bytesRead = read(EventHandler::getHandle(), buffer, sizeof(buffer));
+  if (bytesRead > 0) {
+    queueChunk(buffer, bytesRead);
+    return true;
+  }
+  if (bytesRead == 0) {
+    // Killed midway: no last chunk, so the client sees it is cut short
+    if (timedOut)
+      outputFailed = true;
+    else
+      pending += "0\r\n\r\n";
+    outputComplete = true;
+    return true;
+  }
+  if (errno == EINTR)
+    return true;
+  if (errno == EAGAIN || errno == EWOULDBLOCK)
+    return false;
+  // Left without the last chunk, so the client sees it is cut short
+  Logger::log(ERROR, "Error reading from CGI process: " + std::string(strerror(errno)));
+  outputFailed = true;
+  outputComplete = true;
+  return true;
+}
+
+// The answer was an error, or the client is gone: the script still runs to
+// its end, its output read and dropped
+bool CgiHandler::drainOutput(void) {
+  char buffer[16384];
+  ssize_t bytesRead = read(EventHandler::getHandle(), buffer, sizeof(buffer));
+  if (bytesRead > 0 || (bytesRead == -1 && errno == EINTR))
+    return true;
+  if (bytesRead == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    return false;
+  outputComplete = true;
+  return true;
+}
+
+// Pipe to socket without a copy through user space where the kernel can
+ssize_t CgiHandler::transfer(size_t size) {
+  if (useSplice) {
+    ssize_t moved = splice(EventHandler::getHandle(), NULL, clientFd, NULL, size, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (moved > 0)
+      AccessLog::sending(clientFd, NULL, moved);
+    if (moved != -1 || errno != EINVAL)
+      return moved;
+    // Not supported for this socket: copy through pending instead
+    useSplice = false;
+  }
+  char buffer[16384];
+  ssize_t bytesRead = read(EventHandler::getHandle(), buffer, std::min(size, sizeof(buffer)));
+  if (bytesRead > 0)
+    pending.append(buffer, bytesRead);
+  return bytesRead;
+}
+
+void CgiHandler::queueChunk(const char* data, size_t size) {
+  if (size == 0)
+    return;
+  std::ostringstream line;
+  line << std::hex << size << "\r\n";
+  pending += line.str();
+  pending.append(data, size);
+  pending += "\r\n";
+}
 
-    if (bytesRead == 0) {
-      // End of data or non-blocking read would block, process the output
-      std::string output = cgiOutputBuffer.str();
-      // Process the output, e.g., send as HTTP response
-      Cookie cookie("", "");
-      HTTPResponse::sendSuccessResponse("200 OK", "text/html", output, cookie, client_fd);
-      closeConnection();
+// False while the socket is full; the stream is then paused
+bool CgiHandler::flushPending(void) {
+  while (!pending.empty() && clientFd != -1) {
+    ssize_t sent = send(clientFd, pending.data(), pending.size(), MSG_NOSIGNAL);
+    if (sent > 0) {
+      AccessLog::sending(clientFd, pending.data(), sent);
+      pending.erase(0, sent);
+      continue;
+    }
+    if (sent == -1 && errno == EINTR)
+      continue;
+    if (sent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      pauseClient();
+      return false;
     }
+    Logger::log(WARNING, "Client gone while sending CGI output: " + std::string(strerror(errno)));
+    dropClient();
   }
+  pending.clear();
+  return true;
+}
+
+bool CgiHandler::isClientWritable(void) {
+  struct pollfd client;
+  client.fd = clientFd;
+  client.events = POLLOUT;
+  client.revents = 0;
+  return poll(&client, 1, 0) > 0;
 }
 
-CgiHandler::~CgiHandler() {}
+// The pipe is unwatched rather than muted: once the script closed its end,
+// epoll would report EPOLLHUP on it whatever it is registered for
+void CgiHandler::pauseClient(void) {
+  if (clientBlocked)
+    return;
+  clientBlocked = true;
+  if (watching) {
+    reactor->deregisterHandler(EventHandler::getHandle());
+    watching = false;
+  }
+  reactor->enableEvents(clientFd, EPOLLOUT);
+}
 
-void CgiHandler::setCGIEnvironment(const std::string& queryString) {
-  if (queryString.empty()) {
+void CgiHandler::resumeClient(void) {
+  if (!clientBlocked)
     return;
+  clientBlocked = false;
+  if (clientFd != -1)
+    reactor->disableEvents(clientFd, EPOLLOUT);
+  if (!outputComplete && !watching) {
+    reactor->registerHandler(this, EPOLLIN);
+    watching = true;
   }
-  setenv("QUERY_STRING", queryString.c_str(), 1);
 }
 
-int CgiHandler::executeCGI(const std::string& filePath) {
+void CgiHandler::dropClient(void) {
+  clientFd = -1;
+  discarding = true;
+  pending.clear();
+}
+
+void CgiHandler::stopReading(void) {
+  if (EventHandler::getHandle() == -1)
+    return;
+  if (watching)
+    reactor->deregisterHandler(EventHandler::getHandle());
+  watching = false;
+  SystemUtils::closeUtil(EventHandler::getHandle());
+}
+
+// Done once the output hit EOF and went out, and the child was reaped
+void CgiHandler::tryFinish(void) {
+  if (!outputComplete || !pending.empty())
+    return;
+  stopReading();
+  if (!childReaped) {
+    ProcessReaper* reaper = ServerManager::getInstance().getProcessReaper();
+    if (reaper != NULL)
+      return; // childExited() finishes
+    // Without a reaper: the child closed its output, so it is exiting anyway
+    waitpid(childPid, &exitStatus, 0);
+    childReaped = true;
+  }
+  finish();
+}
+
+void CgiHandler::finish(void) {
+  bool exitedCleanly = WIFEXITED(exitStatus) && WEXITSTATUS(exitStatus) == 0;
+  if (!exitedCleanly)
+    Logger::log(WARNING, "CGI process " + ParsingUtils::toString(childPid) + " exited with status " + ParsingUtils::toString(exitStatus));
+  if (!cacheKey.empty()) {
+    CgiResponseCache& cache = ServerManager::getInstance().getCgiResponseCache();
+    if (outputFailed || timedOut || (output.empty() && !exitedCleanly))
+      cache.fail(cacheKey);
+    else
+      cache.store(cacheKey, output, cacheTtlMs, cacheStaleMs);
+  }
+  bool complete = !(bodyStarted && outputFailed);
+  CgiOutputListener* owner = listener;
+  listener = NULL;
+  delete this;
+  if (owner != NULL)
+    owner->cgiOutputDone(complete);
+}
+
+CgiHandler::~CgiHandler() {
+  if (!childReaped && childPid > 0) {
+    ProcessReaper* reaper = ServerManager::getInstance().getProcessReaper();
+    if (reaper != NULL)
+      reaper->unwatch(childPid);
+    // Only at shutdown: the script is in a process group of its own, so it
+    // would not get the signal that stopped the server
+    kill(-childPid, SIGKILL);
+  }
+  if (supervised)
+    ServerManager::getInstance().getCgiScheduler().finished(this);
+  SystemUtils::closeUtil(EventHandler::getHandle());
+  SystemUtils::closeUtil(inputFd);
+  // Killed before answering, e.g. at shutdown: the client still gets an
+  // answer if the socket takes it right away
+  if (clientFd != -1 && !headerDone) {
+    std::string response = HTTPResponse::buildErrorResponse(502, NULL);
+    AccessLog::sending(clientFd, response.data(), response.size());
+    if (send(clientFd, response.data(), response.size(), MSG_NOSIGNAL | MSG_DONTWAIT) == -1)
+      Logger::log(ERROR, "Error sending CGI response: " + std::string(strerror(errno)));
+  }
+  if (listener != NULL)
+    listener->cgiOutputDone(true);
+}
+
+// The script gets the meta-variables and nothing of the server's own
+// environment but PATH, so interpreters named through /usr/bin/env are found
+std::vector<std::string> CgiHandler::buildEnvironment(const std::map<std::string, std::string>& variables) {
+  std::vector<std::string> environment;
+  for (std::map<std::string, std::string>::const_iterator it = variables.begin(); it != variables.end(); ++it)
+    environment.push_back(it->first + "=" + it->second);
+  const char* path = getenv("PATH");
+  if (variables.find("PATH") == variables.end())
+    environment.push_back(std::string("PATH=") + (path != NULL ? path : "/usr/local/bin:/usr/bin:/bin"));
+  return environment;
+}
+
+// posix_spawn starts the script without copying the server's page tables,
+// which a fork would do at a cost growing with the caches
+int CgiHandler::executeCGI(const std::string& filePath, const std::map<std::string, std::string>& variables, bool withInput) {
     int pipefd[2];
+    int inputPipe[2] = {-1, -1};
     pid_t pid;
 
     // Create a pipe for the child process's output
-    if (pipe(pipefd) == -1) {
+    // Close-on-exec, or other scripts started meanwhile would hold the write
+    // end open and delay this one's EOF until they exit too
+    if (pipe2(pipefd, O_CLOEXEC) == -1) {
         throw std::runtime_error("Failed to create pipe");
     }
 
@@ -75,26 +530,53 @@ int CgiHandler::executeCGI(const std::string& filePath) {
     int flags = fcntl(pipefd[0], F_GETFL, 0);
     fcntl(pipefd[0], F_SETFL, flags | O_NONBLOCK);
 
-    pid = fork();
-    childPid = pid;
-    if (pid == -1) {
-        throw std::runtime_error("Failed to fork process");
+    // The body is written as it arrives, never blocking on a full pipe
+    if (withInput && pipe2(inputPipe, O_CLOEXEC) == -1) {
+        SystemUtils::closeUtil(pipefd[0]);
+        SystemUtils::closeUtil(pipefd[1]);
+        throw std::runtime_error("Failed to create pipe");
     }
+    if (withInput)
+        fcntl(inputPipe[1], F_SETFL, fcntl(inputPipe[1], F_GETFL, 0) | O_NONBLOCK);
 
-    if (pid == 0) {
-        // Child process
-        SystemUtils::closeUtil(pipefd[0]);          
-        dup2(pipefd[1], STDOUT_FILENO);
-        SystemUtils::closeUtil(pipefd[1]);
-        char* execArgs[2];
-        execArgs[0] = const_cast<char*>(filePath.c_str());
-        execArgs[1] = NULL;
-	if (execve(execArgs[0], execArgs, environ) == -1)
-		std::cerr << "Error executing CGI script: " << strerror(errno) << std::endl;
-        _exit(EXIT_FAILURE);
-    } else {
-        // Parent process
-        SystemUtils::closeUtil(pipefd[1]);          
-        return pipefd[0];  // Return the reading end of the pipe
+    std::vector<std::string> environment = buildEnvironment(variables);
+    std::vector<char*> envp;
+    for (std::vector<std::string>::iterator it = environment.begin(); it != environment.end(); ++it)
+        envp.push_back(const_cast<char*>(it->c_str()));
+    envp.push_back(NULL);
+    char* execArgs[2];
+    execArgs[0] = const_cast<char*>(filePath.c_str());
+    execArgs[1] = NULL;
+
+    // The duplicates lose close-on-exec; every other pipe end is closed
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, pipefd[1], STDOUT_FILENO);
+    if (withInput)
+        posix_spawn_file_actions_adddup2(&actions, inputPipe[0], STDIN_FILENO);
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    ProcessReaper::restoreSignalMask(&attributes);
+    // A group of its own, so a timeout also stops what the script started
+    short spawnFlags;
+    posix_spawnattr_getflags(&attributes, &spawnFlags);
+    posix_spawnattr_setflags(&attributes, spawnFlags | POSIX_SPAWN_SETPGROUP);
+    posix_spawnattr_setpgroup(&attributes, 0);
+    int error = posix_spawn(&pid, execArgs[0], &actions, &attributes, execArgs, &envp[0]);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attributes);
+
+    SystemUtils::closeUtil(pipefd[1]);
+    SystemUtils::closeUtil(inputPipe[0]);
+    if (error != 0) {
+        SystemUtils::closeUtil(pipefd[0]);
+        SystemUtils::closeUtil(inputPipe[1]);
+        throw std::runtime_error("Failed to start CGI script: " + std::string(strerror(error)));
     }
+    childPid = pid;
+    inputFd = inputPipe[1];
+    ProcessReaper* reaper = ServerManager::getInstance().getProcessReaper();
+    if (reaper != NULL)
+        reaper->watch(pid, this);
+    return pipefd[0];  // Return the reading end of the pipe
 }
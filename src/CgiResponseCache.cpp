@@ -0,0 +1,237 @@
+#include "CgiResponseCache.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include <sstream>
+#include "CgiResponseHeader.hpp"
+#include "HTTPResponse.hpp"
+#include "Logger.hpp"
+#include "ParsingUtils.hpp"
+
+CgiResponseCache::CgiResponseCache(size_t maxBytes) : maxBytes(maxBytes), bytes(0), useClock(0) {
+  counters.hits = 0;
+  counters.staleHits = 0;
+  counters.misses = 0;
+  counters.collapsed = 0;
+  counters.refreshes = 0;
+}
+
+CgiResponseCache::Status CgiResponseCache::lookup(const std::string& key, CgiResponseListener* listener, const std::string*& response) {
+  response = NULL;
+  std::map<std::string, Entry>::iterator it = entries.find(key);
+  if (it == entries.end()) {
+    Entry& entry = entries[key];
+    entry.freshUntilMs = 0;
+    entry.staleUntilMs = 0;
+    entry.running = true;
+    entry.waiters.push_back(listener);
+    entry.lastUse = ++useClock;
+    ++counters.misses;
+    return MISS;
+  }
+  Entry& entry = it->second;
+  entry.lastUse = ++useClock;
+  long now = nowMs();
+  if (!entry.response.empty() && now < entry.staleUntilMs) {
+    response = &entry.response;
+    if (now < entry.freshUntilMs) {
+      ++counters.hits;
+      return FRESH;
+    }
+    ++counters.staleHits;
+    return STALE;
+  }
+  // First execution, or too stale to serve: share the running one
+  entry.waiters.push_back(listener);
+  if (entry.running) {
+    ++counters.collapsed;
+    return PENDING;
+  }
+  entry.running = true;
+  ++counters.misses;
+  return MISS;
+}
+
+bool CgiResponseCache::beginRefresh(const std::string& key) {
+  std::map<std::string, Entry>::iterator it = entries.find(key);
+  if (it == entries.end() || it->second.running)
+    return false;
+  it->second.running = true;
+  ++counters.refreshes;
+  return true;
+}
+
+void CgiResponseCache::store(const std::string& key, const std::string& output, long ttlMs, long staleMs) {
+  std::string response = CgiResponseHeader::buildResponse(output);
+  std::map<std::string, Entry>::iterator it = entries.find(key);
+  if (it == entries.end())
+    return;
+  std::vector<CgiResponseListener*> waiters;
+  waiters.swap(it->second.waiters);
+
+  bool cacheable = parseCacheControl(output, ttlMs, staleMs) && ttlMs + staleMs > 0
+    && response.size() <= maxBytes / 8 && isShareable(response);
+  if (!cacheable) {
+    bytes -= it->second.response.size();
+    entries.erase(it);
+  }
+  else {
+    Entry& entry = it->second;
+    long now = nowMs();
+    bytes -= entry.response.size();
+    entry.response = response;
+    bytes += entry.response.size();
+    entry.freshUntilMs = now + ttlMs;
+    entry.staleUntilMs = now + ttlMs + staleMs;
+    entry.running = false;
+    evict(key);
+  }
+  notify(waiters, response);
+}
+
+void CgiResponseCache::fail(const std::string& key) {
+  std::map<std::string, Entry>::iterator it = entries.find(key);
+  if (it == entries.end())
+    return;
+  std::vector<CgiResponseListener*> waiters;
+  waiters.swap(it->second.waiters);
+  // A failed refresh keeps serving the stale copy until its window closes
+  if (it->second.response.empty())
+    entries.erase(it);
+  else
+    it->second.running = false;
+  notify(waiters, HTTPResponse::buildErrorResponse(502, NULL));
+}
+
+void CgiResponseCache::removeListener(CgiResponseListener* listener) {
+  for (std::map<std::string, Entry>::iterator it = entries.begin(); it != entries.end(); ++it) {
+    std::vector<CgiResponseListener*>& waiters = it->second.waiters;
+    waiters.erase(std::remove(waiters.begin(), waiters.end(), listener), waiters.end());
+  }
+}
+
+size_t CgiResponseCache::size(void) const {
+  return entries.size();
+}
+
+size_t CgiResponseCache::getBytes(void) const {
+  return bytes;
+}
+
+const CgiResponseCache::Counters& CgiResponseCache::getCounters(void) const {
+  return counters;
+}
+
+std::string CgiResponseCache::formatCounters(void) const {
+  std::ostringstream out;
+  out << "cgi_cache_hits " << counters.hits << "\n";
+  out << "cgi_cache_stale_hits " << counters.staleHits << "\n";
+  out << "cgi_cache_misses " << counters.misses << "\n";
+  out << "cgi_cache_collapsed " << counters.collapsed << "\n";
+  out << "cgi_cache_refreshes " << counters.refreshes << "\n";
+  out << "cgi_cache_entries " << entries.size() << "\n";
+  out << "cgi_cache_bytes " << bytes << "\n";
+  return out.str();
+}
+
+// Only the header block CGI output starts with is looked at. no-store,
+// no-cache and private forbid caching; s-maxage wins over max-age and
+// stale-while-revalidate sets the stale window.
+bool CgiResponseCache::parseCacheControl(const std::string& output, long& ttlMs, long& staleMs) {
+  size_t headerEnd = output.find("\n\n");
+  size_t crlfEnd = output.find("\r\n\r\n");
+  if (crlfEnd != std::string::npos && crlfEnd < headerEnd)
+    headerEnd = crlfEnd;
+  if (headerEnd == std::string::npos)
+    return true;
+
+  bool sharedMaxAge = false;
+  size_t lineStart = 0;
+  while (lineStart < headerEnd) {
+    size_t lineEnd = output.find('\n', lineStart);
+    if (lineEnd == std::string::npos || lineEnd > headerEnd)
+      lineEnd = headerEnd;
+    std::string line = ParsingUtils::toLower(output.substr(lineStart, lineEnd - lineStart));
+    lineStart = lineEnd + 1;
+    if (line.compare(0, 14, "cache-control:") != 0)
+      continue;
+
+    std::istringstream directives(line.substr(14));
+    std::string directive;
+    while (std::getline(directives, directive, ',')) {
+      ParsingUtils::trim(directive);
+      if (directive == "no-store" || directive == "no-cache" || directive == "private")
+        return false;
+      size_t equals = directive.find('=');
+      if (equals == std::string::npos)
+        continue;
+      std::string name = directive.substr(0, equals);
+      long seconds = std::strtol(directive.c_str() + equals + 1, NULL, 10);
+      if (seconds < 0)
+        continue;
+      if (name == "s-maxage") {
+        ttlMs = seconds * 1000;
+        sharedMaxAge = true;
+      }
+      else if (name == "max-age" && !sharedMaxAge)
+        ttlMs = seconds * 1000;
+      else if (name == "stale-while-revalidate")
+        staleMs = seconds * 1000;
+    }
+  }
+  return true;
+}
+
+bool CgiResponseCache::isShareable(const std::string& response) {
+  // "HTTP/1.1 200 OK"
+  if (response.size() < 12 || response.compare(0, 9, "HTTP/1.1 ") != 0)
+    return false;
+  int status = std::atoi(response.substr(9, 3).c_str());
+  if (status != 200 && status != 203 && status != 204 && status != 300 && status != 301
+      && status != 404 && status != 405 && status != 410 && status != 414 && status != 501)
+    return false;
+  size_t headerEnd = response.find("\r\n\r\n");
+  if (headerEnd == std::string::npos)
+    return false;
+  size_t lineStart = response.find("\r\n") + 2;
+  while (lineStart < headerEnd) {
+    size_t lineEnd = response.find("\r\n", lineStart);
+    if (ParsingUtils::toLower(response.substr(lineStart, 11)) == "set-cookie:")
+      return false;
+    lineStart = lineEnd + 2;
+  }
+  return true;
+}
+
+void CgiResponseCache::notify(std::vector<CgiResponseListener*>& waiters, const std::string& response) {
+  for (std::vector<CgiResponseListener*>::iterator it = waiters.begin(); it != waiters.end(); ++it)
+    (*it)->cgiResponseReady(response);
+}
+
+// Oldest completed entries go first; ones still waiting on their first
+// execution hold no bytes and are never evicted
+void CgiResponseCache::evict(const std::string& keep) {
+  while (bytes > maxBytes) {
+    std::map<std::string, Entry>::iterator oldest = entries.end();
+    for (std::map<std::string, Entry>::iterator it = entries.begin(); it != entries.end(); ++it) {
+      if (it->second.response.empty() || it->first == keep)
+        continue;
+      if (oldest == entries.end() || it->second.lastUse < oldest->second.lastUse)
+        oldest = it;
+    }
+    if (oldest == entries.end())
+      return;
+    Logger::log(INFO, "Evicting CGI cache entry: " + oldest->first);
+    bytes -= oldest->second.response.size();
+    if (oldest->second.running)
+      oldest->second.response.clear();
+    else
+      entries.erase(oldest);
+  }
+}
+
+long CgiResponseCache::nowMs(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000L + now.tv_nsec / 1000000L;
+}
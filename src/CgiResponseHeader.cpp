@@ -0,0 +1,135 @@
+#include "CgiResponseHeader.hpp"
+#include <cctype>
+#include <cstdlib>
+#include <sstream>
+#include "HTTPResponse.hpp"
+#include "ParsingUtils.hpp"
+
+CgiResponseHeader::CgiResponseHeader() {
+  reset();
+}
+
+void CgiResponseHeader::reset(void) {
+  status = "200 OK";
+  fields.clear();
+  hasContentType = false;
+  contentLengthGiven = false;
+  contentLength = 0;
+  length = 0;
+}
+
+CgiResponseHeader::Result CgiResponseHeader::parse(const std::string& output, bool atEnd) {
+  reset();
+  bool statusGiven = false;
+  bool hasLocation = false;
+  size_t lineStart = 0;
+  while (true) {
+    size_t lineEnd = output.find('\n', lineStart);
+    if (lineEnd == std::string::npos || lineEnd >= MAX_LENGTH) {
+      if (!atEnd && output.size() < MAX_LENGTH)
+        return INCOMPLETE;
+      reset();
+      return ABSENT;
+    }
+    std::string line = output.substr(lineStart, lineEnd - lineStart);
+    if (!line.empty() && line[line.size() - 1] == '\r')
+      line.erase(line.size() - 1);
+    lineStart = lineEnd + 1;
+    if (line.empty())
+      break;
+    if (!addField(line, statusGiven, hasLocation)) {
+      reset();
+      return ABSENT;
+    }
+  }
+  // A blank first line is body, not an empty header block
+  if (fields.empty() && !statusGiven && !contentLengthGiven) {
+    reset();
+    return ABSENT;
+  }
+  if (statusGiven) {
+    if (status.size() < 3 || !std::isdigit(static_cast<unsigned char>(status[0]))
+        || !std::isdigit(static_cast<unsigned char>(status[1])) || !std::isdigit(static_cast<unsigned char>(status[2]))
+        || (status.size() > 3 && status[3] != ' '))
+      return MALFORMED;
+  }
+  else if (hasLocation)
+    status = "302 Found";
+  length = lineStart;
+  return PARSED;
+}
+
+// False for a line that is not a header field at all
+bool CgiResponseHeader::addField(const std::string& line, bool& statusGiven, bool& hasLocation) {
+  size_t colon = line.find(':');
+  if (colon == std::string::npos || colon == 0)
+    return false;
+  std::string name = line.substr(0, colon);
+  for (size_t i = 0; i < name.size(); ++i) {
+    unsigned char c = name[i];
+    if (!std::isalnum(c) && c != '-' && c != '_')
+      return false;
+  }
+  std::string value = line.substr(colon + 1);
+  ParsingUtils::trim(value);
+  std::string key = ParsingUtils::toLower(name);
+  if (key == "status") {
+    status = value;
+    statusGiven = true;
+  }
+  else if (key == "content-length") {
+    char* end = NULL;
+    long parsed = std::strtol(value.c_str(), &end, 10);
+    if (!value.empty() && *end == '\0' && parsed >= 0) {
+      contentLengthGiven = true;
+      contentLength = parsed;
+    }
+  }
+  // The connection and its framing are the server's
+  else if (key != "connection" && key != "transfer-encoding" && key != "keep-alive") {
+    if (key == "content-type")
+      hasContentType = true;
+    if (key == "location")
+      hasLocation = true;
+    fields.push_back(std::make_pair(name, value));
+  }
+  return true;
+}
+
+size_t CgiResponseHeader::getLength(void) const {
+  return length;
+}
+
+bool CgiResponseHeader::hasContentLength(void) const {
+  return contentLengthGiven;
+}
+
+size_t CgiResponseHeader::getContentLength(void) const {
+  return contentLength;
+}
+
+std::string CgiResponseHeader::format(bool chunked, size_t bodyLength) const {
+  std::ostringstream head;
+  head << "HTTP/1.1 " << status << "\r\n";
+  if (!hasContentType)
+    head << "Content-Type: text/html\r\n";
+  for (size_t i = 0; i < fields.size(); ++i)
+    head << fields[i].first << ": " << fields[i].second << "\r\n";
+  if (chunked)
+    head << "Transfer-Encoding: chunked\r\n";
+  else
+    head << "Content-Length: " << bodyLength << "\r\n";
+  head << "Connection: close\r\n\r\n";
+  return head.str();
+}
+
+std::string CgiResponseHeader::buildResponse(const std::string& output) {
+  CgiResponseHeader header;
+  if (header.parse(output, true) == MALFORMED)
+    return HTTPResponse::buildErrorResponse(502, NULL);
+  std::string body = output.substr(header.getLength());
+  // Anything past the declared length is not part of the response
+  if (header.hasContentLength() && body.size() > header.getContentLength())
+    body.erase(header.getContentLength());
+  return header.format(false, body.size()) + body;
+}
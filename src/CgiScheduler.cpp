@@ -0,0 +1,169 @@
+#include "CgiScheduler.hpp"
+#include <csignal>
+#include <ctime>
+#include <sstream>
+#include <vector>
+#include "Logger.hpp"
+
+CgiScheduler::CgiScheduler() : slotsFreed(false), nextCheckMs(0) {
+  counters.started = 0;
+  counters.queued = 0;
+  counters.refused = 0;
+  counters.expired = 0;
+  counters.timedOut = 0;
+}
+
+CgiScheduler::Admission CgiScheduler::admit(const std::string& pool, const CgiLimits& limits, CgiSlotListener* waiter) {
+  Pool& entry = pools[pool];
+  entry.maxScripts = limits.maxScripts;
+  // Waiters go first, or a request arriving as a slot frees would jump them
+  if (entry.queue.empty() && (entry.maxScripts == 0 || entry.running < entry.maxScripts)) {
+    ++entry.running;
+    return RUN;
+  }
+  if (entry.queue.size() >= static_cast<size_t>(limits.queueSize)) {
+    ++counters.refused;
+    return FULL;
+  }
+  Waiter queued;
+  queued.listener = waiter;
+  queued.deadlineMs = limits.timeoutSeconds > 0 ? nowMs() + limits.timeoutSeconds * 1000L : 0;
+  entry.queue.push_back(queued);
+  ++counters.queued;
+  return QUEUED;
+}
+
+void CgiScheduler::cancel(CgiSlotListener* waiter) {
+  for (std::map<std::string, Pool>::iterator it = pools.begin(); it != pools.end(); ++it) {
+    std::deque<Waiter>& queue = it->second.queue;
+    for (std::deque<Waiter>::iterator waiting = queue.begin(); waiting != queue.end(); ++waiting) {
+      if (waiting->listener == waiter) {
+        queue.erase(waiting);
+        return;
+      }
+    }
+  }
+}
+
+void CgiScheduler::reserve(const std::string& pool) {
+  ++pools[pool].running;
+}
+
+void CgiScheduler::release(const std::string& pool) {
+  std::map<std::string, Pool>::iterator it = pools.find(pool);
+  if (it == pools.end() || it->second.running == 0)
+    return;
+  --it->second.running;
+  slotsFreed = true;
+}
+
+void CgiScheduler::start(CgiScript* script, const std::string& pool, int timeoutSeconds) {
+  Script& entry = scripts[script];
+  entry.pool = pool;
+  entry.deadlineMs = timeoutSeconds > 0 ? nowMs() + timeoutSeconds * 1000L : 0;
+  entry.terminated = false;
+  ++counters.started;
+}
+
+void CgiScheduler::finished(CgiScript* script) {
+  std::map<CgiScript*, Script>::iterator it = scripts.find(script);
+  if (it == scripts.end())
+    return;
+  release(it->second.pool);
+  scripts.erase(it);
+}
+
+void CgiScheduler::tick(void) {
+  if (slotsFreed)
+    grantSlots();
+  long now = nowMs();
+  if (now < nextCheckMs)
+    return;
+  nextCheckMs = now + 1000;
+  checkDeadlines(now);
+}
+
+// Listeners are called once the queues are settled: starting a script may
+// give its slot straight back
+void CgiScheduler::grantSlots(void) {
+  slotsFreed = false;
+  std::vector<CgiSlotListener*> granted;
+  for (std::map<std::string, Pool>::iterator it = pools.begin(); it != pools.end(); ++it) {
+    Pool& pool = it->second;
+    while (!pool.queue.empty() && (pool.maxScripts == 0 || pool.running < pool.maxScripts)) {
+      granted.push_back(pool.queue.front().listener);
+      pool.queue.pop_front();
+      ++pool.running;
+    }
+  }
+  for (std::vector<CgiSlotListener*>::iterator it = granted.begin(); it != granted.end(); ++it)
+    (*it)->cgiSlotGranted();
+}
+
+void CgiScheduler::checkDeadlines(long now) {
+  for (std::map<CgiScript*, Script>::iterator it = scripts.begin(); it != scripts.end(); ++it) {
+    Script& script = it->second;
+    // The script's deadline bounds its client, not the inactivity sweep
+    it->first->keepClientAlive();
+    if (script.deadlineMs == 0 || now < script.deadlineMs)
+      continue;
+    if (!script.terminated) {
+      ++counters.timedOut;
+      it->first->terminate(SIGTERM);
+      script.terminated = true;
+      script.deadlineMs = now + KILL_GRACE_MS;
+    }
+    else {
+      it->first->terminate(SIGKILL);
+      script.deadlineMs = 0;
+    }
+  }
+  // Waiters are in arrival order, and a pool's all share one timeout
+  std::vector<CgiSlotListener*> expired;
+  for (std::map<std::string, Pool>::iterator it = pools.begin(); it != pools.end(); ++it) {
+    std::deque<Waiter>& queue = it->second.queue;
+    while (!queue.empty() && queue.front().deadlineMs != 0 && now >= queue.front().deadlineMs) {
+      expired.push_back(queue.front().listener);
+      queue.pop_front();
+    }
+  }
+  counters.expired += expired.size();
+  for (std::vector<CgiSlotListener*>::iterator it = expired.begin(); it != expired.end(); ++it)
+    (*it)->cgiSlotExpired();
+}
+
+const CgiScheduler::Counters& CgiScheduler::getCounters(void) const {
+  return counters;
+}
+
+size_t CgiScheduler::getRunning(void) const {
+  size_t running = 0;
+  for (std::map<std::string, Pool>::const_iterator it = pools.begin(); it != pools.end(); ++it)
+    running += it->second.running;
+  return running;
+}
+
+size_t CgiScheduler::getWaiting(void) const {
+  size_t waiting = 0;
+  for (std::map<std::string, Pool>::const_iterator it = pools.begin(); it != pools.end(); ++it)
+    waiting += it->second.queue.size();
+  return waiting;
+}
+
+std::string CgiScheduler::formatCounters(void) const {
+  std::ostringstream out;
+  out << "cgi_scripts_started " << counters.started << "\n";
+  out << "cgi_scripts_queued " << counters.queued << "\n";
+  out << "cgi_scripts_refused " << counters.refused << "\n";
+  out << "cgi_scripts_expired_in_queue " << counters.expired << "\n";
+  out << "cgi_scripts_timed_out " << counters.timedOut << "\n";
+  out << "cgi_scripts_running " << getRunning() << "\n";
+  out << "cgi_scripts_waiting " << getWaiting() << "\n";
+  return out.str();
+}
+
+long CgiScheduler::nowMs(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000L + now.tv_nsec / 1000000L;
+}
@@ -0,0 +1,267 @@
+#include "ClientLimiter.hpp"
+#include <ctime>
+#include <sstream>
+#include "ErrorPageManager.hpp"
+#include "Logger.hpp"
+#include "ParsingUtils.hpp"
+
+namespace {
+  const size_t INITIAL_CAPACITY = 64;
+}
+
+ClientLimiter::ClientLimiter()
+  : connectionCount(0), activeConnections(0), bucketCount(0), nextReportMs(0), lastRejected(0) {
+  ConnectionSlot emptyConnection;
+  emptyConnection.address = 0;
+  emptyConnection.count = 0;
+  connections.assign(INITIAL_CAPACITY, emptyConnection);
+  resetBuckets();
+  counters.acceptedConnections = 0;
+  counters.rejectedConnections = 0;
+  counters.allowedRequests = 0;
+  counters.limitedRequests = 0;
+  reported = counters;
+}
+
+bool ClientLimiter::acquireConnection(uint32_t address, size_t limit) {
+  size_t index = findConnection(address);
+  if (limit > 0 && connections[index].count >= limit) {
+    ++counters.rejectedConnections;
+    lastRejected = address;
+    return false;
+  }
+  if (connections[index].count == 0) {
+    if ((connectionCount + 1) * 2 > connections.size()) {
+      growConnections();
+      index = findConnection(address);
+    }
+    connections[index].address = address;
+    ++connectionCount;
+  }
+  ++connections[index].count;
+  ++activeConnections;
+  ++counters.acceptedConnections;
+  return true;
+}
+
+void ClientLimiter::releaseConnection(uint32_t address) {
+  size_t index = findConnection(address);
+  if (connections[index].count == 0)
+    return;
+  --activeConnections;
+  if (--connections[index].count == 0)
+    eraseConnection(index);
+}
+
+size_t ClientLimiter::getConnectionCount(uint32_t address) const {
+  return connections[findConnection(address)].count;
+}
+
+bool ClientLimiter::allowRequest(uint32_t address, const Route& route) {
+  long now = nowMs();
+  Bucket& bucket = findBucket(address, &route, route.getRateLimit(), route.getRateBurst(), now);
+  bucket.tokens += (now - bucket.lastMs) * bucket.rate / 1000.0;
+  if (bucket.tokens > bucket.burst)
+    bucket.tokens = bucket.burst;
+  bucket.lastMs = now;
+  if (bucket.tokens < 1.0) {
+    ++counters.limitedRequests;
+    lastRejected = address;
+    return false;
+  }
+  bucket.tokens -= 1.0;
+  ++counters.allowedRequests;
+  return true;
+}
+
+void ClientLimiter::resetBuckets(void) {
+  Bucket emptyBucket;
+  emptyBucket.address = 0;
+  emptyBucket.route = NULL;
+  emptyBucket.rate = 0;
+  emptyBucket.burst = 0;
+  emptyBucket.tokens = 0;
+  emptyBucket.lastMs = 0;
+  buckets.assign(INITIAL_CAPACITY, emptyBucket);
+  bucketCount = 0;
+}
+
+void ClientLimiter::tick(void) {
+  long now = nowMs();
+  if (now < nextReportMs)
+    return;
+  nextReportMs = now + REPORT_INTERVAL_MS;
+  unsigned long connections = counters.rejectedConnections - reported.rejectedConnections;
+  unsigned long requests = counters.limitedRequests - reported.limitedRequests;
+  reported = counters;
+  if (connections == 0 && requests == 0)
+    return;
+  Logger::log(WARNING, "Client limits: rejected " + ParsingUtils::toString(connections)
+    + " connections over max_connections_per_ip and " + ParsingUtils::toString(requests)
+    + " requests over rate_limit since the last report, latest from " + ParsingUtils::formatIPv4(lastRejected));
+}
+
+const ClientLimiter::Counters& ClientLimiter::getCounters(void) const {
+  return counters;
+}
+
+size_t ClientLimiter::getActiveConnections(void) const {
+  return activeConnections;
+}
+
+size_t ClientLimiter::getTrackedClients(void) const {
+  return connectionCount;
+}
+
+size_t ClientLimiter::getTrackedBuckets(void) const {
+  return bucketCount;
+}
+
+std::string ClientLimiter::formatCounters(void) const {
+  std::ostringstream out;
+  out << "connections_active " << activeConnections << "\n";
+  out << "connections_accepted " << counters.acceptedConnections << "\n";
+  out << "connections_rejected " << counters.rejectedConnections << "\n";
+  out << "clients_tracked " << connectionCount << "\n";
+  out << "requests_allowed " << counters.allowedRequests << "\n";
+  out << "requests_limited " << counters.limitedRequests << "\n";
+  out << "buckets_tracked " << bucketCount << "\n";
+  return out.str();
+}
+
+const std::string& ClientLimiter::getTooManyRequestsResponse(void) {
+  static const std::string response = buildResponse(429, "Too Many Requests", "Retry-After: 1\r\n");
+  return response;
+}
+
+const std::string& ClientLimiter::getServiceUnavailableResponse(void) {
+  static const std::string response = buildResponse(503, "Service Unavailable", "Retry-After: 1\r\n");
+  return response;
+}
+
+// Linear probing: the slot holding address, or the empty slot ending its chain
+size_t ClientLimiter::findConnection(uint32_t address) const {
+  size_t mask = connections.size() - 1;
+  size_t index = hash(address) & mask;
+  while (connections[index].count != 0 && connections[index].address != address)
+    index = (index + 1) & mask;
+  return index;
+}
+
+void ClientLimiter::growConnections(void) {
+  std::vector<ConnectionSlot> previous(connections.size() * 2);
+  previous.swap(connections);
+  for (size_t i = 0; i < previous.size(); ++i) {
+    if (previous[i].count != 0)
+      connections[findConnection(previous[i].address)] = previous[i];
+  }
+}
+
+// Backward-shift deletion: later members of the probe chain move into the
+// hole whenever their home slot allows it, so no tombstones pile up as
+// clients come and go
+void ClientLimiter::eraseConnection(size_t index) {
+  size_t mask = connections.size() - 1;
+  size_t hole = index;
+  size_t next = (hole + 1) & mask;
+  while (connections[next].count != 0) {
+    size_t home = hash(connections[next].address) & mask;
+    if (((next - home) & mask) >= ((next - hole) & mask)) {
+      connections[hole] = connections[next];
+      hole = next;
+    }
+    next = (next + 1) & mask;
+  }
+  connections[hole].count = 0;
+  --connectionCount;
+}
+
+ClientLimiter::Bucket& ClientLimiter::findBucket(uint32_t address, const Route* route, double rate, double burst, long now) {
+  size_t mask = buckets.size() - 1;
+  size_t index = hash(address, route) & mask;
+  while (buckets[index].route != NULL) {
+    if (buckets[index].address == address && buckets[index].route == route)
+      return buckets[index];
+    index = (index + 1) & mask;
+  }
+  if ((bucketCount + 1) * 2 > buckets.size()) {
+    sweepBuckets(now);
+    mask = buckets.size() - 1;
+    index = hash(address, route) & mask;
+    while (buckets[index].route != NULL)
+      index = (index + 1) & mask;
+  }
+  Bucket& bucket = buckets[index];
+  bucket.address = address;
+  bucket.route = route;
+  bucket.rate = rate;
+  bucket.burst = burst;
+  bucket.tokens = burst;
+  bucket.lastMs = now;
+  ++bucketCount;
+  return bucket;
+}
+
+// A bucket that has refilled completely is indistinguishable from a new one,
+// so it is dropped; the table only grows when the live ones still fill it
+void ClientLimiter::sweepBuckets(long now) {
+  std::vector<Bucket> previous;
+  previous.swap(buckets);
+  size_t live = 0;
+  for (size_t i = 0; i < previous.size(); ++i) {
+    const Bucket& bucket = previous[i];
+    if (bucket.route != NULL && bucket.tokens + (now - bucket.lastMs) * bucket.rate / 1000.0 < bucket.burst)
+      ++live;
+  }
+  size_t capacity = previous.size();
+  while ((live + 1) * 2 > capacity)
+    capacity <<= 1;
+  resetBuckets();
+  Bucket emptyBucket = buckets[0];
+  buckets.resize(capacity, emptyBucket);
+  size_t mask = capacity - 1;
+  for (size_t i = 0; i < previous.size(); ++i) {
+    const Bucket& bucket = previous[i];
+    if (bucket.route == NULL || bucket.tokens + (now - bucket.lastMs) * bucket.rate / 1000.0 >= bucket.burst)
+      continue;
+    size_t index = hash(bucket.address, bucket.route) & mask;
+    while (buckets[index].route != NULL)
+      index = (index + 1) & mask;
+    buckets[index] = bucket;
+    ++bucketCount;
+  }
+}
+
+// Multiplicative mixing (murmur3 finalizer), client addresses are far from random
+uint32_t ClientLimiter::hash(uint32_t address) {
+  address ^= address >> 16;
+  address *= 0x85ebca6bu;
+  address ^= address >> 13;
+  address *= 0xc2b2ae35u;
+  address ^= address >> 16;
+  return address;
+}
+
+uint32_t ClientLimiter::hash(uint32_t address, const Route* route) {
+  uintptr_t pointer = reinterpret_cast<uintptr_t>(route);
+  return hash(address ^ hash(static_cast<uint32_t>(pointer ^ (pointer >> 16))));
+}
+
+std::string ClientLimiter::buildResponse(int code, const std::string& reason, const std::string& extraHeaders) {
+  std::string body = ErrorPageManager().getErrorPage(code);
+  std::ostringstream response;
+  response << "HTTP/1.1 " << code << " " << reason << "\r\n";
+  response << "Content-Type: text/html\r\n";
+  response << "Content-Length: " << body.size() << "\r\n";
+  response << extraHeaders;
+  response << "Connection: close\r\n";
+  response << "\r\n";
+  response << body;
+  return response.str();
+}
+
+long ClientLimiter::nowMs(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000L + now.tv_nsec / 1000000L;
+}
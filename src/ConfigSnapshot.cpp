@@ -0,0 +1,51 @@
+#include "ConfigSnapshot.hpp"
+#include "ConfigurationParser.hpp"
+#include "Logger.hpp"
+#include "ParsingUtils.hpp"
+
+unsigned long ConfigSnapshot::nextGeneration = 1;
+
+ConfigSnapshot* ConfigSnapshot::load(const std::string& path) {
+  std::map<std::string, Server*> servers;
+  try {
+    servers = ConfigurationParser::parse(path);
+    ConfigurationParser::checkValidity(servers);
+  } catch (...) {
+    ConfigurationParser::cleanupServers(servers);
+    throw;
+  }
+  return new ConfigSnapshot(servers);
+}
+
+// Takes ownership of the servers, leaving the caller's map empty
+ConfigSnapshot::ConfigSnapshot(std::map<std::string, Server*>& servers) : refCount(1), generation(nextGeneration++) {
+  this->servers.swap(servers);
+  virtualHostIndex.build(this->servers);
+  Logger::log(INFO, "Configuration generation " + ParsingUtils::toString(generation) + " loaded with " + ParsingUtils::toString(this->servers.size()) + " servers");
+}
+
+ConfigSnapshot::~ConfigSnapshot() {
+  Logger::log(INFO, "Configuration generation " + ParsingUtils::toString(generation) + " released");
+  ConfigurationParser::cleanupServers(servers);
+}
+
+void ConfigSnapshot::acquire(void) {
+  ++refCount;
+}
+
+void ConfigSnapshot::release(void) {
+  if (--refCount == 0)
+    delete this;
+}
+
+const std::map<std::string, Server*>& ConfigSnapshot::getServers(void) const {
+  return servers;
+}
+
+const VirtualHostIndex& ConfigSnapshot::getVirtualHostIndex(void) const {
+  return virtualHostIndex;
+}
+
+unsigned long ConfigSnapshot::getGeneration(void) const {
+  return generation;
+}
@@ -6,6 +6,7 @@
 #include <cstdlib>
 #include <algorithm>
 #include <iostream>
+#include <fstream>
 #include <sstream>
 #include <string>
 #include <limits>
@@ -32,6 +33,8 @@ std::map<std::string, Server*> ConfigurationParser::parse(const std::string& fil
   Route currentRouteConfig;
   bool isParsingServer = false;
   bool isParsingRoute = false;
+  bool isParsingTypes = false;
+  size_t serverCount = 0;
 
   while (std::getline(file, line)) {
     if (line.empty() || line[0] == '#')
@@ -53,10 +56,36 @@ std::map<std::string, Server*> ConfigurationParser::parse(const std::string& fil
         currentServerConfig = new Server(); // Create a new Server object for the next server
       }
       isParsingServer = true;
+      isParsingTypes = false;
+      currentServerConfig->setConfigOrder(serverCount++);
       ConfigurationParser::parseServerName(line, *currentServerConfig);
       continue;
     }
 
+    // [types] block: "<mime type>=<extension> [extension...]" lines for the current server
+    if (ParsingUtils::simpleMatcher(line, "[types]")) {
+      if (!isParsingServer)
+        throw ConfigurationParser::InvalidConfigurationException("[types] block outside of a server");
+      if (isParsingRoute) {
+        currentServerConfig->addRoute(currentRouteConfig.getRoutePath(), currentRouteConfig);
+        currentRouteConfig = Route();
+        isParsingRoute = false;
+      }
+      isParsingTypes = true;
+      continue;
+    }
+    if (isParsingTypes) {
+      // The block ends at the next section or the first line that is not
+      // "<type>/<subtype>=...": that one is a server directive again
+      std::string entry = ParsingUtils::trim_copy(line);
+      std::size_t equalPos = entry.find('=');
+      if (!entry.empty() && entry[0] != '[' && equalPos != std::string::npos && entry.find('/') < equalPos) {
+        parseMimeType(line, *currentServerConfig);
+        continue;
+      }
+      isParsingTypes = false;
+    }
+
     if (ParsingUtils::simpleMatcher(line, "[route:")) {
       if (isParsingRoute) {
         // Save the previously parsed route configuration
@@ -64,6 +93,7 @@ std::map<std::string, Server*> ConfigurationParser::parse(const std::string& fil
         currentRouteConfig = Route();
       }
       isParsingRoute = true;
+      isParsingTypes = false;
       ConfigurationParser::parseRoute(line, currentRouteConfig);
       continue;
     }
@@ -85,6 +115,8 @@ std::map<std::string, Server*> ConfigurationParser::parse(const std::string& fil
     delete currentServerConfig; // Delete if not used
   }
 
+  for (std::map<std::string, Server*>::iterator it = parsedConfigs.begin(); it != parsedConfigs.end(); ++it)
+    it->second->compileRoutes();
   return parsedConfigs;
 }
 
@@ -109,7 +141,26 @@ void ConfigurationParser::checkValidity(const std::map<std::string, Server*>& se
 }
 
 void ConfigurationParser::parseServerConfig(std::string& line, Server& serverConfig) {
-  if (ParsingUtils::matcher(line, "host"))
+  // First: a key file path may well contain "host" or "port", and an
+  // access_log path "session_file"
+  std::string key = ParsingUtils::toLower(line.substr(0, line.find('=')));
+  ParsingUtils::trim(key);
+  if (key == "access_log" || key == "access_log_max_size" || key == "access_log_sample")
+    ConfigurationParser::parseAccessLog(line, serverConfig);
+
+  else if (ParsingUtils::matcher(line, "session_mode"))
+    ConfigurationParser::parseSessionMode(line, serverConfig);
+
+  else if (ParsingUtils::matcher(line, "session_keys"))
+    ConfigurationParser::parseSessionKeys(line, serverConfig);
+
+  else if (ParsingUtils::matcher(line, "session_file"))
+    ConfigurationParser::parseSessionFile(line, serverConfig);
+
+  else if (ParsingUtils::matcher(line, "log_level"))
+    ConfigurationParser::parseLogLevel(line, serverConfig);
+
+  else if (ParsingUtils::matcher(line, "host"))
     ConfigurationParser::parseHost(line, serverConfig);
 
   else if (ParsingUtils::matcher(line, "port"))
@@ -120,6 +171,18 @@ void ConfigurationParser::parseServerConfig(std::string& line, Server& serverCon
 
   else if (ParsingUtils::matcher(line, "client_max_body_size"))
     ConfigurationParser::parseClientMaxBodySize(line, serverConfig);
+
+  else if (ParsingUtils::matcher(line, "default_server"))
+    ConfigurationParser::parseDefaultServer(line, serverConfig);
+
+  else if (ParsingUtils::matcher(line, "max_connections_per_ip"))
+    ConfigurationParser::parseMaxConnectionsPerClient(line, serverConfig);
+
+  else if (ParsingUtils::matcher(line, "listen_backlog") || ParsingUtils::matcher(line, "tcp_defer_accept")
+      || ParsingUtils::matcher(line, "tcp_fastopen") || ParsingUtils::matcher(line, "tcp_nodelay")
+      || ParsingUtils::matcher(line, "so_rcvbuf") || ParsingUtils::matcher(line, "so_sndbuf")
+      || ParsingUtils::matcher(line, "so_reuseport"))
+    ConfigurationParser::parseListenerOption(line, serverConfig);
 }
 
 void ConfigurationParser::parseRouteConfig(std::string& line, Route& routeConfig) {
@@ -149,6 +212,39 @@ void ConfigurationParser::parseRouteConfig(std::string& line, Route& routeConfig
 
   else if (ParsingUtils::matcher(line, "cgi_pass"))
     ConfigurationParser::parseCgiPass(line, routeConfig);
+
+  else if (ParsingUtils::matcher(line, "rate_limit"))
+    ConfigurationParser::parseRateLimit(line, routeConfig);
+
+  else if (ParsingUtils::matcher(line, "rate_burst"))
+    ConfigurationParser::parseRateBurst(line, routeConfig);
+
+  else if (ParsingUtils::matcher(line, "status_page"))
+    ConfigurationParser::parseStatusPage(line, routeConfig);
+
+  // Before cgi_cache, which would match these too
+  else if (ParsingUtils::matcher(line, "cgi_cache_stale"))
+    ConfigurationParser::parseCgiCacheStale(line, routeConfig);
+
+  else if (ParsingUtils::matcher(line, "cgi_cache_vary"))
+    ConfigurationParser::parseCgiCacheVary(line, routeConfig);
+
+  else if (ParsingUtils::matcher(line, "cgi_cache_ignore_cookie"))
+    ConfigurationParser::parseCgiCacheIgnoreCookie(line, routeConfig);
+
+  else if (ParsingUtils::matcher(line, "cgi_cache"))
+    ConfigurationParser::parseCgiCache(line, routeConfig);
+
+  else if (ParsingUtils::matcher(line, "fastcgi_workers"))
+    ConfigurationParser::parseFastCgiWorkers(line, routeConfig);
+
+  else if (ParsingUtils::matcher(line, "fastcgi_connections"))
+    ConfigurationParser::parseFastCgiConnections(line, routeConfig);
+
+  else if (ParsingUtils::matcher(line, "cgi_timeout") || ParsingUtils::matcher(line, "cgi_cpu_limit")
+      || ParsingUtils::matcher(line, "cgi_memory_limit") || ParsingUtils::matcher(line, "cgi_max_scripts")
+      || ParsingUtils::matcher(line, "cgi_queue_size"))
+    ConfigurationParser::parseCgiLimit(line, routeConfig);
 }
 
 // Parse server Config
@@ -198,6 +294,242 @@ void ConfigurationParser::parsePort(std::string& line, Server& serverConfig) {
     Logger::log(INFO, "Ports: " + serverConfig.getPortsString());
 }
 
+void ConfigurationParser::parseDefaultServer(std::string& line, Server& serverConfig) {
+  std::istringstream iss(line);
+  std::string value;
+  iss.ignore(std::numeric_limits<std::streamsize>::max(), '=');
+  getline(iss, value);
+
+  if (ParsingUtils::matcher(value, "on")) {
+    Logger::log(INFO, "default_server is on for server " + serverConfig.getServerName());
+    serverConfig.setDefaultServer(true);
+  } else if (ParsingUtils::matcher(value, "off")) {
+    serverConfig.setDefaultServer(false);
+  } else {
+    Logger::log(WARNING, "Invalid default_server value: " + value + ", reverting to default (off) for server " + serverConfig.getServerName() + ".");
+    serverConfig.setDefaultServer(false);
+  }
+}
+
+void ConfigurationParser::parseMaxConnectionsPerClient(std::string& line, Server& serverConfig) {
+  std::istringstream iss(line);
+  std::string value;
+  iss.ignore(std::numeric_limits<std::streamsize>::max(), '=');
+  getline(iss, value);
+  ParsingUtils::trim(value);
+
+  char* end;
+  errno = 0;
+  long limit = std::strtol(value.c_str(), &end, 10);
+  if (value.empty() || errno == ERANGE || limit < 0 || *end != '\0') {
+    Logger::log(WARNING, "Invalid max_connections_per_ip value: " + value + ", reverting to default (unlimited) for server " + serverConfig.getServerName() + ".");
+    return;
+  }
+  Logger::log(INFO, "max_connections_per_ip: " + value + " for server " + serverConfig.getServerName());
+  serverConfig.setMaxConnectionsPerClient(static_cast<size_t>(limit));
+}
+
+// session_mode=store keeps sessions in the SessionManager, session_mode=signed
+// in HMAC-signed cookies any worker can verify
+void ConfigurationParser::parseSessionMode(std::string& line, Server& serverConfig) {
+  std::istringstream iss(line);
+  std::string value;
+  iss.ignore(std::numeric_limits<std::streamsize>::max(), '=');
+  getline(iss, value);
+  ParsingUtils::trim(value);
+
+  if (ParsingUtils::matcher(value, "signed"))
+    serverConfig.setSignedSessions(true);
+  else if (ParsingUtils::matcher(value, "store"))
+    serverConfig.setSignedSessions(false);
+  else {
+    Logger::log(WARNING, "Invalid session_mode value: " + value + ", reverting to default (store) for server " + serverConfig.getServerName() + ".");
+    serverConfig.setSignedSessions(false);
+    return;
+  }
+  Logger::log(INFO, "session_mode: " + value + " for server " + serverConfig.getServerName());
+}
+
+// session_keys=<file> with one key per line, the signing key first. Rotating
+// is putting a new key first and reloading; the old one stays listed until
+// the tokens it signed have expired.
+void ConfigurationParser::parseSessionKeys(std::string& line, Server& serverConfig) {
+  std::istringstream iss(line);
+  std::string path;
+  iss.ignore(std::numeric_limits<std::streamsize>::max(), '=');
+  getline(iss, path);
+  ParsingUtils::trim(path);
+
+  std::ifstream file(path.c_str());
+  if (!file) {
+    Logger::log(WARNING, "Cannot read session_keys file: " + path + " for server " + serverConfig.getServerName() + ".");
+    return;
+  }
+  std::vector<std::string> keys;
+  std::string key;
+  while (std::getline(file, key)) {
+    ParsingUtils::trim(key);
+    if (key.empty() || key[0] == '#')
+      continue;
+    if (key.size() < 32)
+      Logger::log(WARNING, "Session key shorter than 32 bytes in " + path + ".");
+    keys.push_back(key);
+  }
+  if (keys.empty()) {
+    Logger::log(WARNING, "No keys in session_keys file: " + path + " for server " + serverConfig.getServerName() + ".");
+    return;
+  }
+  Logger::log(INFO, "session_keys: " + ParsingUtils::toString(keys.size()) + " keys for server " + serverConfig.getServerName());
+  serverConfig.setSessionKeys(keys);
+}
+
+// session_file=<path> keeps the session table in a memory-mapped file, so
+// sessions survive a restart. There is one table: with several servers the
+// first one naming a file picks it.
+void ConfigurationParser::parseSessionFile(std::string& line, Server& serverConfig) {
+  std::istringstream iss(line);
+  std::string path;
+  iss.ignore(std::numeric_limits<std::streamsize>::max(), '=');
+  getline(iss, path);
+  ParsingUtils::trim(path);
+
+  if (path.empty()) {
+    Logger::log(WARNING, "Empty session_file value, keeping sessions in memory for server " + serverConfig.getServerName() + ".");
+    return;
+  }
+  Logger::log(INFO, "session_file: " + path + " for server " + serverConfig.getServerName());
+  serverConfig.setSessionFile(path);
+}
+
+// log_level=debug|info|warning|error. There is one logger: with several
+// servers the first one naming a level sets it.
+void ConfigurationParser::parseLogLevel(std::string& line, Server& serverConfig) {
+  std::istringstream iss(line);
+  std::string value;
+  iss.ignore(std::numeric_limits<std::streamsize>::max(), '=');
+  getline(iss, value);
+  ParsingUtils::trim(value);
+  value = ParsingUtils::toLower(value);
+
+  Level level;
+  if (!Logger::parseLevel(value, level)) {
+    Logger::log(WARNING, "Invalid log_level value: " + value + ", reverting to default (info) for server " + serverConfig.getServerName() + ".");
+    return;
+  }
+  Logger::log(INFO, "log_level: " + value + " for server " + serverConfig.getServerName());
+  serverConfig.setLogLevel(value);
+}
+
+// access_log=<path> for one JSON line per request; access_log_max_size in
+// bytes with an optional K, M or G (0 never rotates), access_log_sample=<n>
+// to log one request in n. There is one access log: with several servers
+// the first one naming a path sets it up.
+void ConfigurationParser::parseAccessLog(std::string& line, Server& serverConfig) {
+  std::size_t equalPos = line.find('=');
+  std::string name = ParsingUtils::toLower(line.substr(0, equalPos));
+  std::string value = equalPos == std::string::npos ? "" : line.substr(equalPos + 1);
+  ParsingUtils::trim(name);
+  ParsingUtils::trim(value);
+  AccessLogOptions options = serverConfig.getAccessLogOptions();
+
+  if (name == "access_log") {
+    if (value.empty()) {
+      Logger::log(WARNING, "Empty access_log value, no access log for server " + serverConfig.getServerName() + ".");
+      return;
+    }
+    options.path = value;
+  }
+  else {
+    char* end;
+    errno = 0;
+    long number = std::strtol(value.c_str(), &end, 10);
+    long multiplier = 1;
+    if (name == "access_log_max_size" && (*end == 'k' || *end == 'K'))
+      multiplier = 1024;
+    else if (name == "access_log_max_size" && (*end == 'm' || *end == 'M'))
+      multiplier = 1024 * 1024;
+    else if (name == "access_log_max_size" && (*end == 'g' || *end == 'G'))
+      multiplier = 1024 * 1024 * 1024;
+    if (multiplier != 1)
+      ++end;
+    const long maxValue = name == "access_log_max_size" ? 64L * 1024 * 1024 * 1024 : 1000000;
+    const long minValue = name == "access_log_sample" ? 1 : 0;
+    if (value.empty() || errno == ERANGE || *end != '\0' || number < minValue || number > maxValue / multiplier) {
+      Logger::log(WARNING, "Invalid " + name + " value: " + value + ", reverting to default for server " + serverConfig.getServerName() + ".");
+      return;
+    }
+    if (name == "access_log_max_size")
+      options.maxSize = static_cast<size_t>(number * multiplier);
+    else
+      options.sampleRate = static_cast<size_t>(number);
+  }
+  Logger::log(INFO, name + ": " + value + " for server " + serverConfig.getServerName());
+  serverConfig.setAccessLogOptions(options);
+}
+
+// listen_backlog, tcp_defer_accept (seconds), tcp_fastopen (queue length),
+// so_rcvbuf and so_sndbuf (k/m suffixes) take numbers; tcp_nodelay and
+// so_reuseport take on/off
+void ConfigurationParser::parseListenerOption(std::string& line, Server& serverConfig) {
+  std::size_t equalPos = line.find('=');
+  if (equalPos == std::string::npos) {
+    Logger::log(WARNING, "Invalid listener option: " + line);
+    return;
+  }
+  std::string name = ParsingUtils::toLower(line.substr(0, equalPos));
+  std::string value = line.substr(equalPos + 1);
+  ParsingUtils::trim(name);
+  ParsingUtils::trim(value);
+  ListenerOptions options = serverConfig.getListenerOptions();
+
+  if (name == "tcp_nodelay" || name == "so_reuseport") {
+    bool enabled;
+    if (ParsingUtils::matcher(value, "on"))
+      enabled = true;
+    else if (ParsingUtils::matcher(value, "off"))
+      enabled = false;
+    else {
+      Logger::log(WARNING, "Invalid " + name + " value: " + value + ", reverting to default (off) for server " + serverConfig.getServerName() + ".");
+      return;
+    }
+    if (name == "tcp_nodelay")
+      options.noDelay = enabled;
+    else
+      options.reusePort = enabled;
+  }
+  else {
+    char* end;
+    errno = 0;
+    long number = std::strtol(value.c_str(), &end, 10);
+    long multiplier = 1;
+    if ((name == "so_rcvbuf" || name == "so_sndbuf") && (*end == 'k' || *end == 'K'))
+      multiplier = 1024;
+    else if ((name == "so_rcvbuf" || name == "so_sndbuf") && (*end == 'm' || *end == 'M'))
+      multiplier = 1024 * 1024;
+    if (multiplier != 1)
+      ++end;
+    const long maxValue = (name == "listen_backlog" || name == "tcp_fastopen") ? 65535 : (name == "tcp_defer_accept" ? 3600 : 64L * 1024 * 1024);
+    if (value.empty() || errno == ERANGE || *end != '\0' || number < 0 || number > maxValue / multiplier
+        || (name == "listen_backlog" && number == 0)) {
+      Logger::log(WARNING, "Invalid " + name + " value: " + value + ", reverting to default for server " + serverConfig.getServerName() + ".");
+      return;
+    }
+    int result = static_cast<int>(number * multiplier);
+    if (name == "listen_backlog")
+      options.backlog = result;
+    else if (name == "tcp_defer_accept")
+      options.deferAcceptSeconds = result;
+    else if (name == "tcp_fastopen")
+      options.fastOpenQueue = result;
+    else if (name == "so_rcvbuf")
+      options.receiveBuffer = result;
+    else
+      options.sendBuffer = result;
+  }
+  Logger::log(INFO, name + ": " + value + " for server " + serverConfig.getServerName());
+  serverConfig.setListenerOptions(options);
+}
+
 void ConfigurationParser::parseServerName(std::string &line, Server& serverConfig) 
 {
   const std::string prefix = "[server:";
@@ -343,6 +675,30 @@ void ConfigurationParser::parseClientMaxBodySize(std::string& line, Server& serv
   serverConfig.setMaxClientBodySize(size);
 }
 
+void ConfigurationParser::parseMimeType(std::string& line, Server& serverConfig) {
+  std::size_t equalPos = line.find('=');
+  if (equalPos == std::string::npos) {
+    Logger::log(WARNING, "Invalid types entry, expected <mime type>=<extensions>: " + line);
+    return;
+  }
+  std::string type = line.substr(0, equalPos);
+  ParsingUtils::trimAndLower(type);
+  if (type.empty() || type.find('/') == std::string::npos || ParsingUtils::controlCharacters(type)) {
+    Logger::log(WARNING, "Invalid MIME type in types block: " + type);
+    return;
+  }
+  std::istringstream iss(line.substr(equalPos + 1));
+  std::string extension;
+  while (iss >> extension) {
+    if (extension.length() > MimeTypes::MAX_EXTENSION || ParsingUtils::controlCharacters(extension)) {
+      Logger::log(WARNING, "Invalid extension in types block: " + extension);
+      continue;
+    }
+    serverConfig.setMimeType(extension, type);
+  }
+  Logger::log(INFO, "MIME type: " + type + " for extensions:" + line.substr(equalPos + 1));
+}
+
 // Parse route Config
 void ConfigurationParser::parseRoute(std::string& line, Route& route) {
   const std::string prefix = "[route:";
@@ -654,6 +1010,11 @@ void ConfigurationParser::parseCgiPass(std::string &line, Route &route) {
     Logger::log(WARNING, "cgi_pass is empty, reverting to default.");
     return;
   }
+  std::string address = ParsingUtils::trim_copy(cgiPath);
+  if (address.compare(0, 10, "fastcgi://") == 0) {
+    ConfigurationParser::parseFastCgiPass(address.substr(10), route);
+    return;
+  }
 
   std::string fullPath = ParsingUtils::getWebservRoot() + cgiPath;
   if (!ParsingUtils::doesPathExist(fullPath))
@@ -676,18 +1037,294 @@ void ConfigurationParser::parseCgiPass(std::string &line, Route &route) {
   Logger::log(INFO, "CGI path: " + fullPath + " for route " + route.getRoutePath());
 }
 
+// fastcgi://unix:/path/to.sock, fastcgi://host:port, or
+// fastcgi://spawn:/cgi-bin/worker to have the server run the workers itself
+void ConfigurationParser::parseFastCgiPass(const std::string& address, Route& route) {
+  if (address.compare(0, 6, "spawn:") == 0) {
+    std::string fullPath = ParsingUtils::getWebservRoot() + address.substr(6);
+    if (!ParsingUtils::isRegularFile(fullPath) || !ParsingUtils::hasExecutePermissions(fullPath)) {
+      Logger::log(WARNING, "FastCGI worker is not an executable file: " + fullPath + " reverting to default.");
+      return;
+    }
+    route.setFastCgiAddress("spawn:" + fullPath);
+  }
+  else if (address.compare(0, 5, "unix:") == 0) {
+    if (address.size() < 7 || address[5] != '/' || ParsingUtils::controlCharacters(address)) {
+      Logger::log(WARNING, "Invalid FastCGI socket path: " + address + " reverting to default.");
+      return;
+    }
+    route.setFastCgiAddress(address);
+  }
+  else {
+    size_t colon = address.rfind(':');
+    std::string host = address.substr(0, colon);
+    char* end = NULL;
+    long port = colon == std::string::npos ? 0 : std::strtol(address.c_str() + colon + 1, &end, 10);
+    if (port <= 0 || port > 65535 || *end != '\0' || (host != "localhost" && !ParsingUtils::isValidIPv4(host))) {
+      Logger::log(WARNING, "Invalid FastCGI address: " + address + " reverting to default.");
+      return;
+    }
+    route.setFastCgiAddress(address);
+  }
+  route.setHasCGI(true);
+  Logger::log(INFO, "FastCGI application: " + route.getFastCgiAddress() + " for route " + route.getRoutePath());
+}
+
+// Workers a spawned FastCGI pool runs
+void ConfigurationParser::parseFastCgiWorkers(std::string& line, Route& route) {
+  std::istringstream iss(line);
+  std::string value;
+  iss.ignore(std::numeric_limits<std::streamsize>::max(), '=');
+  getline(iss, value);
+  ParsingUtils::trim(value);
+
+  char* end;
+  errno = 0;
+  long workers = std::strtol(value.c_str(), &end, 10);
+  if (value.empty() || errno == ERANGE || *end != '\0' || workers < 1 || workers > 256) {
+    Logger::log(WARNING, "Invalid fastcgi_workers value: " + value + ", reverting to default for route " + route.getRoutePath() + ".");
+    return;
+  }
+  Logger::log(INFO, "fastcgi_workers: " + value + " for route " + route.getRoutePath());
+  route.setFastCgiWorkers(static_cast<int>(workers));
+}
+
+// Kept-alive connections to an external FastCGI application
+void ConfigurationParser::parseFastCgiConnections(std::string& line, Route& route) {
+  std::istringstream iss(line);
+  std::string value;
+  iss.ignore(std::numeric_limits<std::streamsize>::max(), '=');
+  getline(iss, value);
+  ParsingUtils::trim(value);
+
+  char* end;
+  errno = 0;
+  long connections = std::strtol(value.c_str(), &end, 10);
+  if (value.empty() || errno == ERANGE || *end != '\0' || connections < 1 || connections > 1024) {
+    Logger::log(WARNING, "Invalid fastcgi_connections value: " + value + ", reverting to default for route " + route.getRoutePath() + ".");
+    return;
+  }
+  Logger::log(INFO, "fastcgi_connections: " + value + " for route " + route.getRoutePath());
+  route.setFastCgiConnections(static_cast<int>(connections));
+}
+
+// cgi_timeout and cgi_cpu_limit in seconds, cgi_memory_limit in bytes with
+// an optional K, M or G, cgi_max_scripts and cgi_queue_size as counts.
+// cgi_cpu_limit and cgi_memory_limit apply from just after the exec: a
+// script can use more in the moment before they are set.
+void ConfigurationParser::parseCgiLimit(std::string& line, Route& route) {
+  std::size_t equalPos = line.find('=');
+  if (equalPos == std::string::npos) {
+    Logger::log(WARNING, "Invalid CGI limit: " + line);
+    return;
+  }
+  std::string name = ParsingUtils::toLower(line.substr(0, equalPos));
+  std::string value = line.substr(equalPos + 1);
+  ParsingUtils::trim(name);
+  ParsingUtils::trim(value);
+  CgiLimits limits = route.getCgiLimits();
+
+  char* end;
+  errno = 0;
+  long number = std::strtol(value.c_str(), &end, 10);
+  long multiplier = 1;
+  if (name == "cgi_memory_limit" && (*end == 'k' || *end == 'K'))
+    multiplier = 1024;
+  else if (name == "cgi_memory_limit" && (*end == 'm' || *end == 'M'))
+    multiplier = 1024 * 1024;
+  else if (name == "cgi_memory_limit" && (*end == 'g' || *end == 'G'))
+    multiplier = 1024 * 1024 * 1024;
+  else if ((name == "cgi_timeout" || name == "cgi_cpu_limit") && *end == 's')
+    ++end;
+  if (multiplier != 1)
+    ++end;
+  const long maxValue = name == "cgi_memory_limit" ? 64L * 1024 * 1024 * 1024 : (name == "cgi_max_scripts" || name == "cgi_queue_size" ? 65536 : 86400);
+  if (value.empty() || errno == ERANGE || *end != '\0' || number < 0 || number > maxValue / multiplier) {
+    Logger::log(WARNING, "Invalid " + name + " value: " + value + ", reverting to default for route " + route.getRoutePath() + ".");
+    return;
+  }
+  if (name == "cgi_timeout")
+    limits.timeoutSeconds = static_cast<int>(number);
+  else if (name == "cgi_cpu_limit")
+    limits.cpuSeconds = static_cast<int>(number);
+  else if (name == "cgi_memory_limit")
+    limits.memoryBytes = number * multiplier;
+  else if (name == "cgi_max_scripts")
+    limits.maxScripts = static_cast<int>(number);
+  else
+    limits.queueSize = static_cast<int>(number);
+  Logger::log(INFO, name + ": " + value + " for route " + route.getRoutePath());
+  route.setCgiLimits(limits);
+}
+
+// rate_limit=<requests>[r]/s or /m, e.g. "10r/s" or "300/m"
+void ConfigurationParser::parseRateLimit(std::string& line, Route& route) {
+  std::istringstream iss(line);
+  std::string value;
+  iss.ignore(std::numeric_limits<std::streamsize>::max(), '=');
+  getline(iss, value);
+  ParsingUtils::trim(value);
+
+  char* end;
+  errno = 0;
+  long requests = std::strtol(value.c_str(), &end, 10);
+  if (value.empty() || errno == ERANGE || requests <= 0 || end == value.c_str()) {
+    Logger::log(WARNING, "Invalid rate_limit value: " + value + ", no limit for route " + route.getRoutePath() + ".");
+    return;
+  }
+  std::string unit(end);
+  double perSecond;
+  if (unit.empty() || unit == "/s" || unit == "r/s")
+    perSecond = static_cast<double>(requests);
+  else if (unit == "/m" || unit == "r/m")
+    perSecond = static_cast<double>(requests) / 60.0;
+  else {
+    Logger::log(WARNING, "Invalid rate_limit unit: " + unit + ", no limit for route " + route.getRoutePath() + ".");
+    return;
+  }
+  Logger::log(INFO, "rate_limit: " + value + " for route " + route.getRoutePath());
+  route.setRateLimit(perSecond);
+}
+
+void ConfigurationParser::parseRateBurst(std::string& line, Route& route) {
+  std::istringstream iss(line);
+  std::string value;
+  iss.ignore(std::numeric_limits<std::streamsize>::max(), '=');
+  getline(iss, value);
+  ParsingUtils::trim(value);
+
+  char* end;
+  errno = 0;
+  long burst = std::strtol(value.c_str(), &end, 10);
+  if (value.empty() || errno == ERANGE || burst <= 0 || burst > INT_MAX || *end != '\0') {
+    Logger::log(WARNING, "Invalid rate_burst value: " + value + ", reverting to default for route " + route.getRoutePath() + ".");
+    return;
+  }
+  Logger::log(INFO, "rate_burst: " + value + " for route " + route.getRoutePath());
+  route.setRateBurst(static_cast<int>(burst));
+}
+
+void ConfigurationParser::parseStatusPage(std::string& line, Route& route) {
+  std::istringstream iss(line);
+  std::string value;
+  iss.ignore(std::numeric_limits<std::streamsize>::max(), '=');
+  getline(iss, value);
+
+  if (ParsingUtils::matcher(value, "on")) {
+    Logger::log(INFO, "Status page enabled for route " + route.getRoutePath());
+    route.setStatusPage(true);
+  } else if (ParsingUtils::matcher(value, "off")) {
+    route.setStatusPage(false);
+  } else {
+    Logger::log(WARNING, "Invalid status_page value: " + value + ", reverting to default (off) for route " + route.getRoutePath() + ".");
+    route.setStatusPage(false);
+  }
+}
+
+// cgi_cache=<seconds> caches the route's CGI responses that long
+void ConfigurationParser::parseCgiCache(std::string& line, Route& route) {
+  std::istringstream iss(line);
+  std::string value;
+  iss.ignore(std::numeric_limits<std::streamsize>::max(), '=');
+  getline(iss, value);
+  ParsingUtils::trim(value);
+
+  char* end;
+  errno = 0;
+  long seconds = std::strtol(value.c_str(), &end, 10);
+  if (value.empty() || errno == ERANGE || seconds < 0 || seconds > 86400 || (*end != '\0' && std::string(end) != "s")) {
+    Logger::log(WARNING, "Invalid cgi_cache value: " + value + ", caching stays off for route " + route.getRoutePath() + ".");
+    return;
+  }
+  Logger::log(INFO, "cgi_cache: " + value + " for route " + route.getRoutePath());
+  route.setCgiCacheTtl(static_cast<int>(seconds));
+}
+
+void ConfigurationParser::parseCgiCacheStale(std::string& line, Route& route) {
+  std::istringstream iss(line);
+  std::string value;
+  iss.ignore(std::numeric_limits<std::streamsize>::max(), '=');
+  getline(iss, value);
+  ParsingUtils::trim(value);
+
+  char* end;
+  errno = 0;
+  long seconds = std::strtol(value.c_str(), &end, 10);
+  if (value.empty() || errno == ERANGE || seconds < 0 || seconds > 86400 || (*end != '\0' && std::string(end) != "s")) {
+    Logger::log(WARNING, "Invalid cgi_cache_stale value: " + value + ", reverting to default for route " + route.getRoutePath() + ".");
+    return;
+  }
+  Logger::log(INFO, "cgi_cache_stale: " + value + " for route " + route.getRoutePath());
+  route.setCgiCacheStale(static_cast<int>(seconds));
+}
+
+// cgi_cache_vary=Accept-Language,Cookie adds those request headers to the key
+void ConfigurationParser::parseCgiCacheVary(std::string& line, Route& route) {
+  std::istringstream iss(line);
+  std::string value;
+  iss.ignore(std::numeric_limits<std::streamsize>::max(), '=');
+  getline(iss, value);
+
+  std::replace(value.begin(), value.end(), ',', ' ');
+  std::istringstream names(value);
+  std::string name;
+  std::vector<std::string> headers;
+  while (names >> name) {
+    if (ParsingUtils::controlCharacters(name)) {
+      Logger::log(WARNING, "Control characters found in cgi_cache_vary: " + name + ", ignoring it.");
+      continue;
+    }
+    headers.push_back(name);
+  }
+  Logger::log(INFO, "cgi_cache_vary: " + value + " for route " + route.getRoutePath());
+  route.setCgiCacheVary(headers);
+}
+
+// cgi_cache_ignore_cookie=on shares cached responses between clients with
+// different cookies; the script then never sees them
+void ConfigurationParser::parseCgiCacheIgnoreCookie(std::string& line, Route& route) {
+  std::istringstream iss(line);
+  std::string value;
+  iss.ignore(std::numeric_limits<std::streamsize>::max(), '=');
+  getline(iss, value);
+
+  if (ParsingUtils::matcher(value, "on")) {
+    Logger::log(INFO, "cgi_cache_ignore_cookie enabled for route " + route.getRoutePath());
+    route.setCgiCacheIgnoreCookie(true);
+  } else if (ParsingUtils::matcher(value, "off")) {
+    route.setCgiCacheIgnoreCookie(false);
+  } else {
+    Logger::log(WARNING, "Invalid cgi_cache_ignore_cookie value: " + value + ", reverting to default (off) for route " + route.getRoutePath() + ".");
+    route.setCgiCacheIgnoreCookie(false);
+  }
+}
+
+// Servers may share a port (name-based virtual hosting) as long as they bind
+// the same address; at most one of them can be the port's default_server
 void ConfigurationParser::checkForDuplicatePorts(const std::map<std::string, Server *> &servers)
 {
-  std::set<int> usedPorts;
+  std::map<int, const Server*> portOwners;
+  std::set<int> defaultPorts;
   for (std::map<std::string, Server*>::const_iterator it = servers.begin(); it != servers.end(); ++it) {
     const std::vector<int>& ports = it->second->getPorts();
+    std::set<int> serverPorts;
     for (std::vector<int>::const_iterator portIt = ports.begin(); portIt != ports.end(); ++portIt) {
       int port = *portIt;
-      if (usedPorts.find(port) != usedPorts.end()) {
+      std::map<int, const Server*>::iterator owner = portOwners.find(port);
+      if (!serverPorts.insert(port).second) {
         Logger::log(ERROR, "Duplicate port: " + ParsingUtils::toString(port));
         throw ConfigurationParser::InvalidConfigurationException("Duplicate port: " + ParsingUtils::toString(port));
       }
-      usedPorts.insert(port);
+      if (owner != portOwners.end() && owner->second->getHost() != it->second->getHost()) {
+        Logger::log(ERROR, "Port " + ParsingUtils::toString(port) + " is bound to different hosts");
+        throw ConfigurationParser::InvalidConfigurationException("Port " + ParsingUtils::toString(port) + " is bound to different hosts");
+      }
+      if (it->second->isDefaultServer() && !defaultPorts.insert(port).second) {
+        Logger::log(ERROR, "Duplicate default_server on port: " + ParsingUtils::toString(port));
+        throw ConfigurationParser::InvalidConfigurationException("Duplicate default_server on port: " + ParsingUtils::toString(port));
+      }
+      if (owner == portOwners.end())
+        portOwners[port] = it->second;
     }
   }
 }
@@ -9,3 +9,31 @@ std::string Cookie::getCookieName() const { return cookieName; }
 std::string Cookie::getCookieValue() const { return cookieValue; }
 
 std::string Cookie::getCookieString() const { return cookieName + "=" + cookieValue; }
+
+// RFC 6265 cookie-string: "name=value" pairs separated by "; ". Browsers
+// are lenient about the spaces, and a value may be in double quotes.
+std::string Cookie::findValue(const std::string& header, const std::string& name) {
+  size_t start = 0;
+  while (start < header.size()) {
+    size_t end = header.find(';', start);
+    if (end == std::string::npos)
+      end = header.size();
+    std::string pair = trim(header.substr(start, end - start));
+    size_t equals = pair.find('=');
+    if (equals != std::string::npos && trim(pair.substr(0, equals)) == name) {
+      std::string value = trim(pair.substr(equals + 1));
+      if (value.size() >= 2 && value[0] == '"' && value[value.size() - 1] == '"')
+        value = value.substr(1, value.size() - 2);
+      return value;
+    }
+    start = end + 1;
+  }
+  return "";
+}
+
+std::string Cookie::trim(const std::string& text) {
+  size_t first = text.find_first_not_of(" \t");
+  if (first == std::string::npos)
+    return "";
+  return text.substr(first, text.find_last_not_of(" \t") - first + 1);
+}
@@ -0,0 +1,240 @@
+#include "DirectoryListingCache.hpp"
+#include "Logger.hpp"
+#include "ParsingUtils.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <cerrno>
+#include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+namespace {
+  bool byName(const DirectoryEntry& a, const DirectoryEntry& b) {
+    return a.name < b.name;
+  }
+
+  // Index comparators used for the lazily built secondary orders; ties keep
+  // name order so paging stays stable.
+  struct BySize {
+    const std::vector<DirectoryEntry>* entries;
+    bool operator()(size_t a, size_t b) const {
+      if ((*entries)[a].size != (*entries)[b].size)
+        return (*entries)[a].size < (*entries)[b].size;
+      return a < b;
+    }
+  };
+
+  struct ByMtime {
+    const std::vector<DirectoryEntry>* entries;
+    bool operator()(size_t a, size_t b) const {
+      if ((*entries)[a].mtime != (*entries)[b].mtime)
+        return (*entries)[a].mtime < (*entries)[b].mtime;
+      return a < b;
+    }
+  };
+
+  bool sameMtime(const struct timespec& a, const struct timespec& b) {
+    return a.tv_sec == b.tv_sec && a.tv_nsec == b.tv_nsec;
+  }
+
+  std::string withoutFinalSlash(const std::string& path) {
+    std::string trimmed = path;
+    while (trimmed.length() > 1 && trimmed[trimmed.length() - 1] == '/')
+      trimmed.erase(trimmed.length() - 1);
+    return trimmed;
+  }
+}
+
+DirectoryListing::DirectoryListing(const std::string& path, const struct timespec& mtime) : path(path), mtime(mtime), refCount(0), detached(false) {}
+
+const std::string& DirectoryListing::getPath() const {
+  return path;
+}
+
+const struct timespec& DirectoryListing::getMtime() const {
+  return mtime;
+}
+
+size_t DirectoryListing::size() const {
+  return entries.size();
+}
+
+void DirectoryListing::load(void) {
+  DIR* dir = opendir(path.c_str());
+  if (dir == NULL) {
+    Logger::log(ERROR, "Error opening directory: " + std::string(strerror(errno)));
+    throw std::runtime_error("Error opening directory: " + std::string(strerror(errno)));
+  }
+  int dfd = dirfd(dir);
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+      continue;
+    DirectoryEntry de;
+    de.name = entry->d_name;
+    de.isDirectory = false;
+    de.size = 0;
+    de.mtime = 0;
+    // fstatat on the open directory avoids rebuilding the full path per entry
+    struct stat st;
+    if (fstatat(dfd, entry->d_name, &st, 0) == 0) {
+      de.isDirectory = S_ISDIR(st.st_mode);
+      de.size = st.st_size;
+      de.mtime = st.st_mtime;
+    }
+    entries.push_back(de);
+  }
+  closedir(dir);
+  std::sort(entries.begin(), entries.end(), byName);
+}
+
+const std::vector<size_t>& DirectoryListing::getOrder(SortKey key) const {
+  std::vector<size_t>& order = (key == SORT_SIZE) ? bySize : byMtime;
+  if (order.size() != entries.size()) {
+    order.resize(entries.size());
+    for (size_t i = 0; i < entries.size(); ++i)
+      order[i] = i;
+    if (key == SORT_SIZE) {
+      BySize cmp = { &entries };
+      std::sort(order.begin(), order.end(), cmp);
+    } else {
+      ByMtime cmp = { &entries };
+      std::sort(order.begin(), order.end(), cmp);
+    }
+  }
+  return order;
+}
+
+const DirectoryEntry& DirectoryListing::at(size_t index, SortKey key) const {
+  if (key == SORT_NAME)
+    return entries[index];
+  return entries[getOrder(key)[index]];
+}
+
+DirectoryListingCache::DirectoryListingCache(size_t maxDirectories, long ttlMs)
+  : maxDirectories(maxDirectories), ttlMs(ttlMs), useClock(0), watcher(NULL) {}
+
+DirectoryListingCache::~DirectoryListingCache() {
+  clear();
+}
+
+void DirectoryListingCache::setWatcher(FileWatcher* watcher) {
+  if (this->watcher != NULL)
+    this->watcher->removeListener(this);
+  this->watcher = watcher;
+  if (watcher != NULL)
+    watcher->addListener(this);
+  clear();
+}
+
+const DirectoryListing* DirectoryListingCache::getListing(const std::string& directoryPath) {
+  std::map<std::string, Slot>::iterator it = listings.find(directoryPath);
+  // Watched: any change would have dropped it already
+  if (it != listings.end() && it->second.expiresMs == 0) {
+    it->second.lastUse = ++useClock;
+    ++it->second.listing->refCount;
+    return it->second.listing;
+  }
+
+  struct stat st;
+  if (stat(directoryPath.c_str(), &st) != 0) {
+    invalidate(directoryPath);
+    throw std::runtime_error("Error opening directory: " + std::string(strerror(errno)));
+  }
+  if (it != listings.end()) {
+    if (sameMtime(it->second.listing->getMtime(), st.st_mtim) && nowMs() < it->second.expiresMs) {
+      it->second.lastUse = ++useClock;
+      ++it->second.listing->refCount;
+      return it->second.listing;
+    }
+    Logger::log(INFO, "Directory changed or listing expired, reloading: " + directoryPath);
+    drop(it);
+  }
+
+  // Watched from before the read, so no change can slip in between
+  bool watched = watcher != NULL && watcher->watchDirectory(directoryPath);
+  DirectoryListing* listing = new DirectoryListing(directoryPath, st.st_mtim);
+  try {
+    listing->load();
+  } catch (...) {
+    delete listing;
+    throw;
+  }
+  if (listings.size() >= maxDirectories)
+    evictOldest();
+  Slot slot;
+  slot.listing = listing;
+  slot.lastUse = ++useClock;
+  if (watched)
+    slot.expiresMs = 0;
+  else
+    slot.expiresMs = nowMs() + ttlMs;
+  // One reference for the cache, one for the caller
+  listing->refCount = 2;
+  listings[directoryPath] = slot;
+  Logger::log(INFO, "Cached listing of " + directoryPath + " (" + ParsingUtils::toString(listing->size()) + " entries)");
+  return listing;
+}
+
+void DirectoryListingCache::release(const DirectoryListing* listing) {
+  if (listing == NULL || --listing->refCount > 0)
+    return;
+  if (listing->detached)
+    delete listing;
+}
+
+void DirectoryListingCache::invalidate(const std::string& directoryPath) {
+  std::map<std::string, Slot>::iterator it = listings.find(directoryPath);
+  if (it != listings.end())
+    drop(it);
+}
+
+void DirectoryListingCache::clear(void) {
+  while (!listings.empty())
+    drop(listings.begin());
+}
+
+// An entry changed: the listing of the directory holding it is out of date,
+// and so are those of path itself and, for a subtree, everything below it
+void DirectoryListingCache::fileChanged(const std::string& path, bool subtree) {
+  std::string changed = withoutFinalSlash(path);
+  size_t slash = changed.rfind('/');
+  if (slash != std::string::npos) {
+    std::string parent = slash == 0 ? "/" : changed.substr(0, slash);
+    invalidate(parent);
+    invalidate(parent + "/");
+  }
+  invalidate(changed);
+  invalidate(changed + "/");
+  if (!subtree)
+    return;
+  std::string prefix = changed == "/" ? changed : changed + "/";
+  std::map<std::string, Slot>::iterator it = listings.lower_bound(prefix);
+  while (it != listings.end() && it->first.compare(0, prefix.length(), prefix) == 0)
+    drop(it++);
+}
+
+// The cache lets go of its reference; responses still streaming keep theirs
+void DirectoryListingCache::drop(std::map<std::string, Slot>::iterator it) {
+  DirectoryListing* listing = it->second.listing;
+  listings.erase(it);
+  listing->detached = true;
+  release(listing);
+}
+
+void DirectoryListingCache::evictOldest(void) {
+  std::map<std::string, Slot>::iterator oldest = listings.end();
+  for (std::map<std::string, Slot>::iterator it = listings.begin(); it != listings.end(); ++it) {
+    if (oldest == listings.end() || it->second.lastUse < oldest->second.lastUse)
+      oldest = it;
+  }
+  if (oldest != listings.end())
+    drop(oldest);
+}
+
+long DirectoryListingCache::nowMs(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000L + now.tv_nsec / 1000000L;
+}
@@ -0,0 +1,172 @@
+#include "DirectoryListingRenderer.hpp"
+#include "HTTPResponse.hpp"
+#include "ParsingUtils.hpp"
+#include "AccessLog.hpp"
+#include <cstdlib>
+
+namespace {
+  std::string htmlEscape(const std::string& str) {
+    std::string out;
+    out.reserve(str.size());
+    for (size_t i = 0; i < str.size(); ++i) {
+      switch (str[i]) {
+        case '&': out += "&amp;"; break;
+        case '<': out += "&lt;"; break;
+        case '>': out += "&gt;"; break;
+        case '"': out += "&quot;"; break;
+        default: out += str[i];
+      }
+    }
+    return out;
+  }
+
+  const char* sortName(DirectoryListing::SortKey key) {
+    if (key == DirectoryListing::SORT_SIZE)
+      return "size";
+    if (key == DirectoryListing::SORT_MTIME)
+      return "mtime";
+    return "name";
+  }
+}
+
+DirectoryListingQuery::DirectoryListingQuery() : sort(DirectoryListing::SORT_NAME), descending(false), page(0), perPage(DirectoryListingRenderer::DEFAULT_PER_PAGE), json(false) {}
+
+DirectoryListingQuery DirectoryListingQuery::fromQueryString(const std::string& queryString) {
+  DirectoryListingQuery query;
+  std::string sort = ParsingUtils::getQueryParameter(queryString, "sort");
+  if (sort == "size")
+    query.sort = DirectoryListing::SORT_SIZE;
+  else if (sort == "mtime")
+    query.sort = DirectoryListing::SORT_MTIME;
+  query.descending = (ParsingUtils::getQueryParameter(queryString, "order") == "desc");
+  query.json = (ParsingUtils::getQueryParameter(queryString, "format") == "json");
+
+  std::string page = ParsingUtils::getQueryParameter(queryString, "page");
+  std::string perPage = ParsingUtils::getQueryParameter(queryString, "per_page");
+  if (!page.empty())
+    query.page = std::strtoul(page.c_str(), NULL, 10);
+  if (!perPage.empty()) {
+    query.perPage = std::strtoul(perPage.c_str(), NULL, 10);
+    if (query.page == 0)
+      query.page = 1; // per_page alone implies the first page
+  }
+  if (query.perPage == 0)
+    query.perPage = DirectoryListingRenderer::DEFAULT_PER_PAGE;
+  if (query.perPage > DirectoryListingRenderer::MAX_PER_PAGE)
+    query.perPage = DirectoryListingRenderer::MAX_PER_PAGE;
+  return query;
+}
+
+namespace {
+  // Renders the page a piece at a time as the client reads it. The listing
+  // snapshot is held until the last piece, whatever the cache does meanwhile.
+  class ListingSource : public OutputSource {
+    public:
+      ListingSource(const DirectoryListing* listing, DirectoryListingCache& listings, const DirectoryListingQuery& query, const std::string& uriPath, int fd)
+        : listing(listing), listings(listings), query(query), uriPath(uriPath), fd(fd), started(false) {
+        total = listing->size();
+        first = 0;
+        last = total;
+        if (query.page > 0) {
+          // Any page past the end is empty; checked first so a huge page
+          // number cannot overflow the product
+          first = (query.page - 1 > total / query.perPage) ? total : (query.page - 1) * query.perPage;
+          if (first > total)
+            first = total;
+          last = (total - first > query.perPage) ? first + query.perPage : total;
+        }
+        next = first;
+        // Ensure uriPath ends with '/'
+        formattedDirectoryPath = uriPath;
+        if (formattedDirectoryPath.empty() || formattedDirectoryPath[formattedDirectoryPath.length() - 1] != '/')
+          formattedDirectoryPath += '/';
+        formattedDirectoryPath = htmlEscape(formattedDirectoryPath);
+      }
+
+      ~ListingSource() {
+        listings.release(listing);
+      }
+
+      bool produce(std::string& out) {
+        std::string body;
+        body.reserve(DirectoryListingRenderer::FLUSH_THRESHOLD * 2);
+        if (!started) {
+          body += opening();
+          started = true;
+        }
+        for (; next < last && body.size() < DirectoryListingRenderer::FLUSH_THRESHOLD; ++next)
+          body += entry(next);
+        bool complete = next == last && body.size() < DirectoryListingRenderer::FLUSH_THRESHOLD;
+        if (complete)
+          body += closing();
+        size_t before = out.size();
+        HTTPResponse::appendChunk(out, body.data(), body.size());
+        if (complete)
+          HTTPResponse::appendLastChunk(out);
+        AccessLog::sending(fd, NULL, out.size() - before);
+        return !complete;
+      }
+
+    private:
+      const DirectoryListing* listing;
+      DirectoryListingCache& listings;
+      DirectoryListingQuery query;
+      std::string uriPath;
+      std::string formattedDirectoryPath;
+      int fd;
+      bool started;
+      size_t total;
+      size_t first;
+      size_t last;
+      size_t next;
+
+      std::string opening(void) const {
+        if (query.json) {
+          return "{\"path\":\"" + ParsingUtils::jsonEscape(uriPath) + "\",\"total\":" + ParsingUtils::toString(total)
+            + ",\"page\":" + ParsingUtils::toString(query.page) + ",\"per_page\":" + ParsingUtils::toString(query.page > 0 ? query.perPage : total)
+            + ",\"sort\":\"" + sortName(query.sort) + "\",\"order\":\"" + (query.descending ? "desc" : "asc") + "\",\"entries\":[";
+        }
+        std::string escapedPath = htmlEscape(uriPath);
+        return "<html><head><title>Directory Listing of " + escapedPath + "</title></head><body>"
+          "<h2>Directory Listing of " + escapedPath + "</h2><ul>";
+      }
+
+      std::string entry(size_t i) const {
+        size_t index = query.descending ? total - 1 - i : i;
+        const DirectoryEntry& entry = listing->at(index, query.sort);
+        if (query.json) {
+          return std::string(i == first ? "" : ",") + "{\"name\":\"" + ParsingUtils::jsonEscape(entry.name) + "\",\"type\":\""
+            + (entry.isDirectory ? "directory" : "file") + "\",\"size\":" + ParsingUtils::toString(entry.size)
+            + ",\"mtime\":" + ParsingUtils::toString(entry.mtime) + "}";
+        }
+        std::string name = htmlEscape(entry.name);
+        return "<li><a href=\"" + formattedDirectoryPath + name + "\">" + name + (entry.isDirectory ? "/" : "") + "</a></li>";
+      }
+
+      std::string closing(void) const {
+        if (query.json)
+          return "]}";
+        std::string html = "</ul>";
+        if (query.page > 0) {
+          std::string params = std::string("sort=") + sortName(query.sort) + "&amp;order=" + (query.descending ? "desc" : "asc")
+            + "&amp;per_page=" + ParsingUtils::toString(query.perPage);
+          html += "<p>";
+          if (query.page > 1)
+            html += "<a href=\"?" + params + "&amp;page=" + ParsingUtils::toString(query.page - 1) + "\">Previous</a> ";
+          html += "Page " + ParsingUtils::toString(query.page) + " (" + ParsingUtils::toString(total) + " entries)";
+          if (last < total)
+            html += " <a href=\"?" + params + "&amp;page=" + ParsingUtils::toString(query.page + 1) + "\">Next</a>";
+          html += "</p>";
+        }
+        return html + "</body></html>";
+      }
+  };
+}
+
+bool DirectoryListingRenderer::stream(const DirectoryListing* listing, DirectoryListingCache& listings, const DirectoryListingQuery& query, const std::string& uriPath, const Cookie& cookie, OutputQueue& out) {
+  if (!HTTPResponse::sendChunkedHeaders("200 OK", query.json ? "application/json" : "text/html", cookie, out)) {
+    listings.release(listing);
+    return false;
+  }
+  return out.stream(new ListingSource(listing, listings, query, uriPath, out.getFd()));
+}
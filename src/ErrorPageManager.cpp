@@ -62,6 +62,9 @@ std::string ErrorPageManager::errorCodeMessageParser(int errorCode) const {
 			break;
     case 413:
       errorMessage = "Request Entity Too Large. Error code: 413";
+      break;
+    case 429:
+      errorMessage = "Too Many Requests. Error code: 429";
       break;
 		case 500:
 			errorMessage = "Internal Server Error. Error code: 500";
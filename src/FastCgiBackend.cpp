@@ -0,0 +1,357 @@
+#include "FastCgiBackend.hpp"
+#include <sys/prctl.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <signal.h>
+#include <unistd.h>
+#include <string.h>
+#include <cerrno>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include "Reactor.hpp"
+#include "ServerManager.hpp"
+#include "CgiResponseHeader.hpp"
+#include "HTTPResponse.hpp"
+#include "Logger.hpp"
+#include "ParsingUtils.hpp"
+#include "SystemUtils.hpp"
+
+namespace {
+  const size_t DEFAULT_CONNECTIONS = 8;
+  // A worker exiting this many times in a row right after starting is broken
+  const int MAX_QUICK_EXITS = 5;
+  const long QUICK_EXIT_MS = 1000;
+}
+
+FastCgiBackend::FastCgiBackend(const std::string& address, size_t workers, size_t maxConnections, Reactor* reactor)
+  : address(address), reactor(reactor), peerLength(0), resolved(false), listenFd(-1),
+    maxConnections(maxConnections > 0 ? maxConnections : DEFAULT_CONNECTIONS), limitsKnown(false) {
+  memset(&peer, 0, sizeof(peer));
+  if (address.compare(0, 6, "spawn:") == 0) {
+    command = address.substr(6);
+    // A worker serves one kept-alive connection at a time, so more
+    // connections than workers would wait in the backlog forever
+    this->maxConnections = workers;
+    // FCGI_MAX_CONNS of one worker says nothing about the pool
+    limitsKnown = true;
+    resolved = startPool(workers);
+  }
+  else
+    resolved = resolve(address);
+}
+
+// Left over requests are failed, so their clients are not left waiting
+FastCgiBackend::~FastCgiBackend() {
+  std::vector<FastCgiConnection*> open;
+  open.swap(connections);
+  for (std::vector<FastCgiConnection*>::iterator it = open.begin(); it != open.end(); ++it) {
+    (*it)->detach();
+    reactor->deregisterHandler((*it)->getHandle());
+    delete *it;
+  }
+  while (!queue.empty()) {
+    deliver(queue.front(), true);
+    queue.pop_front();
+  }
+  ProcessReaper* reaper = ServerManager::getInstance().getProcessReaper();
+  for (std::vector<Worker>::iterator it = workers.begin(); it != workers.end(); ++it) {
+    if (it->pid <= 0)
+      continue;
+    if (reaper != NULL)
+      reaper->unwatch(it->pid);
+    kill(it->pid, SIGTERM);
+  }
+  SystemUtils::closeUtil(listenFd);
+  if (!socketPath.empty())
+    unlink(socketPath.c_str());
+}
+
+std::string FastCgiBackend::makeKey(const Route& route) {
+  return route.getFastCgiAddress() + " workers=" + ParsingUtils::toString(route.getFastCgiWorkers())
+    + " connections=" + ParsingUtils::toString(route.getFastCgiConnections());
+}
+
+void FastCgiBackend::submit(FastCgiRequest* request) {
+  if (!resolved || (!command.empty() && !hasLiveWorkers())) {
+    Logger::log(ERROR, "FastCGI application unavailable: " + address);
+    deliver(request, true);
+    return;
+  }
+  queue.push_back(request);
+  dispatch();
+}
+
+void FastCgiBackend::removeListener(CgiResponseListener* listener) {
+  for (std::deque<FastCgiRequest*>::iterator it = queue.begin(); it != queue.end(); ) {
+    if ((*it)->listener == listener) {
+      delete *it;
+      it = queue.erase(it);
+    }
+    else
+      ++it;
+  }
+  for (std::vector<FastCgiConnection*>::iterator it = connections.begin(); it != connections.end(); ++it)
+    (*it)->abandon(listener);
+}
+
+// Same rules as CgiHandler: no output and a failing exit status is an error
+void FastCgiBackend::deliver(FastCgiRequest* request, bool failed) {
+  failed = failed || (request->output.empty() && request->appStatus != 0);
+  if (!request->cacheKey.empty()) {
+    CgiResponseCache& cache = ServerManager::getInstance().getCgiResponseCache();
+    if (failed)
+      cache.fail(request->cacheKey);
+    else
+      cache.store(request->cacheKey, request->output, request->cacheTtlMs, request->cacheStaleMs);
+  }
+  else if (request->listener != NULL) {
+    if (failed)
+      request->listener->cgiResponseReady(HTTPResponse::buildErrorResponse(502, NULL));
+    else
+      request->listener->cgiResponseReady(CgiResponseHeader::buildResponse(request->output));
+  }
+  delete request;
+}
+
+void FastCgiBackend::complete(FastCgiRequest* request, bool failed) {
+  deliver(request, failed);
+  dispatch();
+}
+
+void FastCgiBackend::retry(FastCgiRequest* request) {
+  queue.push_front(request);
+  dispatch();
+}
+
+// A kept-alive connection can be closed by the application at any time;
+// requests it never answered get one more try on another connection
+void FastCgiBackend::connectionLost(std::vector<FastCgiRequest*>& requests) {
+  for (std::vector<FastCgiRequest*>::reverse_iterator it = requests.rbegin(); it != requests.rend(); ++it) {
+    FastCgiRequest* request = *it;
+    if (request->retried || !request->output.empty() || (request->listener == NULL && request->cacheKey.empty())) {
+      deliver(request, true);
+      continue;
+    }
+    request->retried = true;
+    queue.push_front(request);
+  }
+  dispatch();
+}
+
+void FastCgiBackend::forget(FastCgiConnection* connection) {
+  for (std::vector<FastCgiConnection*>::iterator it = connections.begin(); it != connections.end(); ++it) {
+    if (*it == connection) {
+      connections.erase(it);
+      return;
+    }
+  }
+}
+
+// An application taking fewer connections than configured leaves the rest
+// waiting in its backlog forever
+void FastCgiBackend::learnLimits(size_t applicationMaxConnections) {
+  if (limitsKnown)
+    return;
+  limitsKnown = true;
+  if (applicationMaxConnections > 0 && applicationMaxConnections < maxConnections) {
+    Logger::log(INFO, "FastCGI application " + address + " takes " + ParsingUtils::toString(applicationMaxConnections) + " connections");
+    maxConnections = applicationMaxConnections;
+  }
+  dispatch();
+}
+
+void FastCgiBackend::dispatch(void) {
+  while (!queue.empty()) {
+    FastCgiConnection* connection = pickConnection();
+    if (connection == NULL)
+      break;
+    FastCgiRequest* request = queue.front();
+    queue.pop_front();
+    connection->start(request);
+  }
+  // Nothing to wait for: the application can't even be connected to
+  if (!queue.empty() && connections.empty()) {
+    while (!queue.empty()) {
+      deliver(queue.front(), true);
+      queue.pop_front();
+    }
+  }
+}
+
+void FastCgiBackend::childExited(pid_t pid, int status) {
+  for (std::vector<Worker>::iterator it = workers.begin(); it != workers.end(); ++it) {
+    if (it->pid != pid)
+      continue;
+    Logger::log(WARNING, "FastCGI worker " + ParsingUtils::toString(pid) + " exited with status " + ParsingUtils::toString(status));
+    it->quickExits = nowMs() - it->startedMs < QUICK_EXIT_MS ? it->quickExits + 1 : 0;
+    if (it->quickExits >= MAX_QUICK_EXITS) {
+      Logger::log(ERROR, "FastCGI worker keeps exiting, not restarting it: " + command);
+      it->pid = -1;
+      // Connections waiting in the backlog are refused rather than left hanging
+      if (!hasLiveWorkers())
+        SystemUtils::closeUtil(listenFd);
+      return;
+    }
+    spawn(*it);
+    return;
+  }
+}
+
+// Idle connections first, then a new one, then sharing the least busy one
+FastCgiConnection* FastCgiBackend::pickConnection(void) {
+  FastCgiConnection* shared = NULL;
+  for (std::vector<FastCgiConnection*>::iterator it = connections.begin(); it != connections.end(); ++it) {
+    if (!(*it)->canStart())
+      continue;
+    if ((*it)->getLoad() == 0)
+      return *it;
+    if (shared == NULL || (*it)->getLoad() < shared->getLoad())
+      shared = *it;
+  }
+  if (connections.size() < (limitsKnown ? maxConnections : 1)) {
+    FastCgiConnection* opened = connect();
+    if (opened != NULL)
+      return opened;
+  }
+  return shared;
+}
+
+FastCgiConnection* FastCgiBackend::connect(void) {
+  int fd = socket(peer.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd == -1) {
+    Logger::log(ERROR, "Cannot create FastCGI socket: " + std::string(strerror(errno)));
+    return NULL;
+  }
+  if (::connect(fd, reinterpret_cast<struct sockaddr*>(&peer), peerLength) == -1 && errno != EINPROGRESS) {
+    Logger::log(ERROR, "Cannot connect to FastCGI application " + address + ": " + std::string(strerror(errno)));
+    SystemUtils::closeUtil(fd);
+    return NULL;
+  }
+  // Records are small and each one completes a write
+  if (peer.ss_family == AF_INET) {
+    int enable = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+  }
+  FastCgiConnection* connection = new FastCgiConnection(this, reactor, fd);
+  try {
+    // Writable once connected; FastCgiConnection drops EPOLLOUT after that
+    reactor->registerHandler(connection, EPOLLIN | EPOLLOUT);
+  } catch (const std::exception& e) {
+    Logger::log(ERROR, "Cannot register FastCGI connection: " + std::string(e.what()));
+    connection->detach();
+    delete connection;
+    return NULL;
+  }
+  connections.push_back(connection);
+  Logger::log(INFO, "Opened FastCGI connection to " + address);
+  return connection;
+}
+
+// "unix:/path" or "host:port", host being an IPv4 address or localhost
+bool FastCgiBackend::resolve(const std::string& target) {
+  if (target.compare(0, 5, "unix:") == 0) {
+    std::string path = target.substr(5);
+    struct sockaddr_un* unixPeer = reinterpret_cast<struct sockaddr_un*>(&peer);
+    if (path.empty() || path.size() >= sizeof(unixPeer->sun_path)) {
+      Logger::log(ERROR, "Invalid FastCGI socket path: " + path);
+      return false;
+    }
+    unixPeer->sun_family = AF_UNIX;
+    memcpy(unixPeer->sun_path, path.c_str(), path.size() + 1);
+    peerLength = sizeof(struct sockaddr_un);
+    return true;
+  }
+  size_t colon = target.rfind(':');
+  if (colon == std::string::npos) {
+    Logger::log(ERROR, "Invalid FastCGI address: " + target);
+    return false;
+  }
+  std::string host = target.substr(0, colon);
+  if (host == "localhost")
+    host = "127.0.0.1";
+  long port = std::strtol(target.c_str() + colon + 1, NULL, 10);
+  struct sockaddr_in* inetPeer = reinterpret_cast<struct sockaddr_in*>(&peer);
+  if (port <= 0 || port > 65535 || inet_pton(AF_INET, host.c_str(), &inetPeer->sin_addr) != 1) {
+    Logger::log(ERROR, "Invalid FastCGI address: " + target);
+    return false;
+  }
+  inetPeer->sin_family = AF_INET;
+  inetPeer->sin_port = htons(static_cast<uint16_t>(port));
+  peerLength = sizeof(struct sockaddr_in);
+  return true;
+}
+
+// The pool listens on a Unix socket of its own, which the workers accept on
+// as FCGI_LISTENSOCK_FILENO (their stdin), as FastCGI applications expect
+bool FastCgiBackend::startPool(size_t count) {
+  static unsigned int pools = 0;
+  socketPath = "/tmp/webserv-fastcgi." + ParsingUtils::toString(getpid()) + "." + ParsingUtils::toString(++pools) + ".sock";
+  if (!resolve("unix:" + socketPath))
+    return false;
+  unlink(socketPath.c_str());
+  listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listenFd == -1 || bind(listenFd, reinterpret_cast<struct sockaddr*>(&peer), peerLength) == -1
+      || listen(listenFd, 128) == -1) {
+    Logger::log(ERROR, "Cannot listen on " + socketPath + ": " + std::string(strerror(errno)));
+    SystemUtils::closeUtil(listenFd);
+    return false;
+  }
+  if (ServerManager::getInstance().getProcessReaper() == NULL)
+    Logger::log(WARNING, "No process reaper, FastCGI workers that exit are not restarted");
+  Worker worker;
+  worker.pid = -1;
+  worker.startedMs = 0;
+  worker.quickExits = 0;
+  workers.assign(count, worker);
+  for (std::vector<Worker>::iterator it = workers.begin(); it != workers.end(); ++it)
+    spawn(*it);
+  return hasLiveWorkers();
+}
+
+void FastCgiBackend::spawn(Worker& worker) {
+  pid_t pid = fork();
+  if (pid == -1) {
+    Logger::log(ERROR, "Cannot start FastCGI worker: " + std::string(strerror(errno)));
+    worker.pid = -1;
+    return;
+  }
+  if (pid == 0) {
+    ProcessReaper::restoreSignalMask();
+    // Workers go away with the server, however it ends
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+    dup2(listenFd, STDIN_FILENO);
+    // Client sockets must not stay open in a long-lived worker
+    long maxFd = sysconf(_SC_OPEN_MAX);
+    for (int fd = STDERR_FILENO + 1; fd < maxFd && fd < 65536; ++fd)
+      close(fd);
+    char* execArgs[2];
+    execArgs[0] = const_cast<char*>(command.c_str());
+    execArgs[1] = NULL;
+    execve(execArgs[0], execArgs, environ);
+    std::cerr << "Error executing FastCGI worker: " << strerror(errno) << std::endl;
+    _exit(EXIT_FAILURE);
+  }
+  worker.pid = pid;
+  worker.startedMs = nowMs();
+  ProcessReaper* reaper = ServerManager::getInstance().getProcessReaper();
+  if (reaper != NULL)
+    reaper->watch(pid, this);
+  Logger::log(INFO, "Started FastCGI worker " + ParsingUtils::toString(pid) + ": " + command);
+}
+
+bool FastCgiBackend::hasLiveWorkers(void) const {
+  for (std::vector<Worker>::const_iterator it = workers.begin(); it != workers.end(); ++it) {
+    if (it->pid > 0)
+      return true;
+  }
+  return false;
+}
+
+long FastCgiBackend::nowMs(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000L + now.tv_nsec / 1000000L;
+}
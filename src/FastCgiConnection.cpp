@@ -0,0 +1,255 @@
+#include "FastCgiConnection.hpp"
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <string.h>
+#include <cerrno>
+#include <cstdlib>
+#include <vector>
+#include "FastCgiBackend.hpp"
+#include "Reactor.hpp"
+#include "Logger.hpp"
+#include "ParsingUtils.hpp"
+#include "SystemUtils.hpp"
+
+namespace {
+  // Cap on requests sharing one connection, whatever the application claims
+  const size_t MAX_SHARED_REQUESTS = 16;
+}
+
+FastCgiRequest::FastCgiRequest() : listener(NULL), cacheTtlMs(0), cacheStaleMs(0), appStatus(0), retried(false) {}
+
+FastCgiConnection::FastCgiConnection(FastCgiBackend* backend, Reactor* reactor, int fd)
+  : backend(backend), reactor(reactor), connected(false), broken(false), multiplexes(false),
+    maxRequests(1), nextRequestId(1) {
+  EventHandler::setHandle(fd);
+  // Asks whether requests may share the connection. Applications that don't
+  // know the query answer UNKNOWN_TYPE and get one request at a time.
+  std::map<std::string, std::string> values;
+  values["FCGI_MPXS_CONNS"] = "";
+  values["FCGI_MAX_REQS"] = "";
+  values["FCGI_MAX_CONNS"] = "";
+  FastCgiRecord::appendPairs(writeBuffer, FastCgiRecord::GET_VALUES, 0, values);
+}
+
+// Only still running requests when deleted by the reactor on shutdown or by
+// a backend that is going away
+FastCgiConnection::~FastCgiConnection() {
+  if (backend != NULL)
+    backend->forget(this);
+  for (std::map<uint16_t, FastCgiRequest*>::iterator it = active.begin(); it != active.end(); ++it)
+    FastCgiBackend::deliver(it->second, true);
+  SystemUtils::closeUtil(EventHandler::getHandle());
+}
+
+size_t FastCgiConnection::getLoad(void) const {
+  return active.size();
+}
+
+bool FastCgiConnection::canStart(void) const {
+  if (broken)
+    return false;
+  return active.empty() || (multiplexes && active.size() < maxRequests);
+}
+
+void FastCgiConnection::start(FastCgiRequest* request) {
+  uint16_t requestId = allocateRequestId();
+  active[requestId] = request;
+  FastCgiRecord::appendBeginRequest(writeBuffer, requestId, true);
+  FastCgiRecord::appendPairs(writeBuffer, FastCgiRecord::PARAMS, requestId, request->params);
+  FastCgiRecord::appendStream(writeBuffer, FastCgiRecord::STDIN, requestId, request->body);
+  // A failed write is dealt with from handleEvent, not under the caller
+  if (connected && !flush())
+    broken = true;
+  updateInterest();
+}
+
+bool FastCgiConnection::abandon(CgiResponseListener* listener) {
+  bool found = false;
+  for (std::map<uint16_t, FastCgiRequest*>::iterator it = active.begin(); it != active.end(); ++it) {
+    if (it->second->listener != listener)
+      continue;
+    it->second->listener = NULL;
+    FastCgiRecord::append(writeBuffer, FastCgiRecord::ABORT_REQUEST, it->first, "", 0);
+    found = true;
+  }
+  // Sent once the socket takes it
+  updateInterest();
+  return found;
+}
+
+void FastCgiConnection::detach(void) {
+  backend = NULL;
+}
+
+void FastCgiConnection::handleEvent(uint32_t events) {
+  if (!connected && !broken && (events & (EPOLLOUT | EPOLLERR | EPOLLHUP)))
+    broken = !finishConnecting();
+  if (connected && !broken && (events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+    broken = !readRecords();
+  if (connected && !broken && !writeBuffer.empty())
+    broken = !flush();
+  if (broken)
+    closeConnection();
+  else
+    updateInterest();
+}
+
+void FastCgiConnection::updateInterest(void) {
+  // A broken connection is closed from handleEvent, which needs the event
+  if (!connected || !writeBuffer.empty() || broken)
+    reactor->enableEvents(EventHandler::getHandle(), EPOLLOUT);
+  else
+    reactor->disableEvents(EventHandler::getHandle(), EPOLLOUT);
+}
+
+// Requests still running are handed back to the backend, which retries the
+// ones the application never answered
+void FastCgiConnection::closeConnection(void) {
+  std::vector<FastCgiRequest*> orphaned;
+  for (std::map<uint16_t, FastCgiRequest*>::iterator it = active.begin(); it != active.end(); ++it)
+    orphaned.push_back(it->second);
+  active.clear();
+  reactor->deregisterHandler(EventHandler::getHandle());
+  FastCgiBackend* owner = backend;
+  delete this;
+  if (owner != NULL)
+    owner->connectionLost(orphaned);
+}
+
+bool FastCgiConnection::finishConnecting(void) {
+  int error = 0;
+  socklen_t length = sizeof(error);
+  if (getsockopt(EventHandler::getHandle(), SOL_SOCKET, SO_ERROR, &error, &length) == -1)
+    error = errno;
+  if (error != 0) {
+    Logger::log(ERROR, "Cannot connect to FastCGI application: " + std::string(strerror(error)));
+    return false;
+  }
+  connected = true;
+  return true;
+}
+
+bool FastCgiConnection::flush(void) {
+  while (!writeBuffer.empty()) {
+    ssize_t bytesSent = send(EventHandler::getHandle(), writeBuffer.data(), writeBuffer.size(), MSG_NOSIGNAL);
+    if (bytesSent > 0) {
+      writeBuffer.erase(0, bytesSent);
+      continue;
+    }
+    if (bytesSent == -1 && errno == EINTR)
+      continue;
+    if (bytesSent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      return true;
+    Logger::log(ERROR, "Error writing to FastCGI application: " + std::string(strerror(errno)));
+    return false;
+  }
+  return true;
+}
+
+// Returns false once the application closed the connection; records that
+// arrived before that are still handled
+bool FastCgiConnection::readRecords(void) {
+  bool open = true;
+  char buffer[16384];
+  while (true) {
+    ssize_t bytesRead = read(EventHandler::getHandle(), buffer, sizeof(buffer));
+    if (bytesRead > 0) {
+      readBuffer.append(buffer, bytesRead);
+      continue;
+    }
+    if (bytesRead == -1 && errno == EINTR)
+      continue;
+    if (bytesRead == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      break;
+    if (bytesRead == -1)
+      Logger::log(ERROR, "Error reading from FastCGI application: " + std::string(strerror(errno)));
+    open = false;
+    break;
+  }
+  size_t offset = 0;
+  FastCgiRecord record;
+  while (FastCgiRecord::parse(readBuffer, offset, record))
+    handleRecord(record);
+  readBuffer.erase(0, offset);
+  return open;
+}
+
+void FastCgiConnection::handleRecord(const FastCgiRecord& record) {
+  if (record.type == FastCgiRecord::STDOUT) {
+    std::map<uint16_t, FastCgiRequest*>::iterator it = active.find(record.requestId);
+    // Output of abandoned requests has nowhere to go
+    if (it != active.end() && (it->second->listener != NULL || !it->second->cacheKey.empty()))
+      it->second->output += record.content;
+  }
+  else if (record.type == FastCgiRecord::STDERR) {
+    if (!record.content.empty())
+      Logger::log(WARNING, "FastCGI application: " + record.content);
+  }
+  else if (record.type == FastCgiRecord::END_REQUEST) {
+    // Answering a request without the values means they won't come
+    if (backend != NULL)
+      backend->learnLimits(0);
+    endRequest(record.requestId, record.content);
+  }
+  else if (record.type == FastCgiRecord::GET_VALUES_RESULT)
+    handleValues(record.content);
+  else if (record.type == FastCgiRecord::UNKNOWN_TYPE && backend != NULL)
+    backend->learnLimits(0);
+}
+
+void FastCgiConnection::handleValues(const std::string& content) {
+  std::map<std::string, std::string> values;
+  if (!FastCgiRecord::decodePairs(content, values))
+    values.clear();
+  if (values["FCGI_MPXS_CONNS"] == "1") {
+    long maxReqs = std::strtol(values["FCGI_MAX_REQS"].c_str(), NULL, 10);
+    multiplexes = true;
+    maxRequests = maxReqs > 0 && static_cast<size_t>(maxReqs) < MAX_SHARED_REQUESTS ? maxReqs : MAX_SHARED_REQUESTS;
+    Logger::log(INFO, "FastCGI application multiplexes up to " + ParsingUtils::toString(maxRequests) + " requests per connection");
+  }
+  long maxConns = std::strtol(values["FCGI_MAX_CONNS"].c_str(), NULL, 10);
+  if (backend == NULL)
+    return;
+  backend->learnLimits(maxConns > 0 ? maxConns : 0);
+  // Queued requests may fit on this connection now
+  if (multiplexes)
+    backend->dispatch();
+}
+
+void FastCgiConnection::endRequest(uint16_t requestId, const std::string& content) {
+  std::map<uint16_t, FastCgiRequest*>::iterator it = active.find(requestId);
+  if (it == active.end())
+    return;
+  FastCgiRequest* request = it->second;
+  active.erase(it);
+  if (backend == NULL) {
+    delete request;
+    return;
+  }
+  uint32_t appStatus = 0;
+  uint8_t protocolStatus = FastCgiRecord::REQUEST_COMPLETE;
+  bool valid = FastCgiRecord::parseEndRequest(content, appStatus, protocolStatus);
+  request->appStatus = appStatus;
+  if (valid && protocolStatus == FastCgiRecord::CANT_MPX_CONN) {
+    // Claimed otherwise; back to one request at a time
+    multiplexes = false;
+    maxRequests = 1;
+    request->output.clear();
+    backend->retry(request);
+    return;
+  }
+  if (!valid || protocolStatus != FastCgiRecord::REQUEST_COMPLETE) {
+    Logger::log(WARNING, "FastCGI application rejected request with status " + ParsingUtils::toString(static_cast<int>(protocolStatus)));
+    backend->complete(request, true);
+    return;
+  }
+  backend->complete(request, false);
+}
+
+// Ids only have to be unique among the requests in flight on this connection
+uint16_t FastCgiConnection::allocateRequestId(void) {
+  while (nextRequestId == 0 || active.find(nextRequestId) != active.end())
+    ++nextRequestId;
+  return nextRequestId++;
+}
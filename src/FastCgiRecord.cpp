@@ -0,0 +1,127 @@
+#include "FastCgiRecord.hpp"
+
+namespace {
+  const uint8_t VERSION = 1;
+  const uint8_t ROLE_RESPONDER = 1;
+  const uint8_t FLAG_KEEP_CONN = 1;
+}
+
+// Content is padded to a multiple of 8, as the specification recommends
+void FastCgiRecord::append(std::string& out, uint8_t type, uint16_t requestId, const char* data, size_t length) {
+  do {
+    size_t chunk = length < MAX_CONTENT_LENGTH ? length : MAX_CONTENT_LENGTH;
+    size_t padding = (8 - chunk % 8) % 8;
+    char header[HEADER_LENGTH];
+    header[0] = VERSION;
+    header[1] = type;
+    header[2] = static_cast<char>(requestId >> 8);
+    header[3] = static_cast<char>(requestId & 0xff);
+    header[4] = static_cast<char>(chunk >> 8);
+    header[5] = static_cast<char>(chunk & 0xff);
+    header[6] = static_cast<char>(padding);
+    header[7] = 0;
+    out.append(header, HEADER_LENGTH);
+    out.append(data, chunk);
+    out.append(padding, '\0');
+    data += chunk;
+    length -= chunk;
+  } while (length > 0);
+}
+
+void FastCgiRecord::appendBeginRequest(std::string& out, uint16_t requestId, bool keepConnection) {
+  char body[8] = { 0, static_cast<char>(ROLE_RESPONDER), 0, 0, 0, 0, 0, 0 };
+  if (keepConnection)
+    body[2] = FLAG_KEEP_CONN;
+  append(out, BEGIN_REQUEST, requestId, body, sizeof(body));
+}
+
+void FastCgiRecord::appendPairs(std::string& out, uint8_t type, uint16_t requestId, const std::map<std::string, std::string>& pairs) {
+  std::string content;
+  for (std::map<std::string, std::string>::const_iterator it = pairs.begin(); it != pairs.end(); ++it)
+    encodePair(content, it->first, it->second);
+  if (!content.empty())
+    append(out, type, requestId, content.data(), content.size());
+  if (type == PARAMS)
+    append(out, type, requestId, "", 0);
+}
+
+void FastCgiRecord::appendStream(std::string& out, uint8_t type, uint16_t requestId, const std::string& data) {
+  if (!data.empty())
+    append(out, type, requestId, data.data(), data.size());
+  append(out, type, requestId, "", 0);
+}
+
+void FastCgiRecord::encodePair(std::string& out, const std::string& name, const std::string& value) {
+  encodeLength(out, name.size());
+  encodeLength(out, value.size());
+  out += name;
+  out += value;
+}
+
+// Lengths below 128 take one byte, longer ones four with the top bit set
+void FastCgiRecord::encodeLength(std::string& out, size_t length) {
+  if (length < 128) {
+    out += static_cast<char>(length);
+    return;
+  }
+  out += static_cast<char>(((length >> 24) & 0x7f) | 0x80);
+  out += static_cast<char>((length >> 16) & 0xff);
+  out += static_cast<char>((length >> 8) & 0xff);
+  out += static_cast<char>(length & 0xff);
+}
+
+bool FastCgiRecord::decodePairs(const std::string& content, std::map<std::string, std::string>& pairs) {
+  size_t offset = 0;
+  while (offset < content.size()) {
+    size_t lengths[2];
+    for (int i = 0; i < 2; ++i) {
+      if (offset >= content.size())
+        return false;
+      unsigned char first = content[offset];
+      if (!(first & 0x80)) {
+        lengths[i] = first;
+        offset += 1;
+        continue;
+      }
+      if (offset + 4 > content.size())
+        return false;
+      lengths[i] = (static_cast<size_t>(first & 0x7f) << 24)
+        | (static_cast<size_t>(static_cast<unsigned char>(content[offset + 1])) << 16)
+        | (static_cast<size_t>(static_cast<unsigned char>(content[offset + 2])) << 8)
+        | static_cast<size_t>(static_cast<unsigned char>(content[offset + 3]));
+      offset += 4;
+    }
+    if (lengths[0] > content.size() - offset || lengths[1] > content.size() - offset - lengths[0])
+      return false;
+    std::string name = content.substr(offset, lengths[0]);
+    offset += lengths[0];
+    pairs[name] = content.substr(offset, lengths[1]);
+    offset += lengths[1];
+  }
+  return true;
+}
+
+bool FastCgiRecord::parse(const std::string& buffer, size_t& offset, FastCgiRecord& record) {
+  if (buffer.size() - offset < HEADER_LENGTH)
+    return false;
+  const unsigned char* header = reinterpret_cast<const unsigned char*>(buffer.data() + offset);
+  size_t contentLength = (static_cast<size_t>(header[4]) << 8) | header[5];
+  size_t total = HEADER_LENGTH + contentLength + header[6];
+  if (buffer.size() - offset < total)
+    return false;
+  record.type = header[1];
+  record.requestId = static_cast<uint16_t>((header[2] << 8) | header[3]);
+  record.content.assign(buffer, offset + HEADER_LENGTH, contentLength);
+  offset += total;
+  return true;
+}
+
+bool FastCgiRecord::parseEndRequest(const std::string& content, uint32_t& appStatus, uint8_t& protocolStatus) {
+  if (content.size() < 8)
+    return false;
+  const unsigned char* body = reinterpret_cast<const unsigned char*>(content.data());
+  appStatus = (static_cast<uint32_t>(body[0]) << 24) | (static_cast<uint32_t>(body[1]) << 16)
+    | (static_cast<uint32_t>(body[2]) << 8) | body[3];
+  protocolStatus = body[4];
+  return true;
+}
@@ -0,0 +1,159 @@
+#include "FileInfoCache.hpp"
+#include <sys/stat.h>
+#include <cerrno>
+#include <cstring>
+
+bool FileInfo::exists(void) const {
+  return error == 0;
+}
+
+bool FileInfo::isDirectory(void) const {
+  return error == 0 && S_ISDIR(mode);
+}
+
+bool FileInfo::isRegularFile(void) const {
+  return error == 0 && S_ISREG(mode);
+}
+
+bool FileInfo::isReadable(void) const {
+  if (error != 0 || !(mode & S_IRUSR))
+    return false;
+  return !S_ISDIR(mode) || (mode & S_IXUSR);
+}
+
+bool FileInfo::isWritable(void) const {
+  return error == 0 && (mode & S_IWUSR);
+}
+
+FileInfoCache::FileInfoCache(size_t maxEntries, long ttlMs)
+  : maxEntries(maxEntries), ttlMs(ttlMs), useClock(0), hits(0), misses(0), watcher(NULL) {}
+
+FileInfoCache::~FileInfoCache() {}
+
+void FileInfoCache::setWatcher(FileWatcher* watcher) {
+  // Watches taken through the old watcher are given back to it
+  clear();
+  if (this->watcher != NULL)
+    this->watcher->removeListener(this);
+  this->watcher = watcher;
+  if (watcher != NULL)
+    watcher->addListener(this);
+}
+
+FileInfo FileInfoCache::lookup(const std::string& path) {
+  FileInfo info = find(path).info;
+  // stat("file/") fails, keep answering the way it would
+  if (path.length() > 1 && path[path.length() - 1] == '/' && info.exists() && !info.isDirectory()) {
+    std::memset(&info, 0, sizeof(info));
+    info.error = ENOTDIR;
+  }
+  return info;
+}
+
+const std::string& FileInfoCache::getMimeType(const std::string& path, const MimeTypes& types) {
+  Slot& slot = find(path);
+  if (slot.mimeTable != &types) {
+    slot.mimeTable = &types;
+    slot.mimeType = &types.getType(path);
+  }
+  return *slot.mimeType;
+}
+
+FileInfoCache::Slot& FileInfoCache::find(const std::string& path) {
+  std::string key = normalize(path);
+  std::map<std::string, Slot>::iterator it = entries.find(key);
+  if (it != entries.end()) {
+    if (it->second.expiresMs == 0 || nowMs() < it->second.expiresMs) {
+      ++hits;
+      it->second.lastUse = ++useClock;
+      return it->second;
+    }
+    erase(it);
+  }
+
+  ++misses;
+  if (entries.size() >= maxEntries)
+    evictOldest();
+  Slot slot;
+  std::memset(&slot.info, 0, sizeof(slot.info));
+  struct stat st;
+  if (stat(key.c_str(), &st) == 0) {
+    slot.info.mode = st.st_mode;
+    slot.info.size = st.st_size;
+    slot.info.mtime = st.st_mtim;
+    slot.info.device = st.st_dev;
+    slot.info.inode = st.st_ino;
+  }
+  else
+    slot.info.error = errno;
+  // Misses are watched too: creating the file is an event in its directory
+  if (watcher != NULL && watcher->watchParentOf(key))
+    slot.expiresMs = 0;
+  else
+    slot.expiresMs = nowMs() + ttlMs;
+  slot.lastUse = ++useClock;
+  slot.mimeTable = NULL;
+  slot.mimeType = NULL;
+  return entries.insert(std::make_pair(key, slot)).first->second;
+}
+
+void FileInfoCache::invalidate(const std::string& path) {
+  std::map<std::string, Slot>::iterator it = entries.find(normalize(path));
+  if (it != entries.end())
+    erase(it);
+}
+
+void FileInfoCache::clear(void) {
+  while (!entries.empty())
+    erase(entries.begin());
+}
+
+void FileInfoCache::fileChanged(const std::string& path, bool subtree) {
+  std::string key = normalize(path);
+  invalidate(key);
+  if (!subtree)
+    return;
+  std::string prefix = key == "/" ? key : key + "/";
+  std::map<std::string, Slot>::iterator it = entries.lower_bound(prefix);
+  while (it != entries.end() && it->first.compare(0, prefix.length(), prefix) == 0)
+    erase(it++);
+}
+
+unsigned long FileInfoCache::getHits(void) const {
+  return hits;
+}
+
+unsigned long FileInfoCache::getMisses(void) const {
+  return misses;
+}
+
+void FileInfoCache::evictOldest(void) {
+  std::map<std::string, Slot>::iterator oldest = entries.begin();
+  for (std::map<std::string, Slot>::iterator it = entries.begin(); it != entries.end(); ++it) {
+    if (it->second.lastUse < oldest->second.lastUse)
+      oldest = it;
+  }
+  if (oldest != entries.end())
+    erase(oldest);
+}
+
+// Gives back the watch reference a watched entry took
+void FileInfoCache::erase(std::map<std::string, Slot>::iterator it) {
+  if (it->second.expiresMs == 0 && watcher != NULL)
+    watcher->unwatchParentOf(it->first);
+  entries.erase(it);
+}
+
+// "/a/b/" and "/a/b" are the same entry, and the form inotify reports
+std::string FileInfoCache::normalize(const std::string& path) {
+  size_t end = path.length();
+  while (end > 1 && path[end - 1] == '/')
+    --end;
+  return path.substr(0, end);
+}
+
+long FileInfoCache::nowMs(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000L + now.tv_nsec / 1000000L;
+}
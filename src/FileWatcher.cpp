@@ -0,0 +1,153 @@
+#include "FileWatcher.hpp"
+#include <sys/inotify.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <string.h>
+#include <cerrno>
+#include "Logger.hpp"
+#include "SystemUtils.hpp"
+
+namespace {
+  const uint32_t watchMask = IN_ATTRIB | IN_CLOSE_WRITE | IN_MODIFY | IN_CREATE | IN_DELETE
+    | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+  std::string parentDirectory(const std::string& path) {
+    size_t end = path.length();
+    while (end > 1 && path[end - 1] == '/')
+      --end;
+    size_t slash = path.rfind('/', end - 1);
+    if (slash == std::string::npos)
+      return ".";
+    if (slash == 0)
+      return "/";
+    return path.substr(0, slash);
+  }
+
+  std::string trimSlashes(const std::string& path) {
+    size_t end = path.length();
+    while (end > 1 && path[end - 1] == '/')
+      --end;
+    return path.substr(0, end);
+  }
+}
+
+FileWatcher::FileWatcher() {
+  EventHandler::setHandle(inotify_init1(IN_NONBLOCK | IN_CLOEXEC));
+  if (EventHandler::getHandle() == -1)
+    Logger::log(WARNING, "inotify unavailable, caches fall back to revalidation: " + std::string(strerror(errno)));
+}
+
+FileWatcher::~FileWatcher() {
+  SystemUtils::closeUtil(EventHandler::getHandle());
+}
+
+bool FileWatcher::isActive(void) const {
+  return handle != -1;
+}
+
+bool FileWatcher::watchParentOf(const std::string& path) {
+  return watchDirectory(parentDirectory(path));
+}
+
+bool FileWatcher::watchDirectory(const std::string& path) {
+  if (!isActive())
+    return false;
+  std::string directory = trimSlashes(path);
+  std::map<std::string, int>::iterator known = watches.find(directory);
+  if (known != watches.end()) {
+    ++directories[known->second].references;
+    return true;
+  }
+  int wd = inotify_add_watch(EventHandler::getHandle(), directory.c_str(), watchMask);
+  if (wd == -1)
+    return false;
+  Watch& watch = directories[wd];
+  if (watch.paths.empty())
+    watch.references = 0;
+  watch.paths.push_back(directory);
+  ++watch.references;
+  watches[directory] = wd;
+  return true;
+}
+
+void FileWatcher::unwatchParentOf(const std::string& path) {
+  unwatchDirectory(parentDirectory(path));
+}
+
+void FileWatcher::unwatchDirectory(const std::string& path) {
+  std::map<std::string, int>::iterator known = watches.find(trimSlashes(path));
+  // Gone already if the kernel dropped it
+  if (known == watches.end())
+    return;
+  std::map<int, Watch>::iterator it = directories.find(known->second);
+  if (--it->second.references > 0)
+    return;
+  inotify_rm_watch(EventHandler::getHandle(), it->first);
+  removeWatch(it);
+}
+
+void FileWatcher::removeWatch(std::map<int, Watch>::iterator it) {
+  for (std::vector<std::string>::const_iterator path = it->second.paths.begin(); path != it->second.paths.end(); ++path)
+    watches.erase(*path);
+  directories.erase(it);
+}
+
+void FileWatcher::addListener(FileChangeListener* listener) {
+  listeners.push_back(listener);
+}
+
+void FileWatcher::removeListener(FileChangeListener* listener) {
+  for (std::vector<FileChangeListener*>::iterator it = listeners.begin(); it != listeners.end(); ++it) {
+    if (*it == listener) {
+      listeners.erase(it);
+      break;
+    }
+  }
+}
+
+void FileWatcher::handleEvent(uint32_t events) {
+  if (!(events & EPOLLIN))
+    return;
+  char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  ssize_t length;
+  while ((length = read(EventHandler::getHandle(), buffer, sizeof(buffer))) > 0) {
+    for (char* ptr = buffer; ptr < buffer + length; ) {
+      const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(ptr);
+      ptr += sizeof(struct inotify_event) + event->len;
+
+      if (event->mask & IN_Q_OVERFLOW) {
+        // Events were dropped, nothing cached can be trusted any more
+        Logger::log(WARNING, "inotify queue overflow, dropping cached file metadata");
+        notify("/", true);
+        continue;
+      }
+      std::map<int, Watch>::iterator it = directories.find(event->wd);
+      if (it == directories.end())
+        continue;
+      const std::string directory = it->second.paths.back();
+      if (event->mask & IN_IGNORED) {
+        // Directory removed or unmounted, the kernel dropped the watch
+        removeWatch(it);
+        notify(directory, true);
+        continue;
+      }
+      if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+        notify(directory, true);
+        continue;
+      }
+      if (event->len == 0)
+        continue;
+      std::string path = directory == "/" ? "/" + std::string(event->name) : directory + "/" + event->name;
+      notify(path, (event->mask & IN_ISDIR) && (event->mask & (IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO)));
+    }
+  }
+}
+
+void FileWatcher::notify(const std::string& path, bool subtree) {
+  for (std::vector<FileChangeListener*>::iterator it = listeners.begin(); it != listeners.end(); ++it)
+    (*it)->fileChanged(path, subtree);
+}
+
+void FileWatcher::closeConnection(void) {
+  SystemUtils::closeUtil(EventHandler::getHandle());
+}
@@ -19,6 +19,16 @@ bool HTTPRequestParser::parseRequestLine(const std::string& requestLine) {
   if (httpVersion != "HTTP/1.1")
     throw InvalidHTTPVersionException();
 
+  // Everything after this sees the path with its dot segments resolved, so
+  // none of them reaches a file outside the route's root
+  size_t queryPos = uri.find('?');
+  std::string path;
+  if (!ParsingUtils::normalizeUriPath(uri.substr(0, queryPos), path))
+    throw InvalidUriException();
+  if (queryPos != std::string::npos)
+    path += uri.substr(queryPos);
+  uri = path;
+
   if (method == "POST") {
     isPostRequest = true;
   }
@@ -40,7 +50,7 @@ bool HTTPRequestParser::isCompleteRequest() const {
 
     // For requests with a content length, check if the entire body has been received
     if (isContentLengthParsed) {
-        return requestData.size() >= contentLength;
+        return receivedBodyLength() >= contentLength;
     }
 
     // For requests without a content length (like GET), the request is complete
@@ -79,7 +89,7 @@ void HTTPRequestParser::appendData(const std::string& data) {
 
     // Process the body if headers are parsed and the content length header is present
     if (headersParsed && isContentLengthParsed) {
-        if (requestData.length() >= contentLength) {
+        if (receivedBodyLength() >= contentLength) {
             extractBody();  // Assuming this method extracts the body from requestData
         }
     }
@@ -105,6 +115,14 @@ bool HTTPRequestParser::parseHeaders() {
   return true;
 }
 
+// requestData still holds the headers in front of the body
+size_t HTTPRequestParser::receivedBodyLength() const {
+  size_t headersEnd = requestData.find("\r\n\r\n");
+  if (headersEnd == std::string::npos)
+    return 0;
+  return requestData.size() - headersEnd - 4;
+}
+
 void HTTPRequestParser::extractBody() {
   // The body starts after the headers (which ends with a blank line)
   size_t headersEnd = requestData.find("\r\n\r\n");
@@ -144,6 +162,17 @@ std::string HTTPRequestParser::getBody() const {
   return body;
 }
 
+size_t HTTPRequestParser::getContentLength() const {
+  return contentLength;
+}
+
+std::string HTTPRequestParser::getReceivedBody() const {
+  size_t headersEnd = requestData.find("\r\n\r\n");
+  if (headersEnd == std::string::npos)
+    return "";
+  return requestData.substr(headersEnd + 4, contentLength);
+}
+
 bool HTTPRequestParser::isRequestLineParsed() const {
   return requestLineParsed;
 }
@@ -3,11 +3,15 @@
 #include <sstream>
 #include <unistd.h>
 #include <string.h>
+#include <cstdio>
+#include <cerrno>
 #include "Logger.hpp"
+#include "ParsingUtils.hpp"
+#include "AccessLog.hpp"
 
 
 
-void HTTPResponse::sendErrorResponse(int errorCode, const Server* server, int client_fd) {
+std::string HTTPResponse::buildErrorResponse(int errorCode, const Server* server) {
   std::string errorPageContent;
   std::string errorMessage;
   if (server != NULL)
@@ -28,15 +32,27 @@ void HTTPResponse::sendErrorResponse(int errorCode, const Server* server, int cl
   responseStream << "Connection: close\r\n";
   responseStream << "\r\n";
   responseStream << errorPageContent;
+  return responseStream.str();
+}
 
-  std::string response = responseStream.str();
-  if (write(client_fd, response.c_str(), response.size()) <= 0)
+// A server's error pages are read and rendered once, floods of 404s reuse them
+void HTTPResponse::sendErrorResponse(int errorCode, const Server* server, OutputQueue& out) {
+  std::string uncached;
+  const std::string* response = server != NULL ? server->getCachedErrorResponse(errorCode) : NULL;
+  if (response == NULL && server != NULL)
+    response = &server->cacheErrorResponse(errorCode, buildErrorResponse(errorCode, server));
+  else if (response == NULL) {
+    uncached = buildErrorResponse(errorCode, NULL);
+    response = &uncached;
+  }
+  AccessLog::sending(out.getFd(), response->data(), response->size());
+  if (!out.write(*response))
     Logger::log(ERROR, "Error sending error response: " + std::string(strerror(errno)));
   return;
 }
 
 
-void HTTPResponse::sendRedirectResponse(const std::string& redirectLocation, int client_fd) {
+void HTTPResponse::sendRedirectResponse(const std::string& redirectLocation, OutputQueue& out) {
     std::ostringstream responseStream;
 
     // HTTP status code 302 for temporary redirection
@@ -53,13 +69,14 @@ void HTTPResponse::sendRedirectResponse(const std::string& redirectLocation, int
     responseStream << "\r\n";
 
     std::string response = responseStream.str();
-    if (write(client_fd, response.c_str(), response.size()) <= 0)
+    AccessLog::sending(out.getFd(), response.data(), response.size());
+    if (!out.write(response))
       Logger::log(ERROR, "Error sending redirect response: " + std::string(strerror(errno)));
     else
-      Logger::log(INFO, "Sent redirect response to: " + redirectLocation);
+      LOG(DEBUG, "Sent redirect response to: " + redirectLocation);
 }
 
-void HTTPResponse::sendSuccessResponse(const std::string& statusCode, const std::string& contentType, const std::string& content, Cookie cookie, int client_fd) {
+std::string HTTPResponse::buildSuccessResponse(const std::string& statusCode, const std::string& contentType, const std::string& content, Cookie cookie) {
 	std::ostringstream responseStream;
 
 	// Start building the HTTP response
@@ -70,7 +87,7 @@ void HTTPResponse::sendSuccessResponse(const std::string& statusCode, const std:
 	responseStream << "Content-Length: " << content.size() << "\r\n";
 	// Check if a cookie needs to be set
 	if (!cookie.getCookieName().empty()) {
-		Logger::log(INFO, "Setting cookie: " + cookie.getCookieString());
+		LOG(DEBUG, "Setting cookie: " + cookie.getCookieName());
 		responseStream << "Set-Cookie: " << cookie.getCookieString() << "\r\n";
 	}
 
@@ -86,26 +103,111 @@ void HTTPResponse::sendSuccessResponse(const std::string& statusCode, const std:
 	responseStream << content;
 
 	// Convert the stream to a string
-	std::string response = responseStream.str();
+	return responseStream.str();
+}
+
+void HTTPResponse::sendSuccessResponse(const std::string& statusCode, const std::string& contentType, const std::string& content, Cookie cookie, OutputQueue& out) {
+	std::string response = buildSuccessResponse(statusCode, contentType, content, cookie);
 
 	// Send the response to the client
-	if (write(client_fd, response.c_str(), response.size()) <= 0)
+	AccessLog::sending(out.getFd(), response.data(), response.size());
+	if (!out.write(response))
+		Logger::log(ERROR, "Error sending response: " + std::string(strerror(errno)));
+	else
+		LOG(DEBUG, "Sent response with status code: " + statusCode);
+}
+
+bool HTTPResponse::sendChunkedHeaders(const std::string& statusCode, const std::string& contentType, Cookie cookie, OutputQueue& out) {
+	std::ostringstream responseStream;
+	responseStream << "HTTP/1.1 " << statusCode << "\r\n";
+	responseStream << "Content-Type: " << contentType << "\r\n";
+	responseStream << "Transfer-Encoding: chunked\r\n";
+	if (!cookie.getCookieName().empty()) {
+		LOG(DEBUG, "Setting cookie: " + cookie.getCookieName());
+		responseStream << "Set-Cookie: " << cookie.getCookieString() << "\r\n";
+	}
+	responseStream << "Connection: close\r\n";
+	responseStream << "\r\n";
+
+	std::string headers = responseStream.str();
+	AccessLog::sending(out.getFd(), headers.data(), headers.size());
+	if (!out.write(headers)) {
+		Logger::log(ERROR, "Error sending chunked response headers: " + std::string(strerror(errno)));
+		return false;
+	}
+	return true;
+}
+
+void HTTPResponse::appendChunk(std::string& out, const char* data, size_t length) {
+	if (length == 0)
+		return; // a zero-length chunk would terminate the body
+	char sizeLine[32];
+	int sizeLength = snprintf(sizeLine, sizeof(sizeLine), "%lx\r\n", static_cast<unsigned long>(length));
+	out.append(sizeLine, sizeLength);
+	out.append(data, length);
+	out += "\r\n";
+}
+
+void HTTPResponse::appendLastChunk(std::string& out) {
+	out += "0\r\n\r\n";
+}
+
+void HTTPResponse::sendTemplateResponse(const std::string& statusCode, const std::string& contentType, const HtmlTemplate& page, const TemplateVariables& variables, Cookie cookie, OutputQueue& out) {
+	size_t bodyLength = page.renderedLength(variables);
+	std::ostringstream responseStream;
+	responseStream << "HTTP/1.1 " << statusCode << "\r\n";
+	responseStream << "Content-Type: " << contentType << "\r\n";
+	responseStream << "Content-Length: " << bodyLength << "\r\n";
+	if (!cookie.getCookieName().empty()) {
+		LOG(DEBUG, "Setting cookie: " + cookie.getCookieName());
+		responseStream << "Set-Cookie: " << cookie.getCookieString() << "\r\n";
+	}
+	responseStream << "Connection: close\r\n";
+	responseStream << "\r\n";
+	std::string headers = responseStream.str();
+
+	std::vector<struct iovec> iov;
+	struct iovec head;
+	head.iov_base = const_cast<char*>(headers.data());
+	head.iov_len = headers.size();
+	iov.push_back(head);
+	page.appendIovecs(variables, iov);
+	AccessLog::sending(out.getFd(), headers.data(), headers.size() + bodyLength);
+
+	if (!out.writev(&iov[0], iov.size()))
+		Logger::log(ERROR, "Error sending response: " + std::string(strerror(errno)));
+	else
+		LOG(DEBUG, "Sent response with status code: " + statusCode);
+}
+
+void HTTPResponse::sendFileResponse(const std::string& statusCode, const std::string& contentType, OpenFile* file, OpenFileCache& files, Cookie cookie, OutputQueue& out) {
+	std::ostringstream responseStream;
+	responseStream << "HTTP/1.1 " << statusCode << "\r\n";
+	responseStream << "Content-Type: " << contentType << "\r\n";
+	responseStream << "Content-Length: " << file->size << "\r\n";
+	if (!cookie.getCookieName().empty()) {
+		LOG(DEBUG, "Setting cookie: " + cookie.getCookieName());
+		responseStream << "Set-Cookie: " << cookie.getCookieString() << "\r\n";
+	}
+	responseStream << "Connection: close\r\n";
+	responseStream << "\r\n";
+	std::string headers = responseStream.str();
+
+	AccessLog::sending(out.getFd(), headers.data(), headers.size() + file->size);
+	out.write(headers);
+	if (!out.sendFile(file, files))
 		Logger::log(ERROR, "Error sending response: " + std::string(strerror(errno)));
 	else
-		Logger::log(INFO, "Sent response with status code: " + statusCode);
+		LOG(DEBUG, "Sent response with status code: " + statusCode);
 }
 
-std::string HTTPResponse::modifyHtmlContentForSession(const std::string& htmlContent, const SessionData* sessionData) {
-    std::string modifiedContent = htmlContent;
-    // Find a placeholder in your HTML where you want to insert session info
-    size_t placeholderPos = modifiedContent.find("[SESSION_INFO]");
-    if (placeholderPos != std::string::npos) {
-        std::stringstream sessionInfo;
-        sessionInfo << "Session ID: " << sessionData->getSessionId() << "<br>"
-                    << "Request count: " << sessionData->getRequestCount();
-        modifiedContent.replace(placeholderPos, std::string("[SESSION_INFO]").length(), sessionInfo.str());
-    }
-    return modifiedContent;
+void HTTPResponse::setSessionVariables(TemplateVariables& variables, const SessionData* sessionData) {
+	std::stringstream sessionInfo;
+	sessionInfo << "Session ID: " << sessionData->getSessionId() << "<br>"
+		<< "Request count: " << sessionData->getRequestCount();
+	variables["SESSION_INFO"] = sessionInfo.str();
+	variables["SESSION_ID"] = sessionData->getSessionId();
+	variables["REQUEST_COUNT"] = ParsingUtils::toString(sessionData->getRequestCount());
 }
 
 std::string HTTPResponse::setCookie(const std::string& cookieName, const std::string& cookieValue) {
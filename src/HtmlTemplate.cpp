@@ -0,0 +1,167 @@
+#include "HtmlTemplate.hpp"
+#include "Logger.hpp"
+#include "ParsingUtils.hpp"
+#include "FileInfoCache.hpp"
+#include <stdexcept>
+#include <cerrno>
+#include <string.h>
+#include <sys/stat.h>
+
+namespace {
+  const size_t MAX_PLACEHOLDER_LENGTH = 128;
+  const std::string INCLUDE_PREFIX = "INCLUDE:";
+
+  bool isVariableName(const std::string& name) {
+    if (name.empty())
+      return false;
+    for (size_t i = 0; i < name.size(); ++i) {
+      char c = name[i];
+      if (!((c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_'))
+        return false;
+    }
+    return true;
+  }
+
+  std::string directoryOf(const std::string& filePath) {
+    size_t slash = filePath.find_last_of('/');
+    if (slash == std::string::npos)
+      return "";
+    return filePath.substr(0, slash + 1);
+  }
+}
+
+HtmlTemplate::HtmlTemplate(const std::string& path) : path(path), placeholders(false) {}
+
+const std::string& HtmlTemplate::getPath(void) const {
+  return path;
+}
+
+bool HtmlTemplate::hasPlaceholders(void) const {
+  return placeholders;
+}
+
+void HtmlTemplate::compile(void) {
+  source.clear();
+  segments.clear();
+  dependencies.clear();
+  placeholders = false;
+  compileFile(path, 0);
+  Logger::log(INFO, "Compiled template " + path + " (" + ParsingUtils::toString(segments.size()) + " segments)");
+}
+
+void HtmlTemplate::compileFile(const std::string& filePath, int depth) {
+  struct stat st;
+  if (stat(filePath.c_str(), &st) != 0)
+    throw std::runtime_error("Error reading template " + filePath + ": " + std::string(strerror(errno)));
+  Dependency dependency;
+  dependency.path = filePath;
+  dependency.mtime = st.st_mtim;
+  dependencies.push_back(dependency);
+
+  size_t base = source.size();
+  source += ParsingUtils::readFile(filePath);
+  size_t end = source.size();
+
+  size_t textStart = base;
+  size_t pos = base;
+  while ((pos = source.find('[', pos)) != std::string::npos && pos < end) {
+    size_t close = source.find(']', pos + 1);
+    if (close == std::string::npos || close >= end || close - pos - 1 > MAX_PLACEHOLDER_LENGTH) {
+      ++pos;
+      continue;
+    }
+    std::string name = source.substr(pos + 1, close - pos - 1);
+    if (name.compare(0, INCLUDE_PREFIX.size(), INCLUDE_PREFIX) == 0) {
+      addText(textStart, pos - textStart);
+      std::string fragment = name.substr(INCLUDE_PREFIX.size());
+      if (depth >= MAX_INCLUDE_DEPTH || fragment.empty() || fragment.find("..") != std::string::npos) {
+        Logger::log(WARNING, "Ignoring include " + fragment + " in template " + filePath);
+      } else {
+        try {
+          compileFile(directoryOf(filePath) + fragment, depth + 1);
+        } catch (const std::exception& e) {
+          Logger::log(WARNING, "Template include failed: " + std::string(e.what()));
+        }
+      }
+      textStart = close + 1;
+    } else if (isVariableName(name)) {
+      addText(textStart, pos - textStart);
+      Segment segment;
+      segment.offset = pos;
+      segment.length = close - pos + 1;
+      segment.variable = name;
+      segments.push_back(segment);
+      placeholders = true;
+      textStart = close + 1;
+    }
+    pos = close + 1;
+  }
+  addText(textStart, end - textStart);
+}
+
+void HtmlTemplate::addText(size_t offset, size_t length) {
+  if (length == 0)
+    return;
+  // Grow the previous static slice when the two are contiguous in source
+  if (!segments.empty() && segments.back().variable.empty()
+      && segments.back().offset + segments.back().length == offset) {
+    segments.back().length += length;
+    return;
+  }
+  Segment segment;
+  segment.offset = offset;
+  segment.length = length;
+  segments.push_back(segment);
+}
+
+bool HtmlTemplate::isStale(FileInfoCache* files) const {
+  for (std::vector<Dependency>::const_iterator it = dependencies.begin(); it != dependencies.end(); ++it) {
+    if (files != NULL) {
+      FileInfo info = files->lookup(it->path);
+      if (!info.exists() || info.mtime.tv_sec != it->mtime.tv_sec || info.mtime.tv_nsec != it->mtime.tv_nsec)
+        return true;
+      continue;
+    }
+    struct stat st;
+    if (stat(it->path.c_str(), &st) != 0)
+      return true;
+    if (st.st_mtim.tv_sec != it->mtime.tv_sec || st.st_mtim.tv_nsec != it->mtime.tv_nsec)
+      return true;
+  }
+  return false;
+}
+
+const std::string* HtmlTemplate::lookup(const Segment& segment, const TemplateVariables& variables) const {
+  if (segment.variable.empty())
+    return NULL;
+  TemplateVariables::const_iterator it = variables.find(segment.variable);
+  if (it == variables.end())
+    return NULL;
+  return &it->second;
+}
+
+size_t HtmlTemplate::renderedLength(const TemplateVariables& variables) const {
+  size_t length = 0;
+  for (std::vector<Segment>::const_iterator it = segments.begin(); it != segments.end(); ++it) {
+    const std::string* value = lookup(*it, variables);
+    length += value ? value->size() : it->length;
+  }
+  return length;
+}
+
+void HtmlTemplate::appendIovecs(const TemplateVariables& variables, std::vector<struct iovec>& iov) const {
+  for (std::vector<Segment>::const_iterator it = segments.begin(); it != segments.end(); ++it) {
+    const std::string* value = lookup(*it, variables);
+    struct iovec slice;
+    if (value) {
+      if (value->empty())
+        continue;
+      slice.iov_base = const_cast<char*>(value->data());
+      slice.iov_len = value->size();
+    } else {
+      slice.iov_base = const_cast<char*>(source.data() + it->offset);
+      slice.iov_len = it->length;
+    }
+    iov.push_back(slice);
+  }
+}
@@ -0,0 +1,91 @@
+#include "ListenerFactory.hpp"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <string.h>
+#include <cerrno>
+#include "Logger.hpp"
+#include "ParsingUtils.hpp"
+#include "SystemUtils.hpp"
+
+ListenerOptions::ListenerOptions()
+  : backlog(511), deferAcceptSeconds(0), fastOpenQueue(0), noDelay(false),
+    receiveBuffer(0), sendBuffer(0), reusePort(false) {}
+
+bool ListenerOptions::operator==(const ListenerOptions& other) const {
+  return backlog == other.backlog && deferAcceptSeconds == other.deferAcceptSeconds
+    && fastOpenQueue == other.fastOpenQueue && noDelay == other.noDelay
+    && receiveBuffer == other.receiveBuffer && sendBuffer == other.sendBuffer
+    && reusePort == other.reusePort;
+}
+
+int ListenerFactory::createListener(const std::string& host, int port, const ListenerOptions& options) {
+  int server_fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (server_fd == -1) {
+    Logger::log(ERROR, "Error creating socket: " + std::string(strerror(errno)));
+    return -1;
+  }
+  sockaddr_in serv_addr = {};
+  serv_addr.sin_family = AF_INET;
+  serv_addr.sin_port = htons(port);
+  // Check if a specific host IP is configured
+  if (!host.empty())
+    serv_addr.sin_addr.s_addr = inet_addr(host.c_str());
+  else
+    serv_addr.sin_addr.s_addr = INADDR_ANY;
+
+  // Allow socket reuse
+  if (!setOption(server_fd, SOL_SOCKET, SO_REUSEADDR, 1, "SO_REUSEADDR")
+      || (options.reusePort && !setOption(server_fd, SOL_SOCKET, SO_REUSEPORT, 1, "SO_REUSEPORT"))) {
+    SystemUtils::closeUtil(server_fd);
+    return -1;
+  }
+
+  if (bind(server_fd, (struct sockaddr*)&serv_addr, sizeof(serv_addr)) == -1) {
+    Logger::log(ERROR, "Error binding socket to port " + ParsingUtils::toString(port) + ": " + std::string(strerror(errno)));
+    SystemUtils::closeUtil(server_fd);
+    return -1;
+  }
+
+  // Buffer sizes must be set before listen() to size the window scale
+  // offered to clients; the rest are best effort
+  tuneListener(server_fd, options);
+  if (listen(server_fd, options.backlog) == -1) {
+    Logger::log(ERROR, "Error listening on socket: " + std::string(strerror(errno)));
+    SystemUtils::closeUtil(server_fd);
+    return -1;
+  }
+  Logger::log(INFO, "Listening on port " + ParsingUtils::toString(port) + " with backlog " + ParsingUtils::toString(options.backlog));
+  return server_fd;
+}
+
+void ListenerFactory::tuneListener(int fd, const ListenerOptions& options) {
+  if (options.receiveBuffer > 0)
+    setOption(fd, SOL_SOCKET, SO_RCVBUF, options.receiveBuffer, "SO_RCVBUF");
+  if (options.sendBuffer > 0)
+    setOption(fd, SOL_SOCKET, SO_SNDBUF, options.sendBuffer, "SO_SNDBUF");
+  // Connections that send nothing never wake the AcceptHandler
+  setOption(fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, options.deferAcceptSeconds, "TCP_DEFER_ACCEPT");
+  if (options.fastOpenQueue > 0)
+    setOption(fd, IPPROTO_TCP, TCP_FASTOPEN, options.fastOpenQueue, "TCP_FASTOPEN");
+  // Calling listen() again on a listening socket only resizes its backlog
+  int listening = 0;
+  socklen_t length = sizeof(listening);
+  if (getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &length) == 0 && listening
+      && listen(fd, options.backlog) == -1)
+    Logger::log(WARNING, "Error resizing listen backlog: " + std::string(strerror(errno)));
+}
+
+void ListenerFactory::tuneAccepted(int fd, const ListenerOptions& options) {
+  if (options.noDelay)
+    setOption(fd, IPPROTO_TCP, TCP_NODELAY, 1, "TCP_NODELAY");
+}
+
+bool ListenerFactory::setOption(int fd, int level, int name, int value, const char* label) {
+  if (setsockopt(fd, level, name, &value, sizeof(value)) == -1) {
+    Logger::log(WARNING, "Error setting " + std::string(label) + ": " + std::string(strerror(errno)));
+    return false;
+  }
+  return true;
+}
@@ -1,30 +1,83 @@
 #include "../inc/Logger.hpp"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
 #include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
 
 Logger::Logger() {
   std::string filename = generateLogFilename();
-  logFile.open(filename.c_str(), std::ios::app);
-  if(!logFile) {
+  logFd = open(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (logFd == -1) {
     std::cerr << "Error opening log file: " << filename << std::endl;
   }
 }
 
 Logger::~Logger() {
-  if (logFile)
-    logFile.close();
+  flush();
+  if (logFd != -1)
+    close(logFd);
+  logFd = -1;
 }
 
 void Logger::log(Level level, const std::string& message) {
-  if (logFile)
-    logFile << getCurrentTime() << " " << getLevelString(level) << ": " << message << std::endl;
-  std::cerr << getCurrentTime() <<  " " << getLevelString(level) << ": " << message << std::endl;
+  if (!isEnabled(level))
+    return;
+  // Whatever is still buffered when the process exits
+  if (!flushAtExit) {
+    flushAtExit = true;
+    std::atexit(flush);
+  }
+  std::string line = getCurrentTime() + " " + getLevelString(level) + ": " + message + "\n";
+  append(line.data(), line.size());
+  if (level == WARNING || level == ERROR)
+    flush();
+}
+
+void Logger::setLevel(Level level) {
+  minimum = level;
+}
+
+Level Logger::getLevel(void) {
+  return minimum;
+}
+
+bool Logger::parseLevel(const std::string& name, Level& level) {
+  if (name == "debug")
+    level = DEBUG;
+  else if (name == "info")
+    level = INFO;
+  else if (name == "warning")
+    level = WARNING;
+  else if (name == "error")
+    level = ERROR;
+  else
+    return false;
+  return true;
+}
+
+void Logger::flush(void) {
+  if (buffered == 0)
+    return;
+  writeAll(STDERR_FILENO, buffer, buffered);
+  if (logFd != -1)
+    writeAll(logFd, buffer, buffered);
+  buffered = 0;
 }
 
+// Formatted once a second; every line logged within it shares the string
 std::string Logger::getCurrentTime() {
+  static std::time_t cachedSecond = -1;
+  static char cached[32];
   std::time_t now = std::time(NULL);
-  char buf[100] = {0};
-  std::strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", std::localtime(&now));
-  return buf;
+  if (now != cachedSecond) {
+    struct tm local;
+    localtime_r(&now, &local);
+    std::strftime(cached, sizeof(cached), "%Y-%m-%d %H:%M:%S", &local);
+    cachedSecond = now;
+  }
+  return cached;
 }
 
 std::string Logger::generateLogFilename() {
@@ -49,4 +102,34 @@ std::string Logger::getLevelString(Level level) {
 	}
 }
 
-std::ofstream Logger::logFile;
+void Logger::append(const char* data, size_t size) {
+  if (buffered + size > BUFFER_SIZE)
+    flush();
+  if (size > BUFFER_SIZE) {
+    writeAll(STDERR_FILENO, data, size);
+    if (logFd != -1)
+      writeAll(logFd, data, size);
+    return;
+  }
+  std::memcpy(buffer + buffered, data, size);
+  buffered += size;
+}
+
+// Logging never fails a request: what cannot be written is dropped
+void Logger::writeAll(int fd, const char* data, size_t size) {
+  while (size > 0) {
+    ssize_t written = write(fd, data, size);
+    if (written == -1 && errno == EINTR)
+      continue;
+    if (written <= 0)
+      return;
+    data += written;
+    size -= written;
+  }
+}
+
+Level Logger::minimum = INFO;
+int Logger::logFd = -1;
+char Logger::buffer[Logger::BUFFER_SIZE];
+size_t Logger::buffered = 0;
+bool Logger::flushAtExit = false;
@@ -0,0 +1,143 @@
+#include "MimeTypes.hpp"
+#include <algorithm>
+#include <cstring>
+#include <cctype>
+
+namespace {
+  struct BuiltinType {
+    const char* extension;
+    const char* type;
+  };
+
+  // Kept sorted by extension
+  const BuiltinType BUILTIN_TYPES[] = {
+    { "7z", "application/x-7z-compressed" },
+    { "avif", "image/avif" },
+    { "bin", "application/octet-stream" },
+    { "bmp", "image/bmp" },
+    { "css", "text/css" },
+    { "csv", "text/csv" },
+    { "doc", "application/msword" },
+    { "eot", "application/vnd.ms-fontobject" },
+    { "epub", "application/epub+zip" },
+    { "gif", "image/gif" },
+    { "gz", "application/gzip" },
+    { "htm", "text/html" },
+    { "html", "text/html" },
+    { "ico", "image/x-icon" },
+    { "ics", "text/calendar" },
+    { "jar", "application/java-archive" },
+    { "jpeg", "image/jpeg" },
+    { "jpg", "image/jpeg" },
+    { "js", "application/javascript" },
+    { "json", "application/json" },
+    { "jsonld", "application/ld+json" },
+    { "m4a", "audio/mp4" },
+    { "md", "text/markdown" },
+    { "mid", "audio/midi" },
+    { "midi", "audio/midi" },
+    { "mjs", "application/javascript" },
+    { "mov", "video/quicktime" },
+    { "mp3", "audio/mpeg" },
+    { "mp4", "video/mp4" },
+    { "mpeg", "video/mpeg" },
+    { "oga", "audio/ogg" },
+    { "ogg", "audio/ogg" },
+    { "ogv", "video/ogg" },
+    { "otf", "font/otf" },
+    { "pdf", "application/pdf" },
+    { "png", "image/png" },
+    { "rar", "application/vnd.rar" },
+    { "rtf", "application/rtf" },
+    { "svg", "image/svg+xml" },
+    { "tar", "application/x-tar" },
+    { "tif", "image/tiff" },
+    { "tiff", "image/tiff" },
+    { "ttf", "font/ttf" },
+    { "txt", "text/plain" },
+    { "wasm", "application/wasm" },
+    { "wav", "audio/wav" },
+    { "weba", "audio/webm" },
+    { "webm", "video/webm" },
+    { "webmanifest", "application/manifest+json" },
+    { "webp", "image/webp" },
+    { "woff", "font/woff" },
+    { "woff2", "font/woff2" },
+    { "xhtml", "application/xhtml+xml" },
+    { "xml", "application/xml" },
+    { "zip", "application/zip" }
+  };
+}
+
+const std::string MimeTypes::DEFAULT_TYPE = "application/octet-stream";
+
+MimeTypes::MimeTypes() {
+  size_t count = sizeof(BUILTIN_TYPES) / sizeof(BUILTIN_TYPES[0]);
+  entries.resize(count);
+  for (size_t i = 0; i < count; ++i) {
+    std::strncpy(entries[i].extension, BUILTIN_TYPES[i].extension, MAX_EXTENSION);
+    entries[i].extension[MAX_EXTENSION] = '\0';
+    entries[i].type = BUILTIN_TYPES[i].type;
+  }
+  // Cheap insurance against a mis-sorted edit of the table above
+  std::sort(entries.begin(), entries.end(), entryLess);
+}
+
+const MimeTypes& MimeTypes::builtin() {
+  static const MimeTypes table;
+  return table;
+}
+
+bool MimeTypes::entryLess(const Entry& a, const Entry& b) {
+  return std::strcmp(a.extension, b.extension) < 0;
+}
+
+// Copies the lowercase extension of the last path component into out
+bool MimeTypes::lowerExtension(const std::string& filePath, char* out) {
+  size_t dotPos = filePath.find_last_of("./");
+  if (dotPos == std::string::npos || filePath[dotPos] != '.')
+    return false;
+  size_t length = filePath.size() - dotPos - 1;
+  if (length == 0 || length > MAX_EXTENSION)
+    return false;
+  for (size_t i = 0; i < length; ++i)
+    out[i] = static_cast<char>(std::tolower(static_cast<unsigned char>(filePath[dotPos + 1 + i])));
+  out[length] = '\0';
+  return true;
+}
+
+void MimeTypes::setType(const std::string& extension, const std::string& type) {
+  Entry entry;
+  std::string ext = (!extension.empty() && extension[0] == '.') ? extension : "." + extension;
+  if (!lowerExtension(ext, entry.extension))
+    return;
+  entry.type = type;
+  std::vector<Entry>::iterator it = std::lower_bound(entries.begin(), entries.end(), entry, entryLess);
+  if (it != entries.end() && std::strcmp(it->extension, entry.extension) == 0)
+    it->type = type;
+  else
+    entries.insert(it, entry);
+}
+
+const std::string& MimeTypes::getType(const std::string& filePath) const {
+  char extension[MAX_EXTENSION + 1];
+  if (!lowerExtension(filePath, extension))
+    return DEFAULT_TYPE;
+  size_t low = 0;
+  size_t high = entries.size();
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    int cmp = std::strcmp(entries[mid].extension, extension);
+    if (cmp == 0)
+      return entries[mid].type;
+    if (cmp < 0)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  return DEFAULT_TYPE;
+}
+
+size_t MimeTypes::size() const {
+  return entries.size();
+}
@@ -0,0 +1,135 @@
+#include "NegativeLookupCache.hpp"
+#include <ctime>
+#include <algorithm>
+
+NegativeLookupCache::NegativeLookupCache(size_t maxEntries, long ttlMs)
+  : maxEntries(maxEntries), ttlMs(ttlMs), watcher(NULL), bloom(BLOOM_BITS / 32, 0), bloomInsertions(0) {}
+
+NegativeLookupCache::~NegativeLookupCache() {}
+
+void NegativeLookupCache::setWatcher(FileWatcher* watcher) {
+  if (this->watcher != NULL)
+    this->watcher->removeListener(this);
+  this->watcher = watcher;
+  if (watcher != NULL)
+    watcher->addListener(this);
+  clear();
+}
+
+bool NegativeLookupCache::isKnownMiss(const std::string& root, const std::string& path) {
+  if (!bloomMayContain(path))
+    return false;
+  std::map<std::string, Entry>::iterator it = entries.find(path);
+  if (it == entries.end())
+    return false;
+  const Entry& entry = it->second;
+  if (entry.root == root && entry.generation == rootGenerations[root]
+      && (entry.expiresMs == 0 || nowMs() < entry.expiresMs)) {
+    recency.splice(recency.end(), recency, entry.use);
+    return true;
+  }
+  // Stale: the bit stays set in the filter until the next rebuild
+  erase(it);
+  return false;
+}
+
+void NegativeLookupCache::recordMiss(const std::string& root, const std::string& path, const std::string& resolvedPath) {
+  if (entries.find(path) != entries.end())
+    return;
+  while (entries.size() >= maxEntries && !recency.empty())
+    erase(entries.find(recency.front()));
+  Entry entry;
+  entry.root = root;
+  entry.generation = rootGenerations[root];
+  entry.expiresMs = watchNearestDirectory(root, resolvedPath) ? 0 : nowMs() + ttlMs;
+  entry.use = recency.insert(recency.end(), path);
+  entries[path] = entry;
+  // Rebuild before stale bits push the false positive rate up
+  if (++bloomInsertions > maxEntries * 2)
+    rebuildBloom();
+  bloomAdd(path);
+}
+
+void NegativeLookupCache::clear(void) {
+  entries.clear();
+  recency.clear();
+  rebuildBloom();
+}
+
+void NegativeLookupCache::erase(std::map<std::string, Entry>::iterator it) {
+  recency.erase(it->second.use);
+  entries.erase(it);
+}
+
+// Anything appearing, disappearing or moving below a root may turn one of
+// its misses into a hit, so the whole root is invalidated at once
+void NegativeLookupCache::fileChanged(const std::string& path, bool /*subtree*/) {
+  for (std::map<std::string, unsigned long>::iterator it = rootGenerations.begin(); it != rootGenerations.end(); ++it) {
+    const std::string& root = it->first;
+    if (path.compare(0, root.length(), root) == 0 || root.compare(0, path.length(), path) == 0)
+      ++it->second;
+  }
+}
+
+// The path's directory may not exist either ("/root/wp-admin/x.php"), so the
+// nearest ancestor that does is watched: creating the missing directory is
+// an event there
+bool NegativeLookupCache::watchNearestDirectory(const std::string& root, const std::string& path) {
+  if (watcher == NULL)
+    return false;
+  std::string current = path;
+  while (current.length() >= root.length()) {
+    if (watcher->watchParentOf(current))
+      return true;
+    size_t slash = current.rfind('/', current.length() - 2);
+    if (slash == std::string::npos)
+      break;
+    current.erase(slash + 1);
+  }
+  return false;
+}
+
+bool NegativeLookupCache::bloomMayContain(const std::string& path) const {
+  uint32_t h1, h2;
+  hash(path, h1, h2);
+  for (uint32_t i = 0; i < BLOOM_HASHES; ++i) {
+    uint32_t bit = (h1 + i * h2) % BLOOM_BITS;
+    if (!(bloom[bit / 32] & (1u << (bit % 32))))
+      return false;
+  }
+  return true;
+}
+
+void NegativeLookupCache::bloomAdd(const std::string& path) {
+  uint32_t h1, h2;
+  hash(path, h1, h2);
+  for (uint32_t i = 0; i < BLOOM_HASHES; ++i) {
+    uint32_t bit = (h1 + i * h2) % BLOOM_BITS;
+    bloom[bit / 32] |= 1u << (bit % 32);
+  }
+}
+
+void NegativeLookupCache::rebuildBloom(void) {
+  std::fill(bloom.begin(), bloom.end(), 0);
+  bloomInsertions = entries.size();
+  for (std::map<std::string, Entry>::const_iterator it = entries.begin(); it != entries.end(); ++it)
+    bloomAdd(it->first);
+}
+
+// Two FNV-1a variants combined as h1 + i * h2 give the filter's k indexes
+void NegativeLookupCache::hash(const std::string& path, uint32_t& h1, uint32_t& h2) {
+  h1 = 2166136261u;
+  h2 = 0x9e3779b9u;
+  for (size_t i = 0; i < path.length(); ++i) {
+    unsigned char c = static_cast<unsigned char>(path[i]);
+    h1 = (h1 ^ c) * 16777619u;
+    h2 = (h2 ^ c) * 0x01000193u + (h2 >> 15);
+  }
+  h2 |= 1; // odd, so the k probes differ
+}
+
+long NegativeLookupCache::nowMs(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000L + now.tv_nsec / 1000000L;
+}
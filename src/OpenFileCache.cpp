@@ -0,0 +1,129 @@
+#include "OpenFileCache.hpp"
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include "Logger.hpp"
+#include "SystemUtils.hpp"
+
+OpenFileCache::OpenFileCache(size_t maxFiles, long ttlMs)
+  : maxFiles(maxFiles), ttlMs(ttlMs), useClock(0), watcher(NULL) {}
+
+OpenFileCache::~OpenFileCache() {
+  clear();
+}
+
+void OpenFileCache::setWatcher(FileWatcher* watcher) {
+  if (this->watcher != NULL)
+    this->watcher->removeListener(this);
+  this->watcher = watcher;
+  if (watcher != NULL)
+    watcher->addListener(this);
+  clear();
+}
+
+OpenFile* OpenFileCache::acquire(const std::string& path) {
+  std::map<std::string, Slot>::iterator it = entries.find(path);
+  if (it != entries.end()) {
+    if (it->second.expiresMs == 0 || nowMs() < it->second.expiresMs) {
+      it->second.lastUse = ++useClock;
+      if (it->second.file == NULL) {
+        errno = it->second.error;
+        return NULL;
+      }
+      ++it->second.file->refCount;
+      return it->second.file;
+    }
+    drop(it);
+  }
+
+  if (entries.size() >= maxFiles)
+    evictOldest();
+  Slot slot;
+  slot.file = NULL;
+  slot.error = 0;
+  slot.lastUse = ++useClock;
+  // O_CLOEXEC: CGI children must not inherit the cached descriptors
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  struct stat st;
+  if (fd == -1 || fstat(fd, &st) == -1)
+    slot.error = errno;
+  else if (!S_ISREG(st.st_mode))
+    slot.error = EISDIR;
+  if (slot.error != 0)
+    SystemUtils::closeUtil(fd);
+  else {
+    slot.file = new OpenFile();
+    slot.file->fd = fd;
+    slot.file->size = st.st_size;
+    slot.file->mtime = st.st_mtim;
+    // One reference for the cache, one for the caller
+    slot.file->refCount = 2;
+    slot.file->detached = false;
+  }
+  // Failures are only trusted briefly, even when the directory is watched
+  if (slot.file != NULL && watcher != NULL && watcher->watchParentOf(path))
+    slot.expiresMs = 0;
+  else
+    slot.expiresMs = nowMs() + ttlMs;
+  entries[path] = slot;
+  if (slot.file == NULL)
+    errno = slot.error;
+  return slot.file;
+}
+
+void OpenFileCache::release(OpenFile* file) {
+  if (file == NULL || --file->refCount > 0)
+    return;
+  if (file->detached) {
+    SystemUtils::closeUtil(file->fd);
+    delete file;
+  }
+}
+
+void OpenFileCache::invalidate(const std::string& path) {
+  std::map<std::string, Slot>::iterator it = entries.find(path);
+  if (it != entries.end())
+    drop(it);
+}
+
+void OpenFileCache::clear(void) {
+  while (!entries.empty())
+    drop(entries.begin());
+}
+
+void OpenFileCache::fileChanged(const std::string& path, bool subtree) {
+  invalidate(path);
+  if (!subtree)
+    return;
+  std::string prefix = path == "/" ? path : path + "/";
+  std::map<std::string, Slot>::iterator it = entries.lower_bound(prefix);
+  while (it != entries.end() && it->first.compare(0, prefix.length(), prefix) == 0)
+    drop(it++);
+}
+
+// The cache lets go of its reference; in-flight responses keep theirs
+void OpenFileCache::drop(std::map<std::string, Slot>::iterator it) {
+  OpenFile* file = it->second.file;
+  entries.erase(it);
+  if (file == NULL)
+    return;
+  file->detached = true;
+  release(file);
+}
+
+void OpenFileCache::evictOldest(void) {
+  std::map<std::string, Slot>::iterator oldest = entries.begin();
+  for (std::map<std::string, Slot>::iterator it = entries.begin(); it != entries.end(); ++it) {
+    if (it->second.lastUse < oldest->second.lastUse)
+      oldest = it;
+  }
+  if (oldest != entries.end())
+    drop(oldest);
+}
+
+long OpenFileCache::nowMs(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000L + now.tv_nsec / 1000000L;
+}
@@ -0,0 +1,240 @@
+#include "OutputQueue.hpp"
+#include <sys/socket.h>
+#include <sys/sendfile.h>
+#include <unistd.h>
+#include <cerrno>
+#include <climits>
+#include <string.h>
+
+OutputQueue::Segment::Segment() : sent(0), file(NULL), files(NULL), offset(0), source(NULL) {}
+
+OutputQueue::OutputQueue() : fd(-1), failed(false) {}
+
+OutputQueue::~OutputQueue() {
+  clear();
+}
+
+void OutputQueue::setFd(int fd) {
+  this->fd = fd;
+}
+
+int OutputQueue::getFd(void) const {
+  return fd;
+}
+
+bool OutputQueue::isPending(void) const {
+  return !segments.empty();
+}
+
+bool OutputQueue::hasFailed(void) const {
+  return failed;
+}
+
+void OutputQueue::clear(void) {
+  while (!segments.empty())
+    popFront();
+}
+
+bool OutputQueue::write(const std::string& data) {
+  return write(data.data(), data.size());
+}
+
+bool OutputQueue::write(const char* data, size_t length) {
+  if (failed)
+    return false;
+  // Behind queued output it has to wait its turn
+  if (!segments.empty()) {
+    queue(data, length);
+    return true;
+  }
+  while (length > 0) {
+    ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+    if (sent > 0) {
+      data += sent;
+      length -= sent;
+      continue;
+    }
+    if (sent == -1 && errno == EINTR)
+      continue;
+    if (sent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      break;
+    return fail();
+  }
+  queue(data, length);
+  return true;
+}
+
+bool OutputQueue::writev(const struct iovec* iov, size_t count) {
+  if (failed)
+    return false;
+  size_t skip = 0; // of iov[0], already written
+  while (segments.empty() && count > 0) {
+    struct iovec slices[IOV_MAX];
+    size_t n = count > IOV_MAX ? IOV_MAX : count;
+    for (size_t i = 0; i < n; ++i)
+      slices[i] = iov[i];
+    slices[0].iov_base = static_cast<char*>(slices[0].iov_base) + skip;
+    slices[0].iov_len -= skip;
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = slices;
+    message.msg_iovlen = n;
+    ssize_t sent = sendmsg(fd, &message, MSG_NOSIGNAL);
+    if (sent == -1 && errno == EINTR)
+      continue;
+    if (sent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      break;
+    if (sent == -1)
+      return fail();
+    size_t written = skip + sent;
+    while (count > 0 && written >= iov->iov_len) {
+      written -= iov->iov_len;
+      ++iov;
+      --count;
+    }
+    skip = written;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    queue(static_cast<const char*>(iov[i].iov_base) + skip, iov[i].iov_len - skip);
+    skip = 0;
+  }
+  return true;
+}
+
+bool OutputQueue::sendFile(OpenFile* file, OpenFileCache& files) {
+  if (failed) {
+    files.release(file);
+    return false;
+  }
+  segments.push_back(Segment());
+  segments.back().file = file;
+  segments.back().files = &files;
+  if (segments.size() > 1)
+    return true;
+  return flush();
+}
+
+bool OutputQueue::stream(OutputSource* source) {
+  if (failed) {
+    delete source;
+    return false;
+  }
+  segments.push_back(Segment());
+  segments.back().source = source;
+  if (segments.size() > 1)
+    return true;
+  return flush();
+}
+
+bool OutputQueue::flush(void) {
+  while (!segments.empty() && !failed) {
+    Segment& segment = segments.front();
+    bool done;
+    if (segment.file != NULL)
+      done = sendFileData(segment);
+    else if (segment.source != NULL)
+      done = sendSourceData(segment);
+    else
+      done = sendData(segment);
+    if (failed)
+      break;
+    if (!done)
+      return true; // the socket is full
+    popFront();
+  }
+  return !failed;
+}
+
+// True once the segment is out, false while the socket is full
+bool OutputQueue::sendData(Segment& segment) {
+  while (segment.sent < segment.data.size()) {
+    ssize_t sent = send(fd, segment.data.data() + segment.sent, segment.data.size() - segment.sent, MSG_NOSIGNAL);
+    if (sent > 0) {
+      segment.sent += sent;
+      continue;
+    }
+    if (sent == -1 && errno == EINTR)
+      continue;
+    if (sent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      return false;
+    return fail();
+  }
+  return true;
+}
+
+bool OutputQueue::sendFileData(Segment& segment) {
+  off_t end = segment.file->size;
+  while (segment.offset < end) {
+    ssize_t sent = sendfile(fd, segment.file->fd, &segment.offset, end - segment.offset);
+    if (sent > 0)
+      continue;
+    if (sent == 0)
+      return fail(); // the file shrank under us, Content-Length can't be met
+    if (errno == EINTR)
+      continue;
+    if (errno == EAGAIN || errno == EWOULDBLOCK)
+      return false;
+    if (errno != EINVAL && errno != ENOSYS)
+      return fail();
+    // sendfile not supported for this pair of descriptors: what the socket
+    // doesn't take is read again next time
+    char buffer[16384];
+    size_t chunk = static_cast<size_t>(end - segment.offset) < sizeof(buffer) ? end - segment.offset : sizeof(buffer);
+    ssize_t bytesRead = pread(segment.file->fd, buffer, chunk, segment.offset);
+    if (bytesRead == -1 && errno == EINTR)
+      continue;
+    if (bytesRead <= 0)
+      return fail();
+    sent = send(fd, buffer, bytesRead, MSG_NOSIGNAL);
+    if (sent > 0)
+      segment.offset += sent;
+    else if (sent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      return false;
+    else if (sent == -1 && errno != EINTR)
+      return fail();
+  }
+  return true;
+}
+
+// A piece is produced only once the last one is out, so a large body never
+// sits in memory whole
+bool OutputQueue::sendSourceData(Segment& segment) {
+  while (sendData(segment)) {
+    segment.data.clear();
+    segment.sent = 0;
+    if (!segment.source->produce(segment.data)) {
+      // The last piece goes out as plain data
+      delete segment.source;
+      segment.source = NULL;
+      return sendData(segment);
+    }
+  }
+  return false;
+}
+
+void OutputQueue::popFront(void) {
+  Segment& segment = segments.front();
+  if (segment.file != NULL)
+    segment.files->release(segment.file);
+  delete segment.source;
+  segments.pop_front();
+}
+
+// Appended to the last piece while it has not started going out, so a
+// response written in many small parts does not become as many sends
+void OutputQueue::queue(const char* data, size_t length) {
+  if (length == 0)
+    return;
+  if (segments.empty() || segments.back().sent > 0 || segments.back().file != NULL || segments.back().source != NULL)
+    segments.push_back(Segment());
+  segments.back().data.append(data, length);
+}
+
+// errno is left as the send set it, for the caller to report
+bool OutputQueue::fail(void) {
+  int error = errno;
+  failed = true;
+  clear();
+  errno = error;
+  return false;
+}
@@ -11,6 +11,7 @@
 #include "Logger.hpp"
 #include <string.h>
 #include <unistd.h>
+#include <cstdio>
 
 
 ParsingUtils::ParsingUtils() {}
@@ -150,6 +151,82 @@ bool ParsingUtils::isDirectory(const std::string& path) {
   return false;
 }
 
+std::string ParsingUtils::formatIPv4(unsigned int address) {
+  std::ostringstream oss;
+  oss << ((address >> 24) & 0xff) << '.' << ((address >> 16) & 0xff) << '.'
+      << ((address >> 8) & 0xff) << '.' << (address & 0xff);
+  return oss.str();
+}
+
+namespace {
+  // Length of the UTF-8 sequence starting at str[i], 0 if it is not one
+  size_t utf8Length(const std::string& str, size_t i) {
+    unsigned char c = str[i];
+    size_t length;
+    unsigned char low = 0x80;
+    unsigned char high = 0xbf;
+    if (c >= 0xc2 && c <= 0xdf)
+      length = 2;
+    else if (c >= 0xe0 && c <= 0xef) {
+      length = 3;
+      // No overlong forms, no surrogates
+      if (c == 0xe0)
+        low = 0xa0;
+      else if (c == 0xed)
+        high = 0x9f;
+    }
+    else if (c >= 0xf0 && c <= 0xf4) {
+      length = 4;
+      if (c == 0xf0)
+        low = 0x90;
+      else if (c == 0xf4)
+        high = 0x8f;
+    }
+    else
+      return 0;
+    if (i + length > str.size())
+      return 0;
+    unsigned char second = str[i + 1];
+    if (second < low || second > high)
+      return 0;
+    for (size_t j = 2; j < length; ++j) {
+      unsigned char next = str[i + j];
+      if (next < 0x80 || next > 0xbf)
+        return 0;
+    }
+    return length;
+  }
+}
+
+std::string ParsingUtils::jsonEscape(const std::string& str) {
+  std::string out;
+  out.reserve(str.size() + 2);
+  for (size_t i = 0; i < str.size(); ) {
+    unsigned char c = str[i];
+    if (c >= 0x80) {
+      size_t length = utf8Length(str, i);
+      if (length > 0) {
+        out.append(str, i, length);
+        i += length;
+        continue;
+      }
+    }
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    }
+    else if (c < 0x20 || c >= 0x7f) {
+      char escaped[8];
+      std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      out += escaped;
+    }
+    else
+      out += c;
+    ++i;
+  }
+  return out;
+}
+
 bool ParsingUtils::isValidIPv4(const std::string& host) {
     struct sockaddr_in sa;
     int result = inet_pton(AF_INET, host.c_str(), &(sa.sin_addr));
@@ -185,6 +262,21 @@ bool ParsingUtils::isAbsoluteUrl(const std::string& url) {
     return false;
 }
 
+// Returns the raw value of the first name=value pair in a query string, or ""
+std::string ParsingUtils::getQueryParameter(const std::string& query, const std::string& name) {
+  size_t pos = 0;
+  while (pos <= query.length()) {
+    size_t end = query.find('&', pos);
+    if (end == std::string::npos)
+      end = query.length();
+    size_t eq = query.find('=', pos);
+    if (eq != std::string::npos && eq < end && query.compare(pos, eq - pos, name) == 0 && eq - pos == name.length())
+      return query.substr(eq + 1, end - eq - 1);
+    pos = end + 1;
+  }
+  return "";
+}
+
 bool ParsingUtils::containsAlpha(std::string& str) {
   for (size_t i = 0; i < str.length(); ++i) {
     if (std::isalpha(str[i])) {
@@ -279,3 +371,34 @@ std::string ParsingUtils::removeFinalSlash(const std::string& path) {
   }
   return path;
 }
+
+bool ParsingUtils::normalizeUriPath(const std::string& path, std::string& normalized) {
+  if (path.empty() || path[0] != '/')
+    return false;
+  std::vector<std::string> segments;
+  // A path ending in a directory keeps its trailing slash
+  bool directory = false;
+  size_t pos = 1;
+  while (pos <= path.size()) {
+    size_t end = path.find('/', pos);
+    if (end == std::string::npos)
+      end = path.size();
+    std::string segment = path.substr(pos, end - pos);
+    directory = segment.empty() || segment == "." || segment == "..";
+    if (segment == "..") {
+      if (segments.empty())
+        return false;
+      segments.pop_back();
+    }
+    else if (!segment.empty() && segment != ".")
+      segments.push_back(segment);
+    pos = end + 1;
+  }
+  normalized = "/";
+  for (size_t i = 0; i < segments.size(); ++i) {
+    normalized += segments[i];
+    if (i + 1 < segments.size() || directory)
+      normalized += '/';
+  }
+  return true;
+}
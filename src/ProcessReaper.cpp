@@ -0,0 +1,100 @@
+#include "ProcessReaper.hpp"
+#include <sys/signalfd.h>
+#include <sys/epoll.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+#include <string.h>
+#include <cerrno>
+#include "Logger.hpp"
+#include "ParsingUtils.hpp"
+#include "SystemUtils.hpp"
+#include "ServerManager.hpp"
+
+ProcessReaper::ProcessReaper() {
+  sigset_t mask;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGCHLD);
+  if (sigprocmask(SIG_BLOCK, &mask, NULL) == -1) {
+    Logger::log(WARNING, "Cannot block SIGCHLD, children are reaped synchronously: " + std::string(strerror(errno)));
+    EventHandler::setHandle(-1);
+    return;
+  }
+  EventHandler::setHandle(signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC));
+  if (EventHandler::getHandle() == -1) {
+    Logger::log(WARNING, "signalfd unavailable, children are reaped synchronously: " + std::string(strerror(errno)));
+    sigprocmask(SIG_UNBLOCK, &mask, NULL);
+  }
+}
+
+ProcessReaper::~ProcessReaper() {
+  // The reactor deletes its handlers in no particular order
+  if (ServerManager::getInstance().getProcessReaper() == this)
+    ServerManager::getInstance().setProcessReaper(NULL);
+  SystemUtils::closeUtil(EventHandler::getHandle());
+}
+
+bool ProcessReaper::isActive(void) const {
+  return handle != -1;
+}
+
+void ProcessReaper::watch(pid_t pid, ChildExitListener* listener) {
+  listeners[pid] = listener;
+}
+
+void ProcessReaper::unwatch(pid_t pid) {
+  listeners.erase(pid);
+}
+
+void ProcessReaper::restoreSignalMask(void) {
+  sigset_t mask;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGCHLD);
+  sigprocmask(SIG_UNBLOCK, &mask, NULL);
+  // Ignored dispositions survive exec
+  signal(SIGPIPE, SIG_DFL);
+}
+
+void ProcessReaper::restoreSignalMask(posix_spawnattr_t* attributes) {
+  sigset_t mask;
+  sigprocmask(SIG_SETMASK, NULL, &mask);
+  sigdelset(&mask, SIGCHLD);
+  posix_spawnattr_setsigmask(attributes, &mask);
+  sigset_t defaults;
+  sigemptyset(&defaults);
+  sigaddset(&defaults, SIGPIPE);
+  posix_spawnattr_setsigdefault(attributes, &defaults);
+  short flags;
+  posix_spawnattr_getflags(attributes, &flags);
+  posix_spawnattr_setflags(attributes, flags | POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+}
+
+void ProcessReaper::handleEvent(uint32_t events) {
+  if (!(events & EPOLLIN))
+    return;
+  // Signals of one kind coalesce, so one siginfo may stand for many exits
+  struct signalfd_siginfo info;
+  while (read(EventHandler::getHandle(), &info, sizeof(info)) == sizeof(info))
+    ;
+  reap();
+}
+
+void ProcessReaper::reap(void) {
+  int status;
+  pid_t pid;
+  while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+    std::map<pid_t, ChildExitListener*>::iterator it = listeners.find(pid);
+    if (it == listeners.end()) {
+      Logger::log(INFO, "Reaped unwatched child " + ParsingUtils::toString(pid));
+      continue;
+    }
+    ChildExitListener* listener = it->second;
+    // The listener may well delete itself
+    listeners.erase(it);
+    listener->childExited(pid, status);
+  }
+}
+
+void ProcessReaper::closeConnection(void) {
+  SystemUtils::closeUtil(EventHandler::getHandle());
+}
@@ -10,8 +10,10 @@
 #include "ParsingUtils.hpp"
 #include "SystemUtils.hpp"
 #include "RequestHandler.hpp"
+#include "SignalHandler.hpp"
+#include "ServerManager.hpp"
 
-Reactor::Reactor() {
+Reactor::Reactor() : batchSize(0), batchNext(0) {
 	epfd = epoll_create(1);
 	if (epfd == -1) {
 		throw std::runtime_error("Error creating epoll file descriptor: " + std::string(strerror(errno)));
@@ -30,7 +32,7 @@ void Reactor::removeFromInactivityList(int fd) {
   lastActivityMap.erase(fd);
 }
 
-void Reactor::registerHandler(EventHandler* eh) {
+void Reactor::registerHandler(EventHandler* eh, uint32_t events) {
 	int fd = eh->getHandle();
 
 	int flags = fcntl(fd, F_GETFL, 0);
@@ -41,46 +43,95 @@ void Reactor::registerHandler(EventHandler* eh) {
 		throw std::runtime_error("Error setting non-blocking mode: " + std::string(strerror(errno)));
 
 	epoll_event event = {};
-	event.events = EPOLLIN | EPOLLOUT;
+	event.events = events;
 	event.data.ptr = eh;
 	if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &event) == -1)
 		throw std::runtime_error("Error adding epoll event: " + std::string(strerror(errno)));
-	Logger::log(INFO, "Handler registered for fd: " + ParsingUtils::toString(fd));
+	LOG(DEBUG, "Handler registered for fd: " + ParsingUtils::toString(fd));
 	handlers[fd] = eh;
+	interests[fd] = events;
 	// Add the file descriptor to the lastActivityMap with the current time
 	// Check if the EventHandler is a RequestHandler
 	if (dynamic_cast<RequestHandler*>(eh) != NULL) {
 		// Add the file descriptor to the lastActivityMap with the current time
 		lastActivityMap[fd] = time(NULL);
-		Logger::log(INFO, "Added fd to lastActivityMap: " + ParsingUtils::toString(fd));
+		LOG(DEBUG, "Added fd to lastActivityMap: " + ParsingUtils::toString(fd));
 	}
 }
 
 void Reactor::deregisterHandler(int fd) {
   if (epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL) == -1)
     throw std::runtime_error("Error deleting epoll event: " + std::string(strerror(errno)));
+  std::map<int, EventHandler*>::iterator it = handlers.find(fd);
+  if (it != handlers.end()) {
+    // It may be deleted before its pending events come up
+    for (int n = batchNext; n < batchSize; ++n) {
+      if (batch[n].data.ptr == it->second)
+        batch[n].data.ptr = NULL;
+    }
+  }
   handlers.erase(fd);
+  interests.erase(fd);
+}
+
+void Reactor::modifyHandler(int fd, uint32_t events) {
+  std::map<int, EventHandler*>::iterator it = handlers.find(fd);
+  if (it == handlers.end() || interests[fd] == events)
+    return;
+  epoll_event event = {};
+  event.events = events;
+  event.data.ptr = it->second;
+  if (epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &event) == -1)
+    throw std::runtime_error("Error modifying epoll event: " + std::string(strerror(errno)));
+  interests[fd] = events;
+}
+
+void Reactor::enableEvents(int fd, uint32_t events) {
+  std::map<int, uint32_t>::iterator it = interests.find(fd);
+  if (it != interests.end())
+    modifyHandler(fd, it->second | events);
+}
+
+void Reactor::disableEvents(int fd, uint32_t events) {
+  std::map<int, uint32_t>::iterator it = interests.find(fd);
+  if (it != interests.end())
+    modifyHandler(fd, it->second & ~events);
 }
 
 void Reactor::event_loop() {
 	time_t lastCheckTime = time(NULL);
 	while (true) {
-		epoll_event events[2000];
-		int nfds = epoll_wait(epfd, events, 2000, -1);
-		if (nfds == -1) {
+		// Woken every second so idle clients are still swept
+		int nfds = epoll_wait(epfd, batch, MAX_EVENTS, 1000);
+		if (nfds == -1 && errno != EINTR) {
 			Logger::log(ERROR, "Error in epoll_wait: " + std::string(strerror(errno)));
 			return;
 		}
-		for (int n = 0; n < nfds; ++n) {
-			EventHandler* eh = (EventHandler*)events[n].data.ptr;
-			eh->handleEvent(events[n].events);
+		batchSize = nfds > 0 ? nfds : 0;
+		for (batchNext = 0; batchNext < batchSize; ) {
+			epoll_event& event = batch[batchNext++];
+			EventHandler* eh = (EventHandler*)event.data.ptr;
+			if (eh != NULL)
+				eh->handleEvent(event.events);
 		}
+		batchSize = 0;
+		// Queued CGI requests start here, and scripts past their timeout die
+		ServerManager::getInstance().getCgiScheduler().tick();
+		// Expired sessions go a few at a time
+		ServerManager::getInstance().getSessionManager().tick();
+		ServerManager::getInstance().getClientLimiter().tick();
+		// Swapping the configuration here means no handler is mid-request
+		if (SignalHandler::getInstance().consumeReloadRequest())
+			ServerManager::getInstance().reloadConfig(*this);
 		time_t currentTime = time(NULL);
 		if (currentTime - lastCheckTime >= 5) { // 5 seconds timeout for inactivity check 
-			Logger::log(INFO, "Checking for inactive clients");
+			LOG(DEBUG, "Checking for inactive clients");
 			removeInactiveClients(5); // Perform the check
 			lastCheckTime = currentTime; // Update the last check time
 		}
+		// One write for everything logged in this round
+		Logger::flush();
+		ServerManager::getInstance().getAccessLog().flush();
 	}
 }
 
@@ -2,10 +2,12 @@
 #include <string>
 #include <string.h>
 #include <iostream>
+#include <fstream>
 #include <sys/epoll.h>
 #include <errno.h>
 #include <cstdlib>
 #include <algorithm>
+#include <cctype>
 #include "RequestHandler.hpp"
 #include "ServerManager.hpp"
 #include "Reactor.hpp"
@@ -17,28 +19,49 @@
 #include "ErrorPageManager.hpp"
 #include "ParsingUtils.hpp"
 #include "CgiHandler.hpp"
+#include "FastCgiBackend.hpp"
+#include "DirectoryListingRenderer.hpp"
+#include "SessionToken.hpp"
 
-RequestHandler::RequestHandler(int fd, Reactor *reactor) : reactor(reactor), closeConnectionFlag (true) {
+RequestHandler::RequestHandler(int fd, Reactor *reactor, int localPort, uint32_t clientAddress) : reactor(reactor), closeConnectionFlag (true), hasSignedSession(false), localPort(localPort), clientAddress(clientAddress), waitingForCgi(false), waitingForFastCgi(false), cgiHandler(NULL), bodyStream(NULL), cgiBodyStarted(false), cgiQueued(false), queuedRoute(NULL), queuedServer(NULL), config(NULL), resolvedServer(NULL), closeAfterOutput(false) {
   EventHandler::setHandle(fd);
+  output.setFd(fd);
 }
 
-RequestHandler::~RequestHandler() {}
+RequestHandler::~RequestHandler() {
+  if (waitingForCgi)
+    ServerManager::getInstance().getCgiResponseCache().removeListener(this);
+  if (waitingForFastCgi)
+    ServerManager::getInstance().removeFastCgiListener(this);
+  if (cgiQueued)
+    ServerManager::getInstance().getCgiScheduler().cancel(this);
+  if (cgiHandler != NULL)
+    cgiHandler->detach();
+  if (bodyStream != NULL)
+    bodyStream->abort();
+  logAccess();
+  ServerManager::getInstance().getClientLimiter().releaseConnection(clientAddress);
+  if (config != NULL)
+    config->release();
+}
 
-void RequestHandler::handleSession() {
+void RequestHandler::handleSession(const Server* server) {
+  if (server->hasSignedSessions()) {
+    handleSignedSession(server);
+    return;
+  }
   SessionManager& sessionManager = ServerManager::getInstance().getSessionManager();
   std::string cookieHeader = parser.getHeader("Cookie");
-  Logger::log(INFO, "Cookie header: " + cookieHeader);
   if (!cookieHeader.empty()) {
     std::string sessionId = extractSessionIdFromCookie(cookieHeader);
-    Logger::log(INFO, "Session ID: " + sessionId);
+    LOG(DEBUG, "Session ID: " + SessionManager::logPrefix(sessionId));
     SessionData* sessionData = sessionManager.getSessionData(sessionId);
     if (sessionData != NULL) {
       sessionData->incrementRequestCount();
     }
     else {
-      // A cookie already exist so let's register it and use it
-      sessionId = sessionManager.createSession(sessionId);
-      cookie = Cookie("session_id", sessionId);
+      // Unknown, expired or evicted: the client gets a new session
+      cookie = Cookie("session_id", sessionManager.createSession());
     }
   } else {
     std::string sessionId = sessionManager.createSession();
@@ -47,45 +70,127 @@ void RequestHandler::handleSession() {
   }
 }
 
+// The session travels in the cookie: verified, counted and signed again on
+// every request, so it needs no store any worker would have to share
+void RequestHandler::handleSignedSession(const Server* server) {
+  SessionManager& sessionManager = ServerManager::getInstance().getSessionManager();
+  const std::vector<std::string>& keys = server->getSessionKeys().empty() ? sessionManager.getFallbackKeys() : server->getSessionKeys();
+  time_t now = time(NULL);
+  std::string token = extractSessionIdFromCookie(parser.getHeader("Cookie"));
+  if (!token.empty() && SessionToken::verify(token, keys, now, signedSession))
+    signedSession.incrementRequestCount();
+  else
+    signedSession = SessionData(sessionManager.generateUniqueID(), now);
+  signedSession.touch(now);
+  hasSignedSession = true;
+  cookie = Cookie("session_id", SessionToken::issue(signedSession, sessionManager.getExpiry(signedSession), keys[0]));
+}
+
+// Session of the current request: the one named by the Cookie header, or the
+// one handleSession just created for a cookie-less client
+SessionData* RequestHandler::findSessionData(void) {
+  if (hasSignedSession)
+    return &signedSession;
+  SessionManager& sessionManager = ServerManager::getInstance().getSessionManager();
+  std::string cookieHeader = parser.getHeader("Cookie");
+  if (!cookieHeader.empty()) {
+    SessionData* sessionData = sessionManager.getSessionData(extractSessionIdFromCookie(cookieHeader));
+    if (sessionData != NULL)
+      return sessionData;
+  }
+  if (!cookie.getCookieValue().empty())
+    return sessionManager.getSessionData(cookie.getCookieValue());
+  return NULL;
+}
+
 void RequestHandler::handleEvent(uint32_t events) {
-  if (events & EPOLLIN) {
+  // A response is still going out, or the socket closes after one
+  if (output.isPending() || closeAfterOutput) {
+    if (events & (EPOLLOUT | EPOLLHUP | EPOLLERR))
+      flushOutput();
+    return;
+  }
+  // Only asked for while the script's output is blocked on this socket.
+  // May finish the response and close the connection, so anything else
+  // waits for the next round.
+  if ((events & EPOLLOUT) && cgiHandler != NULL) {
+    cgiHandler->clientWritable();
+    return;
+  }
+  // A hang-up or error is seen by the read below
+  if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+    // May close the connection: nothing is touched afterwards
+    if (bodyStream != NULL) {
+      bodyStream->pump();
+      return;
+    }
     char buffer[1024];
 
     while (true) {
       ssize_t bytes_read = read(EventHandler::getHandle(), buffer, sizeof(buffer));
       if (bytes_read > 0) {
+        // The request is answered already: with Connection: close on every
+        // response, anything the client sends after it is dropped
+        if (cgiBodyStarted || cgiHandler != NULL || waitingForCgi || waitingForFastCgi)
+          continue;
+        if (!access.open)
+          ServerManager::getInstance().getAccessLog().begin(access, EventHandler::getHandle(), clientAddress);
+        access.bytesIn += bytes_read;
         try {
           parser.appendData(std::string(buffer, bytes_read));
           // std::cout << "PACKET RECV ----" << std::endl << std::string(buffer, bytes_read) << std::cout << "PACKET END ----" << std::endl;
         } catch (const HTTPRequestParser::InvalidHTTPVersionException& e) {
           Logger::log(ERROR, std::string("Error Parsing HTTP Request: ") + e.what());
-          HTTPResponse::sendErrorResponse(505, NULL, EventHandler::getHandle());
+          HTTPResponse::sendErrorResponse(505, NULL, output);
           closeConnection();
           break;
         }
         catch (const HTTPRequestParser::InvalidMethodException& e) {
           Logger::log(ERROR, "Error Parsing HTTP Request: " + std::string(e.what()));
-          HTTPResponse::sendErrorResponse(405, NULL, EventHandler::getHandle());
+          HTTPResponse::sendErrorResponse(405, NULL, output);
+          closeConnection();
+          break;
+        }
+        catch (const HTTPRequestParser::InvalidUriException& e) {
+          Logger::log(ERROR, "Error Parsing HTTP Request: " + std::string(e.what()));
+          HTTPResponse::sendErrorResponse(400, NULL, output);
           closeConnection();
           break;
         }
         reactor->updateLastActivity(EventHandler::getHandle());
-        // Check if the entire request has been received
-        if (parser.isCompleteRequest()) {
+        // Check if the entire request has been received. CGI POSTs start as
+        // soon as the headers are in and get their body as it arrives.
+        bool streamBody = !parser.isCompleteRequest() && isStreamedCgiPost();
+        if (parser.isCompleteRequest() || streamBody) {
           // std::cout << "PARSED DATA" << std::endl << parser.requestData << std::endl << "END PARSED DATA" << std::endl;
-          Logger::log(INFO, "Received complete request");
-          Server* server = findServerForHost(parser.getHeader("Host"), ServerManager::getInstance().getServersMap());
+          LOG(DEBUG, "Received complete request");
+          access.lap(access.parseUs);
+          access.method = parser.getMethod();
+          access.path = removeQueryString(parser.getUri());
+          Server* server = findServerForHost(parser.getHeader("Host"));
+          if (server != NULL)
+            access.vhost = server->getServerName();
           if (server == NULL)
           {
             Logger::log(ERROR, "No matching server found for request:" + parser.getUri());
-            HTTPResponse::sendErrorResponse(400, NULL, EventHandler::getHandle());
+            HTTPResponse::sendErrorResponse(400, NULL, output);
             closeConnection();
           }
           else {
-            handleSession();
+            handleSession(server);
             RequestHandler::handleRequest(server);
-            if (shouldCloseConnection()) {
-              Logger::log(INFO, "Should close connection");
+            // Answered already unless a script, the cache or the socket still has to
+            if (!cgiQueued && !waitingForCgi && !waitingForFastCgi && cgiHandler == NULL && bodyStream == NULL && !output.isPending())
+              logAccess();
+            if (cgiQueued) {
+              // Read again once the script starts
+            }
+            else if (waitingForCgi || waitingForFastCgi || cgiHandler != NULL || bodyStream != NULL) {
+              // Closed once the script answered
+            }
+            else {
+              // Every response says Connection: close; a refused CGI POST's
+              // body is never read either
               closeConnection();
             }
           }
@@ -94,7 +199,7 @@ void RequestHandler::handleEvent(uint32_t events) {
       }
       else if (bytes_read == 0) {
         // Client disconnected
-        Logger::log(INFO, "Client disconnected");
+        LOG(DEBUG, "Client disconnected");
         closeConnection();
         break;
       }
@@ -108,63 +213,48 @@ void RequestHandler::handleEvent(uint32_t events) {
   }
 }
 
-Server* RequestHandler::findServerForHost(const std::string& host, const std::map<std::string, Server*>* serversMap) {
-    // Extract hostname or IP and port from the host header
-    std::string parsedHost;
-    int parsedPort = -1; // Default to an invalid port
-    size_t colonPos = host.find(':');
-    if (colonPos != std::string::npos) {
-        parsedHost = host.substr(0, colonPos);
-        std::istringstream iss(host.substr(colonPos + 1));
-        iss >> parsedPort;
-    } else {
-        parsedHost = host;
-    }
-
-    // Check if the host header is an IP address
-    bool isIpAddress = ParsingUtils::isValidIPv4(parsedHost);
-
-    if (!serversMap) {
-        Logger::log(ERROR, "Servers map is NULL");
-        return NULL;
-    }
-
-    for (std::map<std::string, Server*>::const_iterator it = serversMap->begin(); it != serversMap->end(); ++it) {
-        Server* server = it->second;
-        if (server != NULL) {
-            const std::string& serverHost = server->getHost();
-            const std::vector<int>& serverPorts = server->getPorts();
-
-            // Check for IP address match or empty host
-            if (isIpAddress && (serverHost.empty() || parsedHost == serverHost)) {
-                // Check if parsedPort is among the server's ports
-                if (std::find(serverPorts.begin(), serverPorts.end(), parsedPort) != serverPorts.end()) {
-                    std::ostringstream oss;
-                    oss << parsedPort;
-                    Logger::log(INFO, "Found matching server for IP address: " + parsedHost + " on port " + oss.str() + " with server :" + server->getServerName());
-                    return server;
-                }
-            }
-            // Check for hostname match
-            else if (!isIpAddress && parsedHost == server->getServerName()) {
-                Logger::log(INFO, "Found matching server for host name: " + parsedHost + " with server :" + server->getServerName());
-                return server;
-            }
-        }
-    }
-    Logger::log(ERROR, "No matching server found for host: " + parsedHost);
+// Keep-alive clients send the same Host header on every request, so the
+// index is only consulted when it or the configuration changes. A reload
+// takes effect on a connection at its next request; the snapshot held here
+// keeps the returned Server alive until then.
+Server* RequestHandler::findServerForHost(const std::string& host) {
+  ConfigSnapshot* current = ServerManager::getInstance().getConfig();
+  if (current != config) {
+    if (current != NULL)
+      current->acquire();
+    if (config != NULL)
+      config->release();
+    config = current;
+    resolvedServer = NULL;
+  }
+  if (config == NULL)
+    return NULL;
+  if (host.empty()) {
+    Logger::log(ERROR, "Missing Host header");
     return NULL;
+  }
+  if (resolvedServer != NULL && host == resolvedHost)
+    return resolvedServer;
+  Server* server = config->getVirtualHostIndex().resolve(localPort, host);
+  if (server == NULL) {
+    Logger::log(ERROR, "No matching server found for host: " + host + " on port " + ParsingUtils::toString(localPort));
+    return NULL;
+  }
+  LOG(DEBUG, "Found matching server for host: " + host + " with server :" + server->getServerName());
+  resolvedHost = host;
+  resolvedServer = server;
+  return server;
 }
 
 std::string RequestHandler::getFilePathFromUri(const Route& route, const std::string& uri) {
 	std::string rootPath = route.getRootDirectoryPath();
 	std::string filePath = ParsingUtils::removeFinalSlash(rootPath);
 	filePath = filePath + uri;
-	if (ParsingUtils::isDirectory(filePath))
+	if (ServerManager::getInstance().getFileInfoCache().lookup(filePath).isDirectory())
 	{
 		if (route.getHasDefaultFile()) {
 			std::string file = route.getDefaultFile();
-      Logger::log(INFO, "Serving default file: " + file + " for URI: " + uri);
+      LOG(DEBUG, "Serving default file: " + file + " for URI: " + uri);
 			if (file[0] == '/')
 				filePath += file.substr(1);
 			else
@@ -174,124 +264,106 @@ std::string RequestHandler::getFilePathFromUri(const Route& route, const std::st
 			filePath += "/";
 		}
 	}
-	if (route.getHasCGI())
+	// FastCGI applications are handed the requested script instead
+	if (route.getHasCGI() && !route.getHasFastCgi())
 	{
 		filePath = route.getCGIPath();
-    Logger::log(INFO, "Serving CGI file: " + filePath + " for URI: " + uri);
+    LOG(DEBUG, "Serving CGI file: " + filePath + " for URI: " + uri);
 		return filePath;
 	}
 	return filePath;
 }
 
-std::string RequestHandler::generateDirectoryListingPage(const std::vector<std::string>& contents, const std::string& directoryPath) {
-    std::ostringstream html;
-    html << "<html><head><title>Directory Listing of " << directoryPath << "</title></head><body>";
-    html << "<h2>Directory Listing of " << directoryPath << "</h2><ul>";
-
-    // Ensure directoryPath ends with '/'
-    std::string formattedDirectoryPath = directoryPath;
-    if (formattedDirectoryPath.empty() || formattedDirectoryPath[formattedDirectoryPath.length() - 1] != '/') {
-        formattedDirectoryPath += '/';
-    }
-
-    // List each item in the directory
-    for (std::vector<std::string>::const_iterator it = contents.begin(); it != contents.end(); ++it) {
-        std::string itemPath = formattedDirectoryPath + *it;
-        html << "<li><a href=\"" << itemPath << "\">" << *it << "</a></li>";
-    }
-
-    html << "</ul></body></html>";
-    return html.str();
-}
-
 void RequestHandler::handleRedirect(const Route& route) {
-  Logger::log(INFO, "Redirecting to: " + route.getRedirectLocation());
-  HTTPResponse::sendRedirectResponse(route.getRedirectLocation(), EventHandler::getHandle());
+  LOG(DEBUG, "Redirecting to: " + route.getRedirectLocation());
+  HTTPResponse::sendRedirectResponse(route.getRedirectLocation(), output);
 }
 
 void RequestHandler::handleDirectoryRequest(const Route& route, const Server* server)
 {
-      std::string directoryPath = getFilePathFromUri(route, parser.getUri());
-      if (!ParsingUtils::doesPathExist(directoryPath)) {
+      std::string directoryPath = getFilePathFromUri(route, removeQueryString(parser.getUri()));
+      FileInfo info = ServerManager::getInstance().getFileInfoCache().lookup(directoryPath);
+      if (!info.exists()) {
         Logger::log(ERROR, "Directory does not exist: " + directoryPath);
-        HTTPResponse::sendErrorResponse(403, server, EventHandler::getHandle());
+        HTTPResponse::sendErrorResponse(403, server, output);
         return;
       }
-      if (!ParsingUtils::hasReadPermissions(directoryPath)) {
+      if (!info.isReadable()) {
         Logger::log(ERROR, "Directory is not readable: " + directoryPath);
-        HTTPResponse::sendErrorResponse(403, server, EventHandler::getHandle());
+        HTTPResponse::sendErrorResponse(403, server, output);
         return;
       }
       // Directory exists and is readable
-      Logger::log(INFO, "Directory listing on GET request: " + directoryPath);
-      std::vector<std::string> contents;
+      LOG(DEBUG, "Directory listing on GET request: " + directoryPath);
+      DirectoryListingCache& listings = ServerManager::getInstance().getDirectoryListingCache();
+      const DirectoryListing* listing;
       try {
-        contents = ParsingUtils::getDirectoryContents(directoryPath);
+        listing = listings.getListing(directoryPath);
       } catch (const std::exception& e) {
         Logger::log(ERROR, "500 - Error reading directory contents: " + std::string(e.what()));
-        HTTPResponse::sendErrorResponse(500, server, EventHandler::getHandle());
+        HTTPResponse::sendErrorResponse(500, server, output);
         return;
       }
-      std::string directoryListingPage = generateDirectoryListingPage(contents, parser.getUri());
-      HTTPResponse::sendSuccessResponse("200 OK", "text/html", directoryListingPage, cookie, EventHandler::getHandle());
+      DirectoryListingQuery query = DirectoryListingQuery::fromQueryString(extractQueryString(parser.getUri()));
+      if (!DirectoryListingRenderer::stream(listing, listings, query, removeQueryString(parser.getUri()), cookie, output))
+        Logger::log(ERROR, "Error streaming directory listing: " + directoryPath);
       return;
 }
 
-std::string RequestHandler::getMimeType(const std::string& filePath) {
-    Logger::log(DEBUG, "getMimeType called with filePath: " + filePath);
-
-    // Local map for MIME types
-    std::map<std::string, std::string> localMimeTypes;
-    localMimeTypes["html"] = "text/html";
-    localMimeTypes["css"] = "text/css";
-    localMimeTypes["jpg"] = "image/jpeg";
-    localMimeTypes["jpeg"] = "image/jpeg";
-    // Add more MIME types as needed
-
-    size_t dotPos = filePath.find_last_of('.');
-    if (dotPos != std::string::npos) {
-        std::string extension = filePath.substr(dotPos + 1);
-
-        std::ostringstream oss;
-        oss << localMimeTypes.size();
-
-        std::map<std::string, std::string>::const_iterator it = localMimeTypes.find(extension);
-        if (it != localMimeTypes.end()) {
-            Logger::log(INFO, "MIME type found: " + it->second);
-            return it->second;
-        }
-    }
-
-    Logger::log(INFO, "Returning default MIME type for extension: " + filePath.substr(dotPos + 1));
-    return "application/octet-stream";
+const std::string& RequestHandler::getMimeType(const std::string& filePath, const Server* server) {
+  if (server != NULL)
+    return ServerManager::getInstance().getFileInfoCache().getMimeType(filePath, server->getMimeTypes());
+  return MimeTypes::builtin().getType(filePath);
 }
 
 void RequestHandler::handleFileRequest(const Route& route, const Server* server) {
-  std::string filePath = getFilePathFromUri(route, parser.getUri());
-  Logger::log(INFO, "Looking to GET: " + filePath);
-  if (ParsingUtils::isDirectory(filePath))
+  std::string filePath = getFilePathFromUri(route, removeQueryString(parser.getUri()));
+  LOG(DEBUG, "Looking to GET: " + filePath);
+  FileInfoCache& files = ServerManager::getInstance().getFileInfoCache();
+  FileInfo info = files.lookup(filePath);
+  if (info.isDirectory())
   {
-    HTTPResponse::sendErrorResponse(403, server, EventHandler::getHandle());
+    HTTPResponse::sendErrorResponse(403, server, output);
     Logger::log(ERROR, "403 - Directory listing is not enabled: " + filePath);
     return;
   }
-  if (ParsingUtils::doesPathExistAndReadable(filePath)) {
-    std::string fileContent = ParsingUtils::readFile(filePath);
-    // handle file with session
-    SessionManager& sessionManager = ServerManager::getInstance().getSessionManager();
-    std::string cookieHeader = parser.getHeader("Cookie");
-    if (!cookieHeader.empty()) {
-      std::string sessionId = extractSessionIdFromCookie(cookieHeader);
-      SessionData* sessionData = sessionManager.getSessionData(sessionId);
-      if (sessionData != NULL)
-        fileContent = HTTPResponse::modifyHtmlContentForSession(fileContent, sessionData);
+  if (info.isReadable()) {
+    const std::string& mimeType = getMimeType(filePath, server);
+    if (mimeType == "text/html") {
+      // HTML goes through the compiled template, everything else is sent as is
+      const HtmlTemplate* page;
+      try {
+        page = ServerManager::getInstance().getTemplateCache().getTemplate(filePath, &files);
+      } catch (const std::exception& e) {
+        Logger::log(ERROR, "500 - Error loading template: " + std::string(e.what()));
+        HTTPResponse::sendErrorResponse(500, server, output);
+        return;
+      }
+      TemplateVariables variables;
+      if (page->hasPlaceholders()) {
+        SessionData* sessionData = findSessionData();
+        if (sessionData != NULL)
+          HTTPResponse::setSessionVariables(variables, sessionData);
+      }
+      HTTPResponse::sendTemplateResponse("200 OK", mimeType, *page, variables, cookie, output);
+    } else {
+      OpenFileCache& openFiles = ServerManager::getInstance().getOpenFileCache();
+      OpenFile* file = openFiles.acquire(filePath);
+      if (file == NULL) {
+        Logger::log(ERROR, "500 - Error opening file: " + filePath + ": " + std::string(strerror(errno)));
+        HTTPResponse::sendErrorResponse(500, server, output);
+        return;
+      }
+      HTTPResponse::sendFileResponse("200 OK", mimeType, file, openFiles, cookie, output);
     }
-    ServerManager::getInstance().getSessionManager().debugPrintSessions();
-    HTTPResponse::sendSuccessResponse("200 OK", getMimeType(filePath), fileContent, cookie, EventHandler::getHandle());
-    Logger::log(INFO, "File request on GET request: " + filePath); 
+    LOG(DEBUG, "File request on GET request: " + filePath); 
     return;
   } else {
-    HTTPResponse::sendErrorResponse(404, server, EventHandler::getHandle());
+    if (!info.exists()) {
+      std::string root = ParsingUtils::removeFinalSlash(route.getRootDirectoryPath());
+      ServerManager::getInstance().getNegativeLookupCache().recordMiss(root, root + removeQueryString(parser.getUri()), filePath);
+    }
+    HTTPResponse::sendErrorResponse(404, server, output);
     Logger::log(ERROR, "404 - File not found: " + filePath);
     return;
   }
@@ -314,42 +386,52 @@ std::string RequestHandler::endWithSlash(const std::string& uri) {
 
 void RequestHandler::handleGetRequest(const Server* server) {
   std::string originalPath = removeQueryString(parser.getUri()); // Get the original URI
-  Route route;
-  try {
-    // First try to find the route directly with the original URI
-    route = server->getRoute(originalPath);
-  } catch (const std::out_of_range&) {
-    // If not found, try extracting the directory path and then finding the route
-    std::string directoryPath = extractDirectoryPath(originalPath);
-    try {
-      route = server->getRoute(directoryPath);
-    } catch (const std::out_of_range& e) {
-      // No route found for either the original URI or the directory path
-      HTTPResponse::sendErrorResponse(404, server, EventHandler::getHandle());
-      Logger::log(ERROR, "404 - No route found for URI: " + originalPath);
-      return;
-    }
+  const RouteRecord* record = server->matchRoute(originalPath);
+  access.lap(access.routeUs);
+  if (record == NULL) {
+    HTTPResponse::sendErrorResponse(404, server, output);
+    Logger::log(ERROR, "404 - No route found for URI: " + originalPath);
+    return;
   }
-  bool isFileRequest = false;
-  std::string fp = getFilePathFromUri(route, parser.getUri());
-  if (ParsingUtils::isRegularFile(fp))
-    isFileRequest = true;
-
-  if (!route.getGetMethod()) {
+  const Route& route = *record->route;
+  if (isRateLimited(*record))
+    return;
+  if (!record->has(ROUTE_GET)) {
     // Method not allowed for this route
-    HTTPResponse::sendErrorResponse(405, server, EventHandler::getHandle());
+    HTTPResponse::sendErrorResponse(405, server, output);
     Logger::log(ERROR, "405 - Method not allowed for URI: " + parser.getUri());
     return;
   }
-  if (route.getRedirect()) {
+  if (record->has(ROUTE_STATUS)) {
+    std::string counters = ServerManager::getInstance().getClientLimiter().formatCounters()
+      + ServerManager::getInstance().getCgiResponseCache().formatCounters()
+      + ServerManager::getInstance().getCgiScheduler().formatCounters()
+      + ServerManager::getInstance().getSessionManager().formatCounters();
+    HTTPResponse::sendSuccessResponse("200 OK", "text/plain", counters, cookie, output);
+    return;
+  }
+  if (record->has(ROUTE_REDIRECT)) {
     handleRedirect(route);
     return;
   }
-  else if (route.getDirectoryListing() && !route.getHasDefaultFile() && !isFileRequest) {
+  if (!record->has(ROUTE_CGI)) {
+    // Repeated misses (scanners) are answered before touching the filesystem
+    std::string root = ParsingUtils::removeFinalSlash(route.getRootDirectoryPath());
+    if (ServerManager::getInstance().getNegativeLookupCache().isKnownMiss(root, root + originalPath)) {
+      HTTPResponse::sendErrorResponse(404, server, output);
+      Logger::log(ERROR, "404 - Known missing path: " + originalPath);
+      return;
+    }
+  }
+  bool isFileRequest = false;
+  if (record->has(ROUTE_DIRECTORY_LISTING) && !record->has(ROUTE_DEFAULT_FILE))
+    isFileRequest = ServerManager::getInstance().getFileInfoCache().lookup(getFilePathFromUri(route, originalPath)).isRegularFile();
+
+  if (record->has(ROUTE_DIRECTORY_LISTING) && !record->has(ROUTE_DEFAULT_FILE) && !isFileRequest) {
     handleDirectoryRequest(route, server);
     return;
   }
-  else if (route.getHasCGI()) {
+  else if (record->has(ROUTE_CGI)) {
     handleCGIRequest(route, server);
     return;
   }
@@ -359,6 +441,18 @@ void RequestHandler::handleGetRequest(const Server* server) {
   }
 }
 
+bool RequestHandler::isStreamedCgiPost(void) {
+  if (cgiBodyStarted || !parser.areHeadersParsed() || parser.getMethod() != "POST")
+    return false;
+  Server* server = findServerForHost(parser.getHeader("Host"));
+  if (server == NULL)
+    return false;
+  const RouteRecord* record = server->matchRoute(removeQueryString(parser.getUri()));
+  // FastCGI requests are sent whole
+  return record != NULL && record->has(ROUTE_CGI) && !record->has(ROUTE_FILE_UPLOAD)
+    && !record->route->getHasFastCgi();
+}
+
 std::string RequestHandler::removeQueryString(const std::string& uri) {
   size_t pos = uri.find('?');
   if (pos != std::string::npos) {
@@ -371,26 +465,250 @@ void RequestHandler::handleCGIRequest(const Route& route, const Server* server)
   std::string queryString = extractQueryString(parser.getUri());
   std::string filePath = getFilePathFromUri(route, parser.getUri());
   filePath = removeQueryString(filePath);
-  Logger::log(INFO, "Looking for: " + filePath);
-  Logger::log(INFO, "Query string: " + queryString);
+  LOG(DEBUG, "Looking for: " + filePath);
+  LOG(DEBUG, "Query string: " + queryString);
 
   if (!ParsingUtils::doesPathExist(filePath)) {
     Logger::log(ERROR, "404 - File not found: " + filePath);
-    HTTPResponse::sendErrorResponse(404, server, EventHandler::getHandle());
+    HTTPResponse::sendErrorResponse(404, server, output);
     return;
   }
 
-  if (!ParsingUtils::hasExecutePermissions(filePath)) {
+  // FastCGI scripts are read by the application, not executed
+  if (!route.getHasFastCgi() && !ParsingUtils::hasExecutePermissions(filePath)) {
     Logger::log(ERROR, "403 - File is not executable: " + filePath);
-    HTTPResponse::sendErrorResponse(403, server, EventHandler::getHandle());
+    HTTPResponse::sendErrorResponse(403, server, output);
+    return;
+  }
+  // Scripts of one route share its cgi_max_scripts
+  std::string pool = server->getServerName() + ":" + route.getRoutePath();
+  // Responses to POSTs are never cached
+  if (route.getHasCgiCache() && parser.getMethod() == "GET") {
+    handleCachedCGIRequest(route, filePath, queryString, pool);
+    return;
+  }
+  // The worker pool bounds FastCGI already
+  if (route.getHasFastCgi()) {
+    FastCgiRequest* request = createFastCgiRequest(filePath, queryString);
+    request->listener = this;
+    waitingForFastCgi = true;
+    submitFastCgiRequest(route, request);
+    return;
+  }
+  CgiScheduler& scheduler = ServerManager::getInstance().getCgiScheduler();
+  CgiScheduler::Admission admission = scheduler.admit(pool, route.getCgiLimits(), this);
+  if (admission == CgiScheduler::FULL) {
+    Logger::log(WARNING, "503 - CGI queue full for " + pool);
+    const std::string& response = ClientLimiter::getServiceUnavailableResponse();
+    AccessLog::sending(EventHandler::getHandle(), response.data(), response.size());
+    output.write(response);
+    return;
+  }
+  if (admission == CgiScheduler::QUEUED) {
+    LOG(DEBUG, "CGI request queued: " + filePath);
+    cgiQueued = true;
+    queuedRoute = &route;
+    queuedServer = server;
+    queuedFilePath = filePath;
+    queuedQueryString = queryString;
+    queuedPool = pool;
+    // The body stays in the socket, and the wait is bounded by the route's
+    // timeout rather than by the inactivity sweep
+    reactor->disableEvents(EventHandler::getHandle(), EPOLLIN);
+    reactor->removeFromInactivityList(EventHandler::getHandle());
+    return;
+  }
+  startCGI(route, server, filePath, queryString, pool);
+}
+
+// Runs with a slot of pool taken, which the CgiHandler gives back
+void RequestHandler::startCGI(const Route& route, const Server* server, const std::string& filePath,
+    const std::string& queryString, const std::string& pool) {
+  bool hasBody = parser.getContentLength() > 0;
+  try {
+    cgiHandler = new CgiHandler(filePath, buildCgiVariables(filePath, queryString), this, EventHandler::getHandle(), reactor, hasBody);
+  } catch (const std::exception& e) {
+    ServerManager::getInstance().getCgiScheduler().release(pool);
+    Logger::log(ERROR, "500 - Error starting CGI: " + std::string(e.what()));
+    HTTPResponse::sendErrorResponse(500, server, output);
     return;
   }
-  CgiHandler* cgiHandler = new CgiHandler(filePath, queryString, EventHandler::getHandle(), reactor);
-  closeConnectionFlag = false;
   // File exists and is readable and executable
-  Logger::log(INFO, "CGI request on GET request: " + filePath);
-  reactor->registerHandler(cgiHandler);
-  return;
+  LOG(DEBUG, "CGI request on " + parser.getMethod() + " request: " + filePath);
+  cgiHandler->supervise(pool, route.getCgiLimits());
+  reactor->registerHandler(cgiHandler, EPOLLIN);
+  if (!hasBody)
+    return;
+  cgiBodyStarted = true;
+  std::string received = parser.getReceivedBody();
+  // The rest of the body goes from the socket to the script unseen here
+  access.bytesIn += parser.getContentLength() - received.size();
+  bodyStream = new CgiBodyStream(cgiHandler->releaseInput(), EventHandler::getHandle(),
+    parser.getContentLength() - received.size(), reactor, this);
+  bodyStream->start(received);
+}
+
+// The connection stays with this handler: the response is written here,
+// from the cache or once the execution this request joined completes
+void RequestHandler::handleCachedCGIRequest(const Route& route, const std::string& filePath, const std::string& queryString,
+    const std::string& pool) {
+  std::string key = filePath + "?" + queryString;
+  // The script sees the cookies, so its output may depend on them
+  if (!route.getCgiCacheIgnoreCookie())
+    key += "\nCookie: " + parser.getHeader("Cookie");
+  const std::vector<std::string>& vary = route.getCgiCacheVary();
+  for (std::vector<std::string>::const_iterator it = vary.begin(); it != vary.end(); ++it)
+    key += "\n" + *it + ": " + parser.getHeader(*it);
+
+  CgiResponseCache& cache = ServerManager::getInstance().getCgiResponseCache();
+  const std::string* cached = NULL;
+  CgiResponseCache::Status status = cache.lookup(key, this, cached);
+  if (status == CgiResponseCache::FRESH || status == CgiResponseCache::STALE) {
+    LOG(DEBUG, "CGI response served from cache: " + filePath);
+    AccessLog::sending(EventHandler::getHandle(), cached->data(), cached->size());
+    if (!output.write(*cached))
+      Logger::log(ERROR, "Error sending cached CGI response: " + std::string(strerror(errno)));
+    if (status == CgiResponseCache::FRESH || !cache.beginRefresh(key))
+      return;
+    LOG(DEBUG, "Refreshing stale CGI response: " + filePath);
+  }
+  else {
+    waitingForCgi = true;
+    if (status == CgiResponseCache::PENDING) {
+      LOG(DEBUG, "Waiting for running CGI execution: " + filePath);
+      return;
+    }
+  }
+  long ttlMs = route.getCgiCacheTtl() * 1000L;
+  long staleMs = route.getCgiCacheStale() * 1000L;
+  std::map<std::string, std::string> variables = buildCgiVariables(filePath, queryString);
+  // Left out of the key, so the script must not see them either
+  if (route.getCgiCacheIgnoreCookie())
+    variables.erase("HTTP_COOKIE");
+  if (route.getHasFastCgi()) {
+    FastCgiRequest* request = createFastCgiRequest(filePath, queryString);
+    request->params = variables;
+    request->cacheKey = key;
+    request->cacheTtlMs = ttlMs;
+    request->cacheStaleMs = staleMs;
+    submitFastCgiRequest(route, request);
+    return;
+  }
+  // One execution answers every waiter on the key, so it is not queued;
+  // it still counts against the route's cap and timeout
+  CgiScheduler& scheduler = ServerManager::getInstance().getCgiScheduler();
+  scheduler.reserve(pool);
+  try {
+    // No client of its own: the cache answers whoever waits for the key
+    CgiHandler* execution = new CgiHandler(filePath, variables, NULL, -1, reactor);
+    execution->cacheAs(key, ttlMs, staleMs);
+    execution->supervise(pool, route.getCgiLimits());
+    reactor->registerHandler(execution, EPOLLIN);
+  } catch (const std::exception& e) {
+    scheduler.release(pool);
+    Logger::log(ERROR, "Error starting CGI: " + std::string(e.what()));
+    cache.fail(key);
+  }
+}
+
+// RFC 3875 meta-variables for the script, plus the request headers as HTTP_*
+std::map<std::string, std::string> RequestHandler::buildCgiVariables(const std::string& scriptPath, const std::string& queryString) {
+  std::map<std::string, std::string> variables;
+  variables["GATEWAY_INTERFACE"] = "CGI/1.1";
+  variables["SERVER_SOFTWARE"] = "webserv";
+  variables["SERVER_PROTOCOL"] = parser.getHttpVersion();
+  variables["SERVER_NAME"] = resolvedServer != NULL ? resolvedServer->getServerName() : resolvedHost;
+  variables["SERVER_PORT"] = ParsingUtils::toString(localPort);
+  variables["REMOTE_ADDR"] = ParsingUtils::formatIPv4(clientAddress);
+  variables["REQUEST_METHOD"] = parser.getMethod();
+  variables["REQUEST_URI"] = parser.getUri();
+  variables["SCRIPT_NAME"] = removeQueryString(parser.getUri());
+  variables["SCRIPT_FILENAME"] = scriptPath;
+  variables["QUERY_STRING"] = queryString;
+  if (parser.getContentLength() > 0)
+    variables["CONTENT_LENGTH"] = ParsingUtils::toString(parser.getContentLength());
+  std::string contentType = parser.getHeader("Content-Type");
+  if (!contentType.empty())
+    variables["CONTENT_TYPE"] = contentType;
+
+  std::map<std::string, std::string> headers = parser.getHeaders();
+  for (std::map<std::string, std::string>::const_iterator it = headers.begin(); it != headers.end(); ++it) {
+    std::string name = "HTTP_";
+    for (std::string::const_iterator c = it->first.begin(); c != it->first.end(); ++c)
+      name += *c == '-' ? '_' : static_cast<char>(std::toupper(static_cast<unsigned char>(*c)));
+    // Already passed as CONTENT_*
+    if (name != "HTTP_CONTENT_LENGTH" && name != "HTTP_CONTENT_TYPE")
+      variables[name] = it->second;
+  }
+  return variables;
+}
+
+FastCgiRequest* RequestHandler::createFastCgiRequest(const std::string& filePath, const std::string& queryString) {
+  FastCgiRequest* request = new FastCgiRequest();
+  request->params = buildCgiVariables(filePath, queryString);
+  request->body = parser.getBody();
+  return request;
+}
+
+void RequestHandler::submitFastCgiRequest(const Route& route, FastCgiRequest* request) {
+  FastCgiBackend* backend = ServerManager::getInstance().getFastCgiBackend(route);
+  LOG(DEBUG, "FastCGI request: " + request->params["SCRIPT_FILENAME"]);
+  if (backend == NULL) {
+    Logger::log(ERROR, "No FastCGI backend for route " + route.getRoutePath());
+    FastCgiBackend::deliver(request, true);
+    return;
+  }
+  backend->submit(request);
+}
+
+void RequestHandler::cgiResponseReady(const std::string& response) {
+  waitingForCgi = false;
+  waitingForFastCgi = false;
+  AccessLog::sending(EventHandler::getHandle(), response.data(), response.size());
+  if (!output.write(response))
+    Logger::log(ERROR, "Error sending CGI response: " + std::string(strerror(errno)));
+  // Closed from the event loop, as this can run inside handleRequest
+  closeAfterOutput = true;
+  waitForOutput();
+}
+
+void RequestHandler::cgiOutputDone(bool complete) {
+  cgiHandler = NULL;
+  logAccess();
+  // Answered before reading its whole body: the rest is drained and
+  // dropped, and the connection closed after it
+  if (bodyStream != NULL && complete) {
+    bodyStream->stopFeeding();
+    return;
+  }
+  closeConnection();
+}
+
+void RequestHandler::cgiSlotGranted(void) {
+  cgiQueued = false;
+  reactor->enableEvents(EventHandler::getHandle(), EPOLLIN);
+  reactor->updateLastActivity(EventHandler::getHandle());
+  startCGI(*queuedRoute, queuedServer, queuedFilePath, queuedQueryString, queuedPool);
+  // Could not start: answered with an error already
+  if (cgiHandler == NULL)
+    closeConnection();
+}
+
+void RequestHandler::cgiSlotExpired(void) {
+  cgiQueued = false;
+  Logger::log(WARNING, "503 - CGI request waited too long: " + queuedFilePath);
+  const std::string& response = ClientLimiter::getServiceUnavailableResponse();
+  AccessLog::sending(EventHandler::getHandle(), response.data(), response.size());
+  output.write(response);
+  // Any body is still unread in the socket
+  closeConnection();
+}
+
+void RequestHandler::cgiBodyStreamed(bool complete) {
+  bodyStream = NULL;
+  // Closed once the response is out too
+  if (!complete || cgiHandler == NULL)
+    closeConnection();
 }
 
 std::string RequestHandler::extractQueryString(const std::string& uri) {
@@ -401,6 +719,22 @@ std::string RequestHandler::extractQueryString(const std::string& uri) {
     return "";
 }
 
+// Draws a token from the client's bucket for rate limited routes. When the
+// bucket is empty the prebuilt 429 is sent and true returned.
+bool RequestHandler::isRateLimited(const RouteRecord& record) {
+  if (!record.has(ROUTE_RATE_LIMIT))
+    return false;
+  if (ServerManager::getInstance().getClientLimiter().allowRequest(clientAddress, *record.route))
+    return false;
+  const std::string& response = ClientLimiter::getTooManyRequestsResponse();
+  AccessLog::sending(EventHandler::getHandle(), response.data(), response.size());
+  if (!output.write(response))
+    Logger::log(ERROR, "Error sending 429 response: " + std::string(strerror(errno)));
+  // Counted by the limiter and summarized from its tick()
+  LOG(DEBUG, "429 - Rate limit exceeded by " + ParsingUtils::formatIPv4(clientAddress) + " for URI: " + parser.getUri());
+  return true;
+}
+
 bool RequestHandler::isPayloadTooLarge(const Server* server, const Route& route) {
     std::string contentLengthHeader = parser.getHeader("Content-Length");
     long long contentLength = 0;
@@ -409,13 +743,13 @@ bool RequestHandler::isPayloadTooLarge(const Server* server, const Route& route)
         if (route.getHasMaxBodySize())
         {
           if (contentLength > route.getMaxBodySize()) {
-            HTTPResponse::sendErrorResponse(413, server, EventHandler::getHandle());
+            HTTPResponse::sendErrorResponse(413, server, output);
             Logger::log(ERROR, "413 - Payload is too large: " + contentLengthHeader + " Maximum allowed: " + ParsingUtils::toString(route.getMaxBodySize()) + " bytes");
             return true; // Payload is too large
           }
         }
         if (contentLength > server->getMaxClientBodySize()) {
-            HTTPResponse::sendErrorResponse(413, server, EventHandler::getHandle());
+            HTTPResponse::sendErrorResponse(413, server, output);
             Logger::log(ERROR, "413 - Payload is too large: " + contentLengthHeader + " Maximum allowed: " + ParsingUtils::toString(server->getMaxClientBodySize()) + " bytes");
             return true; // Payload is too large
         }
@@ -462,7 +796,7 @@ void RequestHandler::handleFileUpload(const Route& route, const Server* server)
 
   if (boundary.empty()) {
     Logger::log(ERROR, "400 - No boundary found in multipart form data");
-    HTTPResponse::sendErrorResponse(400, server, EventHandler::getHandle()); // Bad Request
+    HTTPResponse::sendErrorResponse(400, server, output); // Bad Request
     return;
   }
 
@@ -483,51 +817,56 @@ void RequestHandler::handleFileUpload(const Route& route, const Server* server)
     }
   }
 
-  if (!ParsingUtils::doesPathExist(filePath)) {
+  FileInfoCache& files = ServerManager::getInstance().getFileInfoCache();
+  FileInfo info = files.lookup(filePath);
+  if (!info.exists()) {
     Logger::log(ERROR, "Directory does not exist: " + filePath);
-    HTTPResponse::sendErrorResponse(403, server, EventHandler::getHandle());
+    HTTPResponse::sendErrorResponse(403, server, output);
     return;
   }
 
-  if (!ParsingUtils::hasWritePermissions(filePath)) {
+  if (!info.isWritable()) {
     Logger::log(ERROR, "Directory is not writable: " + filePath);
-    HTTPResponse::sendErrorResponse(403, server, EventHandler::getHandle());
+    HTTPResponse::sendErrorResponse(403, server, output);
     return;
   }
 
   filePath += getFilename(multipartParser);
   // Directory exists and is writable
-  Logger::log(INFO, "File upload on POST request: " + filePath);
+  LOG(DEBUG, "File upload on POST request: " + filePath);
   std::string fileContent = parser.getBody();
   std::ofstream fileStream(filePath.c_str(), std::ios::out | std::ios::binary);
   if (!fileStream) {
     Logger::log(ERROR, "500 - Error opening file for writing: " + filePath);
-    HTTPResponse::sendErrorResponse(500, server, EventHandler::getHandle());
+    HTTPResponse::sendErrorResponse(500, server, output);
     return;
   }
   fileStream << fileContent;
   fileStream.close();
+  files.invalidate(filePath);
+  ServerManager::getInstance().getOpenFileCache().invalidate(filePath);
   std::string successPageHtml = 
 	  "<!DOCTYPE html><html lang=\"en\"><head><meta charset=\"UTF-8\"><title>Upload Success</title></head><body>"
 	  "<h1>Upload Successful</h1><p>200 OK - Your file has been uploaded successfully.</p>"
 	  "</body></html>";
-  HTTPResponse::sendSuccessResponse("200 OK", "text/html", successPageHtml, cookie, EventHandler::getHandle());
+  HTTPResponse::sendSuccessResponse("200 OK", "text/html", successPageHtml, cookie, output);
   return;
 }
 
 void RequestHandler::handlePostRequest(const Server* server) {
-  Route route;
-  
-  try {
-    route = server->getRoute(parser.getUri());
-  } catch (const std::out_of_range& e) {
-    HTTPResponse::sendErrorResponse(404, server, EventHandler::getHandle());
+  const RouteRecord* record = server->matchRoute(removeQueryString(parser.getUri()));
+  access.lap(access.routeUs);
+  if (record == NULL) {
+    HTTPResponse::sendErrorResponse(404, server, output);
     Logger::log(ERROR, "404 - No route found for URI: " + parser.getUri());
     return;
   }
+  const Route& route = *record->route;
+  if (isRateLimited(*record))
+    return;
 
-  if (!route.getPostMethod()) {
-    HTTPResponse::sendErrorResponse(405, server, EventHandler::getHandle());
+  if (!record->has(ROUTE_POST)) {
+    HTTPResponse::sendErrorResponse(405, server, output);
     Logger::log(ERROR, "405 - Method not allowed for URI: " + parser.getUri());
     return;
   }
@@ -536,12 +875,15 @@ void RequestHandler::handlePostRequest(const Server* server) {
     return;
   }
 
-  if (route.getAllowFileUpload()) {
+  if (record->has(ROUTE_FILE_UPLOAD)) {
     handleFileUpload(route, server);
   }
+  else if (record->has(ROUTE_CGI)) {
+    handleCGIRequest(route, server);
+  }
   else {
-    Logger::log(INFO, "POST request on URI: " + parser.getUri());
-    HTTPResponse::sendSuccessResponse("200 OK", "text/html", " 200 OK - POST request received with body: " + parser.getBody(), cookie, EventHandler::getHandle());
+    LOG(DEBUG, "POST request on URI: " + parser.getUri());
+    HTTPResponse::sendSuccessResponse("200 OK", "text/html", " 200 OK - POST request received with body: " + parser.getBody(), cookie, output);
   }
 }
 
@@ -577,34 +919,29 @@ std::string RequestHandler::extractDirectoryPath(const std::string& filePath) {
 
 void RequestHandler::handleDeleteRequest(const Server* server) {
 	std::string originalPath = removeQueryString(parser.getUri()); // Get the original URI
-	Route route;
-	try {
-		// First try to find the route directly with the original URI
-		route = server->getRoute(originalPath);
-	} catch (const std::out_of_range&) {
-		// If not found, try extracting the directory path and then finding the route
-		std::string directoryPath = extractDirectoryPath(originalPath);
-		try {
-			route = server->getRoute(directoryPath);
-		} catch (const std::out_of_range& e) {
-			// No route found for either the original URI or the directory path
-			HTTPResponse::sendErrorResponse(404, server, EventHandler::getHandle());
-			Logger::log(ERROR, "404 - No route found for URI: " + originalPath);
-			return;
-		}
+	const RouteRecord* record = server->matchRoute(originalPath);
+	access.lap(access.routeUs);
+	if (record == NULL) {
+		HTTPResponse::sendErrorResponse(404, server, output);
+		Logger::log(ERROR, "404 - No route found for URI: " + originalPath);
+		return;
 	}
+	const Route& route = *record->route;
+	if (isRateLimited(*record))
+		return;
 
-	std::string filePath = getFilePathFromUri(route, parser.getUri());
-  Logger::log(INFO, "Looking to DELETE: " + filePath);
-	if (!route.getDeleteMethod()) {
-		HTTPResponse::sendErrorResponse(405, server, EventHandler::getHandle());
+	std::string filePath = getFilePathFromUri(route, originalPath);
+  LOG(DEBUG, "Looking to DELETE: " + filePath);
+	if (!record->has(ROUTE_DELETE)) {
+		HTTPResponse::sendErrorResponse(405, server, output);
 		Logger::log(ERROR, "405 - Method not allowed for URI: " + parser.getUri());
 		return;
 	}
 
-	if (!ParsingUtils::doesPathExist(filePath)) {
+	FileInfoCache& files = ServerManager::getInstance().getFileInfoCache();
+	if (!files.lookup(filePath).exists()) {
 		Logger::log(ERROR, "404 - File not found: " + filePath);
-		HTTPResponse::sendErrorResponse(404, server, EventHandler::getHandle());
+		HTTPResponse::sendErrorResponse(404, server, output);
 		return;
 	}
 
@@ -613,17 +950,20 @@ void RequestHandler::handleDeleteRequest(const Server* server) {
 	//check if write and execute permissions are set in the directory in order to delete file.
 	if (!ParsingUtils::hasWriteAndExecutePermissions(dir)) {
 		Logger::log(ERROR, "403 - Insufficient permissions to delete file: " + dir);
-		HTTPResponse::sendErrorResponse(403, server, EventHandler::getHandle());
+		HTTPResponse::sendErrorResponse(403, server, output);
 		return;
 	}
 
 	if (unlink(filePath.c_str()) != 0) {
 		Logger::log(ERROR, "500 - Error deleting file: " + filePath);
-		HTTPResponse::sendErrorResponse(500, server, EventHandler::getHandle());
+		HTTPResponse::sendErrorResponse(500, server, output);
 		return;
 	}
+	// Don't wait for inotify, the next request may already be in the buffer
+	files.invalidate(filePath);
+	ServerManager::getInstance().getOpenFileCache().invalidate(filePath);
 
-	HTTPResponse::sendSuccessResponse("200 OK", "text/html", "200 - OK File deleted successfully", cookie, EventHandler::getHandle());
+	HTTPResponse::sendSuccessResponse("200 OK", "text/html", "200 - OK File deleted successfully", cookie, output);
 	return;
 }
 
@@ -632,7 +972,6 @@ void RequestHandler::handleRequest(const Server* server) {
     Logger::log(ERROR, "Server is NULL");
     return;
   }
-  Route route;
   if (parser.getMethod() == "GET") {
     handleGetRequest(server);
   }
@@ -654,21 +993,49 @@ std::string RequestHandler::getFilename(const MultipartFormDataParser& parser) {
   return filename;
 }
 
-RequestHandler::RequestHandler() {}
+RequestHandler::RequestHandler() : reactor(NULL), closeConnectionFlag(true), hasSignedSession(false), localPort(-1), clientAddress(0), waitingForCgi(false), waitingForFastCgi(false), cgiHandler(NULL), bodyStream(NULL), cgiBodyStarted(false), cgiQueued(false), queuedRoute(NULL), queuedServer(NULL), config(NULL), resolvedServer(NULL), closeAfterOutput(false) {}
 
 std::string RequestHandler::extractSessionIdFromCookie(const std::string& cookie) {
-  size_t pos = cookie.find('=');
-  if (pos != std::string::npos) {
-    return cookie.substr(pos + 1);
-  }
-  return "";
+  return Cookie::findValue(cookie, "session_id");
+}
+
+// Ends the current request's access_log record, if it has one open
+void RequestHandler::logAccess(void) {
+  ServerManager::getInstance().getAccessLog().finish(access, EventHandler::getHandle());
 }
 
-bool RequestHandler::shouldCloseConnection() {
-    return reactor->isClientInactive(EventHandler::getHandle());
+// The socket is full: EPOLLOUT resumes the response, reads wait for its end
+void RequestHandler::waitForOutput(void) {
+  reactor->disableEvents(EventHandler::getHandle(), EPOLLIN);
+  reactor->enableEvents(EventHandler::getHandle(), EPOLLOUT);
+}
+
+void RequestHandler::flushOutput(void) {
+  if (!output.flush()) {
+    Logger::log(WARNING, "Client gone while sending response: " + std::string(strerror(errno)));
+    closeConnection();
+    return;
+  }
+  // The client is reading, however slowly
+  reactor->updateLastActivity(EventHandler::getHandle());
+  if (output.isPending())
+    return;
+  logAccess();
+  reactor->disableEvents(EventHandler::getHandle(), EPOLLOUT);
+  if (closeAfterOutput) {
+    closeAfterOutput = false;
+    closeConnection();
+    return;
+  }
+  reactor->enableEvents(EventHandler::getHandle(), EPOLLIN);
 }
 
 void RequestHandler::closeConnection(void) {
+  if (output.isPending()) {
+    closeAfterOutput = true;
+    waitForOutput();
+    return;
+  }
   if (closeConnectionFlag)
   {
     reactor->removeFromInactivityList(EventHandler::getHandle());
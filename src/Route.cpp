@@ -1,5 +1,8 @@
 #include "Route.hpp"
 #include "ParsingUtils.hpp"
+#include <cmath>
+
+CgiLimits::CgiLimits() : timeoutSeconds(60), cpuSeconds(0), memoryBytes(0), maxScripts(0), queueSize(32) {}
 
 Route::Route()
 {
@@ -14,6 +17,15 @@ Route::Route()
     this->hasMaxBodySize = false;
     this->hasRootDirectoryPath = false;
     this->maxBodySize = 1000000;
+    this->hasRateLimit = false;
+    this->rateLimit = 0;
+    this->rateBurst = 0;
+    this->statusPage = false;
+    this->cgiCacheTtl = 0;
+    this->cgiCacheStale = -1;
+    this->cgiCacheIgnoreCookie = false;
+    this->fastCgiWorkers = 4;
+    this->fastCgiConnections = 0;
     std::string cwd = ParsingUtils::getCurrentWorkingDirectory();
     this->rootDirectoryPath = cwd + "/webserver/";
     this->uploadLocation = cwd + "/webserver/uploads/";
@@ -35,6 +47,62 @@ void Route::setHasMaxBodySize(bool value)
   this->hasMaxBodySize = value;
 }
 
+void Route::setRateLimit(double requestsPerSecond)
+{
+    this->hasRateLimit = true;
+    this->rateLimit = requestsPerSecond;
+}
+
+void Route::setRateBurst(int burst)
+{
+    this->rateBurst = burst;
+}
+
+void Route::setStatusPage(bool value)
+{
+    this->statusPage = value;
+}
+
+void Route::setCgiCacheTtl(int seconds)
+{
+    this->cgiCacheTtl = seconds;
+}
+
+void Route::setCgiCacheStale(int seconds)
+{
+    this->cgiCacheStale = seconds;
+}
+
+void Route::setCgiCacheVary(const std::vector<std::string>& headers)
+{
+    this->cgiCacheVary = headers;
+}
+
+void Route::setCgiCacheIgnoreCookie(bool value)
+{
+    this->cgiCacheIgnoreCookie = value;
+}
+
+void Route::setFastCgiAddress(const std::string& address)
+{
+    this->fastCgiAddress = address;
+}
+
+void Route::setFastCgiWorkers(int workers)
+{
+    this->fastCgiWorkers = workers;
+}
+
+void Route::setFastCgiConnections(int connections)
+{
+    this->fastCgiConnections = connections;
+}
+
+void Route::setCgiLimits(const CgiLimits& limits)
+{
+    this->cgiLimits = limits;
+}
+
 void Route::setMaxBodySize(int size)
 {
     this->maxBodySize = size;
@@ -200,3 +268,80 @@ bool Route::getHasRootDirectoryPath() const
 {
     return this->hasRootDirectoryPath;
 }
+
+bool Route::getHasRateLimit() const
+{
+    return this->hasRateLimit;
+}
+
+double Route::getRateLimit() const
+{
+    return this->rateLimit;
+}
+
+// Without rate_burst a client may spend one second's worth of requests at once
+int Route::getRateBurst() const
+{
+    if (this->rateBurst > 0)
+        return this->rateBurst;
+    int burst = static_cast<int>(std::ceil(this->rateLimit));
+    return burst > 0 ? burst : 1;
+}
+
+bool Route::getStatusPage() const
+{
+    return this->statusPage;
+}
+
+bool Route::getHasCgiCache() const
+{
+    return this->cgiCacheTtl > 0;
+}
+
+int Route::getCgiCacheTtl() const
+{
+    return this->cgiCacheTtl;
+}
+
+// Stale copies are served for as long again as they were fresh by default
+int Route::getCgiCacheStale() const
+{
+    if (this->cgiCacheStale < 0)
+        return this->cgiCacheTtl;
+    return this->cgiCacheStale;
+}
+
+const std::vector<std::string>& Route::getCgiCacheVary() const
+{
+    return this->cgiCacheVary;
+}
+
+bool Route::getCgiCacheIgnoreCookie() const
+{
+    return this->cgiCacheIgnoreCookie;
+}
+
+bool Route::getHasFastCgi() const
+{
+    return !this->fastCgiAddress.empty();
+}
+
+std::string Route::getFastCgiAddress() const
+{
+    return this->fastCgiAddress;
+}
+
+int Route::getFastCgiWorkers() const
+{
+    return this->fastCgiWorkers;
+}
+
+int Route::getFastCgiConnections() const
+{
+    return this->fastCgiConnections;
+}
+
+const CgiLimits& Route::getCgiLimits() const
+{
+    return this->cgiLimits;
+}
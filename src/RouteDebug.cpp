@@ -24,4 +24,19 @@ void RouteDebug::printRouteInfo(const Route& route) {
   std::cout << "Has Max Body Size: " << std::boolalpha << route.getHasMaxBodySize() << std::endl;
   std::cout << "Max Body Size: " << route.getMaxBodySize() << std::endl;
   std::cout << "Has Root Directory Path: " << std::boolalpha << route.getHasRootDirectoryPath() << std::endl;
+  std::cout << "Has Rate Limit: " << std::boolalpha << route.getHasRateLimit() << std::endl;
+  std::cout << "Rate Limit: " << route.getRateLimit() << "/s, burst " << route.getRateBurst() << std::endl;
+  std::cout << "Status Page: " << std::boolalpha << route.getStatusPage() << std::endl;
+  std::cout << "CGI Cache: " << route.getCgiCacheTtl() << "s, stale " << route.getCgiCacheStale() << "s, vary ";
+  const std::vector<std::string>& vary = route.getCgiCacheVary();
+  for (std::size_t i = 0; i < vary.size(); ++i) {
+    std::cout << vary[i];
+    if (i != vary.size() - 1) std::cout << ", ";
+  }
+  std::cout << std::endl;
+  std::cout << "FastCGI: " << route.getFastCgiAddress() << ", workers " << route.getFastCgiWorkers()
+    << ", connections " << route.getFastCgiConnections() << std::endl;
+  const CgiLimits& limits = route.getCgiLimits();
+  std::cout << "CGI Limits: timeout " << limits.timeoutSeconds << "s, cpu " << limits.cpuSeconds << "s, memory "
+    << limits.memoryBytes << " bytes, " << limits.maxScripts << " scripts, queue " << limits.queueSize << std::endl;
 }
@@ -0,0 +1,146 @@
+#include "Router.hpp"
+
+struct Router::BuildNode {
+  int record;
+  std::map<std::string, BuildNode*> children;
+
+  BuildNode() : record(-1) {}
+  ~BuildNode() {
+    for (std::map<std::string, BuildNode*>::iterator it = children.begin(); it != children.end(); ++it)
+      delete it->second;
+  }
+};
+
+Router::Router() {}
+
+uint16_t Router::packFlags(const Route& route) {
+  uint16_t flags = 0;
+  if (route.getGetMethod()) flags |= ROUTE_GET;
+  if (route.getPostMethod()) flags |= ROUTE_POST;
+  if (route.getDeleteMethod()) flags |= ROUTE_DELETE;
+  if (route.getRedirect()) flags |= ROUTE_REDIRECT;
+  if (route.getDirectoryListing()) flags |= ROUTE_DIRECTORY_LISTING;
+  if (route.getHasDefaultFile()) flags |= ROUTE_DEFAULT_FILE;
+  if (route.getHasCGI()) flags |= ROUTE_CGI;
+  if (route.getAllowFileUpload()) flags |= ROUTE_FILE_UPLOAD;
+  if (route.getHasMaxBodySize()) flags |= ROUTE_MAX_BODY_SIZE;
+  if (route.getHasRateLimit()) flags |= ROUTE_RATE_LIMIT;
+  if (route.getStatusPage()) flags |= ROUTE_STATUS;
+  if (route.getHasCgiCache()) flags |= ROUTE_CGI_CACHE;
+  return flags;
+}
+
+// Yields the next non-empty segment of path starting at pos
+bool Router::nextSegment(const std::string& path, size_t& pos, size_t& start, size_t& length) {
+  while (pos < path.size() && path[pos] == '/')
+    ++pos;
+  if (pos >= path.size())
+    return false;
+  start = pos;
+  while (pos < path.size() && path[pos] != '/')
+    ++pos;
+  length = pos - start;
+  return true;
+}
+
+void Router::compile(const std::map<std::string, Route>& routes) {
+  records.clear();
+  nodes.clear();
+  edges.clear();
+
+  BuildNode root;
+  for (std::map<std::string, Route>::const_iterator it = routes.begin(); it != routes.end(); ++it) {
+    BuildNode* node = &root;
+    size_t pos = 0, start, length;
+    while (nextSegment(it->first, pos, start, length)) {
+      std::string segment = it->first.substr(start, length);
+      BuildNode*& child = node->children[segment];
+      if (child == NULL)
+        child = new BuildNode();
+      node = child;
+    }
+    RouteRecord record;
+    record.route = &it->second;
+    record.flags = packFlags(it->second);
+    node->record = static_cast<int>(records.size());
+    records.push_back(record);
+  }
+  flatten(&root);
+}
+
+size_t Router::flatten(const BuildNode* buildNode) {
+  size_t index = nodes.size();
+  Node node;
+  node.record = buildNode->record;
+  node.firstEdge = edges.size();
+  node.edgeCount = buildNode->children.size();
+  nodes.push_back(node);
+
+  // Reserve this node's edges contiguously before descending
+  std::vector<const BuildNode*> targets;
+  for (std::map<std::string, BuildNode*>::const_iterator it = buildNode->children.begin(); it != buildNode->children.end(); ++it) {
+    Edge edge;
+    edge.label.push_back(it->first);
+    const BuildNode* target = it->second;
+    while (target->record == -1 && target->children.size() == 1) {
+      edge.label.push_back(target->children.begin()->first);
+      target = target->children.begin()->second;
+    }
+    edge.child = 0;
+    edges.push_back(edge);
+    targets.push_back(target);
+  }
+  for (size_t i = 0; i < targets.size(); ++i) {
+    size_t child = flatten(targets[i]);
+    edges[nodes[index].firstEdge + i].child = child;
+  }
+  return index;
+}
+
+const Router::Edge* Router::findEdge(const Node& node, const std::string& path, size_t start, size_t length) const {
+  size_t low = node.firstEdge;
+  size_t high = node.firstEdge + node.edgeCount;
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    int cmp = path.compare(start, length, edges[mid].label[0]);
+    if (cmp == 0)
+      return &edges[mid];
+    if (cmp > 0)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  return NULL;
+}
+
+const RouteRecord* Router::match(const std::string& path) const {
+  if (nodes.empty())
+    return NULL;
+  int best = nodes[0].record;
+  size_t current = 0;
+  size_t pos = 0, start, length;
+  while (nextSegment(path, pos, start, length)) {
+    const Edge* edge = findEdge(nodes[current], path, start, length);
+    if (edge == NULL)
+      break;
+    bool matched = true;
+    for (size_t i = 1; i < edge->label.size(); ++i) {
+      if (!nextSegment(path, pos, start, length) || path.compare(start, length, edge->label[i]) != 0) {
+        matched = false;
+        break;
+      }
+    }
+    if (!matched)
+      break;
+    current = edge->child;
+    if (nodes[current].record != -1)
+      best = nodes[current].record;
+  }
+  if (best == -1)
+    return NULL;
+  return &records[best];
+}
+
+size_t Router::size() const {
+  return records.size();
+}
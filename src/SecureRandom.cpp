@@ -0,0 +1,131 @@
+#include "SecureRandom.hpp"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/random.h>
+
+namespace {
+  uint32_t rotate(uint32_t value, int bits) {
+    return (value << bits) | (value >> (32 - bits));
+  }
+
+  void quarterRound(uint32_t* x, int a, int b, int c, int d) {
+    x[a] += x[b]; x[d] = rotate(x[d] ^ x[a], 16);
+    x[c] += x[d]; x[b] = rotate(x[b] ^ x[c], 12);
+    x[a] += x[b]; x[d] = rotate(x[d] ^ x[a], 8);
+    x[c] += x[d]; x[b] = rotate(x[b] ^ x[c], 7);
+  }
+
+  // getrandom() blocks only until the pool is first initialised; kernels
+  // older than 3.17 fall back to /dev/urandom
+  void kernelRandom(unsigned char* out, size_t length) {
+    size_t filled = 0;
+    while (filled < length) {
+      ssize_t got = getrandom(out + filled, length - filled, 0);
+      if (got > 0) {
+        filled += got;
+        continue;
+      }
+      if (got == -1 && errno == EINTR)
+        continue;
+      if (got == -1 && errno != ENOSYS)
+        throw std::runtime_error("getrandom failed: " + std::string(strerror(errno)));
+      int fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+      if (fd == -1)
+        throw std::runtime_error("Cannot open /dev/urandom: " + std::string(strerror(errno)));
+      while (filled < length) {
+        ssize_t bytesRead = read(fd, out + filled, length - filled);
+        if (bytesRead > 0)
+          filled += bytesRead;
+        else if (bytesRead == 0 || errno != EINTR) {
+          close(fd);
+          throw std::runtime_error("Cannot read /dev/urandom");
+        }
+      }
+      close(fd);
+    }
+  }
+
+  uint32_t loadLittleEndian(const unsigned char* in) {
+    return in[0] | (in[1] << 8) | (in[2] << 16) | (static_cast<uint32_t>(in[3]) << 24);
+  }
+}
+
+SecureRandom::SecureRandom() : available(0), sinceReseed(0) {
+  reseed();
+}
+
+SecureRandom::~SecureRandom() {
+  std::memset(key, 0, sizeof(key));
+  std::memset(buffer, 0, sizeof(buffer));
+}
+
+void SecureRandom::fill(unsigned char* out, size_t length) {
+  while (length > 0) {
+    if (available == 0)
+      refill();
+    size_t take = length < available ? length : available;
+    unsigned char* source = buffer + sizeof(buffer) - available;
+    std::memcpy(out, source, take);
+    std::memset(source, 0, take);
+    available -= take;
+    out += take;
+    length -= take;
+  }
+}
+
+void SecureRandom::block(const uint32_t key[8], uint32_t counter, const uint32_t nonce[3], unsigned char out[BLOCK_SIZE]) {
+  uint32_t state[16] = { 0x61707865, 0x3320646e, 0x79622d32, 0x6b206574 };
+  for (int i = 0; i < 8; ++i)
+    state[4 + i] = key[i];
+  state[12] = counter;
+  state[13] = nonce[0];
+  state[14] = nonce[1];
+  state[15] = nonce[2];
+  uint32_t x[16];
+  std::memcpy(x, state, sizeof(x));
+  for (int round = 0; round < 10; ++round) {
+    quarterRound(x, 0, 4, 8, 12);
+    quarterRound(x, 1, 5, 9, 13);
+    quarterRound(x, 2, 6, 10, 14);
+    quarterRound(x, 3, 7, 11, 15);
+    quarterRound(x, 0, 5, 10, 15);
+    quarterRound(x, 1, 6, 11, 12);
+    quarterRound(x, 2, 7, 8, 13);
+    quarterRound(x, 3, 4, 9, 14);
+  }
+  for (int i = 0; i < 16; ++i) {
+    uint32_t word = x[i] + state[i];
+    out[4 * i] = word & 0xff;
+    out[4 * i + 1] = (word >> 8) & 0xff;
+    out[4 * i + 2] = (word >> 16) & 0xff;
+    out[4 * i + 3] = word >> 24;
+  }
+}
+
+void SecureRandom::reseed(void) {
+  unsigned char seed[sizeof(key)];
+  kernelRandom(seed, sizeof(seed));
+  for (int i = 0; i < 8; ++i)
+    key[i] = loadLittleEndian(seed + 4 * i);
+  std::memset(seed, 0, sizeof(seed));
+  sinceReseed = 0;
+}
+
+// Every key is used for one refill only, so the nonce and counter can start
+// at zero each time
+void SecureRandom::refill(void) {
+  if (sinceReseed >= RESEED_BYTES)
+    reseed();
+  static const uint32_t nonce[3] = { 0, 0, 0 };
+  for (size_t i = 0; i < BLOCKS; ++i)
+    block(key, i, nonce, buffer + i * BLOCK_SIZE);
+  for (int i = 0; i < 8; ++i)
+    key[i] = loadLittleEndian(buffer + 4 * i);
+  std::memset(buffer, 0, sizeof(key));
+  available = sizeof(buffer) - sizeof(key);
+  sinceReseed += available;
+}
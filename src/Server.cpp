@@ -9,6 +9,10 @@ Server::Server()
       this->serverName = "";
       this->customErrorPage = false;
       this->maxClientBodySize = 1000000;
+      this->defaultServer = false;
+      this->configOrder = 0;
+      this->maxConnectionsPerClient = 0;
+      this->signedSessions = false;
       this->errorPageManager = ErrorPageManager();
 }
 
@@ -44,6 +48,16 @@ void Server::setMaxClientBodySize(size_t size)
 	    this->maxClientBodySize = size;
 }
 
+void Server::setDefaultServer(bool value)
+{
+	    this->defaultServer = value;
+}
+
+void Server::setConfigOrder(size_t order)
+{
+	    this->configOrder = order;
+}
+
 void Server::addRoute(const std::string& path, const Route& route)
 {
 	    this->routes[path] = route;
@@ -96,17 +110,124 @@ long long Server::getMaxClientBodySize() const
 	    return this->maxClientBodySize;
 }
 
+bool Server::isDefaultServer(void) const
+{
+	    return this->defaultServer;
+}
+
+size_t Server::getConfigOrder(void) const
+{
+	    return this->configOrder;
+}
+
+void Server::setMaxConnectionsPerClient(size_t limit)
+{
+	    this->maxConnectionsPerClient = limit;
+}
+
+size_t Server::getMaxConnectionsPerClient(void) const
+{
+	    return this->maxConnectionsPerClient;
+}
+
+void Server::setListenerOptions(const ListenerOptions& options)
+{
+	    this->listenerOptions = options;
+}
+
+const ListenerOptions& Server::getListenerOptions(void) const
+{
+	    return this->listenerOptions;
+}
+
+void Server::setSignedSessions(bool value)
+{
+	    this->signedSessions = value;
+}
+
+bool Server::hasSignedSessions(void) const
+{
+	    return this->signedSessions;
+}
+
+void Server::setSessionKeys(const std::vector<std::string>& keys)
+{
+	    this->sessionKeys = keys;
+}
+
+const std::vector<std::string>& Server::getSessionKeys(void) const
+{
+	    return this->sessionKeys;
+}
+
+void Server::setSessionFile(const std::string& path)
+{
+	    this->sessionFile = path;
+}
+
+const std::string& Server::getSessionFile(void) const
+{
+	    return this->sessionFile;
+}
+
+void Server::setLogLevel(const std::string& level)
+{
+	    this->logLevel = level;
+}
+
+const std::string& Server::getLogLevel(void) const
+{
+	    return this->logLevel;
+}
+
+void Server::setAccessLogOptions(const AccessLogOptions& options)
+{
+	    this->accessLogOptions = options;
+}
+
+const AccessLogOptions& Server::getAccessLogOptions(void) const
+{
+	    return this->accessLogOptions;
+}
+
 Route Server::getRoute(const std::string& path) const
 {
 	    return this->routes.at(path);
 }
 
+// Must run again after routes are added, RouteRecords point into routes
+void Server::compileRoutes(void)
+{
+  this->router.compile(this->routes);
+}
+
+const RouteRecord* Server::matchRoute(const std::string& path) const
+{
+  return this->router.match(path);
+}
+
+const std::string* Server::getCachedErrorResponse(int errorCode) const
+{
+  std::map<int, std::string>::const_iterator it = this->errorResponses.find(errorCode);
+  return it == this->errorResponses.end() ? NULL : &it->second;
+}
+
+const std::string& Server::cacheErrorResponse(int errorCode, const std::string& response) const
+{
+  return this->errorResponses[errorCode] = response;
+}
+
 ErrorPageManager Server::getErrorPageManager() const
 {
   return this->errorPageManager;
 }
 
-const std::map<std::string, std::string>& Server::getMimeTypes() const
+void Server::setMimeType(const std::string& extension, const std::string& type)
+{
+  this->mimeTypes.setType(extension, type);
+}
+
+const MimeTypes& Server::getMimeTypes() const
 {
   return this->mimeTypes;
 }
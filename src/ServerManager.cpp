@@ -1,4 +1,24 @@
 #include "ServerManager.hpp"
+#include "AcceptHandler.hpp"
+#include "ListenerFactory.hpp"
+#include "Reactor.hpp"
+#include "Logger.hpp"
+#include "ParsingUtils.hpp"
+
+namespace {
+  bool isWildcard(const std::string& host) {
+    return host.empty() || host == "0.0.0.0";
+  }
+
+  // Whether a listener can be bound while the previous one still holds the
+  // port: both reuse it, or they are on two distinct addresses
+  bool bindsAlongside(const std::string& host, const ListenerOptions& options,
+                      const std::string& previousHost, const ListenerOptions& previousOptions) {
+    if (options.reusePort && previousOptions.reusePort)
+      return true;
+    return !isWildcard(host) && !isWildcard(previousHost) && host != previousHost;
+  }
+}
 
 ServerManager& ServerManager::getInstance() {
   static ServerManager instance;
@@ -9,14 +29,288 @@ SessionManager& ServerManager::getSessionManager() {
   return sessionManager;
 }
 
-void ServerManager::setServersMap(std::map<std::string, Server*>* map) {
-  serversMap = map;
+DirectoryListingCache& ServerManager::getDirectoryListingCache() {
+  return directoryListingCache;
+}
+
+TemplateCache& ServerManager::getTemplateCache() {
+  return templateCache;
+}
+
+FileInfoCache& ServerManager::getFileInfoCache() {
+  return fileInfoCache;
+}
+
+OpenFileCache& ServerManager::getOpenFileCache() {
+  return openFileCache;
+}
+
+NegativeLookupCache& ServerManager::getNegativeLookupCache() {
+  return negativeLookupCache;
+}
+
+ClientLimiter& ServerManager::getClientLimiter() {
+  return clientLimiter;
+}
+
+CgiResponseCache& ServerManager::getCgiResponseCache() {
+  return cgiResponseCache;
+}
+
+CgiScheduler& ServerManager::getCgiScheduler() {
+  return cgiScheduler;
+}
+
+AccessLog& ServerManager::getAccessLog() {
+  return accessLog;
+}
+
+void ServerManager::setProcessReaper(ProcessReaper* reaper) {
+  processReaper = reaper;
+}
+
+ProcessReaper* ServerManager::getProcessReaper() const {
+  return processReaper;
+}
+
+FastCgiBackend* ServerManager::getFastCgiBackend(const Route& route) {
+  std::map<std::string, FastCgiBackend*>::iterator it = fastCgiBackends.find(FastCgiBackend::makeKey(route));
+  return it == fastCgiBackends.end() ? NULL : it->second;
+}
+
+void ServerManager::removeFastCgiListener(CgiResponseListener* listener) {
+  for (std::map<std::string, FastCgiBackend*>::iterator it = fastCgiBackends.begin(); it != fastCgiBackends.end(); ++it)
+    it->second->removeListener(listener);
+}
+
+// Takes over the caller's reference; the previous snapshot lives on until
+// the last connection still using it lets go
+void ServerManager::setConfig(ConfigSnapshot* snapshot) {
+  ConfigSnapshot* previous = config;
+  config = snapshot;
+  // Cached MIME types point into the previous configuration's tables
+  fileInfoCache.clear();
+  // Roots may have moved with the new routes
+  negativeLookupCache.clear();
+  // Rate limit buckets are keyed by the previous configuration's routes
+  clientLimiter.resetBuckets();
+  syncSessionFile();
+  syncLogLevel();
+  syncAccessLog();
+  if (previous != NULL)
+    previous->release();
+}
+
+// A table that is already in a file stays there when the directive goes
+// away: moving it back to memory would lose it at the next restart
+void ServerManager::syncSessionFile(void) {
+  if (config == NULL)
+    return;
+  std::string file;
+  const std::map<std::string, Server*>& servers = config->getServers();
+  for (std::map<std::string, Server*>::const_iterator it = servers.begin(); it != servers.end(); ++it) {
+    const std::string& wanted = it->second->getSessionFile();
+    if (wanted.empty())
+      continue;
+    if (file.empty())
+      file = wanted;
+    else if (wanted != file)
+      Logger::log(WARNING, "Ignoring session_file " + wanted + " of server " + it->first + ", sessions are kept in " + file);
+  }
+  if (!file.empty() && file != sessionManager.getFilePath())
+    sessionManager.attach(file);
+}
+
+// The logger is process-wide: the first server setting log_level decides
+void ServerManager::syncLogLevel(void) {
+  Level level = INFO;
+  const std::string* source = NULL;
+  if (config != NULL) {
+    const std::map<std::string, Server*>& servers = config->getServers();
+    for (std::map<std::string, Server*>::const_iterator it = servers.begin(); it != servers.end(); ++it) {
+      Level wanted;
+      if (!Logger::parseLevel(it->second->getLogLevel(), wanted))
+        continue;
+      if (source == NULL) {
+        level = wanted;
+        source = &it->first;
+      }
+      else if (wanted != level)
+        Logger::log(WARNING, "Ignoring log_level " + it->second->getLogLevel() + " of server " + it->first + ", the level of server " + *source + " applies");
+    }
+  }
+  Logger::setLevel(level);
+}
+
+// One access log for the process, as the first server configuring it says
+void ServerManager::syncAccessLog(void) {
+  AccessLogOptions options;
+  const std::string* source = NULL;
+  if (config != NULL) {
+    const std::map<std::string, Server*>& servers = config->getServers();
+    for (std::map<std::string, Server*>::const_iterator it = servers.begin(); it != servers.end(); ++it) {
+      const AccessLogOptions& wanted = it->second->getAccessLogOptions();
+      if (wanted.path.empty())
+        continue;
+      if (source == NULL) {
+        options = wanted;
+        source = &it->first;
+      }
+      else if (!(wanted == options))
+        Logger::log(WARNING, "Ignoring the access_log settings of server " + it->first + ", the access log of server " + *source + " applies");
+    }
+  }
+  accessLog.configure(options);
+}
+
+ConfigSnapshot* ServerManager::getConfig() const {
+  return config;
+}
+
+void ServerManager::setConfigPath(const std::string& path) {
+  configPath = path;
+}
+
+void ServerManager::syncListeners(Reactor& reactor) {
+  // Each port is bound and tuned as its default server says
+  std::map<int, const Server*> wanted;
+  if (config != NULL) {
+    const std::map<std::string, Server*>& servers = config->getServers();
+    for (std::map<std::string, Server*>::const_iterator it = servers.begin(); it != servers.end(); ++it) {
+      const std::vector<int>& ports = it->second->getPorts();
+      for (std::vector<int>::const_iterator portIt = ports.begin(); portIt != ports.end(); ++portIt)
+        wanted.insert(std::make_pair(*portIt, config->getVirtualHostIndex().getDefaultServer(*portIt)));
+    }
+  }
+
+  std::vector<int> moved;
+  for (std::map<int, Listener>::iterator it = listeners.begin(); it != listeners.end(); ) {
+    std::map<int, const Server*>::iterator wantedIt = wanted.find(it->first);
+    if (wantedIt == wanted.end()) {
+      closeListener(reactor, it->first, it->second);
+      listeners.erase(it++);
+      continue;
+    }
+    // A new address or SO_REUSEPORT setting takes a new socket
+    if (wantedIt->second->getHost() != it->second.host
+        || wantedIt->second->getListenerOptions().reusePort != it->second.options.reusePort)
+      moved.push_back(it->first);
+    else if (!(wantedIt->second->getListenerOptions() == it->second.options)) {
+      Logger::log(INFO, "Retuning listener on port " + ParsingUtils::toString(it->first));
+      it->second.options = wantedIt->second->getListenerOptions();
+      ListenerFactory::tuneListener(it->second.handler->getHandle(), it->second.options);
+    }
+    ++it;
+  }
+
+  for (std::vector<int>::iterator it = moved.begin(); it != moved.end(); ++it) {
+    const Server* server = wanted[*it];
+    Listener previous = listeners[*it];
+    // The old socket keeps accepting until the new one is bound, when the
+    // two can be bound side by side
+    if (bindsAlongside(server->getHost(), server->getListenerOptions(), previous.host, previous.options)) {
+      if (openListener(reactor, *it, server->getHost(), server->getListenerOptions()))
+        closeListener(reactor, *it, previous);
+      else
+        Logger::log(WARNING, "Keeping the previous listener on port " + ParsingUtils::toString(*it));
+      continue;
+    }
+    // Otherwise the port has to be given up for the bind, and taken back
+    // if that fails
+    closeListener(reactor, *it, previous);
+    listeners.erase(*it);
+    if (openListener(reactor, *it, server->getHost(), server->getListenerOptions()))
+      continue;
+    if (openListener(reactor, *it, previous.host, previous.options))
+      Logger::log(WARNING, "Keeping the previous listener on port " + ParsingUtils::toString(*it));
+    else
+      Logger::log(ERROR, "Port " + ParsingUtils::toString(*it) + " is no longer listened on");
+  }
+
+  for (std::map<int, const Server*>::iterator it = wanted.begin(); it != wanted.end(); ++it) {
+    if (listeners.find(it->first) == listeners.end())
+      openListener(reactor, it->first, it->second->getHost(), it->second->getListenerOptions());
+  }
+}
+
+bool ServerManager::openListener(Reactor& reactor, int port, const std::string& host, const ListenerOptions& options) {
+  int fd = ListenerFactory::createListener(host, port, options);
+  if (fd == -1)
+    return false;
+  Listener listener;
+  listener.host = host;
+  listener.options = options;
+  listener.handler = new AcceptHandler(fd, reactor);
+  reactor.registerHandler(listener.handler);
+  listeners[port] = listener;
+  return true;
+}
+
+void ServerManager::closeListener(Reactor& reactor, int port, const Listener& listener) {
+  Logger::log(INFO, "Closing listener on port " + ParsingUtils::toString(port));
+  reactor.deregisterHandler(listener.handler->getHandle());
+  delete listener.handler;
+}
+
+bool ServerManager::reloadConfig(Reactor& reactor) {
+  Logger::log(INFO, "Reloading configuration from " + configPath);
+  ConfigSnapshot* snapshot;
+  try {
+    snapshot = ConfigSnapshot::load(configPath);
+  } catch (const std::exception& e) {
+    Logger::log(ERROR, "Configuration reload failed, keeping the running configuration: " + std::string(e.what()));
+    return false;
+  }
+  setConfig(snapshot);
+  syncListeners(reactor);
+  syncFastCgiBackends(reactor);
+  Logger::log(INFO, "Configuration generation " + ParsingUtils::toString(snapshot->getGeneration()) + " is now active");
+  return true;
+}
+
+void ServerManager::syncFastCgiBackends(Reactor& reactor) {
+  std::map<std::string, Route> wanted;
+  if (config != NULL) {
+    const std::map<std::string, Server*>& servers = config->getServers();
+    for (std::map<std::string, Server*>::const_iterator it = servers.begin(); it != servers.end(); ++it) {
+      std::map<std::string, Route> routes = it->second->getRoutes();
+      for (std::map<std::string, Route>::const_iterator routeIt = routes.begin(); routeIt != routes.end(); ++routeIt) {
+        if (routeIt->second.getHasFastCgi())
+          wanted.insert(std::make_pair(FastCgiBackend::makeKey(routeIt->second), routeIt->second));
+      }
+    }
+  }
+
+  for (std::map<std::string, FastCgiBackend*>::iterator it = fastCgiBackends.begin(); it != fastCgiBackends.end(); ) {
+    if (wanted.find(it->first) != wanted.end()) {
+      ++it;
+      continue;
+    }
+    Logger::log(INFO, "Stopping FastCGI backend " + it->first);
+    delete it->second;
+    fastCgiBackends.erase(it++);
+  }
+
+  for (std::map<std::string, Route>::iterator it = wanted.begin(); it != wanted.end(); ++it) {
+    if (fastCgiBackends.find(it->first) != fastCgiBackends.end())
+      continue;
+    Logger::log(INFO, "Starting FastCGI backend " + it->first);
+    const Route& route = it->second;
+    fastCgiBackends[it->first] = new FastCgiBackend(route.getFastCgiAddress(), route.getFastCgiWorkers(),
+      route.getFastCgiConnections(), &reactor);
+  }
 }
 
-std::map<std::string, Server*>* ServerManager::getServersMap() const {
-  return serversMap;
+// Listener handlers belong to the reactor, which deletes them itself; the
+// FastCGI backends' connections are gone with it by now
+void ServerManager::shutdown(void) {
+  listeners.clear();
+  for (std::map<std::string, FastCgiBackend*>::iterator it = fastCgiBackends.begin(); it != fastCgiBackends.end(); ++it)
+    delete it->second;
+  fastCgiBackends.clear();
+  setConfig(NULL);
 }
 
-ServerManager::ServerManager() {}
+ServerManager::ServerManager() : config(NULL), processReaper(NULL) {}
 
 ServerManager::~ServerManager() {}
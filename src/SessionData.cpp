@@ -1,8 +1,19 @@
 #include "SessionData.hpp"
+#include <cstring>
 
-SessionData::SessionData(const std::string& id) : sessionId(id), requestCount(0) {}
+SessionData::SessionData() : requestCount(0), createdAt(0), lastAccess(0) { sessionId[0] = '\0'; }
+SessionData::SessionData(const std::string& id, time_t now) : requestCount(0), createdAt(now), lastAccess(now) { setSessionId(id); }
 void SessionData::incrementRequestCount() { requestCount++; }
 std::string SessionData::getSessionId() const { return sessionId; }
-void SessionData::setSessionId(const std::string& id) { sessionId = id; }
+// Longer IDs are truncated; SessionManager never stores one
+void SessionData::setSessionId(const std::string& id) {
+  size_t length = id.size() < MAX_ID_LENGTH ? id.size() : MAX_ID_LENGTH;
+  std::memcpy(sessionId, id.data(), length);
+  sessionId[length] = '\0';
+}
+bool SessionData::hasSessionId(const std::string& id) const { return id.size() <= MAX_ID_LENGTH && id.compare(sessionId) == 0; }
 int SessionData::getRequestCount() const { return requestCount; }
 void SessionData::setRequestCount(int count) { requestCount = count; }
+time_t SessionData::getCreatedAt() const { return createdAt; }
+time_t SessionData::getLastAccess() const { return lastAccess; }
+void SessionData::touch(time_t now) { lastAccess = now; }
@@ -1,81 +1,488 @@
 #include "SessionManager.hpp"
 #include "Logger.hpp"
 #include "ParsingUtils.hpp"
-#include <cstdlib>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstring>
 #include <ctime>
-#include <stdexcept>
-#include <iostream>
+#include <new>
+#include <sstream>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-std::string SessionManager::generateUniqueID() {
-  // Generate a random unique ID for the session
-  std::string id;
-  static const char alphanum[] =
-    "0123456789"
-    "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-    "abcdefghijklmnopqrstuvwxyz";
+namespace {
+  const size_t INITIAL_CAPACITY = 64;
+  const char MAGIC[8] = "WSSESS1";
 
-  srand((unsigned) time(NULL));
+  // Blocks are allocated up front: a full disk fails here, not as a SIGBUS
+  // on some later write to the mapping
+  bool allocateFile(int fd, size_t size) {
+    return ftruncate(fd, 0) == 0 && posix_fallocate(fd, 0, size) == 0;
+  }
 
-  for (int i = 0; i < 10; ++i) { // 10 character long ID
-    id += alphanum[rand() % (sizeof(alphanum) - 1)];
+  bool accessedEarlier(const SessionData& a, const SessionData& b) {
+    return a.getLastAccess() < b.getLastAccess();
   }
+}
+
+SessionManager::SessionManager(size_t maxSessions, long idleTimeout, long lifetime)
+    : header(NULL), slots(NULL), fd(-1), maxSessions(maxSessions), idleTimeout(idleTimeout), lifetime(lifetime),
+      sweepCursor(0), lastTick(0) {
+  Header* table = mapTable(-1, INITIAL_CAPACITY);
+  if (table == NULL)
+    throw std::bad_alloc();
+  formatTable(table, INITIAL_CAPACITY);
+  replaceTable(table, -1);
+}
 
-  return id;
+SessionManager::~SessionManager() {
+  // The next process to map the file can take it as it is
+  if (fd != -1)
+    header->clean = 1;
+  unmapTable(header, fd);
+}
+
+bool SessionManager::attach(const std::string& file) {
+  int fileFd = open(file.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+  if (fileFd == -1) {
+    Logger::log(WARNING, "Cannot open session_file " + file + ": " + strerror(errno));
+    return false;
+  }
+  // Two servers updating one table would corrupt it
+  if (flock(fileFd, LOCK_EX | LOCK_NB) == -1) {
+    Logger::log(WARNING, "session_file " + file + " is in use by another process, sessions stay in memory.");
+    close(fileFd);
+    return false;
+  }
+  struct stat info;
+  Header* table = fstat(fileFd, &info) == 0 ? loadTable(fileFd, info.st_size) : NULL;
+  bool clean = table != NULL && table->clean;
+  if (table == NULL) {
+    if (info.st_size > 0)
+      Logger::log(WARNING, "session_file " + file + " holds no session table this build can read, starting it afresh.");
+    size_t capacity = header->capacity;
+    table = allocateFile(fileFd, mappingSize(capacity)) ? mapTable(fileFd, capacity) : NULL;
+    if (table == NULL) {
+      Logger::log(WARNING, "Cannot map session_file " + file + ": " + strerror(errno));
+      close(fileFd);
+      return false;
+    }
+    formatTable(table, capacity);
+    table->counters = header->counters;
+    clean = true;
+  }
+  Header* previous = header;
+  Slot* previousSlots = slots;
+  int previousFd = fd;
+  replaceTable(table, fileFd);
+  path = file;
+  // A crash can leave a probe chain or the LRU list half updated
+  if (!clean)
+    rebuild();
+  header->clean = 0;
+  size_t restored = header->count;
+  // Sessions made before the file was attached join the ones in it
+  for (uint32_t index = previous->oldest; index != NONE; index = previousSlots[index].newer) {
+    if (!slots[find(previousSlots[index].data.getSessionId())].used)
+      insert(previousSlots[index].data);
+  }
+  if (previousFd != -1)
+    previous->clean = 1;
+  unmapTable(previous, previousFd);
+  Logger::log(INFO, "session_file: " + ParsingUtils::toString(restored) + " sessions restored from " + file);
+  return true;
+}
+
+const std::string& SessionManager::getFilePath(void) const {
+  return path;
+}
+
+// Unguessable: 132 random bits. Uniqueness is left to createSession, which
+// draws again in the unlikely case the table already holds the ID.
+std::string SessionManager::generateUniqueID() {
+  static const char alphabet[] =
+    "0123456789"
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+    "abcdefghijklmnopqrstuvwxyz"
+    "-_";
+  unsigned char bytes[ID_LENGTH];
+  random.fill(bytes, ID_LENGTH);
+  char id[ID_LENGTH];
+  for (size_t i = 0; i < ID_LENGTH; ++i)
+    id[i] = alphabet[bytes[i] & 63];
+  return std::string(id, ID_LENGTH);
 }
 
 std::string SessionManager::createSession() {
   std::string sessionId;
-  std::pair<std::map<std::string, SessionData>::iterator, bool> result;
   do {
     sessionId = generateUniqueID();
-    result = sessions.insert(std::pair<std::string, SessionData>(sessionId, SessionData(sessionId)));
-  } while (!result.second); // Continue looping until the session ID is unique and insertion is successful
-  Logger::log(INFO, "Inserted session id: ----" + sessionId + "----");
+  } while (slots[find(sessionId)].used); // Never loops in practice, but an ID must not be shared
+  insert(SessionData(sessionId, time(NULL)));
+  ++header->counters.created;
+  LOG(DEBUG, "Inserted session " + logPrefix(sessionId));
   return sessionId;
 }
 
-std::string SessionManager::createSession(const std::string& sessionId) {
-    std::pair<std::map<std::string, SessionData>::iterator, bool> result;
-    result = sessions.insert(std::make_pair(sessionId, SessionData(sessionId)));
-
-    if (!result.second) {
-        // Handle the case where a session with the provided ID already exists
-        Logger::log(ERROR, "Session with ID " + sessionId + " already exists. Not inserting a new one.");
-        return ""; // Or handle it some other way
+SessionData* SessionManager::getSessionData(const std::string& sessionId) {
+    size_t index = find(sessionId);
+    if (!slots[index].used) {
+      LOG(DEBUG, "Session " + logPrefix(sessionId) + " not found");
+        return NULL; // Return nullptr if session ID not found
+    }
+    time_t now = time(NULL);
+    if (isExpired(slots[index].data, now)) {
+      countExpiry(slots[index].data, now);
+      erase(index);
+      LOG(DEBUG, "Session " + logPrefix(sessionId) + " expired");
+      return NULL;
     }
+    slots[index].data.touch(now);
+    unlink(index);
+    link(index);
+    return &slots[index].data; // Return pointer to the found session data
+}
+
+// The ID is a bearer credential: logs get enough of it to tell sessions
+// apart, never enough to use one
+std::string SessionManager::logPrefix(const std::string& sessionId) {
+  return sessionId.substr(0, LOG_PREFIX_LENGTH) + "...";
+}
+
+// IDs this server issues, or could have before a restart: the characters
+// generateUniqueID draws from, and no longer than a slot holds
+bool SessionManager::isValidId(const std::string& sessionId) {
+  if (sessionId.empty() || sessionId.size() > SessionData::MAX_ID_LENGTH)
+    return false;
+  for (size_t i = 0; i < sessionId.size(); ++i) {
+    unsigned char c = sessionId[i];
+    if (!std::isalnum(c) && c != '-' && c != '_')
+      return false;
+  }
+  return true;
+}
+
+time_t SessionManager::getExpiry(const SessionData& session) const {
+  time_t idleExpiry = session.getLastAccess() + idleTimeout;
+  time_t lifetimeExpiry = session.getCreatedAt() + lifetime;
+  if (idleTimeout <= 0)
+    return lifetime <= 0 ? static_cast<time_t>(LONG_MAX) : lifetimeExpiry;
+  if (lifetime <= 0)
+    return idleExpiry;
+  return idleExpiry < lifetimeExpiry ? idleExpiry : lifetimeExpiry;
+}
 
-    Logger::log(INFO, "Inserted session id: ----" + sessionId + "----");
-    return sessionId;
+const std::vector<std::string>& SessionManager::getFallbackKeys(void) {
+  if (fallbackKeys.empty()) {
+    unsigned char key[32];
+    random.fill(key, sizeof(key));
+    fallbackKeys.push_back(std::string(reinterpret_cast<char*>(key), sizeof(key)));
+    Logger::log(WARNING, "No session_keys configured: signed sessions end with this process.");
+  }
+  return fallbackKeys;
+}
+
+// One line per session: for debugging, never on the request path
+void SessionManager::debugPrintSessions() const {
+  if (!Logger::isEnabled(DEBUG))
+    return;
+  Logger::log(DEBUG, "Current Sessions:");
+  for (uint32_t index = header->newest; index != NONE; index = slots[index].older) {
+    const SessionData& session = slots[index].data;
+    Logger::log(DEBUG, "Session " + logPrefix(session.getSessionId()) + ", Request Count: " + ParsingUtils::toString(session.getRequestCount()));
+  }
 }
 
+void SessionManager::tick(void) {
+  time_t now = time(NULL);
+  if (now == lastTick)
+    return;
+  lastTick = now;
+  expire(now);
+}
 
-void SessionManager::cleanupSessions() {
-  for (std::map<std::string, SessionData>::iterator it = sessions.begin(); it != sessions.end(); ) {
-    if (it->second.getRequestCount() == 0) {
-      sessions.erase(it++);
+// Idle sessions come off the old end of the LRU list. Sessions past their
+// lifetime may still be in use, so a cursor sweeps the table for them a
+// stretch at a time.
+void SessionManager::expire(time_t now) {
+  size_t budget = EXPIRE_BUDGET;
+  while (budget > 0 && header->oldest != NONE && isExpired(slots[header->oldest].data, now)) {
+    countExpiry(slots[header->oldest].data, now);
+    erase(header->oldest);
+    --budget;
+  }
+  if (lifetime <= 0)
+    return;
+  for (size_t scanned = 0; budget > 0 && scanned < EXPIRE_BUDGET * 4; ++scanned) {
+    if (sweepCursor >= header->capacity)
+      sweepCursor = 0;
+    if (slots[sweepCursor].used && isExpired(slots[sweepCursor].data, now)) {
+      countExpiry(slots[sweepCursor].data, now);
+      // The slot gets whichever session shifts into it, so it is looked at again
+      erase(sweepCursor);
+      --budget;
     }
-    else {
-      ++it;
+    else
+      ++sweepCursor;
+  }
+}
+
+size_t SessionManager::getSessionCount(void) const {
+  return header->count;
+}
+
+const SessionManager::Counters& SessionManager::getCounters(void) const {
+  return header->counters;
+}
+
+std::string SessionManager::formatCounters(void) const {
+  std::ostringstream out;
+  out << "sessions_active " << header->count << "\n";
+  out << "sessions_created " << header->counters.created << "\n";
+  out << "sessions_expired_idle " << header->counters.expiredIdle << "\n";
+  out << "sessions_expired_lifetime " << header->counters.expiredLifetime << "\n";
+  out << "sessions_evicted " << header->counters.evicted << "\n";
+  return out.str();
+}
+
+// Linear probing: the slot holding sessionId, or the empty slot ending its chain
+size_t SessionManager::find(const std::string& sessionId) const {
+  size_t mask = header->capacity - 1;
+  size_t index = hash(sessionId) & mask;
+  while (slots[index].used && !slots[index].data.hasSessionId(sessionId))
+    index = (index + 1) & mask;
+  return index;
+}
+
+SessionData* SessionManager::insert(const SessionData& session) {
+  if (maxSessions > 0 && header->count >= maxSessions && header->oldest != NONE) {
+    ++header->counters.evicted;
+    erase(header->oldest);
+  }
+  // Kept at most half full, so probe chains stay short
+  if ((header->count + 1) * 2 > header->capacity)
+    grow();
+  size_t index = find(session.getSessionId());
+  slots[index].data = session;
+  slots[index].used = true;
+  link(index);
+  ++header->count;
+  return &slots[index].data;
+}
+
+// Backward-shift deletion, as in the ClientLimiter; a session shifted into
+// the hole takes its LRU links along. Nothing is left behind, so the table
+// never needs compacting.
+void SessionManager::erase(size_t index) {
+  unlink(index);
+  size_t mask = header->capacity - 1;
+  size_t hole = index;
+  size_t next = (hole + 1) & mask;
+  while (slots[next].used) {
+    size_t home = hash(slots[next].data.getSessionId()) & mask;
+    if (((next - home) & mask) >= ((next - hole) & mask)) {
+      slots[hole] = slots[next];
+      relink(hole);
+      hole = next;
     }
+    next = (next + 1) & mask;
   }
+  slots[hole].used = false;
+  --header->count;
 }
 
-SessionData* SessionManager::getSessionData(const std::string& sessionId) {
-    std::map<std::string, SessionData>::iterator it = sessions.find(sessionId);
-    if (it == sessions.end()) {
-      Logger:: log(ERROR, "Session id: ----" + sessionId + "---- not found.");
-        return NULL; // Return nullptr if session ID not found
+// Rehashed oldest first, so the LRU order survives. A file grows into a new
+// file renamed over it once filled, so the path always holds a whole table.
+void SessionManager::grow(void) {
+  size_t capacity = header->capacity * 2;
+  std::string temporary = path + ".tmp";
+  int grownFd = -1;
+  Header* grown = NULL;
+  if (fd != -1) {
+    grownFd = open(temporary.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (grownFd != -1 && flock(grownFd, LOCK_EX | LOCK_NB) == 0 && allocateFile(grownFd, mappingSize(capacity)))
+      grown = mapTable(grownFd, capacity);
+    if (grown == NULL) {
+      Logger::log(WARNING, "Cannot grow session_file " + path + ", sessions are kept in memory from now on.");
+      if (grownFd != -1) {
+        close(grownFd);
+        ::unlink(temporary.c_str());
+      }
+      grownFd = -1;
+      path.clear();
     }
-    return &it->second; // Return pointer to the found session data
+  }
+  if (grown == NULL)
+    grown = mapTable(-1, capacity);
+  if (grown == NULL)
+    throw std::bad_alloc();
+  formatTable(grown, capacity);
+  grown->count = header->count;
+  grown->counters = header->counters;
+  Header* previous = header;
+  Slot* previousSlots = slots;
+  int previousFd = fd;
+  replaceTable(grown, grownFd);
+  for (uint32_t index = previous->oldest; index != NONE; index = previousSlots[index].newer) {
+    size_t target = find(previousSlots[index].data.getSessionId());
+    slots[target].data = previousSlots[index].data;
+    slots[target].used = true;
+    link(target);
+  }
+  if (fd != -1 && rename(temporary.c_str(), path.c_str()) == -1) {
+    Logger::log(WARNING, "Cannot replace session_file " + path + ", the sessions are in " + temporary + " until restarted.");
+    path = temporary;
+  }
+  unmapTable(previous, previousFd);
 }
 
-SessionManager::~SessionManager() {
-  cleanupSessions();
+// After a crash: the sessions go back in oldest first, on fresh probe chains
+// and LRU links
+void SessionManager::rebuild(void) {
+  std::vector<SessionData> sessions;
+  for (size_t i = 0; i < header->capacity; ++i) {
+    if (slots[i].used && isValidId(slots[i].data.getSessionId()))
+      sessions.push_back(slots[i].data);
+    slots[i].used = false;
+    slots[i].newer = NONE;
+    slots[i].older = NONE;
+  }
+  std::sort(sessions.begin(), sessions.end(), accessedEarlier);
+  header->count = 0;
+  header->newest = NONE;
+  header->oldest = NONE;
+  for (size_t i = 0; i < sessions.size(); ++i)
+    insert(sessions[i]);
 }
 
-void SessionManager::debugPrintSessions() const {
-  Logger::log(INFO, "Current Sessions:");
-  for (std::map<std::string, SessionData>::const_iterator it = sessions.begin(); it != sessions.end(); ++it) {
-    Logger:: log(INFO, "Session ID: " + it->first + ", Request Count: " + ParsingUtils::toString(it->second.getRequestCount()));
+void SessionManager::replaceTable(Header* table, int tableFd) {
+  header = table;
+  slots = slotsOf(table);
+  fd = tableFd;
+  sweepCursor = 0;
+}
+
+// Makes the slot the newest
+void SessionManager::link(size_t index) {
+  slots[index].newer = NONE;
+  slots[index].older = header->newest;
+  if (header->newest != NONE)
+    slots[header->newest].newer = index;
+  header->newest = index;
+  if (header->oldest == NONE)
+    header->oldest = index;
+}
+
+void SessionManager::unlink(size_t index) {
+  Slot& slot = slots[index];
+  if (slot.newer != NONE)
+    slots[slot.newer].older = slot.older;
+  else
+    header->newest = slot.older;
+  if (slot.older != NONE)
+    slots[slot.older].newer = slot.newer;
+  else
+    header->oldest = slot.newer;
+  slot.newer = NONE;
+  slot.older = NONE;
+}
+
+// The slot was moved to index to: its neighbours are pointed at it
+void SessionManager::relink(size_t to) {
+  Slot& slot = slots[to];
+  if (slot.newer != NONE)
+    slots[slot.newer].older = to;
+  else
+    header->newest = to;
+  if (slot.older != NONE)
+    slots[slot.older].newer = to;
+  else
+    header->oldest = to;
+}
+
+bool SessionManager::isExpired(const SessionData& session, time_t now) const {
+  return (idleTimeout > 0 && now - session.getLastAccess() >= idleTimeout)
+    || (lifetime > 0 && now - session.getCreatedAt() >= lifetime);
+}
+
+void SessionManager::countExpiry(const SessionData& session, time_t now) {
+  if (lifetime > 0 && now - session.getCreatedAt() >= lifetime)
+    ++header->counters.expiredLifetime;
+  else
+    ++header->counters.expiredIdle;
+}
+
+// FNV-1a
+uint32_t SessionManager::hash(const std::string& sessionId) {
+  uint32_t value = 2166136261u;
+  for (size_t i = 0; i < sessionId.size(); ++i) {
+    value ^= static_cast<unsigned char>(sessionId[i]);
+    value *= 16777619u;
+  }
+  return value;
+}
+
+// An anonymous mapping while tableFd is -1
+SessionManager::Header* SessionManager::mapTable(int tableFd, size_t capacity) {
+  int flags = tableFd == -1 ? MAP_PRIVATE | MAP_ANONYMOUS : MAP_SHARED;
+  void* table = mmap(NULL, mappingSize(capacity), PROT_READ | PROT_WRITE, flags, tableFd, 0);
+  return table == MAP_FAILED ? NULL : static_cast<Header*>(table);
+}
+
+// NULL unless the file holds a table of this build, as it was left
+SessionManager::Header* SessionManager::loadTable(int tableFd, size_t size) {
+  if (size < sizeof(Header))
+    return NULL;
+  void* mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, tableFd, 0);
+  if (mapping == MAP_FAILED)
+    return NULL;
+  Header* table = static_cast<Header*>(mapping);
+  uint64_t capacity = table->capacity;
+  if (std::memcmp(table->magic, MAGIC, sizeof(MAGIC)) != 0 || table->slotSize != sizeof(Slot)
+      || capacity < INITIAL_CAPACITY || capacity > NONE || (capacity & (capacity - 1)) != 0
+      || mappingSize(capacity) != size || table->count > capacity / 2) {
+    munmap(mapping, size);
+    return NULL;
+  }
+  return table;
+}
+
+// Fresh mappings are zeroed, so only the links need setting
+void SessionManager::formatTable(Header* table, size_t capacity) {
+  std::memcpy(table->magic, MAGIC, sizeof(MAGIC));
+  table->slotSize = sizeof(Slot);
+  table->clean = 0;
+  table->capacity = capacity;
+  table->count = 0;
+  table->newest = NONE;
+  table->oldest = NONE;
+  std::memset(&table->counters, 0, sizeof(table->counters));
+  Slot* tableSlots = slotsOf(table);
+  for (size_t i = 0; i < capacity; ++i) {
+    new (&tableSlots[i]) Slot();
+    tableSlots[i].used = false;
+    tableSlots[i].newer = NONE;
+    tableSlots[i].older = NONE;
   }
 }
+
+void SessionManager::unmapTable(Header* table, int tableFd) {
+  munmap(table, mappingSize(table->capacity));
+  if (tableFd != -1)
+    close(tableFd);
+}
+
+// The slots start on a cache line
+size_t SessionManager::mappingSize(size_t capacity) {
+  return (sizeof(Header) + 63) / 64 * 64 + capacity * sizeof(Slot);
+}
+
+SessionManager::Slot* SessionManager::slotsOf(Header* table) {
+  return reinterpret_cast<Slot*>(reinterpret_cast<char*>(table) + (sizeof(Header) + 63) / 64 * 64);
+}
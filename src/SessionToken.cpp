@@ -0,0 +1,114 @@
+#include "SessionToken.hpp"
+#include "Sha256.hpp"
+
+namespace {
+  const char ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+}
+
+std::string SessionToken::issue(const SessionData& session, time_t expiresAt, const std::string& key) {
+  std::string id = session.getSessionId();
+  std::string payload;
+  payload += static_cast<char>(VERSION);
+  payload += static_cast<char>(id.size());
+  payload += id;
+  putNumber(payload, static_cast<uint64_t>(session.getCreatedAt()), 8);
+  putNumber(payload, static_cast<uint32_t>(session.getRequestCount()), 4);
+  putNumber(payload, static_cast<uint64_t>(expiresAt), 8);
+  return encode(payload) + "." + encode(Sha256::hmac(key, payload));
+}
+
+bool SessionToken::verify(const std::string& token, const std::vector<std::string>& keys, time_t now, SessionData& session) {
+  size_t dot = token.find('.');
+  std::string payload;
+  std::string mac;
+  if (dot == std::string::npos || !decode(token.substr(0, dot), payload) || !decode(token.substr(dot + 1), mac))
+    return false;
+  bool signedByKey = false;
+  for (std::vector<std::string>::const_iterator it = keys.begin(); it != keys.end() && !signedByKey; ++it)
+    signedByKey = equals(Sha256::hmac(*it, payload), mac);
+  if (!signedByKey)
+    return false;
+  // Signed by us, so well formed unless the format changed
+  if (payload.size() < 2 || static_cast<unsigned char>(payload[0]) != VERSION)
+    return false;
+  size_t idLength = static_cast<unsigned char>(payload[1]);
+  if (payload.size() != 2 + idLength + 8 + 4 + 8)
+    return false;
+  size_t offset = 2 + idLength;
+  time_t expiresAt = static_cast<time_t>(getNumber(payload, offset + 12, 8));
+  if (now >= expiresAt)
+    return false;
+  session = SessionData(payload.substr(2, idLength), static_cast<time_t>(getNumber(payload, offset, 8)));
+  session.setRequestCount(static_cast<int>(getNumber(payload, offset + 8, 4)));
+  return true;
+}
+
+// base64url without padding: the token is a cookie value as is
+std::string SessionToken::encode(const std::string& bytes) {
+  std::string text;
+  uint32_t bits = 0;
+  int count = 0;
+  for (size_t i = 0; i < bytes.size(); ++i) {
+    bits = (bits << 8) | static_cast<unsigned char>(bytes[i]);
+    count += 8;
+    while (count >= 6) {
+      count -= 6;
+      text += ALPHABET[(bits >> count) & 63];
+    }
+  }
+  if (count > 0)
+    text += ALPHABET[(bits << (6 - count)) & 63];
+  return text;
+}
+
+bool SessionToken::decode(const std::string& text, std::string& bytes) {
+  bytes.clear();
+  uint32_t bits = 0;
+  int count = 0;
+  for (size_t i = 0; i < text.size(); ++i) {
+    unsigned char c = text[i];
+    uint32_t value;
+    if (c >= 'A' && c <= 'Z')
+      value = c - 'A';
+    else if (c >= 'a' && c <= 'z')
+      value = c - 'a' + 26;
+    else if (c >= '0' && c <= '9')
+      value = c - '0' + 52;
+    else if (c == '-')
+      value = 62;
+    else if (c == '_')
+      value = 63;
+    else
+      return false;
+    bits = (bits << 6) | value;
+    count += 6;
+    if (count >= 8) {
+      count -= 8;
+      bytes += static_cast<char>((bits >> count) & 0xff);
+    }
+  }
+  // Leftover bits must be zero, or one token would have several spellings
+  return count < 6 && (bits & ((1u << count) - 1)) == 0;
+}
+
+// Constant time, so a forged MAC cannot be guessed a byte at a time
+bool SessionToken::equals(const std::string& a, const std::string& b) {
+  if (a.size() != b.size())
+    return false;
+  unsigned char difference = 0;
+  for (size_t i = 0; i < a.size(); ++i)
+    difference |= a[i] ^ b[i];
+  return difference == 0;
+}
+
+void SessionToken::putNumber(std::string& out, uint64_t value, int bytes) {
+  for (int i = bytes - 1; i >= 0; --i)
+    out += static_cast<char>((value >> (8 * i)) & 0xff);
+}
+
+uint64_t SessionToken::getNumber(const std::string& in, size_t offset, int bytes) {
+  uint64_t value = 0;
+  for (int i = 0; i < bytes; ++i)
+    value = (value << 8) | static_cast<unsigned char>(in[offset + i]);
+  return value;
+}
@@ -0,0 +1,127 @@
+#include "Sha256.hpp"
+#include <cstring>
+
+namespace {
+  const uint32_t ROUND_CONSTANTS[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+  };
+
+  uint32_t rotate(uint32_t value, int bits) {
+    return (value >> bits) | (value << (32 - bits));
+  }
+}
+
+Sha256::Sha256() {
+  reset();
+}
+
+void Sha256::reset(void) {
+  static const uint32_t initial[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+  };
+  std::memcpy(state, initial, sizeof(state));
+  blockLength = 0;
+  totalLength = 0;
+}
+
+void Sha256::update(const void* data, size_t length) {
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  totalLength += length;
+  if (blockLength > 0) {
+    size_t take = BLOCK_SIZE - blockLength < length ? BLOCK_SIZE - blockLength : length;
+    std::memcpy(block + blockLength, bytes, take);
+    blockLength += take;
+    bytes += take;
+    length -= take;
+    if (blockLength < BLOCK_SIZE)
+      return;
+    compress(block);
+    blockLength = 0;
+  }
+  for (; length >= BLOCK_SIZE; bytes += BLOCK_SIZE, length -= BLOCK_SIZE)
+    compress(bytes);
+  std::memcpy(block, bytes, length);
+  blockLength = length;
+}
+
+void Sha256::finish(unsigned char digest[DIGEST_SIZE]) {
+  uint64_t bits = totalLength * 8;
+  unsigned char padding[BLOCK_SIZE * 2] = { 0x80 };
+  size_t padLength = (blockLength < 56 ? 56 : 120) - blockLength;
+  for (int i = 0; i < 8; ++i)
+    padding[padLength + i] = static_cast<unsigned char>(bits >> (56 - 8 * i));
+  update(padding, padLength + 8);
+  for (int i = 0; i < 8; ++i) {
+    digest[4 * i] = state[i] >> 24;
+    digest[4 * i + 1] = (state[i] >> 16) & 0xff;
+    digest[4 * i + 2] = (state[i] >> 8) & 0xff;
+    digest[4 * i + 3] = state[i] & 0xff;
+  }
+}
+
+void Sha256::compress(const unsigned char* data) {
+  uint32_t w[64];
+  for (int i = 0; i < 16; ++i)
+    w[i] = (static_cast<uint32_t>(data[4 * i]) << 24) | (data[4 * i + 1] << 16) | (data[4 * i + 2] << 8) | data[4 * i + 3];
+  for (int i = 16; i < 64; ++i) {
+    uint32_t s0 = rotate(w[i - 15], 7) ^ rotate(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    uint32_t s1 = rotate(w[i - 2], 17) ^ rotate(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+  uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+  uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+  for (int i = 0; i < 64; ++i) {
+    uint32_t t1 = h + (rotate(e, 6) ^ rotate(e, 11) ^ rotate(e, 25)) + ((e & f) ^ (~e & g)) + ROUND_CONSTANTS[i] + w[i];
+    uint32_t t2 = (rotate(a, 2) ^ rotate(a, 13) ^ rotate(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+    h = g;
+    g = f;
+    f = e;
+    e = d + t1;
+    d = c;
+    c = b;
+    b = a;
+    a = t1 + t2;
+  }
+  state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+  state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+std::string Sha256::digest(const std::string& message) {
+  Sha256 hash;
+  hash.update(message.data(), message.size());
+  unsigned char out[DIGEST_SIZE];
+  hash.finish(out);
+  return std::string(reinterpret_cast<char*>(out), DIGEST_SIZE);
+}
+
+std::string Sha256::hmac(const std::string& key, const std::string& message) {
+  unsigned char padded[BLOCK_SIZE] = { 0 };
+  if (key.size() > BLOCK_SIZE)
+    std::memcpy(padded, digest(key).data(), DIGEST_SIZE);
+  else
+    std::memcpy(padded, key.data(), key.size());
+  unsigned char pad[BLOCK_SIZE];
+  for (size_t i = 0; i < BLOCK_SIZE; ++i)
+    pad[i] = padded[i] ^ 0x36;
+  Sha256 inner;
+  inner.update(pad, BLOCK_SIZE);
+  inner.update(message.data(), message.size());
+  unsigned char innerDigest[DIGEST_SIZE];
+  inner.finish(innerDigest);
+  for (size_t i = 0; i < BLOCK_SIZE; ++i)
+    pad[i] = padded[i] ^ 0x5c;
+  Sha256 outer;
+  outer.update(pad, BLOCK_SIZE);
+  outer.update(innerDigest, DIGEST_SIZE);
+  unsigned char out[DIGEST_SIZE];
+  outer.finish(out);
+  std::memset(padded, 0, sizeof(padded));
+  return std::string(reinterpret_cast<char*>(out), DIGEST_SIZE);
+}
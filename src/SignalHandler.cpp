@@ -1,6 +1,10 @@
 #include "SignalHandler.hpp"
+#include <string.h>
 #include "Logger.hpp"
 #include "ParsingUtils.hpp"
+#include "ServerManager.hpp"
+
+volatile sig_atomic_t SignalHandler::reloadRequested = 0;
 
 SignalHandler& SignalHandler::getInstance() {
   static SignalHandler instance;
@@ -9,6 +13,16 @@ SignalHandler& SignalHandler::getInstance() {
 
 void SignalHandler::setupSignalHandlers() {
   std::signal(SIGINT, SignalHandler::handleSignal);
+  // A script that exits without reading its whole body makes writes to its
+  // stdin fail with EPIPE instead of killing the server
+  std::signal(SIGPIPE, SIG_IGN);
+  // No SA_RESTART: epoll_wait has to return so the reload is not delayed
+  // until the next client event
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = SignalHandler::handleReloadSignal;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGHUP, &action, NULL);
 }
 
 void SignalHandler::cleanup() {
@@ -23,22 +37,7 @@ void SignalHandler::cleanup() {
     }
     resources.clear();
   }
-  if (serversMap) {
-    for (std::map<std::string, Server*>::iterator it = serversMap->begin(); it != serversMap->end(); ++it) {
-      Logger::log(INFO, "Deleting server: " + it->first);
-      delete it->second; // Free Server instances
-    }
-    serversMap->clear();
-  }
-}
-
-void SignalHandler::setServersMap(std::map<std::string, Server*>* map) {
-  Logger::log(INFO, "Setting serversMap: " + ParsingUtils::toString(map->size()) + " servers.");
-  serversMap = map;
-  for (std::map<std::string, Server*>::iterator it = serversMap->begin(); it != serversMap->end(); ++it) {
-    Logger::log(INFO, "Server ready for cleanup: " + it->first);
-  }
-  Logger::log(INFO, "serversMap set with " + ParsingUtils::toString(serversMap->size()) + " servers.");
+  ServerManager::getInstance().shutdown();
 }
 
 void SignalHandler::handleSignal(int signal) {
@@ -47,6 +46,17 @@ void SignalHandler::handleSignal(int signal) {
   exit(signal);
 }
 
+void SignalHandler::handleReloadSignal(int /*signal*/) {
+  reloadRequested = 1;
+}
+
+bool SignalHandler::consumeReloadRequest(void) {
+  if (!reloadRequested)
+    return false;
+  reloadRequested = 0;
+  return true;
+}
+
 void SignalHandler::registerResource(EventHandler* resource) {
   resources.push_back(resource);
 }
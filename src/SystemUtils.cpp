@@ -1,8 +1,24 @@
 #include "SystemUtils.hpp"
 #include <unistd.h>
+#include <cerrno>
 
 void SystemUtils::closeUtil(int& fd) {
   if (fd >= 0)
     close(fd);
   fd = -1;
 }
+
+bool SystemUtils::writeAll(int fd, const char* data, size_t length) {
+  size_t sent = 0;
+  while (sent < length) {
+    ssize_t n = write(fd, data + sent, length - sent);
+    if (n > 0) {
+      sent += n;
+      continue;
+    }
+    if (n == -1 && errno == EINTR)
+      continue;
+    return false;
+  }
+  return true;
+}
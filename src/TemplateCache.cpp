@@ -0,0 +1,59 @@
+#include "TemplateCache.hpp"
+
+TemplateCache::TemplateCache(size_t maxTemplates) : maxTemplates(maxTemplates), useClock(0) {}
+
+TemplateCache::~TemplateCache() {
+  clear();
+}
+
+const HtmlTemplate* TemplateCache::getTemplate(const std::string& filePath, FileInfoCache* files) {
+  std::map<std::string, Slot>::iterator it = templates.find(filePath);
+  if (it != templates.end()) {
+    if (!it->second.compiled->isStale(files)) {
+      it->second.lastUse = ++useClock;
+      return it->second.compiled;
+    }
+    invalidate(filePath);
+  }
+
+  HtmlTemplate* compiled = new HtmlTemplate(filePath);
+  try {
+    compiled->compile();
+  } catch (...) {
+    delete compiled;
+    throw;
+  }
+  if (templates.size() >= maxTemplates)
+    evictOldest();
+  Slot slot;
+  slot.compiled = compiled;
+  slot.lastUse = ++useClock;
+  templates[filePath] = slot;
+  return compiled;
+}
+
+void TemplateCache::invalidate(const std::string& filePath) {
+  std::map<std::string, Slot>::iterator it = templates.find(filePath);
+  if (it != templates.end()) {
+    delete it->second.compiled;
+    templates.erase(it);
+  }
+}
+
+void TemplateCache::clear(void) {
+  for (std::map<std::string, Slot>::iterator it = templates.begin(); it != templates.end(); ++it)
+    delete it->second.compiled;
+  templates.clear();
+}
+
+void TemplateCache::evictOldest(void) {
+  std::map<std::string, Slot>::iterator oldest = templates.end();
+  for (std::map<std::string, Slot>::iterator it = templates.begin(); it != templates.end(); ++it) {
+    if (oldest == templates.end() || it->second.lastUse < oldest->second.lastUse)
+      oldest = it;
+  }
+  if (oldest != templates.end()) {
+    delete oldest->second.compiled;
+    templates.erase(oldest);
+  }
+}
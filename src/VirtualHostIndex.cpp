@@ -0,0 +1,169 @@
+#include "VirtualHostIndex.hpp"
+#include <algorithm>
+#include <cctype>
+#include "Logger.hpp"
+#include "ParsingUtils.hpp"
+
+namespace {
+  inline char lower(char c) {
+    return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  }
+
+  inline uint32_t mix(uint32_t hash, unsigned char byte) {
+    return (hash ^ byte) * 16777619u;
+  }
+
+  bool configuredEarlier(const Server* a, const Server* b) {
+    return a->getConfigOrder() < b->getConfigOrder();
+  }
+}
+
+VirtualHostIndex::VirtualHostIndex() : count(0) {}
+
+void VirtualHostIndex::clear(void) {
+  slots.clear();
+  count = 0;
+}
+
+void VirtualHostIndex::build(const std::map<std::string, Server*>& servers) {
+  clear();
+  size_t entries = 0;
+  for (std::map<std::string, Server*>::const_iterator it = servers.begin(); it != servers.end(); ++it)
+    entries += it->second->getPorts().size() * 2;
+  // Keep the load factor under one half so probe chains stay short
+  size_t capacity = 16;
+  while (capacity < entries * 2)
+    capacity <<= 1;
+  Slot empty;
+  empty.port = 0;
+  empty.server = NULL;
+  empty.used = false;
+  slots.assign(capacity, empty);
+
+  // Explicit default servers claim their ports first
+  for (std::map<std::string, Server*>::const_iterator it = servers.begin(); it != servers.end(); ++it) {
+    if (!it->second->isDefaultServer())
+      continue;
+    const std::vector<int>& ports = it->second->getPorts();
+    for (std::vector<int>::const_iterator portIt = ports.begin(); portIt != ports.end(); ++portIt)
+      insert(*portIt, "", it->second, false);
+  }
+  // The map is sorted by name, the implicit default goes by file order
+  std::vector<Server*> ordered;
+  for (std::map<std::string, Server*>::const_iterator it = servers.begin(); it != servers.end(); ++it)
+    ordered.push_back(it->second);
+  std::stable_sort(ordered.begin(), ordered.end(), configuredEarlier);
+  for (std::vector<Server*>::const_iterator it = ordered.begin(); it != ordered.end(); ++it) {
+    std::string name = (*it)->getServerName();
+    ParsingUtils::trimAndLower(name);
+    while (!name.empty() && name[name.length() - 1] == '.')
+      name.erase(name.length() - 1);
+    const std::vector<int>& ports = (*it)->getPorts();
+    for (std::vector<int>::const_iterator portIt = ports.begin(); portIt != ports.end(); ++portIt) {
+      if (!name.empty())
+        insert(*portIt, name, *it, false);
+      // First server on a port is its default unless one was marked
+      insert(*portIt, "", *it, false);
+    }
+  }
+  Logger::log(INFO, "Virtual host index built with " + ParsingUtils::toString(count) + " entries");
+}
+
+Server* VirtualHostIndex::resolve(int localPort, const std::string& hostHeader) const {
+  size_t begin = 0;
+  size_t end;
+  if (!hostHeader.empty() && hostHeader[0] == '[') {
+    // IPv6 literal: "[::1]:8080"
+    begin = 1;
+    end = hostHeader.find(']');
+  }
+  else
+    end = hostHeader.find(':');
+  if (end == std::string::npos)
+    end = hostHeader.length();
+  while (end > begin && (hostHeader[end - 1] == '.' || hostHeader[end - 1] == ' '))
+    --end;
+  while (begin < end && hostHeader[begin] == ' ')
+    ++begin;
+
+  const char* host = hostHeader.data() + begin;
+  size_t length = end - begin;
+  if (length > 0) {
+    Server* server = find(localPort, host, length, false);
+    if (server != NULL)
+      return server;
+    // "a.b.example.com" tries "*.b.example.com", then "*.example.com", ...
+    for (size_t i = 0; i < length; ++i) {
+      if (host[i] != '.')
+        continue;
+      server = find(localPort, host + i, length - i, true);
+      if (server != NULL)
+        return server;
+    }
+  }
+  return getDefaultServer(localPort);
+}
+
+Server* VirtualHostIndex::getDefaultServer(int localPort) const {
+  return find(localPort, "", 0, false);
+}
+
+size_t VirtualHostIndex::size(void) const {
+  return count;
+}
+
+void VirtualHostIndex::insert(int port, const std::string& host, Server* server, bool replace) {
+  bool wildcard = !host.empty() && host[0] == '*';
+  const char* key = host.data() + (wildcard ? 1 : 0);
+  size_t length = host.length() - (wildcard ? 1 : 0);
+  size_t mask = slots.size() - 1;
+  size_t index = hash(port, key, length, wildcard) & mask;
+  while (slots[index].used) {
+    if (slots[index].port == port && slots[index].host == host) {
+      if (replace)
+        slots[index].server = server;
+      return;
+    }
+    index = (index + 1) & mask;
+  }
+  slots[index].host = host;
+  slots[index].port = port;
+  slots[index].server = server;
+  slots[index].used = true;
+  ++count;
+}
+
+// host is compared case-insensitively against the lowercase keys, so the
+// request's Host header never has to be copied
+Server* VirtualHostIndex::find(int port, const char* host, size_t length, bool wildcard) const {
+  if (slots.empty())
+    return NULL;
+  size_t mask = slots.size() - 1;
+  size_t offset = wildcard ? 1 : 0;
+  size_t index = hash(port, host, length, wildcard) & mask;
+  while (slots[index].used) {
+    const Slot& slot = slots[index];
+    if (slot.port == port && slot.host.length() == length + offset
+        && (!wildcard || slot.host[0] == '*')) {
+      size_t i = 0;
+      while (i < length && slot.host[i + offset] == lower(host[i]))
+        ++i;
+      if (i == length)
+        return slot.server;
+    }
+    index = (index + 1) & mask;
+  }
+  return NULL;
+}
+
+// FNV-1a over the port and the lowercased host
+uint32_t VirtualHostIndex::hash(int port, const char* host, size_t length, bool wildcard) {
+  uint32_t hash = 2166136261u;
+  hash = mix(hash, static_cast<unsigned char>(port & 0xff));
+  hash = mix(hash, static_cast<unsigned char>((port >> 8) & 0xff));
+  if (wildcard)
+    hash = mix(hash, '*');
+  for (size_t i = 0; i < length; ++i)
+    hash = mix(hash, static_cast<unsigned char>(lower(host[i])));
+  return hash;
+}
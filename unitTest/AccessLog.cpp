@@ -0,0 +1,133 @@
+#include <criterion.h>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+#include "AccessLog.hpp"
+
+static std::string readFile(const std::string& path) {
+    std::ifstream in(path.c_str());
+    return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+static size_t countLines(const std::string& text) {
+    size_t lines = 0;
+    for (size_t i = 0; i < text.size(); ++i)
+        lines += text[i] == '\n';
+    return lines;
+}
+
+static std::string tempPath(const std::string& name) {
+    char path[64];
+    std::snprintf(path, sizeof(path), "/tmp/accesslog_test_%d_", static_cast<int>(getpid()));
+    return path + name;
+}
+
+static void removeRotated(const std::string& path) {
+    std::remove(path.c_str());
+    for (size_t i = 1; i <= AccessLog::KEEP_FILES + 1; ++i) {
+        char suffix[16];
+        std::snprintf(suffix, sizeof(suffix), ".%lu", static_cast<unsigned long>(i));
+        std::remove((path + suffix).c_str());
+    }
+}
+
+Test(access_log, formats_one_json_line) {
+    AccessLog::Record record;
+    record.started.tv_sec = 0;
+    record.started.tv_nsec = 1500;
+    record.client = 0x7f000001;
+    record.vhost = "example.com";
+    record.method = "GET";
+    record.path = "/a\"b\\c\n";
+    record.status = 404;
+    record.bytesIn = 78;
+    record.bytesOut = 255;
+    record.parseUs = 1;
+    record.routeUs = 2;
+    record.fsUs = 3;
+    record.sendUs = 4;
+    cr_assert_eq(AccessLog::format(record),
+        "{\"time\":\"1970-01-01T00:00:00.000001Z\",\"client\":\"127.0.0.1\",\"vhost\":\"example.com\","
+        "\"method\":\"GET\",\"path\":\"/a\\\"b\\\\c\\u000a\",\"status\":404,\"bytes_in\":78,\"bytes_out\":255,"
+        "\"parse_us\":1,\"route_us\":2,\"fs_us\":3,\"send_us\":4}\n");
+}
+
+Test(access_log, reads_status_and_counts_bytes_sent) {
+    std::string path = tempPath("status.log");
+    removeRotated(path);
+    AccessLogOptions options;
+    options.path = path;
+    AccessLog log;
+    log.configure(options);
+    cr_assert(log.isEnabled());
+
+    AccessLog::Record record;
+    log.begin(record, 42, 0x7f000001);
+    std::string headers = "HTTP/1.1 201 Created\r\nContent-Length: 5\r\n\r\n";
+    AccessLog::sending(42, headers.data(), headers.size());
+    AccessLog::sending(42, NULL, 5);
+    // Another client's bytes are not this request's
+    AccessLog::sending(43, "HTTP/1.1 500 Error\r\n", 20);
+    cr_assert_eq(record.status, 201);
+    cr_assert_eq(record.bytesOut, headers.size() + 5);
+    log.finish(record, 42);
+    // Closed: nothing more is counted
+    AccessLog::sending(42, NULL, 100);
+    cr_assert_eq(record.bytesOut, headers.size() + 5);
+    log.flush();
+    cr_assert_eq(countLines(readFile(path)), 1u);
+    removeRotated(path);
+}
+
+Test(access_log, samples_but_keeps_server_errors) {
+    std::string path = tempPath("sample.log");
+    removeRotated(path);
+    AccessLogOptions options;
+    options.path = path;
+    options.sampleRate = 10;
+    AccessLog log;
+    log.configure(options);
+    for (int i = 0; i < 100; ++i) {
+        AccessLog::Record record;
+        log.begin(record, 5, 0);
+        AccessLog::sending(5, i < 3 ? "HTTP/1.1 502 Bad Gateway\r\n" : "HTTP/1.1 200 OK\r\n", 17);
+        log.finish(record, 5);
+    }
+    log.flush();
+    // Ten sampled, and the 5xx that were not
+    cr_assert_eq(countLines(readFile(path)), 13u);
+    removeRotated(path);
+}
+
+Test(access_log, rotates_past_max_size) {
+    std::string path = tempPath("rotate.log");
+    removeRotated(path);
+    AccessLogOptions options;
+    options.path = path;
+    options.maxSize = 1024;
+    AccessLog log;
+    log.configure(options);
+    for (int i = 0; i < 200; ++i) {
+        AccessLog::Record record;
+        log.begin(record, 7, 0);
+        log.finish(record, 7);
+        log.flush();
+    }
+    cr_assert_leq(readFile(path).size(), 1024u);
+    cr_assert_leq(readFile(path + ".1").size(), 1024u);
+    cr_assert_gt(readFile(path + ".1").size(), 0u);
+    cr_assert(access((path + ".5").c_str(), F_OK) == 0);
+    // Only KEEP_FILES old files are kept
+    cr_assert(access((path + ".6").c_str(), F_OK) != 0);
+    removeRotated(path);
+}
+
+Test(access_log, keeps_utf8_and_escapes_stray_bytes) {
+    AccessLog::Record record;
+    record.started.tv_sec = 0;
+    record.started.tv_nsec = 0;
+    record.path = "/caf\xc3\xa9/\xff\xe9t\xc3";
+    std::string line = AccessLog::format(record);
+    cr_assert(line.find("\"path\":\"/caf\xc3\xa9/\\u00ff\\u00e9t\\u00c3\"") != std::string::npos, "Valid UTF-8 should pass, other high bytes be escaped: %s", line.c_str());
+}
@@ -0,0 +1,129 @@
+#include <criterion.h>
+#include <csignal>
+#include <fcntl.h>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "CgiBodyStream.hpp"
+#include "Reactor.hpp"
+
+namespace {
+    struct Listener : CgiBodyListener {
+        int calls;
+        bool complete;
+        Listener() : calls(0), complete(false) {}
+        void cgiBodyStreamed(bool done) { ++calls; complete = done; }
+    };
+
+    // The stream reads the client end of a socketpair and writes the pipe
+    struct Fixture {
+        Reactor reactor;
+        int client[2];  // [0] is the server side
+        int script[2];  // [1] is the script's stdin
+        Listener listener;
+
+        Fixture() {
+            signal(SIGPIPE, SIG_IGN);
+            socketpair(AF_UNIX, SOCK_STREAM, 0, client);
+            pipe(script);
+            fcntl(client[0], F_SETFL, O_NONBLOCK);
+            fcntl(script[0], F_SETFL, O_NONBLOCK);
+        }
+        ~Fixture() {
+            close(client[0]);
+            close(client[1]);
+            if (script[0] != -1)
+                close(script[0]);
+        }
+        CgiBodyStream* open(size_t length) {
+            return new CgiBodyStream(script[1], client[0], length, &reactor, &listener);
+        }
+        std::string drain(void) {
+            std::string data;
+            char buffer[65536];
+            ssize_t length;
+            while ((length = read(script[0], buffer, sizeof(buffer))) > 0)
+                data.append(buffer, length);
+            return data;
+        }
+    };
+
+    void sendAll(int fd, const std::string& data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t length = write(fd, data.data() + sent, data.size() - sent);
+            if (length <= 0)
+                break;
+            sent += length;
+        }
+    }
+}
+
+Test(cgi_body_stream, forwards_the_body_received_with_the_headers) {
+    Fixture f;
+    f.open(0)->start("hello");
+    cr_assert_eq(f.listener.calls, 1, "A body that came with the headers is done at once.");
+    cr_assert(f.listener.complete);
+    cr_assert_eq(f.drain(), "hello");
+}
+
+Test(cgi_body_stream, stops_at_content_length) {
+    Fixture f;
+    // Content-Length 10, three bytes of it read along with the headers
+    CgiBodyStream* stream = f.open(7);
+    stream->start("abc");
+    sendAll(f.client[1], "defghij<next request>");
+    stream->pump();
+    cr_assert_eq(f.listener.calls, 1);
+    cr_assert(f.listener.complete);
+    cr_assert_eq(f.drain(), "abcdefghij", "Nothing past the body may reach the script.");
+}
+
+Test(cgi_body_stream, reports_a_client_gone_mid_body) {
+    Fixture f;
+    CgiBodyStream* stream = f.open(7);
+    stream->start("abc");
+    close(f.client[1]);
+    f.client[1] = socket(AF_UNIX, SOCK_STREAM, 0);
+    stream->pump();
+    cr_assert_eq(f.listener.calls, 1);
+    cr_assert_not(f.listener.complete, "A truncated body is not complete.");
+}
+
+Test(cgi_body_stream, waits_for_a_slow_script) {
+    Fixture f;
+    fcntl(f.script[1], F_SETPIPE_SZ, 4096);
+    std::string body;
+    for (size_t i = 0; body.size() < 100000; ++i)
+        body += static_cast<char>('a' + i % 26);
+    CgiBodyStream* stream = f.open(body.size());
+    stream->start("");
+    sendAll(f.client[1], body);
+    stream->pump();
+    cr_assert_eq(f.listener.calls, 0, "The pipe is full, the stream waits.");
+    std::string received;
+    for (int rounds = 0; f.listener.calls == 0 && rounds < 1000; ++rounds) {
+        received += f.drain();
+        // What the reactor does once the pipe has room
+        stream->handleEvent(EPOLLOUT);
+    }
+    received += f.drain();
+    cr_assert_eq(f.listener.calls, 1);
+    cr_assert(f.listener.complete);
+    cr_assert(received == body, "The body should arrive whole and in order.");
+}
+
+Test(cgi_body_stream, drains_the_body_once_the_script_stops_reading) {
+    Fixture f;
+    CgiBodyStream* stream = f.open(100);
+    stream->start("");
+    close(f.script[0]);
+    f.script[0] = -1;
+    sendAll(f.client[1], std::string(100, 'x'));
+    stream->pump();
+    cr_assert_eq(f.listener.calls, 1);
+    cr_assert(f.listener.complete, "The client sent it all, the script just did not want it.");
+    char byte;
+    cr_assert_eq(recv(f.client[0], &byte, 1, MSG_DONTWAIT), -1, "The body should be read off the socket.");
+}
@@ -0,0 +1,95 @@
+#include <criterion.h>
+#include <string>
+#include <vector>
+#include "CgiResponseCache.hpp"
+
+namespace {
+    struct Recorder : public CgiResponseListener {
+        std::vector<std::string> responses;
+        void cgiResponseReady(const std::string& response) {
+            responses.push_back(response);
+        }
+    };
+}
+
+Test(cgi_cache, collapses_concurrent_misses) {
+    CgiResponseCache cache;
+    Recorder first, second;
+    const std::string* response = NULL;
+    cr_assert_eq(cache.lookup("/greet.py?name=a", &first, response), CgiResponseCache::MISS);
+    cr_assert_eq(cache.lookup("/greet.py?name=a", &second, response), CgiResponseCache::PENDING);
+    cache.store("/greet.py?name=a", "Content-Type: text/html\n\nhello", 60000, 0);
+    cr_assert_eq(first.responses.size(), 1u, "The first requester should be answered.");
+    cr_assert_eq(second.responses.size(), 1u, "The collapsed requester should be answered too.");
+
+    Recorder third;
+    cr_assert_eq(cache.lookup("/greet.py?name=a", &third, response), CgiResponseCache::FRESH);
+    cr_assert_not_null(response, "A fresh hit should carry the response.");
+    cr_assert(response->find("hello") != std::string::npos, "The cached response should hold the output.");
+    cr_assert_eq(third.responses.size(), 0u, "Hits are not queued.");
+}
+
+Test(cgi_cache, serves_stale_while_one_refresh_runs) {
+    CgiResponseCache cache;
+    Recorder client;
+    const std::string* response = NULL;
+    cache.lookup("/time.py?", &client, response);
+    cache.store("/time.py?", "Cache-Control: max-age=0, stale-while-revalidate=60\n\nv1", 60000, 0);
+    cr_assert_eq(cache.lookup("/time.py?", &client, response), CgiResponseCache::STALE);
+    cr_assert(cache.beginRefresh("/time.py?"), "The first stale hit should refresh.");
+    cr_assert_not(cache.beginRefresh("/time.py?"), "Only one refresh should run.");
+    cache.store("/time.py?", "Cache-Control: max-age=60\n\nv2", 0, 0);
+    cr_assert_eq(cache.lookup("/time.py?", &client, response), CgiResponseCache::FRESH);
+    cr_assert(response->find("v2") != std::string::npos, "The refreshed output should be served.");
+}
+
+Test(cgi_cache, honours_no_store_and_budget) {
+    CgiResponseCache cache(8 * 1024);
+    Recorder client;
+    const std::string* response = NULL;
+    cache.lookup("private", &client, response);
+    cache.store("private", "Cache-Control: no-store\n\nsecret", 60000, 0);
+    cr_assert_eq(cache.size(), 0u, "no-store output should not be kept.");
+    cr_assert_eq(client.responses.size(), 1u, "It should still be delivered.");
+
+    for (int i = 0; i < 20; ++i) {
+        std::string key(1, static_cast<char>('a' + i));
+        cache.lookup(key, &client, response);
+        cache.store(key, std::string(600, 'x'), 60000, 0);
+    }
+    cr_assert(cache.getBytes() <= 8 * 1024, "The byte budget should hold.");
+    cr_assert_eq(cache.lookup("t", &client, response), CgiResponseCache::FRESH, "The newest entry should survive.");
+}
+
+Test(cgi_cache, failure_answers_waiters) {
+    CgiResponseCache cache;
+    Recorder client;
+    const std::string* response = NULL;
+    cache.lookup("/broken.py?", &client, response);
+    cache.fail("/broken.py?");
+    cr_assert_eq(client.responses.size(), 1u);
+    cr_assert(client.responses[0].find("502") != std::string::npos, "Waiters should get a 502.");
+    cr_assert_eq(cache.size(), 0u, "A failed first execution leaves nothing behind.");
+}
+
+Test(cgi_cache, never_shares_cookies_or_errors) {
+    CgiResponseCache cache;
+    Recorder client;
+    const std::string* response = NULL;
+    cache.lookup("/login.py?", &client, response);
+    cache.store("/login.py?", "Set-Cookie: session_id=alice\nContent-Type: text/html\n\nHello Alice", 60000, 0);
+    cr_assert_eq(cache.size(), 0u, "A response setting a cookie must not be kept.");
+    cr_assert(client.responses[0].find("Hello Alice") != std::string::npos, "It should still reach its client.");
+
+    cache.lookup("/broken.py?", &client, response);
+    cache.store("/broken.py?", "Status: 500 Internal Server Error\n\noops", 60000, 0);
+    cr_assert_eq(cache.size(), 0u, "A server error must not be kept.");
+
+    cache.lookup("/missing.py?", &client, response);
+    cache.store("/missing.py?", "Status: 404 Not Found\n\nnone", 60000, 0);
+    cr_assert_eq(cache.size(), 1u, "A 404 is cacheable by default.");
+
+    cr_assert(CgiResponseCache::isShareable("HTTP/1.1 200 OK\r\nContent-Type: text/html\r\n\r\nbody"));
+    cr_assert_not(CgiResponseCache::isShareable("HTTP/1.1 302 Found\r\nLocation: /\r\n\r\n"));
+    cr_assert_not(CgiResponseCache::isShareable("HTTP/1.1 200 OK\r\nSET-COOKIE: a=b\r\n\r\n"));
+}
@@ -0,0 +1,52 @@
+#include <criterion.h>
+#include <string>
+#include "CgiResponseHeader.hpp"
+
+Test(cgi_header, passes_status_and_fields_on) {
+    CgiResponseHeader header;
+    std::string output = "Status: 201 Created\r\nSet-Cookie: a=1\r\nConnection: keep-alive\r\n\r\nbody";
+    cr_assert_eq(header.parse(output, false), CgiResponseHeader::PARSED);
+    cr_assert_eq(header.getLength(), output.size() - 4, "The body should start after the blank line.");
+    std::string head = header.format(true, 0);
+    cr_assert(head.find("HTTP/1.1 201 Created\r\n") == 0, "The script's status should be the status line.");
+    cr_assert(head.find("Set-Cookie: a=1\r\n") != std::string::npos, "Other fields should be passed on.");
+    cr_assert(head.find("Content-Type: text/html\r\n") != std::string::npos, "A missing Content-Type should default.");
+    cr_assert(head.find("keep-alive") == std::string::npos, "Connection is the server's.");
+    cr_assert(head.find("Transfer-Encoding: chunked\r\n") != std::string::npos);
+}
+
+Test(cgi_header, location_without_status_redirects) {
+    CgiResponseHeader header;
+    cr_assert_eq(header.parse("Location: /next\n\n", true), CgiResponseHeader::PARSED);
+    cr_assert(header.format(false, 0).find("HTTP/1.1 302 Found\r\n") == 0);
+}
+
+Test(cgi_header, waits_for_the_end_of_the_block) {
+    CgiResponseHeader header;
+    cr_assert_eq(header.parse("Content-Type: text/plain\n", false), CgiResponseHeader::INCOMPLETE);
+    cr_assert_eq(header.parse("", false), CgiResponseHeader::INCOMPLETE);
+}
+
+Test(cgi_header, output_without_header_is_all_body) {
+    CgiResponseHeader header;
+    cr_assert_eq(header.parse("<p>hello</p>\n", false), CgiResponseHeader::ABSENT);
+    cr_assert_eq(header.parse("Content-Type: text/plain\n", true), CgiResponseHeader::ABSENT);
+    cr_assert_eq(header.parse(std::string(CgiResponseHeader::MAX_LENGTH, 'a') + ":b", false), CgiResponseHeader::ABSENT);
+    cr_assert_eq(header.getLength(), 0u);
+    std::string response = CgiResponseHeader::buildResponse("<p>hello</p>");
+    cr_assert(response.find("HTTP/1.1 200 OK\r\n") == 0);
+    cr_assert(response.find("Content-Length: 12\r\n") != std::string::npos);
+}
+
+Test(cgi_header, rejects_a_malformed_status) {
+    CgiResponseHeader header;
+    cr_assert_eq(header.parse("Status: abc\n\n", true), CgiResponseHeader::MALFORMED);
+    cr_assert(CgiResponseHeader::buildResponse("Status: 20\n\nx").find("HTTP/1.1 502") == 0);
+}
+
+Test(cgi_header, response_length_counts_the_body_only) {
+    std::string response = CgiResponseHeader::buildResponse("Content-Type: text/plain\nContent-Length: 99\n\nhello");
+    cr_assert(response.find("Content-Length: 5\r\n") != std::string::npos, "The real body length should be sent.");
+    cr_assert(response.find("Content-Length: 99") == std::string::npos);
+    cr_assert_eq(response.substr(response.size() - 5), std::string("hello"));
+}
@@ -0,0 +1,103 @@
+#include <criterion.h>
+#include <csignal>
+#include <unistd.h>
+#include <vector>
+#include "CgiScheduler.hpp"
+
+namespace {
+    struct Waiter : CgiSlotListener {
+        int granted;
+        int expired;
+        Waiter() : granted(0), expired(0) {}
+        void cgiSlotGranted(void) { ++granted; }
+        void cgiSlotExpired(void) { ++expired; }
+    };
+
+    struct Script : CgiScript {
+        std::vector<int> signals;
+        void keepClientAlive(void) {}
+        void terminate(int signal) { signals.push_back(signal); }
+    };
+
+    CgiLimits limits(int maxScripts, int queueSize, int timeoutSeconds) {
+        CgiLimits result;
+        result.maxScripts = maxScripts;
+        result.queueSize = queueSize;
+        result.timeoutSeconds = timeoutSeconds;
+        return result;
+    }
+}
+
+Test(cgi_scheduler, admits_then_queues_then_refuses) {
+    CgiScheduler scheduler;
+    Waiter first, second, third;
+    cr_assert_eq(scheduler.admit("/cgi", limits(1, 1, 0), &first), CgiScheduler::RUN);
+    cr_assert_eq(scheduler.admit("/cgi", limits(1, 1, 0), &second), CgiScheduler::QUEUED);
+    cr_assert_eq(scheduler.admit("/cgi", limits(1, 1, 0), &third), CgiScheduler::FULL, "The queue is full.");
+    cr_assert_eq(scheduler.admit("/other", limits(1, 1, 0), &third), CgiScheduler::RUN, "Each route is its own pool.");
+    cr_assert_eq(scheduler.getCounters().refused, 1);
+
+    Script script;
+    scheduler.start(&script, "/cgi", 0);
+    scheduler.finished(&script);
+    cr_assert_eq(second.granted, 0, "Slots are handed on from tick(), not from finished().");
+    scheduler.tick();
+    cr_assert_eq(second.granted, 1);
+    cr_assert_eq(scheduler.getWaiting(), 0);
+    cr_assert_eq(scheduler.getRunning(), 2);
+}
+
+Test(cgi_scheduler, waiters_are_served_in_order) {
+    CgiScheduler scheduler;
+    Waiter running, first, second, late;
+    scheduler.admit("/cgi", limits(1, 4, 0), &running);
+    scheduler.admit("/cgi", limits(1, 4, 0), &first);
+    scheduler.admit("/cgi", limits(1, 4, 0), &second);
+    scheduler.release("/cgi");
+    // Arriving as the slot frees, it must not jump the queue
+    cr_assert_eq(scheduler.admit("/cgi", limits(1, 4, 0), &late), CgiScheduler::QUEUED);
+    scheduler.tick();
+    cr_assert_eq(first.granted, 1);
+    cr_assert_eq(second.granted, 0);
+    scheduler.cancel(&second);
+    scheduler.release("/cgi");
+    scheduler.tick();
+    cr_assert_eq(second.granted, 0, "A cancelled waiter is never granted.");
+    cr_assert_eq(late.granted, 1);
+}
+
+Test(cgi_scheduler, queued_requests_expire) {
+    CgiScheduler scheduler;
+    Waiter running, waiting;
+    scheduler.admit("/cgi", limits(1, 1, 1), &running);
+    scheduler.admit("/cgi", limits(1, 1, 1), &waiting);
+    scheduler.tick();
+    cr_assert_eq(waiting.expired, 0);
+    usleep(1100 * 1000);
+    scheduler.tick();
+    cr_assert_eq(waiting.expired, 1, "A waiter past the timeout is dropped.");
+    cr_assert_eq(scheduler.getWaiting(), 0);
+    cr_assert_eq(scheduler.getCounters().expired, 1);
+}
+
+Test(cgi_scheduler, overdue_scripts_get_sigterm_then_sigkill) {
+    CgiScheduler scheduler;
+    Waiter waiter;
+    Script script;
+    scheduler.admit("/cgi", limits(1, 1, 1), &waiter);
+    scheduler.start(&script, "/cgi", 1);
+    scheduler.tick();
+    cr_assert(script.signals.empty());
+    usleep(1100 * 1000);
+    scheduler.tick();
+    cr_assert_eq(script.signals.size(), 1u);
+    cr_assert_eq(script.signals[0], SIGTERM);
+    usleep((CgiScheduler::KILL_GRACE_MS + 100) * 1000);
+    scheduler.tick();
+    cr_assert_eq(script.signals.size(), 2u);
+    cr_assert_eq(script.signals[1], SIGKILL, "SIGKILL follows after the grace period.");
+    usleep(1100 * 1000);
+    scheduler.tick();
+    cr_assert_eq(script.signals.size(), 2u, "Nothing is sent after SIGKILL.");
+    cr_assert_eq(scheduler.getCounters().timedOut, 1);
+}
@@ -0,0 +1,37 @@
+#include <criterion.h>
+#include "ClientLimiter.hpp"
+
+Test(client_limiter, caps_connections_per_address) {
+    ClientLimiter limiter;
+    cr_assert(limiter.acquireConnection(0x0a000001, 2), "First connection should be admitted.");
+    cr_assert(limiter.acquireConnection(0x0a000001, 2), "Second connection should be admitted.");
+    cr_assert_not(limiter.acquireConnection(0x0a000001, 2), "Third connection should be over the cap.");
+    cr_assert(limiter.acquireConnection(0x0a000002, 2), "Other clients should not be affected.");
+    limiter.releaseConnection(0x0a000001);
+    cr_assert(limiter.acquireConnection(0x0a000001, 2), "A released slot should be reusable.");
+    cr_assert_eq(limiter.getCounters().rejectedConnections, 1);
+    cr_assert_eq(limiter.getActiveConnections(), 3);
+}
+
+Test(client_limiter, table_survives_growth_and_deletion) {
+    ClientLimiter limiter;
+    for (uint32_t address = 1; address <= 1000; ++address)
+        limiter.acquireConnection(address, 0);
+    for (uint32_t address = 1; address <= 1000; address += 2)
+        limiter.releaseConnection(address);
+    cr_assert_eq(limiter.getTrackedClients(), 500);
+    for (uint32_t address = 1; address <= 1000; ++address)
+        cr_assert_eq(limiter.getConnectionCount(address), address % 2 == 0 ? 1u : 0u, "Count for %u is wrong.", address);
+}
+
+Test(client_limiter, token_bucket_allows_burst) {
+    ClientLimiter limiter;
+    Route route;
+    route.setRateLimit(1.0 / 60);
+    route.setRateBurst(3);
+    for (int i = 0; i < 3; ++i)
+        cr_assert(limiter.allowRequest(0x7f000001, route), "The burst should be allowed.");
+    cr_assert_not(limiter.allowRequest(0x7f000001, route), "The fourth request should be limited.");
+    cr_assert(limiter.allowRequest(0x7f000002, route), "Each client has its own bucket.");
+    cr_assert_eq(limiter.getCounters().limitedRequests, 1);
+}
@@ -0,0 +1,79 @@
+#include <criterion.h>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "DirectoryListingCache.hpp"
+#include "DirectoryListingRenderer.hpp"
+
+namespace {
+    // A directory holding a.txt, b.txt, ... with count files
+    std::string makeDirectory(size_t count) {
+        char path[64];
+        std::snprintf(path, sizeof(path), "/tmp/listing_test_%d_XXXXXX", static_cast<int>(getpid()));
+        std::string directory = mkdtemp(path);
+        for (size_t i = 0; i < count; ++i) {
+            std::string file = directory + "/" + static_cast<char>('a' + i) + ".txt";
+            close(open(file.c_str(), O_CREAT | O_WRONLY, 0644));
+        }
+        return directory;
+    }
+
+    void removeDirectory(const std::string& directory, size_t count) {
+        for (size_t i = 0; i < count; ++i)
+            std::remove((directory + "/" + static_cast<char>('a' + i) + ".txt").c_str());
+        rmdir(directory.c_str());
+    }
+
+    // The whole response, as a client reading the socket would get it
+    std::string render(const std::string& directory, const std::string& queryString) {
+        int pair[2];
+        socketpair(AF_UNIX, SOCK_STREAM, 0, pair);
+        fcntl(pair[0], F_SETFL, O_NONBLOCK);
+        fcntl(pair[1], F_SETFL, O_NONBLOCK);
+        OutputQueue out;
+        out.setFd(pair[0]);
+        DirectoryListingCache listings;
+        DirectoryListingRenderer::stream(listings.getListing(directory), listings,
+            DirectoryListingQuery::fromQueryString(queryString), "/files", Cookie("", ""), out);
+        std::string response;
+        char buffer[65536];
+        ssize_t length;
+        do {
+            while ((length = read(pair[1], buffer, sizeof(buffer))) > 0)
+                response.append(buffer, length);
+        } while (out.flush() && out.isPending());
+        while ((length = read(pair[1], buffer, sizeof(buffer))) > 0)
+            response.append(buffer, length);
+        close(pair[0]);
+        close(pair[1]);
+        return response;
+    }
+}
+
+Test(directory_listing, pages_through_the_entries) {
+    std::string directory = makeDirectory(5);
+    std::string page = render(directory, "format=json&page=2&per_page=2");
+    cr_assert(page.find("\"name\":\"c.txt\"") != std::string::npos);
+    cr_assert(page.find("\"name\":\"d.txt\"") != std::string::npos);
+    cr_assert(page.find("\"name\":\"b.txt\"") == std::string::npos, "Only the second page should be listed.");
+    cr_assert(page.find("\"name\":\"e.txt\"") == std::string::npos);
+    removeDirectory(directory, 5);
+}
+
+Test(directory_listing, page_past_the_end_is_empty) {
+    std::string directory = makeDirectory(5);
+    cr_assert(render(directory, "format=json&page=4&per_page=2").find("\"entries\":[]") != std::string::npos);
+    // (page - 1) * per_page would wrap around to an arbitrary offset
+    std::string page = render(directory, "format=json&page=18446744073709551615&per_page=2");
+    cr_assert(page.find("\"entries\":[]") != std::string::npos, "A huge page number should list nothing.");
+    // 2^63 * 2 wraps to exactly 0, the first page
+    page = render(directory, "format=json&page=9223372036854775809&per_page=2");
+    cr_assert(page.find("\"entries\":[]") != std::string::npos, "A wrapped offset should not list the first page.");
+    page = render(directory, "page=18446744073709551615");
+    cr_assert(page.find("<li>") == std::string::npos);
+    cr_assert(page.find(">Next</a>") == std::string::npos);
+    removeDirectory(directory, 5);
+}
@@ -0,0 +1,71 @@
+#include <criterion.h>
+#include <map>
+#include <string>
+#include "FastCgiRecord.hpp"
+
+Test(fastcgi_record, round_trips_a_record) {
+    std::string buffer;
+    FastCgiRecord::append(buffer, FastCgiRecord::STDOUT, 7, "hello", 5);
+    cr_assert_eq(buffer.size() % 8, 0u, "Records should be padded to 8 bytes.");
+
+    size_t offset = 0;
+    FastCgiRecord record;
+    cr_assert(FastCgiRecord::parse(buffer, offset, record), "A complete record should parse.");
+    cr_assert_eq(record.type, FastCgiRecord::STDOUT);
+    cr_assert_eq(record.requestId, 7);
+    cr_assert_eq(record.content, std::string("hello"));
+    cr_assert_eq(offset, buffer.size(), "Parsing should consume the padding.");
+}
+
+Test(fastcgi_record, waits_for_partial_records) {
+    std::string buffer;
+    FastCgiRecord::append(buffer, FastCgiRecord::STDERR, 1, "oops", 4);
+    std::string partial = buffer.substr(0, buffer.size() - 1);
+    size_t offset = 0;
+    FastCgiRecord record;
+    cr_assert_not(FastCgiRecord::parse(partial, offset, record), "A truncated record should not parse.");
+    cr_assert_eq(offset, 0u, "Nothing should be consumed.");
+}
+
+Test(fastcgi_record, splits_long_streams) {
+    std::string data(70000, 'x');
+    std::string buffer;
+    FastCgiRecord::appendStream(buffer, FastCgiRecord::STDIN, 3, data);
+
+    size_t offset = 0;
+    FastCgiRecord record;
+    std::string received;
+    int records = 0;
+    while (FastCgiRecord::parse(buffer, offset, record)) {
+        received += record.content;
+        ++records;
+    }
+    cr_assert_eq(records, 3, "Two data records and the empty one ending the stream.");
+    cr_assert_eq(received, data);
+    cr_assert(record.content.empty(), "The stream should end with an empty record.");
+}
+
+Test(fastcgi_record, encodes_short_and_long_pairs) {
+    std::map<std::string, std::string> pairs;
+    pairs["QUERY_STRING"] = "name=bob";
+    pairs["HTTP_COOKIE"] = std::string(300, 'c');
+    pairs["EMPTY"] = "";
+    std::string content;
+    for (std::map<std::string, std::string>::iterator it = pairs.begin(); it != pairs.end(); ++it)
+        FastCgiRecord::encodePair(content, it->first, it->second);
+
+    std::map<std::string, std::string> decoded;
+    cr_assert(FastCgiRecord::decodePairs(content, decoded), "Encoded pairs should decode.");
+    cr_assert(decoded == pairs, "Decoded pairs should match.");
+    cr_assert_not(FastCgiRecord::decodePairs(content.substr(0, content.size() - 1), decoded), "Truncated pairs should be rejected.");
+}
+
+Test(fastcgi_record, parses_end_request) {
+    std::string content("\x00\x00\x01\x02\x00\x00\x00\x00", 8);
+    uint32_t appStatus;
+    uint8_t protocolStatus;
+    cr_assert(FastCgiRecord::parseEndRequest(content, appStatus, protocolStatus));
+    cr_assert_eq(appStatus, 258u);
+    cr_assert_eq(protocolStatus, FastCgiRecord::REQUEST_COMPLETE);
+    cr_assert_not(FastCgiRecord::parseEndRequest("short", appStatus, protocolStatus));
+}
@@ -0,0 +1,105 @@
+#include <criterion.h>
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "FileInfoCache.hpp"
+
+static std::string tempDir(const std::string& name) {
+    char path[64];
+    std::snprintf(path, sizeof(path), "/tmp/fileinfo_test_%d_", static_cast<int>(getpid()));
+    std::string directory = path + name;
+    mkdir(directory.c_str(), 0755);
+    return directory;
+}
+
+static void writeFile(const std::string& path, const std::string& content) {
+    std::ofstream out(path.c_str());
+    out << content;
+}
+
+// inotify watches the descriptor holds, as listed in /proc
+static int countWatches(FileWatcher& watcher) {
+    std::ostringstream path;
+    path << "/proc/self/fdinfo/" << watcher.getHandle();
+    std::ifstream in(path.str().c_str());
+    std::string line;
+    int watches = 0;
+    while (std::getline(in, line))
+        watches += line.compare(0, 8, "inotify ") == 0;
+    return watches;
+}
+
+Test(file_info_cache, reports_what_stat_would) {
+    std::string directory = tempDir("stat");
+    std::string file = directory + "/a.txt";
+    writeFile(file, "12345");
+    FileInfoCache cache;
+    FileInfo info = cache.lookup(file);
+    cr_assert(info.isRegularFile());
+    cr_assert_eq(info.size, 5);
+    cr_assert(cache.lookup(directory + "/").isDirectory(), "A directory is one with or without its slash.");
+    cr_assert_eq(cache.lookup(file + "/").error, ENOTDIR, "\"file/\" fails like stat() does.");
+    cr_assert_eq(cache.lookup(directory + "/missing").error, ENOENT);
+    cr_assert_not(cache.lookup(directory + "/missing").exists());
+    std::remove(file.c_str());
+    rmdir(directory.c_str());
+}
+
+Test(file_info_cache, trusts_entries_until_they_expire) {
+    std::string directory = tempDir("ttl");
+    std::string file = directory + "/a.txt";
+    writeFile(file, "x");
+    FileInfoCache cache(16, 60000);
+    cr_assert(cache.lookup(file).exists());
+    std::remove(file.c_str());
+    cr_assert(cache.lookup(file).exists(), "Without a watcher the entry stands until its TTL.");
+    cr_assert_eq(cache.getHits(), 1);
+    cache.invalidate(file);
+    cr_assert_not(cache.lookup(file).exists());
+    cr_assert_eq(cache.getMisses(), 2);
+    rmdir(directory.c_str());
+}
+
+Test(file_info_cache, watcher_reports_changes) {
+    std::string directory = tempDir("watch");
+    std::string file = directory + "/a.txt";
+    writeFile(file, "x");
+    FileWatcher watcher;
+    cr_assert(watcher.isActive());
+    FileInfoCache cache(16, 60000);
+    cache.setWatcher(&watcher);
+    cr_assert_eq(cache.lookup(file).size, 1);
+    writeFile(file, "longer");
+    watcher.handleEvent(EPOLLIN);
+    cr_assert_eq(cache.lookup(file).size, 6, "The change should drop the entry.");
+    cache.setWatcher(NULL);
+    std::remove(file.c_str());
+    rmdir(directory.c_str());
+}
+
+Test(file_info_cache, evicted_entries_give_back_their_watch) {
+    std::string first = tempDir("evict1");
+    std::string second = tempDir("evict2");
+    FileWatcher watcher;
+    // Another cache holding the first directory keeps it watched
+    cr_assert(watcher.watchDirectory(first));
+    FileInfoCache cache(1, 60000);
+    cache.setWatcher(&watcher);
+    FileInfo kept = cache.lookup(first + "/a");
+    cr_assert_eq(countWatches(watcher), 1);
+    cache.lookup(second + "/b");
+    cr_assert_eq(countWatches(watcher), 2);
+    cache.lookup(first + "/a");
+    cr_assert_eq(countWatches(watcher), 1, "The evicted entry's directory should be unwatched.");
+    cache.clear();
+    cr_assert_eq(countWatches(watcher), 1, "A watch someone else holds should stay.");
+    cr_assert_eq(kept.error, ENOENT, "A copy outlives its entry.");
+    cache.setWatcher(NULL);
+    rmdir(first.c_str());
+    rmdir(second.c_str());
+}
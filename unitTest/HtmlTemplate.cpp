@@ -0,0 +1,121 @@
+#include <criterion.h>
+#include <cstdio>
+#include <fcntl.h>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "FileInfoCache.hpp"
+#include "HtmlTemplate.hpp"
+#include "TemplateCache.hpp"
+
+static std::string tempPath(const std::string& name) {
+    char path[64];
+    std::snprintf(path, sizeof(path), "/tmp/template_test_%d_", static_cast<int>(getpid()));
+    return path + name;
+}
+
+// A new mtime each time, even within the same second
+static void writeFile(const std::string& path, const std::string& content) {
+    static long tick = 0;
+    std::ofstream out(path.c_str());
+    out << content;
+    out.close();
+    struct timespec times[2];
+    times[0].tv_sec = times[1].tv_sec = 1000000 + ++tick;
+    times[0].tv_nsec = times[1].tv_nsec = 0;
+    utimensat(AT_FDCWD, path.c_str(), times, 0);
+}
+
+static std::string render(const HtmlTemplate& page, const TemplateVariables& variables) {
+    std::vector<struct iovec> iov;
+    page.appendIovecs(variables, iov);
+    std::string out;
+    for (size_t i = 0; i < iov.size(); ++i)
+        out.append(static_cast<const char*>(iov[i].iov_base), iov[i].iov_len);
+    return out;
+}
+
+Test(html_template, fills_variables_and_includes) {
+    std::string page = tempPath("page.html");
+    std::string fragment = tempPath("fragment.html");
+    writeFile(page, "<h1>[TITLE]</h1>[INCLUDE:" + fragment.substr(5) + "]<p>[UNSET] [not a variable]</p>");
+    writeFile(fragment, "<b>[USER_1]</b>");
+    HtmlTemplate compiled(page);
+    compiled.compile();
+    TemplateVariables variables;
+    variables["TITLE"] = "Hello";
+    variables["USER_1"] = "ann";
+    std::string expected = "<h1>Hello</h1><b>ann</b><p>[UNSET] [not a variable]</p>";
+    cr_assert(compiled.hasPlaceholders());
+    cr_assert_eq(render(compiled, variables), expected, "Unset variables should keep their placeholder.");
+    cr_assert_eq(compiled.renderedLength(variables), expected.size());
+    std::remove(page.c_str());
+    std::remove(fragment.c_str());
+}
+
+Test(html_template, refuses_includes_outside_its_directory) {
+    std::string page = tempPath("escape.html");
+    writeFile(page, "a[INCLUDE:../etc/passwd]b");
+    HtmlTemplate compiled(page);
+    compiled.compile();
+    cr_assert_eq(render(compiled, TemplateVariables()), "ab");
+    std::remove(page.c_str());
+}
+
+Test(html_template, missing_file_throws) {
+    HtmlTemplate compiled(tempPath("missing.html"));
+    bool thrown = false;
+    try {
+        compiled.compile();
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    cr_assert(thrown, "A template that can't be read should throw.");
+}
+
+Test(template_cache, recompiles_when_an_include_changes) {
+    std::string page = tempPath("cached.html");
+    std::string fragment = tempPath("cached_fragment.html");
+    writeFile(page, "[INCLUDE:" + fragment.substr(5) + "]");
+    writeFile(fragment, "v1");
+    TemplateCache cache;
+    FileInfoCache files(4096, 0);
+    const HtmlTemplate* first = cache.getTemplate(page, &files);
+    cr_assert_eq(cache.getTemplate(page, &files), first, "An unchanged template should be reused.");
+    cr_assert_not(first->isStale(&files));
+    writeFile(fragment, "v2");
+    cr_assert(first->isStale(&files), "A changed include makes the page stale.");
+    const HtmlTemplate* second = cache.getTemplate(page, &files);
+    cr_assert_eq(render(*second, TemplateVariables()), "v2");
+    std::remove(page.c_str());
+    std::remove(fragment.c_str());
+}
+
+Test(template_cache, evicts_the_least_recently_used) {
+    std::string a = tempPath("a.html");
+    std::string b = tempPath("b.html");
+    std::string c = tempPath("c.html");
+    writeFile(a, "a");
+    writeFile(b, "b");
+    writeFile(c, "c");
+    TemplateCache cache(2);
+    // Metadata trusted for a minute: a cached template never touches the disk
+    FileInfoCache files(4096, 60000);
+    cache.getTemplate(a, &files);
+    cache.getTemplate(b, &files);
+    cache.getTemplate(a, &files);
+    cache.getTemplate(c, &files);
+    std::remove(a.c_str());
+    std::remove(b.c_str());
+    std::remove(c.c_str());
+    cr_assert_eq(render(*cache.getTemplate(a, &files), TemplateVariables()), "a", "The most recently used template should stay.");
+    bool thrown = false;
+    try {
+        cache.getTemplate(b, &files);
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    cr_assert(thrown, "The least recently used template should have been evicted.");
+}
@@ -0,0 +1,48 @@
+#include <criterion.h>
+#include "NegativeLookupCache.hpp"
+
+Test(negative_lookup, remembers_misses_per_root) {
+    NegativeLookupCache cache;
+    cache.recordMiss("/srv/www", "/srv/www/wp-login.php", "/srv/www/wp-login.php");
+    cr_assert(cache.isKnownMiss("/srv/www", "/srv/www/wp-login.php"), "A recorded miss should be known.");
+    cr_assert_not(cache.isKnownMiss("/srv/www", "/srv/www/index.html"), "Other paths should not be.");
+    cr_assert_not(cache.isKnownMiss("/srv/other", "/srv/www/wp-login.php"), "The miss belongs to its root only.");
+}
+
+Test(negative_lookup, change_below_root_invalidates) {
+    NegativeLookupCache cache;
+    cache.recordMiss("/srv/www", "/srv/www/a/b.html", "/srv/www/a/b.html");
+    cache.recordMiss("/srv/img", "/srv/img/c.png", "/srv/img/c.png");
+    cache.fileChanged("/srv/www/a", true);
+    cr_assert_not(cache.isKnownMiss("/srv/www", "/srv/www/a/b.html"), "A change below the root should drop its misses.");
+    cr_assert(cache.isKnownMiss("/srv/img", "/srv/img/c.png"), "Other roots should keep theirs.");
+}
+
+Test(negative_lookup, bounded_and_rebuilt) {
+    NegativeLookupCache cache(16);
+    for (int i = 0; i < 100; ++i) {
+        std::string path = "/srv/www/scan" + std::string(1, 'a' + i % 26) + std::string(1, 'a' + i / 26);
+        cache.recordMiss("/srv/www", path, path);
+    }
+    cr_assert_not(cache.isKnownMiss("/srv/www", "/srv/www/scanaa"), "The oldest misses should be evicted.");
+    cr_assert(cache.isKnownMiss("/srv/www", "/srv/www/scanvd"), "The newest misses should survive Bloom filter rebuilds.");
+}
+
+Test(negative_lookup, evicts_least_recently_hit) {
+    NegativeLookupCache cache(3);
+    // A stale miss recorded again must not count twice
+    for (int i = 0; i < 50; ++i) {
+        cache.recordMiss("/srv/www", "/srv/www/a", "/srv/www/a");
+        cache.fileChanged("/srv/www/a", false);
+        cr_assert_not(cache.isKnownMiss("/srv/www", "/srv/www/a"));
+    }
+    cache.recordMiss("/srv/www", "/srv/www/a", "/srv/www/a");
+    cache.recordMiss("/srv/www", "/srv/www/b", "/srv/www/b");
+    cache.recordMiss("/srv/www", "/srv/www/c", "/srv/www/c");
+    cr_assert(cache.isKnownMiss("/srv/www", "/srv/www/a"));
+    cache.recordMiss("/srv/www", "/srv/www/d", "/srv/www/d");
+    cr_assert(cache.isKnownMiss("/srv/www", "/srv/www/a"), "A recently hit miss should be kept.");
+    cr_assert_not(cache.isKnownMiss("/srv/www", "/srv/www/b"), "The least recently hit miss should go first.");
+    cr_assert(cache.isKnownMiss("/srv/www", "/srv/www/c"));
+    cr_assert(cache.isKnownMiss("/srv/www", "/srv/www/d"));
+}
@@ -0,0 +1,119 @@
+#include <criterion.h>
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <fstream>
+#include <string>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include "OpenFileCache.hpp"
+
+static std::string tempPath(const std::string& name) {
+    char path[64];
+    std::snprintf(path, sizeof(path), "/tmp/openfile_test_%d_", static_cast<int>(getpid()));
+    return path + name;
+}
+
+static void writeFile(const std::string& path, const std::string& content) {
+    std::ofstream out(path.c_str());
+    out << content;
+}
+
+static bool isOpen(int fd) {
+    return fcntl(fd, F_GETFD) != -1;
+}
+
+Test(open_file_cache, shares_one_descriptor) {
+    std::string path = tempPath("shared.txt");
+    writeFile(path, "hello");
+    OpenFileCache cache;
+    OpenFile* first = cache.acquire(path);
+    OpenFile* second = cache.acquire(path);
+    cr_assert_not_null(first);
+    cr_assert_eq(first, second, "Both responses should share the open file.");
+    cr_assert_eq(first->size, 5);
+    cr_assert_eq(first->refCount, 3, "The cache holds a reference of its own.");
+    cache.release(first);
+    cache.release(second);
+    cr_assert(isOpen(first->fd), "The cache keeps the file open.");
+    std::remove(path.c_str());
+}
+
+Test(open_file_cache, dropped_file_stays_open_until_released) {
+    std::string path = tempPath("dropped.txt");
+    writeFile(path, "old");
+    OpenFileCache cache;
+    OpenFile* file = cache.acquire(path);
+    int fd = file->fd;
+    cache.invalidate(path);
+    cr_assert(file->detached);
+    cr_assert(isOpen(fd), "A response still sending it keeps it open.");
+    writeFile(path, "new content");
+    OpenFile* fresh = cache.acquire(path);
+    cr_assert_neq(fresh, file);
+    cr_assert_eq(fresh->size, 11);
+    char buffer[8];
+    cr_assert_gt(pread(fd, buffer, sizeof(buffer), 0), 0, "The old response can still read it.");
+    cache.release(file);
+    cr_assert_not(isOpen(fd), "The last release closes a dropped file.");
+    cache.release(fresh);
+    std::remove(path.c_str());
+}
+
+Test(open_file_cache, failures_are_cached_briefly) {
+    std::string path = tempPath("late.txt");
+    std::remove(path.c_str());
+    OpenFileCache cache(16, 60000);
+    errno = 0;
+    cr_assert_null(cache.acquire(path));
+    cr_assert_eq(errno, ENOENT);
+    writeFile(path, "x");
+    cr_assert_null(cache.acquire(path), "The failure is remembered for the TTL.");
+    cr_assert_eq(errno, ENOENT);
+    cr_assert_null(cache.acquire("/tmp"));
+    cr_assert_eq(errno, EISDIR, "Only regular files are opened.");
+
+    OpenFileCache shortLived(16, 0);
+    OpenFile* file = shortLived.acquire(path);
+    cr_assert_not_null(file);
+    shortLived.release(file);
+    std::remove(path.c_str());
+}
+
+Test(open_file_cache, watcher_drops_changed_files) {
+    std::string path = tempPath("watched.txt");
+    writeFile(path, "v1");
+    FileWatcher watcher;
+    OpenFileCache cache(16, 60000);
+    cache.setWatcher(&watcher);
+    OpenFile* first = cache.acquire(path);
+    cache.release(first);
+    writeFile(path, "v2 is longer");
+    watcher.handleEvent(EPOLLIN);
+    OpenFile* second = cache.acquire(path);
+    cr_assert_eq(second->size, 12, "A change reported by the watcher should reopen the file.");
+    cache.release(second);
+    cache.setWatcher(NULL);
+    std::remove(path.c_str());
+}
+
+Test(open_file_cache, evicts_the_least_recently_used) {
+    std::string a = tempPath("a.txt");
+    std::string b = tempPath("b.txt");
+    std::string c = tempPath("c.txt");
+    writeFile(a, "a");
+    writeFile(b, "b");
+    writeFile(c, "c");
+    OpenFileCache cache(2, 60000);
+    cache.release(cache.acquire(a));
+    cache.release(cache.acquire(b));
+    cache.release(cache.acquire(a));
+    cache.release(cache.acquire(c));
+    std::remove(a.c_str());
+    std::remove(b.c_str());
+    std::remove(c.c_str());
+    OpenFile* file = cache.acquire(a);
+    cr_assert_not_null(file, "The most recently used file should stay open.");
+    cache.release(file);
+    cr_assert_null(cache.acquire(b), "The least recently used file should have been closed.");
+}
@@ -0,0 +1,45 @@
+#include <criterion.h>
+#include "HTTPRequestParser.hpp"
+#include "ParsingUtils.hpp"
+
+static std::string normalize(const std::string& path) {
+    std::string normalized;
+    if (!ParsingUtils::normalizeUriPath(path, normalized))
+        return "<rejected>";
+    return normalized;
+}
+
+Test(path_traversal, resolves_dot_segments) {
+    cr_assert_eq(normalize("/"), "/");
+    cr_assert_eq(normalize("/index.html"), "/index.html");
+    cr_assert_eq(normalize("/dir/"), "/dir/", "A directory keeps its trailing slash.");
+    cr_assert_eq(normalize("/a/./b//c"), "/a/b/c");
+    cr_assert_eq(normalize("/a/b/../c"), "/a/c");
+    cr_assert_eq(normalize("/a/b/.."), "/a/");
+    cr_assert_eq(normalize("/a/.."), "/");
+    cr_assert_eq(normalize("/a/..b/c.."), "/a/..b/c..", "Only whole segments are dot segments.");
+}
+
+Test(path_traversal, rejects_paths_escaping_the_root) {
+    cr_assert_eq(normalize("/.."), "<rejected>");
+    cr_assert_eq(normalize("/../../../../etc/passwd"), "<rejected>");
+    cr_assert_eq(normalize("/a/../../etc/passwd"), "<rejected>");
+    cr_assert_eq(normalize("etc/passwd"), "<rejected>", "Only absolute paths are served.");
+    cr_assert_eq(normalize(""), "<rejected>");
+}
+
+Test(path_traversal, parser_normalizes_the_request_uri) {
+    HTTPRequestParser parser;
+    parser.appendData("GET /dir/./sub/../file.txt?x=/../y HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    cr_assert(parser.isCompleteRequest());
+    cr_assert_eq(parser.getUri(), "/dir/file.txt?x=/../y", "The query string is left alone.");
+
+    HTTPRequestParser escaping;
+    bool rejected = false;
+    try {
+        escaping.appendData("GET /../../../../etc/passwd HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    } catch (const HTTPRequestParser::InvalidUriException&) {
+        rejected = true;
+    }
+    cr_assert(rejected, "A path above the root must be refused.");
+}
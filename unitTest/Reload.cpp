@@ -0,0 +1,119 @@
+#include <criterion.h>
+#include <arpa/inet.h>
+#include <cstdio>
+#include <fstream>
+#include <netinet/in.h>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "ConfigSnapshot.hpp"
+#include "Reactor.hpp"
+#include "ServerManager.hpp"
+
+namespace {
+    // Ports of their own, so parallel runs don't collide
+    int testPort(int offset) {
+        return 20000 + getpid() % 20000 + offset;
+    }
+
+    std::string configFile(void) {
+        char path[64];
+        std::snprintf(path, sizeof(path), "/tmp/reload_test_%d_.ini", static_cast<int>(getpid()));
+        return path;
+    }
+
+    void writeConfig(const std::string& host, int port, int otherPort) {
+        std::ofstream out(configFile().c_str());
+        out << "[server:example.com]\n";
+        if (!host.empty())
+            out << "host=" << host << "\n";
+        out << "port=" << port;
+        if (otherPort != 0)
+            out << "," << otherPort;
+        out << "\n";
+        out << "\n[route:/]\nmethods=GET\n";
+    }
+
+    // The kernel completes the handshake from the backlog, no accept() needed
+    bool connects(const std::string& host, int port) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in address;
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        inet_pton(AF_INET, host.c_str(), &address.sin_addr);
+        bool connected = connect(fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) == 0;
+        close(fd);
+        return connected;
+    }
+
+    struct Fixture {
+        Reactor reactor;
+        ServerManager& manager;
+
+        Fixture() : manager(ServerManager::getInstance()) {
+            manager.setConfigPath(configFile());
+        }
+        ~Fixture() {
+            manager.setConfig(NULL);
+            manager.syncListeners(reactor);
+            std::remove(configFile().c_str());
+        }
+        void start(void) {
+            manager.setConfig(ConfigSnapshot::load(configFile()));
+            manager.syncListeners(reactor);
+        }
+    };
+}
+
+Test(reload, opens_and_closes_ports) {
+    Fixture f;
+    int port = testPort(0);
+    int otherPort = testPort(1);
+    writeConfig("", port, 0);
+    f.start();
+    cr_assert(connects("127.0.0.1", port));
+    cr_assert_not(connects("127.0.0.1", otherPort));
+    writeConfig("", port, otherPort);
+    cr_assert(f.manager.reloadConfig(f.reactor));
+    cr_assert(connects("127.0.0.1", port), "An unchanged port should stay open.");
+    cr_assert(connects("127.0.0.1", otherPort), "A new port should be opened.");
+    writeConfig("", otherPort, 0);
+    cr_assert(f.manager.reloadConfig(f.reactor));
+    cr_assert_not(connects("127.0.0.1", port), "A port no longer configured should be closed.");
+    cr_assert(connects("127.0.0.1", otherPort));
+}
+
+Test(reload, invalid_config_keeps_the_running_one) {
+    Fixture f;
+    int port = testPort(2);
+    writeConfig("", port, 0);
+    f.start();
+    ConfigSnapshot* running = f.manager.getConfig();
+    {
+        std::ofstream out(configFile().c_str());
+        out << "[server:example.com]\nport=nope\n";
+    }
+    cr_assert_not(f.manager.reloadConfig(f.reactor));
+    cr_assert_eq(f.manager.getConfig(), running);
+    cr_assert(connects("127.0.0.1", port), "The listener should be left alone.");
+}
+
+Test(reload, moved_listener_survives_a_failed_bind) {
+    Fixture f;
+    int port = testPort(3);
+    writeConfig("127.0.0.1", port, 0);
+    f.start();
+    cr_assert(connects("127.0.0.1", port));
+    writeConfig("127.0.0.2", port, 0);
+    cr_assert(f.manager.reloadConfig(f.reactor));
+    cr_assert(connects("127.0.0.2", port), "The port should follow its new address.");
+    cr_assert_not(connects("127.0.0.1", port));
+    // Not an address of this machine, so the bind fails
+    writeConfig("192.0.2.1", port, 0);
+    cr_assert(f.manager.reloadConfig(f.reactor));
+    cr_assert(connects("127.0.0.2", port), "The old listener should be kept when the new one can't be bound.");
+    writeConfig("", port, 0);
+    cr_assert(f.manager.reloadConfig(f.reactor));
+    cr_assert(connects("127.0.0.1", port), "Moving to the wildcard address rebinds the port.");
+}
@@ -70,4 +70,24 @@ Test(request_handler_tests, get_mime_type_unknown) {
     cr_assert_str_eq(mimeType.c_str(), "application/octet-stream", "Failed to return default MIME type for unknown file extension.");
 }
 
+Test(request_handler_tests, get_mime_type_uppercase_extension) {
+    RequestHandler handler;
+    std::string mimeType = handler.getMimeType("/path/to/IMAGE.PNG");
+    cr_assert_str_eq(mimeType.c_str(), "image/png", "Failed to match an uppercase extension.");
+}
 
+Test(request_handler_tests, get_mime_type_dot_in_directory_only) {
+    RequestHandler handler;
+    std::string mimeType = handler.getMimeType("/path.html/README");
+    cr_assert_str_eq(mimeType.c_str(), "application/octet-stream", "Failed to ignore a dot outside the file name.");
+}
+
+Test(request_handler_tests, get_mime_type_server_types_block) {
+    RequestHandler handler;
+    Server server;
+    server.setMimeType("md", "text/x-markdown");
+    server.setMimeType(".Foo", "application/x-foo");
+    cr_assert_str_eq(handler.getMimeType("/notes.md", &server).c_str(), "text/x-markdown", "Failed to override a built-in type.");
+    cr_assert_str_eq(handler.getMimeType("/a.foo", &server).c_str(), "application/x-foo", "Failed to add a configured type.");
+    cr_assert_str_eq(handler.getMimeType("/a.css", &server).c_str(), "text/css", "Failed to keep built-in types.");
+}
@@ -0,0 +1,48 @@
+#include <criterion.h>
+#include "Router.hpp"
+
+static std::map<std::string, Route> makeRoutes(const char** paths, size_t count) {
+    std::map<std::string, Route> routes;
+    for (size_t i = 0; i < count; ++i) {
+        Route route;
+        route.setRoutePath(paths[i]);
+        routes[paths[i]] = route;
+    }
+    return routes;
+}
+
+Test(router, longest_prefix_match) {
+    const char* paths[] = { "/", "/website", "/website/img", "/api/v1/users" };
+    std::map<std::string, Route> routes = makeRoutes(paths, 4);
+    Router router;
+    router.compile(routes);
+    cr_assert_str_eq(router.match("/website/img/x.jpg")->route->getRoutePath().c_str(), "/website/img", "Deepest route should win.");
+    cr_assert_str_eq(router.match("/website/about.html")->route->getRoutePath().c_str(), "/website", "Parent route should match a file below it.");
+    cr_assert_str_eq(router.match("/api/v1/users/42")->route->getRoutePath().c_str(), "/api/v1/users", "Collapsed edges should match.");
+    cr_assert_str_eq(router.match("/api/v1")->route->getRoutePath().c_str(), "/", "A partial edge should fall back to the root route.");
+}
+
+Test(router, matches_whole_segments_only) {
+    const char* paths[] = { "/website" };
+    std::map<std::string, Route> routes = makeRoutes(paths, 1);
+    Router router;
+    router.compile(routes);
+    cr_assert_null(router.match("/websites"), "A route must not match a longer segment.");
+    cr_assert_not_null(router.match("/website/"), "A trailing slash should still match.");
+    cr_assert_null(router.match("/"), "No root route was configured.");
+}
+
+Test(router, packs_route_flags) {
+    std::map<std::string, Route> routes;
+    Route route;
+    route.setRoutePath("/uploads");
+    route.setGetMethod(true);
+    route.setDeleteMethod(true);
+    route.setAllowFileUpload(true);
+    routes["/uploads"] = route;
+    Router router;
+    router.compile(routes);
+    const RouteRecord* record = router.match("/uploads/a.txt");
+    cr_assert(record->has(ROUTE_GET) && record->has(ROUTE_DELETE) && record->has(ROUTE_FILE_UPLOAD), "Flags should be set.");
+    cr_assert_not(record->has(ROUTE_POST) || record->has(ROUTE_CGI), "Unset flags should stay clear.");
+}
@@ -0,0 +1,43 @@
+#include <criterion.h>
+#include <cstring>
+#include <set>
+#include "SecureRandom.hpp"
+#include "SessionManager.hpp"
+
+// RFC 8439, 2.3.2
+Test(secure_random, chacha20_block_matches_rfc_vector) {
+    uint32_t key[8];
+    for (int i = 0; i < 8; ++i)
+        key[i] = (4 * i) | ((4 * i + 1) << 8) | ((4 * i + 2) << 16) | ((4 * i + 3) << 24);
+    const uint32_t nonce[3] = { 0x09000000, 0x4a000000, 0x00000000 };
+    const unsigned char expected[64] = {
+        0x10, 0xf1, 0xe7, 0xe4, 0xd1, 0x3b, 0x59, 0x15, 0x50, 0x0f, 0xdd, 0x1f, 0xa3, 0x20, 0x71, 0xc4,
+        0xc7, 0xd1, 0xf4, 0xc7, 0x33, 0xc0, 0x68, 0x03, 0x04, 0x22, 0xaa, 0x9a, 0xc3, 0xd4, 0x6c, 0x4e,
+        0xd2, 0x82, 0x64, 0x46, 0x07, 0x9f, 0xaa, 0x09, 0x14, 0xc2, 0xd7, 0x05, 0xd9, 0x8b, 0x02, 0xa2,
+        0xb5, 0x12, 0x9c, 0xd1, 0xde, 0x16, 0x4e, 0xb9, 0xcb, 0xd0, 0x83, 0xe8, 0xa2, 0x50, 0x3c, 0x4e
+    };
+    unsigned char out[64];
+    SecureRandom::block(key, 1, nonce, out);
+    cr_assert(std::memcmp(out, expected, sizeof(out)) == 0, "ChaCha20 block does not match the test vector.");
+}
+
+Test(secure_random, output_does_not_repeat_across_refills) {
+    SecureRandom random;
+    std::set<std::string> seen;
+    unsigned char chunk[16];
+    for (int i = 0; i < 10000; ++i) {
+        random.fill(chunk, sizeof(chunk));
+        cr_assert(seen.insert(std::string(reinterpret_cast<char*>(chunk), sizeof(chunk))).second, "Chunk %d repeated.", i);
+    }
+}
+
+Test(secure_random, session_ids_are_distinct_and_well_formed) {
+    SessionManager sessions;
+    std::set<std::string> seen;
+    for (int i = 0; i < 100000; ++i) {
+        std::string id = sessions.generateUniqueID();
+        cr_assert_eq(id.size(), SessionManager::ID_LENGTH);
+        cr_assert(SessionManager::isValidId(id), "%s is not a valid ID.", id.c_str());
+        cr_assert(seen.insert(id).second, "%s was generated twice.", id.c_str());
+    }
+}
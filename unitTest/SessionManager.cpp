@@ -0,0 +1,151 @@
+#include <criterion.h>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+#include "SessionManager.hpp"
+#include "Cookie.hpp"
+
+static std::vector<std::string> createSessions(SessionManager& sessions, int count) {
+    std::vector<std::string> ids;
+    for (int i = 0; i < count; ++i)
+        ids.push_back(sessions.createSession());
+    return ids;
+}
+
+Test(session_manager, evicts_least_recently_used_past_cap) {
+    SessionManager sessions(3, 0, 0);
+    std::string a = sessions.createSession();
+    std::string b = sessions.createSession();
+    std::string c = sessions.createSession();
+    cr_assert_not_null(sessions.getSessionData(a), "A lookup should make a the newest.");
+    std::string d = sessions.createSession();
+    cr_assert_null(sessions.getSessionData(b), "b was the least recently used.");
+    cr_assert_not_null(sessions.getSessionData(a));
+    cr_assert_not_null(sessions.getSessionData(c));
+    cr_assert_not_null(sessions.getSessionData(d));
+    cr_assert_eq(sessions.getSessionCount(), 3);
+    cr_assert_eq(sessions.getCounters().evicted, 1);
+}
+
+Test(session_manager, table_survives_growth_and_eviction) {
+    SessionManager sessions(500, 0, 0);
+    std::vector<std::string> ids = createSessions(sessions, 1000);
+    cr_assert_eq(sessions.getSessionCount(), 500);
+    for (int i = 0; i < 1000; ++i) {
+        SessionData* session = sessions.getSessionData(ids[i]);
+        cr_assert_eq(session != NULL, i >= 500, "Session %d is in the wrong state.", i);
+    }
+}
+
+Test(session_manager, expires_idle_sessions) {
+    SessionManager sessions(100, 60, 0);
+    time_t now = time(NULL);
+    createSessions(sessions, 10);
+    sessions.expire(now + 30);
+    cr_assert_eq(sessions.getSessionCount(), 10, "Nothing is idle for long enough yet.");
+    sessions.expire(now + 61);
+    cr_assert_eq(sessions.getSessionCount(), 0);
+    cr_assert_eq(sessions.getCounters().expiredIdle, 10);
+}
+
+Test(session_manager, expires_sessions_past_their_lifetime) {
+    SessionManager sessions(100, 3600, 120);
+    time_t now = time(NULL);
+    createSessions(sessions, 10);
+    sessions.expire(now + 121);
+    cr_assert_eq(sessions.getSessionCount(), 0);
+    cr_assert_eq(sessions.getCounters().expiredLifetime, 10);
+}
+
+Test(session_manager, issues_fresh_ids_only) {
+    SessionManager sessions;
+    std::string id = sessions.createSession();
+    cr_assert(SessionManager::isValidId(id));
+    cr_assert_eq(id.size(), SessionManager::ID_LENGTH);
+    cr_assert_neq(sessions.createSession(), id, "Every session gets its own ID.");
+    cr_assert_null(sessions.getSessionData("chosen-by-the-client"), "An unknown ID is a miss.");
+    cr_assert_eq(sessions.getSessionCount(), 2, "A miss creates nothing.");
+}
+
+Test(session_manager, restores_sessions_from_file) {
+    const char* path = "/tmp/webserv_sessions_test";
+    std::remove(path);
+    std::string early;
+    std::vector<std::string> ids;
+    {
+        SessionManager sessions(300, 0, 0);
+        early = sessions.createSession();
+        cr_assert(sessions.attach(path));
+        ids = createSessions(sessions, 299);
+        sessions.getSessionData(early)->setRequestCount(7);
+    }
+    SessionManager restarted(300, 0, 0);
+    cr_assert(restarted.attach(path));
+    cr_assert_eq(restarted.getSessionCount(), 300);
+    cr_assert_eq(restarted.getCounters().created, 300);
+    SessionData* restored = restarted.getSessionData(early);
+    cr_assert_not_null(restored, "Sessions made before attaching move into the file.");
+    cr_assert_eq(restored->getRequestCount(), 7);
+    restarted.createSession();
+    cr_assert_null(restarted.getSessionData(ids[0]), "The LRU order survives the restart.");
+    std::remove(path);
+}
+
+Test(session_manager, recovers_table_after_crash) {
+    const char* path = "/tmp/webserv_sessions_crash";
+    const char* idsPath = "/tmp/webserv_sessions_crash_ids";
+    std::remove(path);
+    pid_t pid = fork();
+    if (pid == 0) {
+        SessionManager sessions(1000, 0, 0);
+        sessions.attach(path);
+        std::vector<std::string> ids = createSessions(sessions, 100);
+        std::ofstream out(idsPath);
+        for (size_t i = 0; i < ids.size(); ++i)
+            out << ids[i] << "\n";
+        out.close();
+        _exit(0); // Never closed: the file is left as a crash would leave it
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    SessionManager restarted(1000, 0, 0);
+    cr_assert(restarted.attach(path));
+    cr_assert_eq(restarted.getSessionCount(), 100);
+    std::ifstream in(idsPath);
+    std::string id;
+    int count = 0;
+    while (std::getline(in, id)) {
+        cr_assert_not_null(restarted.getSessionData(id), "Session %d was lost.", count);
+        ++count;
+    }
+    cr_assert_eq(count, 100);
+    std::remove(path);
+    std::remove(idsPath);
+}
+
+Test(session_manager, refuses_file_in_use_and_foreign_files) {
+    const char* path = "/tmp/webserv_sessions_locked";
+    {
+        std::ofstream foreign(path);
+        foreign << "not a session table";
+    }
+    SessionManager first;
+    cr_assert(first.attach(path), "A foreign file is started afresh.");
+    cr_assert_eq(first.getSessionCount(), 0);
+    SessionManager second;
+    cr_assert_not(second.attach(path), "The first manager holds the lock.");
+    cr_assert_eq(second.getFilePath(), "");
+    std::remove(path);
+}
+
+Test(cookie, finds_value_among_several_cookies) {
+    cr_assert_eq(Cookie::findValue("session_id=abc", "session_id"), "abc");
+    cr_assert_eq(Cookie::findValue("theme=dark; session_id=abc; lang=en", "session_id"), "abc");
+    cr_assert_eq(Cookie::findValue("theme=dark;session_id = \"abc\"", "session_id"), "abc");
+    cr_assert_eq(Cookie::findValue("my_session_id=xyz; session_id=abc", "session_id"), "abc");
+    cr_assert_eq(Cookie::findValue("theme=dark", "session_id"), "");
+    cr_assert_eq(Cookie::findValue("session_id", "session_id"), "");
+}
@@ -0,0 +1,69 @@
+#include <criterion.h>
+#include <string>
+#include <vector>
+#include "SessionToken.hpp"
+#include "Sha256.hpp"
+
+static std::string hex(const std::string& bytes) {
+    static const char digits[] = "0123456789abcdef";
+    std::string out;
+    for (size_t i = 0; i < bytes.size(); ++i) {
+        out += digits[static_cast<unsigned char>(bytes[i]) >> 4];
+        out += digits[static_cast<unsigned char>(bytes[i]) & 15];
+    }
+    return out;
+}
+
+Test(sha256, matches_fips_vectors) {
+    cr_assert_eq(hex(Sha256::digest("abc")), "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    cr_assert_eq(hex(Sha256::digest("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq")),
+        "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+    cr_assert_eq(hex(Sha256::digest(std::string(1000000, 'a'))), "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+}
+
+// RFC 4231, test cases 2 and 6
+Test(sha256, hmac_matches_rfc_vectors) {
+    cr_assert_eq(hex(Sha256::hmac("Jefe", "what do ya want for nothing?")),
+        "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843");
+    cr_assert_eq(hex(Sha256::hmac(std::string(131, '\xaa'), "Test Using Larger Than Block-Size Key - Hash Key First")),
+        "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54");
+}
+
+Test(session_token, round_trips_the_session) {
+    SessionData session("abcDEF123-_", 1000);
+    session.setRequestCount(41);
+    std::string token = SessionToken::issue(session, 5000, "current key");
+    std::vector<std::string> keys(1, "current key");
+    SessionData verified;
+    cr_assert(SessionToken::verify(token, keys, 4999, verified));
+    cr_assert_eq(verified.getSessionId(), "abcDEF123-_");
+    cr_assert_eq(verified.getRequestCount(), 41);
+    cr_assert_eq(verified.getCreatedAt(), 1000);
+    cr_assert_not(SessionToken::verify(token, keys, 5000, verified), "The token has expired.");
+}
+
+Test(session_token, rejects_tampered_tokens) {
+    SessionData session("abc", 1000);
+    std::string token = SessionToken::issue(session, 5000, "current key");
+    std::vector<std::string> keys(1, "current key");
+    SessionData verified;
+    for (size_t i = 0; i < token.size(); ++i) {
+        std::string forged = token;
+        forged[i] = forged[i] == 'A' ? 'B' : 'A';
+        cr_assert_not(SessionToken::verify(forged, keys, 2000, verified), "Forged at %lu.", (unsigned long)i);
+    }
+    cr_assert_not(SessionToken::verify("abc", keys, 2000, verified));
+    cr_assert_not(SessionToken::verify("", keys, 2000, verified));
+}
+
+Test(session_token, verifies_with_rotated_keys) {
+    SessionData session("abc", 1000);
+    std::string oldToken = SessionToken::issue(session, 5000, "old key");
+    std::vector<std::string> keys;
+    keys.push_back("new key");
+    keys.push_back("old key");
+    SessionData verified;
+    cr_assert(SessionToken::verify(oldToken, keys, 2000, verified), "The old key is still listed.");
+    keys.pop_back();
+    cr_assert_not(SessionToken::verify(oldToken, keys, 2000, verified), "The old key was retired.");
+}
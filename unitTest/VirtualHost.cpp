@@ -0,0 +1,54 @@
+#include <criterion.h>
+#include "VirtualHostIndex.hpp"
+
+static Server* makeServer(const std::string& name, int port, bool isDefault = false) {
+    Server* server = new Server();
+    server->setServerName(name);
+    server->setPorts(std::vector<int>(1, port));
+    server->setDefaultServer(isDefault);
+    return server;
+}
+
+Test(virtual_host, exact_name_ignores_case_and_port) {
+    std::map<std::string, Server*> servers;
+    servers["example.com"] = makeServer("example.com", 8080);
+    servers["apisafe.com"] = makeServer("apisafe.com", 8080);
+    VirtualHostIndex index;
+    index.build(servers);
+    cr_assert_eq(index.resolve(8080, "APIsafe.com:9999"), servers["apisafe.com"], "Host should match case-insensitively, ignoring its port.");
+    cr_assert_eq(index.resolve(8080, "example.com."), servers["example.com"], "A trailing dot should be ignored.");
+    cr_assert_null(index.resolve(8081, "example.com"), "A name must not match on a port its server does not listen on.");
+}
+
+Test(virtual_host, wildcard_and_default_fallback) {
+    std::map<std::string, Server*> servers;
+    servers["a.com"] = makeServer("a.com", 8080);
+    servers["*.example.com"] = makeServer("*.example.com", 8080);
+    servers["fallback"] = makeServer("fallback", 8080, true);
+    VirtualHostIndex index;
+    index.build(servers);
+    cr_assert_eq(index.resolve(8080, "www.img.example.com"), servers["*.example.com"], "Wildcard should match nested subdomains.");
+    cr_assert_eq(index.resolve(8080, "127.0.0.1:8080"), servers["fallback"], "Unknown hosts should go to the default_server.");
+    cr_assert_eq(index.getDefaultServer(8080), servers["fallback"], "default_server should win over the first server.");
+}
+
+Test(virtual_host, first_server_is_default) {
+    std::map<std::string, Server*> servers;
+    servers["a.com"] = makeServer("a.com", 8080);
+    servers["b.com"] = makeServer("b.com", 8080);
+    VirtualHostIndex index;
+    index.build(servers);
+    cr_assert_eq(index.resolve(8080, "[::1]:8080"), servers["a.com"], "Without default_server the first server is the default.");
+}
+
+Test(virtual_host, default_follows_config_order) {
+    std::map<std::string, Server*> servers;
+    servers["b.com"] = makeServer("b.com", 8080);
+    servers["b.com"]->setConfigOrder(0);
+    servers["a.com"] = makeServer("a.com", 8080);
+    servers["a.com"]->setConfigOrder(1);
+    VirtualHostIndex index;
+    index.build(servers);
+    cr_assert_eq(index.getDefaultServer(8080), servers["b.com"], "The first server in the file should be the default, not the first by name.");
+    cr_assert_eq(index.resolve(8080, "a.com"), servers["a.com"], "Names should still resolve.");
+}
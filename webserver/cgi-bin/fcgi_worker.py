@@ -0,0 +1,177 @@
+#!/usr/bin/env python3
+# FastCGI worker for cgi_pass=fastcgi://spawn:/cgi-bin/fcgi_worker.py
+#
+# Accepts connections on the socket webserv passes as stdin (FCGI_LISTENSOCK_FILENO)
+# and runs the script named by SCRIPT_FILENAME. Python scripts are compiled
+# once and run in this process, so a request costs no fork or interpreter
+# start-up; anything else is run as a plain CGI program. Requests on one
+# connection may be interleaved (FCGI_MPXS_CONNS); they are answered in
+# the order their input completes.
+
+import io
+import os
+import signal
+import socket
+import struct
+import subprocess
+import sys
+
+BEGIN_REQUEST, ABORT_REQUEST, END_REQUEST, PARAMS, STDIN, STDOUT, STDERR = 1, 2, 3, 4, 5, 6, 7
+GET_VALUES, GET_VALUES_RESULT, UNKNOWN_TYPE = 9, 10, 11
+REQUEST_COMPLETE, UNKNOWN_ROLE = 0, 3
+RESPONDER = 1
+HEADER = struct.Struct("!BBHHBx")
+MAX_REQUESTS = 16
+
+compiled = {}
+
+
+def record(kind, request_id, content=b""):
+    out = []
+    for start in range(0, max(len(content), 1), 65535):
+        chunk = content[start:start + 65535]
+        padding = -len(chunk) % 8
+        out.append(HEADER.pack(1, kind, request_id, len(chunk), padding) + chunk + b"\0" * padding)
+    return b"".join(out)
+
+
+def stream(kind, request_id, content):
+    return (record(kind, request_id, content) if content else b"") + record(kind, request_id)
+
+
+def decode_length(data, offset):
+    if data[offset] & 0x80:
+        return struct.unpack("!I", data[offset:offset + 4])[0] & 0x7fffffff, offset + 4
+    return data[offset], offset + 1
+
+
+def decode_pairs(data):
+    pairs, offset = {}, 0
+    while offset < len(data):
+        name_length, offset = decode_length(data, offset)
+        value_length, offset = decode_length(data, offset)
+        name = data[offset:offset + name_length].decode("latin-1")
+        offset += name_length
+        pairs[name] = data[offset:offset + value_length].decode("latin-1")
+        offset += value_length
+    return pairs
+
+
+def encode_pairs(pairs):
+    out = b""
+    for name, value in pairs.items():
+        name, value = name.encode(), value.encode()
+        for length in (len(name), len(value)):
+            out += bytes([length]) if length < 128 else struct.pack("!I", length | 0x80000000)
+        out += name + value
+    return out
+
+
+def run_python(path, params, body):
+    mtime = os.stat(path).st_mtime
+    cached = compiled.get(path)
+    if cached is None or cached[0] != mtime:
+        with open(path, "rb") as source:
+            cached = (mtime, compile(source.read(), path, "exec"))
+        compiled[path] = cached
+    saved = sys.stdin, sys.stdout, os.environ.copy()
+    output = io.BytesIO()
+    sys.stdin = io.TextIOWrapper(io.BytesIO(body))
+    writer = sys.stdout = io.TextIOWrapper(output, write_through=True)
+    os.environ.clear()
+    os.environ.update(params)
+    status, errors = 0, b""
+    try:
+        exec(cached[1], {"__name__": "__main__", "__file__": path})
+    except SystemExit as exit:
+        status = exit.code if isinstance(exit.code, int) else 1
+    except Exception as error:
+        status, errors = 1, ("%s: %r\n" % (path, error)).encode()
+    finally:
+        writer.flush()
+        writer.detach()
+        sys.stdin, sys.stdout = saved[0], saved[1]
+        os.environ.clear()
+        os.environ.update(saved[2])
+    return output.getvalue(), errors, status
+
+
+def run_program(path, params, body):
+    result = subprocess.run([path], input=body, env=params, capture_output=True)
+    return result.stdout, result.stderr, result.returncode
+
+
+def respond(request_id, params, body):
+    path = params.get("SCRIPT_FILENAME", "")
+    try:
+        if path.endswith(".py"):
+            output, errors, status = run_python(path, params, body)
+        else:
+            output, errors, status = run_program(path, params, body)
+    except OSError as error:
+        output, errors, status = b"", ("%s: %s\n" % (path, error.strerror)).encode(), 1
+    reply = stream(STDOUT, request_id, output)
+    if errors:
+        reply += stream(STDERR, request_id, errors)
+    return reply + record(END_REQUEST, request_id, struct.pack("!IB3x", status & 0xffffffff, REQUEST_COMPLETE))
+
+
+def serve(connection):
+    requests, buffer = {}, b""
+    while True:
+        data = connection.recv(65536)
+        if not data:
+            return
+        buffer += data
+        replies = []
+        while len(buffer) >= HEADER.size:
+            _, kind, request_id, length, padding = HEADER.unpack_from(buffer)
+            if len(buffer) < HEADER.size + length + padding:
+                break
+            content = buffer[HEADER.size:HEADER.size + length]
+            buffer = buffer[HEADER.size + length + padding:]
+            if kind == GET_VALUES:
+                values = {"FCGI_MPXS_CONNS": "1", "FCGI_MAX_REQS": str(MAX_REQUESTS), "FCGI_MAX_CONNS": "1"}
+                asked = decode_pairs(content)
+                replies.append(record(GET_VALUES_RESULT, 0, encode_pairs({k: v for k, v in values.items() if k in asked})))
+            elif kind == BEGIN_REQUEST:
+                role, flags = struct.unpack("!HB", content[:3])
+                if role != RESPONDER:
+                    replies.append(record(END_REQUEST, request_id, struct.pack("!IB3x", 0, UNKNOWN_ROLE)))
+                else:
+                    requests[request_id] = {"params": b"", "stdin": b"", "keep": flags & 1}
+            elif kind == ABORT_REQUEST and request_id in requests:
+                del requests[request_id]
+                replies.append(record(END_REQUEST, request_id, struct.pack("!IB3x", 0, REQUEST_COMPLETE)))
+            elif kind == PARAMS and request_id in requests:
+                requests[request_id]["params"] += content
+            elif kind == STDIN and request_id in requests:
+                if content:
+                    requests[request_id]["stdin"] += content
+                    continue
+                request = requests.pop(request_id)
+                replies.append(respond(request_id, decode_pairs(request["params"]), request["stdin"]))
+                if not request["keep"]:
+                    connection.sendall(b"".join(replies))
+                    return
+            elif kind > GET_VALUES_RESULT:
+                replies.append(record(UNKNOWN_TYPE, 0, bytes([kind]) + b"\0" * 7))
+        if replies:
+            connection.sendall(b"".join(replies))
+
+
+def main():
+    signal.signal(signal.SIGINT, signal.SIG_DFL)
+    signal.signal(signal.SIGTERM, signal.SIG_DFL)
+    listener = socket.socket(fileno=0)
+    while True:
+        connection, _ = listener.accept()
+        with connection:
+            try:
+                serve(connection)
+            except (ConnectionError, struct.error):
+                pass
+
+
+if __name__ == "__main__":
+    main()